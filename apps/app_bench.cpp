@@ -0,0 +1,1549 @@
+#include <cstdio>
+#include <queue>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <vector>
+#include <chrono>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <cstdlib>
+#include <ctime>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include "trt_common/mpmc_queue.hpp"
+#include "trt_common/infer_controller.hpp"
+#include "trt_common/event_count.hpp"
+#include "trt_common/trt_tensor.hpp"
+#include "trt_common/memory_allocator.hpp"
+#include "trt_common/ilogger.hpp"
+#include "trt_common/preprocess_kernel_cpu.hpp"
+#include "trt_common/cpu_nms.hpp"
+#include "apps/yolo/yolo.hpp"
+#include "apps/bytetrack/BYTETracker.h"
+#include "apps/bytetrack/kalmanBatch.h"
+#include "apps/bytetrack/trackerManager.h"
+#include "apps/bytetrack/keyframeTracker.h"
+#include "apps/bytetrack/lapjv.h"
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+
+/// 不需要模型和 GPU 的基准测试，由 config.yaml 中的 task: "bench" 调用
+
+static double now_ms(){
+    return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// ---------------------------------- job queue ----------------------------------
+/// 与 InferController::Job 大小相近的任务：promise + 提交时间 + 输入
+struct BenchJob{
+    int input = 0;
+    shared_ptr<promise<int>> pro;
+    chrono::steady_clock::time_point commit_time;
+};
+
+/// 原来的实现：std::queue + mutex + condition_variable
+class LockedJobQueue{
+public:
+    void push(BenchJob&& job){
+        {
+            unique_lock<mutex> l(lock_);
+            jobs_.push(move(job));
+        }
+        cond_.notify_one();
+    }
+
+    bool pop_batch(vector<BenchJob>& batch, int max_size){
+        unique_lock<mutex> l(lock_);
+        cond_.wait(l, [&](){ return closed_ || !jobs_.empty(); });
+        batch.clear();
+        for(int i = 0; i < max_size && !jobs_.empty(); ++i){
+            batch.emplace_back(move(jobs_.front()));
+            jobs_.pop();
+        }
+        return !batch.empty();
+    }
+
+    void close(){
+        {
+            unique_lock<mutex> l(lock_);
+            closed_ = true;
+        }
+        cond_.notify_all();
+    }
+
+private:
+    mutex lock_;
+    condition_variable cond_;
+    queue<BenchJob> jobs_;
+    bool closed_ = false;
+};
+
+class LockFreeJobQueue{
+public:
+    void push(BenchJob&& job){ jobs_.push(move(job)); }
+
+    bool pop_batch(vector<BenchJob>& batch, int max_size){
+        BenchJob job;
+        batch.clear();
+        if(!jobs_.pop(job)) return false;
+        batch.emplace_back(move(job));
+        while(batch.size() < max_size && jobs_.try_pop(job))
+            batch.emplace_back(move(job));
+        return true;
+    }
+
+    void close(){ jobs_.close(); }
+
+private:
+    MPMCQueue<BenchJob> jobs_{1024};
+};
+
+/// 多个生产者（相当于相机线程调用 commit 并等待结果）+ 一个消费者（相当于 worker 按 batch 取任务）
+/// 每个生产者最多有 MAX_INFLIGHT 个未完成的任务，和 TensorAllocator 限制在途任务数的效果一样，队列不会被塞满
+template<class Queue>
+static void bench_queue_once(const char* name, int num_producers, int num_items){
+    const int MAX_INFLIGHT = 8;
+    Queue queue;
+    int items_per_producer = num_items / num_producers;
+    vector<double> commit_ns(num_producers, 0);
+    long long consumed = 0;
+
+    thread consumer([&](){
+        vector<BenchJob> batch;
+        while(queue.pop_batch(batch, 16)){
+            for(auto& job : batch){
+                consumed += job.input;
+                job.pro->set_value(job.input);
+            }
+        }
+    });
+
+    double begin = now_ms();
+    vector<thread> producers;
+    for(int p = 0; p < num_producers; ++p){
+        producers.emplace_back([&, p](){
+            vector<future<int>> inflight(MAX_INFLIGHT);
+            double total_ns = 0;
+            for(int i = 0; i < items_per_producer; ++i){
+                auto& slot = inflight[i % MAX_INFLIGHT];
+                if(slot.valid()) slot.get();
+
+                BenchJob job;
+                job.input = 1;
+                job.pro = make_shared<promise<int>>();
+                slot = job.pro->get_future();
+
+                auto t0 = chrono::steady_clock::now();
+                job.commit_time = t0;
+                queue.push(move(job));
+                total_ns += chrono::duration<double, nano>(chrono::steady_clock::now() - t0).count();
+            }
+            for(auto& slot : inflight)
+                if(slot.valid()) slot.get();
+            commit_ns[p] = total_ns / items_per_producer;
+        });
+    }
+
+    for(auto& t : producers) t.join();
+    queue.close();
+    consumer.join();
+    double elapsed = now_ms() - begin;
+
+    double avg_commit_ns = 0;
+    for(auto v : commit_ns) avg_commit_ns += v / num_producers;
+
+    long long total = (long long)items_per_producer * num_producers;
+    printf("  %-10s producers=%-3d jobs=%-8lld %8.2f ms  %7.3f Mjobs/s  push %.0f ns/job%s\n",
+           name, num_producers, total, elapsed, total / elapsed / 1000.0, avg_commit_ns,
+           consumed == total ? "" : "  [LOST JOBS]");
+}
+
+void bench_job_queue(int num_items){
+    printf("Job queue contention: %d jobs, 1 consumer taking batches of 16, %d hardware threads\n",
+           num_items, (int)thread::hardware_concurrency());
+    for(int num_producers : {1, 2, 4, 8, 16, 32, 64}){
+        bench_queue_once<LockedJobQueue>("mutex", num_producers, num_items);
+        bench_queue_once<LockFreeJobQueue>("lock-free", num_producers, num_items);
+    }
+}
+
+/// ---------------------------------- job allocations ----------------------------------
+/// 统计堆分配次数：libLinfer 不替换全局 operator new，由单独的 bench_alloc 程序（bench_alloc.cpp）替换并调用 bench_count_alloc，
+/// 在 pro 里运行这些 bench 时分配次数显示为 n/a
+static atomic<bool> g_alloc_hooked{false};
+static atomic<bool> g_count_allocs{false};
+static atomic<uint64_t> g_num_allocs{0};
+
+void bench_set_alloc_hooked(){
+    g_alloc_hooked = true;
+}
+
+void bench_count_alloc(){
+    if(g_count_allocs.load(memory_order_relaxed))
+        g_num_allocs.fetch_add(1, memory_order_relaxed);
+}
+
+static string format_allocs(const char* fmt, double allocs){
+    return g_alloc_hooked ? iLogger::format(fmt, allocs) : string("n/a");
+}
+
+/// 与 Yolo::Box 相同的布局
+struct BenchBox{
+    float left, top, right, bottom, confidence;
+    int label;
+
+    BenchBox(float left, float top, float right, float bottom, float confidence, int label)
+        :left(left), top(top), right(right), bottom(bottom), confidence(confidence), label(label){}
+};
+
+using BenchBoxArray = vector<BenchBox>;
+
+/// 不加载模型的 controller：worker 把固定的 decode 结果（counter + 每个框 7 个 float）交给 postprocess，
+/// 除了 forward 之外，任务经过的路径和 yolo 完全一样
+class BenchController : public InferController<int, BenchBoxArray>{
+public:
+    static const int NUM_BOXES       = 20;
+    static const int NUM_BOX_ELEMENT = 7;
+
+    ~BenchController() override{
+        stop();
+    }
+
+    using InferController::commit;
+
+protected:
+    void worker(promise<bool>& result) override{
+        vector<float> decoded(1 + NUM_BOXES * NUM_BOX_ELEMENT, 1.0f);
+        decoded[0] = NUM_BOXES;
+        result.set_value(true);
+
+        vector<Job> fetch_jobs;
+        while(get_jobs_and_wait(fetch_jobs, 16)){
+            for(auto& job : fetch_jobs){
+                job.host_output.assign(decoded.begin(), decoded.end());
+                finish(move(job));
+            }
+            fetch_jobs.clear();
+        }
+    }
+
+    bool preprocess(Job& job, const int& input) override{
+        job.additional = input;
+        return true;
+    }
+
+    void postprocess(Job& job) override{
+        float* parray = job.host_output.data();
+        int count     = (job.host_output.size() - 1) / NUM_BOX_ELEMENT;
+        auto& boxes   = job.output;
+        boxes.reserve(count);
+        for(int i = 0; i < count; ++i){
+            float* pbox = parray + 1 + i * NUM_BOX_ELEMENT;
+            boxes.emplace_back(pbox[0], pbox[1], pbox[2], pbox[3], pbox[4], (int)pbox[5]);
+        }
+    }
+};
+
+enum class CommitMode : int{
+    FutureCopy = 0,   // auto boxes = commit(image).get()，常见的用法
+    FutureRef  = 1,   // const auto& boxes = commit(image).get()
+    Callback   = 2    // commit(image, stream_id, callback)
+};
+
+static void bench_alloc_once(const char* name, CommitMode mode, int num_frames){
+    const int MAX_INFLIGHT = 8;
+    const int WARMUP       = 1000;
+    BenchController controller;
+    controller.startup(make_tuple(string(), 0));
+
+    // callback 只捕获一个指针，和 std::function 的小对象优化对齐，不额外分配
+    struct Progress{
+        long long num_boxes = 0;
+        atomic<int> done{0};
+        EventCount done_event;
+    } progress;
+
+    long long& num_boxes = progress.num_boxes;
+    auto wait_done = [&](int target){
+        while(progress.done.load(memory_order_acquire) < target){
+            auto key = progress.done_event.prepare_wait();
+            if(progress.done.load(memory_order_acquire) >= target){
+                progress.done_event.cancel_wait();
+                break;
+            }
+            progress.done_event.wait(key);
+        }
+    };
+    deque<shared_future<BenchBoxArray>> inflight;
+    auto consume = [&](){
+        auto& future = inflight.front();
+        if(mode == CommitMode::FutureCopy){
+            BenchBoxArray boxes = future.get();
+            num_boxes += boxes.size();
+        }else{
+            const BenchBoxArray& boxes = future.get();
+            num_boxes += boxes.size();
+        }
+        inflight.pop_front();
+    };
+
+    double begin = 0;
+    for(int i = 0; i < WARMUP + num_frames; ++i){
+        if(i == WARMUP){
+            // 先跑一段让各种池子稳定下来，之后的分配才是每帧真正的开销
+            while(!inflight.empty()) consume();
+            if(mode == CommitMode::Callback) wait_done(i);
+            g_num_allocs = 0;
+            g_count_allocs = true;
+            begin = now_ms();
+        }
+
+        if(mode == CommitMode::Callback){
+            wait_done(i - MAX_INFLIGHT + 1);
+            Progress* p = &progress;
+            controller.commit(i, -1, [p](BenchBoxArray&& boxes){
+                p->num_boxes += boxes.size();
+                p->done.fetch_add(1, memory_order_release);
+                p->done_event.notify_one();
+            });
+        }else{
+            if(inflight.size() >= MAX_INFLIGHT) consume();
+            inflight.emplace_back(controller.commit(i));
+        }
+    }
+    while(!inflight.empty()) consume();
+    if(mode == CommitMode::Callback) wait_done(WARMUP + num_frames);
+
+    double elapsed = now_ms() - begin;
+    g_count_allocs = false;
+    uint64_t allocs = g_num_allocs.load();
+
+    printf("  %-16s frames=%-8d %8.2f ms  %6.2f us/frame  %5s allocs/frame%s\n",
+           name, num_frames, elapsed, elapsed * 1000 / num_frames, format_allocs("%.2f", allocs / (double)num_frames).c_str(),
+           num_boxes == (long long)(WARMUP + num_frames) * BenchController::NUM_BOXES ? "" : "  [LOST BOXES]");
+}
+
+void bench_job_alloc(int num_frames){
+    printf("Job allocations: %d frames, %d boxes per frame, up to 8 frames in flight\n",
+           num_frames, BenchController::NUM_BOXES);
+    bench_alloc_once("future + copy", CommitMode::FutureCopy, num_frames);
+    bench_alloc_once("future", CommitMode::FutureRef, num_frames);
+    bench_alloc_once("callback", CommitMode::Callback, num_frames);
+}
+
+/// ---------------------------------- MixMemory allocator ----------------------------------
+/// 统计向 upstream 申请的次数，GPU 上对应 cudaMalloc / cudaMallocHost（以及带同步的释放），是真正昂贵的部分；
+/// host 内存的 malloc 本身已经有 glibc 的缓存，所以这里的耗时差别不大
+class CountingAllocator : public TRT::MemoryAllocator{
+public:
+    explicit CountingAllocator(shared_ptr<TRT::MemoryAllocator> upstream) : upstream_(upstream){}
+
+    TRT::MemoryBlock allocate(TRT::MemoryKind kind, int device_id, size_t size) override{
+        num_allocate++;
+        return upstream_->allocate(kind, device_id, size);
+    }
+
+    void deallocate(TRT::MemoryKind kind, int device_id, const TRT::MemoryBlock& block) override{
+        upstream_->deallocate(kind, device_id, block);
+    }
+
+    atomic<uint64_t> num_allocate{0};
+
+private:
+    shared_ptr<TRT::MemoryAllocator> upstream_;
+};
+
+/// 模拟预处理的内存使用：输入图像的尺寸在几种分辨率之间变化
+///   temporary：每帧新建一块 host 内存放图像，用完释放（相当于每帧的临时 Tensor）
+///   workspace：16 个常驻的 workspace 轮流使用，图像变大时重新分配（相当于 TensorAllocator 里的 tensor）
+/// 只用 CPU_DEVICE_ID 的 host 内存，没有 GPU 也可以运行
+static void bench_memory_once(const char* name, bool caching, int num_frames){
+    const int sizes[][2] = {{640, 480}, {1280, 720}, {1920, 1080}, {1920, 1088}, {1280, 960}, {1024, 768}, {800, 600}};
+    const int num_sizes  = sizeof(sizes) / sizeof(sizes[0]);
+    const int NUM_WORKSPACE = 16;
+
+    auto upstream = make_shared<CountingAllocator>(TRT::create_host_allocator());
+    shared_ptr<TRT::MemoryAllocator> allocator = upstream;
+    if(caching) allocator = make_shared<TRT::CachingAllocator>(upstream);
+    TRT::set_memory_allocator(allocator);
+
+    string temporary_owner = string(name) + ".temporary";
+    string workspace_owner = string(name) + ".workspace";
+
+    vector<shared_ptr<TRT::MixMemory>> workspaces(NUM_WORKSPACE);
+    for(auto& workspace : workspaces){
+        workspace = make_shared<TRT::MixMemory>(CPU_DEVICE_ID);
+        workspace->set_owner(workspace_owner);
+    }
+
+    unsigned int seed = 13;
+    long long checksum = 0;
+    double begin = now_ms();
+    for(int i = 0; i < num_frames; ++i){
+        seed = seed * 1103515245 + 12345;
+        auto& size = sizes[(seed >> 16) % num_sizes];
+        size_t bytes = (size_t)size[0] * size[1] * 3;
+
+        TRT::MixMemory temporary(CPU_DEVICE_ID);
+        temporary.set_owner(temporary_owner);
+        uint8_t* image = (uint8_t*)temporary.cpu(bytes);
+        image[bytes - 1] = i;
+
+        uint8_t* workspace = (uint8_t*)workspaces[i % NUM_WORKSPACE]->cpu(bytes);
+        workspace[bytes - 1] = image[bytes - 1];
+        checksum += workspace[bytes - 1];
+    }
+    double elapsed = now_ms() - begin;
+    workspaces.clear();
+
+    uint64_t temporary_allocs = 0, workspace_allocs = 0;
+    size_t peak_bytes = 0;
+    for(auto& stats : TRT::memory_stats()){
+        if(stats.owner == temporary_owner) temporary_allocs = stats.num_alloc;
+        if(stats.owner == workspace_owner) workspace_allocs = stats.num_alloc;
+        if(stats.owner == temporary_owner || stats.owner == workspace_owner) peak_bytes += stats.peak_bytes;
+    }
+
+    printf("  %-8s frames=%-7d %8.2f ms  %7.2f us/frame  upstream allocs=%-6llu workspace reallocs=%-4llu peak %.1f MB%s\n",
+           name, num_frames, elapsed, elapsed * 1000 / num_frames, (unsigned long long)upstream->num_allocate.load(),
+           (unsigned long long)workspace_allocs, peak_bytes / 1024.0 / 1024.0,
+           checksum >= 0 && temporary_allocs == (uint64_t)num_frames ? "" : "  [BAD]");
+}
+
+void bench_mix_memory(int num_frames){
+    printf("MixMemory allocator: %d frames, image size changes between 7 resolutions\n", num_frames);
+    auto previous = TRT::get_memory_allocator();
+    bench_memory_once("system", false, num_frames);
+    bench_memory_once("caching", true, num_frames);
+    TRT::set_memory_allocator(previous);
+}
+
+/// ---------------------------------- logger ----------------------------------
+static double thread_cpu_ns(){
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/// num_threads 个线程同时写日志，统计每次调用占用调用线程的 CPU 时间（线程数多于核数时墙上时间包含了被调度走的时间）
+/// 另外给出包含 flush 线程输出在内的总吞吐
+static double bench_logger_once(const char* name, bool filtered, int num_threads, int num_logs){
+
+    atomic<int> ready{0};
+    atomic<bool> go{false};
+    vector<double> elapsed(num_threads, 0);
+    vector<thread> threads;
+    for(int t = 0; t < num_threads; ++t){
+        threads.emplace_back([&, t]{
+            ready++;
+            while(!go.load()) this_thread::yield();
+
+            double tic = thread_cpu_ns();
+            for(int i = 0; i < num_logs; ++i){
+                if(filtered)
+                    INFOD("thread %d, log %d, value %f", t, i, i * 0.5f);
+                else
+                    INFO("thread %d, log %d, value %f", t, i, i * 0.5f);
+            }
+            elapsed[t] = thread_cpu_ns() - tic;
+        });
+    }
+    while(ready.load() < num_threads) this_thread::yield();
+
+    double tic = now_ms();
+    go = true;
+    for(auto& t : threads) t.join();
+    iLogger::flush_logger();
+    double total = now_ms() - tic;
+
+    double sum = 0;
+    for(auto e : elapsed) sum += e;
+    double ns_per_call = sum / num_threads / num_logs;
+    printf("  %-10s threads=%-3d logs=%-9lld %8.2f ns/call  %10.0f logs/s (including flush)\n",
+           name, num_threads, (long long)num_threads * num_logs, ns_per_call, num_threads * (double)num_logs / total * 1000);
+    return ns_per_call;
+}
+
+void bench_logger(int num_threads, int num_logs){
+    printf("Logger: %d threads x %d logs, console off, files in /tmp/linfer_bench_logs\n", num_threads, num_logs);
+
+    auto previous_level     = iLogger::get_logger_level();
+    auto previous_directory = iLogger::get_logger_save_directory();
+    bool previous_async     = iLogger::is_logger_async();
+    bool previous_console   = iLogger::is_logger_console();
+    iLogger::flush_logger();
+
+    iLogger::set_logger_console(false);
+    iLogger::set_logger_level(iLogger::LogLevel::Info);
+    bench_logger_once("filtered", true, num_threads, num_logs);
+
+    iLogger::set_logger_save_directory("/tmp/linfer_bench_logs");
+    iLogger::set_logger_async(false);
+    bench_logger_once("sync", false, num_threads, num_logs);
+
+    iLogger::set_logger_async(true);
+    bench_logger_once("async", false, num_threads, num_logs);
+
+    iLogger::flush_logger();
+    iLogger::set_logger_save_directory(previous_directory);
+    iLogger::set_logger_async(previous_async);
+    iLogger::set_logger_console(previous_console);
+    iLogger::set_logger_level(previous_level);
+}
+
+/// ---------------------------------- warp affine ----------------------------------
+/// letterbox 到 640x640 + 归一化 + HWC -> CHW：OpenCV 四步（warpAffine、convertTo、split、逐平面运算）
+/// 对比 CPUKernel 的标量和 SIMD 版本，单线程和 OpenCV 线程池上的多线程
+static double bench_warp_once(int repeat, const function<void()>& func){
+    func();
+    double best = 1e9;
+    for(int i = 0; i < repeat; ++i){
+        double tic = now_ms();
+        func();
+        best = min(best, now_ms() - tic);
+    }
+    return best;
+}
+
+static float max_abs_diff(const float* a, const float* b, size_t size){
+    float diff = 0;
+    for(size_t i = 0; i < size; ++i)
+        diff = max(diff, fabs(a[i] - b[i]));
+    return diff;
+}
+
+void bench_warp_affine(int repeat){
+    const int dst_width = 640, dst_height = 640;
+    const float mean[] = {0.485f, 0.456f, 0.406f};
+    const float std[]  = {0.229f, 0.224f, 0.225f};
+    auto norm = CUDAKernel::Norm::mean_std(mean, std, 1 / 255.0f, CUDAKernel::ChannelType::Invert);
+    int num_threads = cv::getNumThreads();
+
+    printf("Warp affine + normalize to %dx%d, best of %d, AVX2 %s, %d threads\n",
+           dst_width, dst_height, repeat, CPUKernel::is_simd_available() ? "yes" : "no", num_threads);
+
+    cv::Size sizes[] = {{1280, 720}, {1920, 1080}, {3840, 2160}};
+    for(auto& size : sizes){
+        cv::Mat image(size, CV_8UC3);
+        cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+
+        // 与 yolo 的 AffineMatrix 相同：等比缩放，居中
+        float scale = std::min(dst_width / (float)size.width, dst_height / (float)size.height);
+        float i2d[6], d2i[6];
+        i2d[0] = scale;  i2d[1] = 0;  i2d[2] = (-scale * size.width + dst_width + scale - 1) * 0.5f;
+        i2d[3] = 0;  i2d[4] = scale;  i2d[5] = (-scale * size.height + dst_height + scale - 1) * 0.5f;
+        cv::Mat m2x3_i2d(2, 3, CV_32F, i2d);
+        cv::Mat m2x3_d2i(2, 3, CV_32F, d2i);
+        cv::invertAffineTransform(m2x3_i2d, m2x3_d2i);
+
+        size_t volume = 3 * dst_width * dst_height;
+        vector<float> opencv_output(volume), scalar_output(volume), simd_output(volume);
+
+        auto run_opencv = [&]{
+            cv::Mat warped, input;
+            cv::warpAffine(image, warped, m2x3_i2d, cv::Size(dst_width, dst_height), cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar::all(114));
+            warped.convertTo(input, CV_32F);
+            cv::Mat planes[3];
+            for(int c = 0; c < 3; ++c)
+                planes[c] = cv::Mat(dst_height, dst_width, CV_32F, opencv_output.data() + (2 - c) * dst_width * dst_height);
+            cv::split(input, planes);
+            for(int c = 0; c < 3; ++c)
+                planes[c] = (planes[c] * (1 / 255.0f) - mean[c]) / std[c];
+        };
+
+        auto run_kernel = [&](vector<float>& output){
+            CPUKernel::warp_affine_bilinear_and_normalize_plane(
+                image.data, image.step, image.cols, image.rows,
+                output.data(), dst_width, dst_height,
+                d2i, 114, norm
+            );
+        };
+
+        double opencv_ms = bench_warp_once(repeat, run_opencv);
+        CPUKernel::set_simd_enabled(false);
+        double scalar_ms = bench_warp_once(repeat, [&]{ run_kernel(scalar_output); });
+        CPUKernel::set_simd_enabled(true);
+        double simd_ms   = bench_warp_once(repeat, [&]{ run_kernel(simd_output); });
+
+        cv::setNumThreads(1);
+        double opencv_1t_ms = bench_warp_once(repeat, run_opencv);
+        double simd_1t_ms   = bench_warp_once(repeat, [&]{ run_kernel(simd_output); });
+        cv::setNumThreads(num_threads);
+
+        printf("  %4dx%-4d  opencv %7.3f ms (1 thread %7.3f)  scalar %7.3f ms  simd %7.3f ms (1 thread %7.3f)  "
+               "simd vs scalar max diff %g, vs opencv %g\n",
+               size.width, size.height, opencv_ms, opencv_1t_ms, scalar_ms, simd_ms, simd_1t_ms,
+               max_abs_diff(simd_output.data(), scalar_output.data(), volume),
+               max_abs_diff(simd_output.data(), opencv_output.data(), volume));
+    }
+}
+
+/// ---------------------------------- cpu nms ----------------------------------
+/// 原来的 Yolo::cpu_nms（排序 + O(n²) 逐对判断 label），去掉了 box_result(boxes.size()) 预先构造的空框
+static float legacy_iou(const Yolo::Box& a, const Yolo::Box& b){
+    float cross_left   = std::max(a.left, b.left);
+    float cross_top    = std::max(a.top, b.top);
+    float cross_right  = std::min(a.right, b.right);
+    float cross_bottom = std::min(a.bottom, b.bottom);
+
+    float cross_area = std::max(0.0f, cross_right - cross_left) * std::max(0.0f, cross_bottom - cross_top);
+    float union_area = std::max(0.0f, a.right - a.left) * std::max(0.0f, a.bottom - a.top)
+                       + std::max(0.0f, b.right - b.left) * std::max(0.0f, b.bottom - b.top) - cross_area;
+    if(cross_area == 0.f || union_area == 0.f) return 0.0f;
+    return cross_area / union_area;
+}
+
+static Yolo::BoxArray legacy_cpu_nms(Yolo::BoxArray& boxes, float threshold){
+    std::sort(boxes.begin(), boxes.end(), [](Yolo::Box& a, Yolo::Box& b){return a.confidence > b.confidence;});
+    Yolo::BoxArray box_result;
+    box_result.reserve(boxes.size());
+    vector<bool> remove_flags(boxes.size());
+    for(int i = 0; i < boxes.size(); ++i){
+        if(remove_flags[i]) continue;
+        auto& a = boxes[i];
+        box_result.emplace_back(a);
+        for(int j = i + 1; j < boxes.size(); ++j){
+            if(remove_flags[j]) continue;
+            auto& b = boxes[j];
+            if(b.label == a.label){
+                if(legacy_iou(a, b) >= threshold)
+                    remove_flags[j] = true;
+            }
+        }
+    }
+    return box_result;
+}
+
+/// 模拟 decode 之后的候选框：每个目标周围 30 个抖动的框，80 类，1920x1080
+/// 分数互不相同，否则原来的 std::sort 对相同分数的顺序不确定，结果无法逐个比较
+static Yolo::BoxArray make_nms_candidates(int count, unsigned seed){
+    mt19937 rng(seed);
+    uniform_real_distribution<float> uniform(0, 1);
+    vector<float> scores(count);
+    for(int i = 0; i < count; ++i)
+        scores[i] = 0.25f + 0.75f * (i + 0.5f) / count;
+    shuffle(scores.begin(), scores.end(), rng);
+    Yolo::BoxArray boxes;
+    boxes.reserve(count);
+    while((int)boxes.size() < count){
+        float width  = 20 + uniform(rng) * 300;
+        float height = 20 + uniform(rng) * 300;
+        float left   = uniform(rng) * (1920 - width);
+        float top    = uniform(rng) * (1080 - height);
+        int label    = rng() % 80;
+        for(int i = 0; i < 30 && (int)boxes.size() < count; ++i){
+            float jitter_x = (uniform(rng) - 0.5f) * width * 0.3f;
+            float jitter_y = (uniform(rng) - 0.5f) * height * 0.3f;
+            float scale    = 0.85f + uniform(rng) * 0.3f;
+            boxes.emplace_back(left + jitter_x, top + jitter_y, left + jitter_x + width * scale, top + jitter_y + height * scale,
+                               scores[boxes.size()], (uniform(rng) < 0.9f) ? label : (int)(rng() % 80));
+        }
+    }
+    return boxes;
+}
+
+static bool same_boxes(const Yolo::BoxArray& a, const Yolo::BoxArray& b){
+    if(a.size() != b.size()) return false;
+    for(size_t i = 0; i < a.size(); ++i){
+        if(a[i].left != b[i].left || a[i].top != b[i].top || a[i].right != b[i].right || a[i].bottom != b[i].bottom ||
+           a[i].confidence != b[i].confidence || a[i].label != b[i].label)
+            return false;
+    }
+    return true;
+}
+
+void bench_nms(int repeat){
+    printf("CPU NMS: best of %d, iou 0.45, AVX2 %s\n", repeat, NMS::is_simd_available() ? "yes" : "no");
+
+    auto time_it = [&](const function<void()>& func){
+        double best = 1e9;
+        for(int i = 0; i < repeat; ++i){
+            double tic = now_ms();
+            func();
+            best = min(best, now_ms() - tic);
+        }
+        return best;
+    };
+
+    int counts[] = {1000, 5000, 10000, 30000};
+    for(int count : counts){
+        auto candidates = make_nms_candidates(count, count);
+        Yolo::BoxArray legacy_result, result;
+
+        NMS::Config config;
+        config.iou_threshold = 0.45f;
+        double legacy_ms = time_it([&]{ auto boxes = candidates; legacy_result = legacy_cpu_nms(boxes, config.iou_threshold); });
+        double hard_ms   = time_it([&]{ result = NMS::cpu_nms(candidates, config); });
+        bool same        = same_boxes(legacy_result, result);
+
+        NMS::set_simd_enabled(false);
+        double scalar_ms = time_it([&]{ result = NMS::cpu_nms(candidates, config); });
+        same = same && same_boxes(legacy_result, result);
+        NMS::set_simd_enabled(true);
+
+        auto variant = [&](const NMS::Config& variant_config, int& num_kept){
+            Yolo::BoxArray output;
+            double ms = time_it([&]{ output = NMS::cpu_nms(candidates, variant_config); });
+            num_kept = output.size();
+            return ms;
+        };
+
+        int kept_max_det, kept_agnostic, kept_diou, kept_soft;
+        NMS::Config max_det_config = config;
+        max_det_config.top_k   = 5000;
+        max_det_config.max_det = 300;
+        double max_det_ms = variant(max_det_config, kept_max_det);
+
+        NMS::Config agnostic_config = config;
+        agnostic_config.class_agnostic = true;
+        double agnostic_ms = variant(agnostic_config, kept_agnostic);
+
+        NMS::Config diou_config = config;
+        diou_config.mode = NMS::Mode::DIoU;
+        double diou_ms = variant(diou_config, kept_diou);
+
+        NMS::Config soft_config = max_det_config;
+        soft_config.mode            = NMS::Mode::SoftGaussian;
+        soft_config.score_threshold = 0.001f;
+        double soft_ms = variant(soft_config, kept_soft);
+
+        printf("  %6d boxes  legacy %8.3f ms  hard %7.3f ms (scalar %7.3f, %d kept, %s)  top_k+max_det %7.3f ms (%d)  "
+               "agnostic %7.3f ms (%d)  diou %7.3f ms (%d)  soft %7.3f ms (%d)\n",
+               count, legacy_ms, hard_ms, scalar_ms, (int)result.size(), same ? "same as legacy" : "DIFFERENT",
+               max_det_ms, kept_max_det, agnostic_ms, kept_agnostic, diou_ms, kept_diou, soft_ms, kept_soft);
+    }
+}
+
+/// ---------------------------------- yolo decode ----------------------------------
+/// 模拟模型输出：大部分位置的分数很低，少量位置有一个类别超过阈值
+/// V8 同时生成 [N, 4 + C] 和导出时不转置的 [4 + C, N]，两种布局的解码结果应完全相同
+namespace Yolo{
+    void decode_cpu_invoker(const float* predict, int num_bboxes, int num_classes, float confidence_threshold,
+                            const float* invert_affine_matrix, float* parray, int max_objects, Type type, bool column_major);
+};
+
+static vector<float> make_decode_output(int num_bboxes, int num_classes, bool objectness, unsigned seed){
+    mt19937 rng(seed);
+    uniform_real_distribution<float> uniform(0, 1);
+    int head  = objectness ? 5 : 4;
+    int width = head + num_classes;
+    vector<float> output((size_t)num_bboxes * width);
+    for(int i = 0; i < num_bboxes; ++i){
+        float* pitem = output.data() + (size_t)i * width;
+        pitem[0] = uniform(rng) * 640;
+        pitem[1] = uniform(rng) * 640;
+        pitem[2] = 10 + uniform(rng) * 200;
+        pitem[3] = 10 + uniform(rng) * 200;
+        bool positive = uniform(rng) < 0.01f;
+        if(objectness)
+            pitem[4] = positive ? 0.5f + 0.5f * uniform(rng) : uniform(rng) * 0.3f;
+        for(int c = 0; c < num_classes; ++c)
+            pitem[head + c] = uniform(rng) * 0.05f;
+        if(positive)
+            pitem[head + rng() % num_classes] = 0.5f + 0.5f * uniform(rng);
+    }
+    return output;
+}
+
+static vector<float> to_column_major(const vector<float>& output, int num_bboxes, int width){
+    vector<float> transposed(output.size());
+    for(int i = 0; i < num_bboxes; ++i)
+        for(int j = 0; j < width; ++j)
+            transposed[(size_t)j * num_bboxes + i] = output[(size_t)i * width + j];
+    return transposed;
+}
+
+/// num_threads 为并行解码时 OpenCV 的线程数，<= 0 时使用 cv::getNumThreads()，> 1 时才会覆盖到多个线程写各自的分段
+void bench_decode(int repeat, int num_threads){
+    const int max_objects = 1024;
+    const float threshold = 0.25f;
+    const float d2i[] = {2, 0, -1, 0, 2, -1};
+    int default_threads = cv::getNumThreads();
+    if(num_threads <= 0) num_threads = default_threads;
+    printf("Yolo CPU decode: best of %d, threshold %g, AVX2 %s, %d threads\n",
+           repeat, threshold, CPUKernel::is_simd_available() ? "yes" : "no", num_threads);
+
+    struct Case{ const char* name; int num_bboxes; int num_classes; Yolo::Type type; bool column_major; };
+    Case cases[] = {
+        {"V5 [25200, 85]",     25200, 80, Yolo::Type::V5, false},
+        {"V8 [8400, 84]",      8400,  80, Yolo::Type::V8, false},
+        {"V8 [84, 8400]",      8400,  80, Yolo::Type::V8, true},
+        {"V8 [134400, 84]",    134400, 80, Yolo::Type::V8, false},
+        {"V8 [84, 134400]",    134400, 80, Yolo::Type::V8, true}
+    };
+
+    vector<float> row_output;   // 上一个 [N, 4 + C] 的结果，紧接着的 [4 + C, N] 与它比较
+    for(auto& item : cases){
+        bool objectness = item.type != Yolo::Type::V8;
+        int width = (objectness ? 5 : 4) + item.num_classes;
+        auto predict = make_decode_output(item.num_bboxes, item.num_classes, objectness, item.num_bboxes);
+        if(item.column_major)
+            predict = to_column_major(predict, item.num_bboxes, width);
+
+        size_t volume = 1 + max_objects * 7;
+        vector<float> scalar_output(volume), simd_output(volume), parallel_output(volume);
+        auto run = [&](vector<float>& output){
+            Yolo::decode_cpu_invoker(predict.data(), item.num_bboxes, item.num_classes, threshold, d2i,
+                                     output.data(), max_objects, item.type, item.column_major);
+        };
+
+        cv::setNumThreads(1);
+        CPUKernel::set_simd_enabled(false);
+        double scalar_ms = bench_warp_once(repeat, [&]{ run(scalar_output); });
+        CPUKernel::set_simd_enabled(true);
+        double simd_1t_ms = bench_warp_once(repeat, [&]{ run(simd_output); });
+        cv::setNumThreads(num_threads);
+        double simd_ms = bench_warp_once(repeat, [&]{ run(parallel_output); });
+
+        // 单线程和多线程的结果都与标量单线程的结果比较，框的顺序按分段固定，与线程数无关
+        bool same = equal(scalar_output.begin(), scalar_output.end(), simd_output.begin()) &&
+                    equal(scalar_output.begin(), scalar_output.end(), parallel_output.begin());
+        if(item.column_major)
+            same = same && equal(row_output.begin(), row_output.end(), simd_output.begin());
+        else
+            row_output = simd_output;
+        printf("  %-18s scalar 1 thread %8.3f ms  simd 1 thread %8.3f ms  simd %d threads %8.3f ms  %d boxes, %s\n",
+               item.name, scalar_ms, simd_1t_ms, num_threads, simd_ms, (int)scalar_output[0], same ? "same" : "DIFFERENT");
+    }
+    cv::setNumThreads(default_threads);
+}
+
+/// ---------------------------------- bytetrack ----------------------------------
+/// 合成的行人场景：匀速运动、边界反弹，检测框带噪声，一部分漏检、一部分被遮挡成低分框，另有少量误检
+/// 目标离开后补充新的目标，保持场景中约 num_objects 个目标
+typedef vector<vector<Object>> TrackScene;
+
+/// 场景中目标的真实位置，id 在整个场景中唯一，用于评估跟踪的准确度
+struct TruthBox{ int id; float rect[4]; int label; };
+
+/// 逐帧生成，soak 测试不需要把所有帧放在内存中
+/// num_classes > 1 时每个目标和误检随机取一个类别，否则类别都是 0（随机数序列与单类别时相同）
+class TrackSceneGenerator{
+public:
+    TrackSceneGenerator(int num_objects, unsigned seed, int num_classes = 1)
+        : num_objects_(num_objects), num_classes_(num_classes), rng_(seed){
+        for(int i = 0; i < num_objects; ++i)
+            walkers_.emplace_back(spawn());
+    }
+
+    /// truth 不为空时输出这一帧所有目标的真实位置，包括漏检的目标，不影响随机数序列
+    void next(vector<Object>& objects, vector<TruthBox>* truth = nullptr){
+        objects.clear();
+        if(truth) truth->clear();
+        for(auto& p : walkers_){
+            if(--p.life <= 0) p = spawn();
+            p.x += p.vx;  p.y += p.vy;
+            if(p.x < 0 || p.x + p.w > width_)  p.vx = -p.vx;
+            if(p.y < 0 || p.y + p.h > height_) p.vy = -p.vy;
+            if(truth) truth->push_back({p.id, {p.x, p.y, p.w, p.h}, p.label});
+
+            float dice = uniform_(rng_);
+            if(dice < 0.05f) continue;
+
+            Object obj;
+            obj.rect[0] = p.x + (uniform_(rng_) - 0.5f) * 3;
+            obj.rect[1] = p.y + (uniform_(rng_) - 0.5f) * 3;
+            obj.rect[2] = p.w * (0.95f + uniform_(rng_) * 0.1f);
+            obj.rect[3] = p.h * (0.95f + uniform_(rng_) * 0.1f);
+            obj.label   = p.label;
+            obj.prob    = dice < 0.2f ? 0.15f + uniform_(rng_) * 0.35f : 0.55f + uniform_(rng_) * 0.4f;
+            objects.emplace_back(obj);
+        }
+
+        int num_false = rng_() % (1 + num_objects_ / 50);
+        for(int i = 0; i < num_false; ++i){
+            Object obj;
+            obj.rect[2] = 15 + uniform_(rng_) * 40;
+            obj.rect[3] = obj.rect[2] * 2.5f;
+            obj.rect[0] = uniform_(rng_) * (width_ - obj.rect[2]);
+            obj.rect[1] = uniform_(rng_) * (height_ - obj.rect[3]);
+            obj.label   = 0;
+            obj.prob    = 0.1f + uniform_(rng_) * 0.6f;
+            if(num_classes_ > 1) obj.label = rng_() % num_classes_;
+            objects.emplace_back(obj);
+        }
+    }
+
+private:
+    struct Walker{ float x, y, w, h, vx, vy; int life; int label; int id; };
+
+    Walker spawn(){
+        Walker p;
+        p.w  = 15 + uniform_(rng_) * 40;
+        p.h  = p.w * (2.2f + uniform_(rng_) * 0.6f);
+        p.x  = uniform_(rng_) * (width_ - p.w);
+        p.y  = uniform_(rng_) * (height_ - p.h);
+        p.vx = (uniform_(rng_) - 0.5f) * 6;
+        p.vy = (uniform_(rng_) - 0.5f) * 3;
+        p.life = 50 + rng_() % 400;
+        p.label = num_classes_ > 1 ? rng_() % num_classes_ : 0;
+        p.id = ++num_spawned_;
+        return p;
+    }
+
+    const float width_ = 1920, height_ = 1080;
+    int num_objects_;
+    int num_classes_;
+    int num_spawned_ = 0;
+    mt19937 rng_;
+    uniform_real_distribution<float> uniform_{0, 1};
+    vector<Walker> walkers_;
+};
+
+static TrackScene make_track_scene(int num_frames, int num_objects, unsigned seed, int num_classes = 1){
+    TrackSceneGenerator generator(num_objects, seed, num_classes);
+    TrackScene scene(num_frames);
+    for(auto& objects : scene)
+        generator.next(objects);
+    return scene;
+}
+
+/// 一帧的跟踪结果，track_id 减去整个回放中最小的 id，使结果与 id 计数器的起点无关
+struct TrackRecord{ int track_id; float tlwh[4]; float score; };
+typedef vector<vector<TrackRecord>> TrackReplay;
+
+static void normalize_track_ids(TrackReplay& replay){
+    int min_id = INT32_MAX;
+    for(auto& frame : replay)
+        for(auto& record : frame)
+            min_id = min(min_id, record.track_id);
+    for(auto& frame : replay)
+        for(auto& record : frame)
+            record.track_id -= min_id;
+}
+
+/// 文本格式，%.9g 可以精确还原 float
+/// frame <num_objects> <num_tracks>
+/// d <x> <y> <w> <h> <prob> <label>        * num_objects
+/// t <id> <x> <y> <w> <h> <score>          * num_tracks
+static bool save_track_replay(const string& file, const TrackScene& scene, const TrackReplay& replay){
+    FILE* f = fopen(file.c_str(), "w");
+    if(f == nullptr){
+        INFOE("Open %s failed", file.c_str());
+        return false;
+    }
+    for(size_t frame = 0; frame < scene.size(); ++frame){
+        fprintf(f, "frame %d %d\n", (int)scene[frame].size(), (int)replay[frame].size());
+        for(auto& obj : scene[frame])
+            fprintf(f, "d %.9g %.9g %.9g %.9g %.9g %d\n", obj.rect[0], obj.rect[1], obj.rect[2], obj.rect[3], obj.prob, obj.label);
+        for(auto& t : replay[frame])
+            fprintf(f, "t %d %.9g %.9g %.9g %.9g %.9g\n", t.track_id, t.tlwh[0], t.tlwh[1], t.tlwh[2], t.tlwh[3], t.score);
+    }
+    fclose(f);
+    return true;
+}
+
+static bool load_track_replay(const string& file, TrackScene& scene, TrackReplay& replay){
+    FILE* f = fopen(file.c_str(), "r");
+    if(f == nullptr){
+        INFOE("Open %s failed", file.c_str());
+        return false;
+    }
+    int num_objects, num_tracks;
+    bool ok = true;
+    while(ok && fscanf(f, " frame %d %d", &num_objects, &num_tracks) == 2){
+        scene.emplace_back(num_objects);
+        replay.emplace_back(num_tracks);
+        for(auto& obj : scene.back())
+            ok = ok && fscanf(f, " d %f %f %f %f %f %d", &obj.rect[0], &obj.rect[1], &obj.rect[2], &obj.rect[3], &obj.prob, &obj.label) == 6;
+        for(auto& t : replay.back())
+            ok = ok && fscanf(f, " t %d %f %f %f %f %f", &t.track_id, &t.tlwh[0], &t.tlwh[1], &t.tlwh[2], &t.tlwh[3], &t.score) == 6;
+    }
+    fclose(f);
+    if(!ok) INFOE("Bad replay file %s", file.c_str());
+    return ok;
+}
+
+static TrackReplay run_tracker(const TrackScene& scene, bool sparse, vector<double>* frame_ms = nullptr){
+    BYTETracker tracker;
+    tracker.config().set_sparse_association(sparse);
+    TrackReplay replay(scene.size());
+    for(size_t frame = 0; frame < scene.size(); ++frame){
+        double tic = now_ms();
+        const auto& tracks = tracker.update(scene[frame]);
+        if(frame_ms) frame_ms->push_back(now_ms() - tic);
+
+        for(auto& track : tracks){
+            TrackRecord record;
+            record.track_id = track.track_id;
+            for(int i = 0; i < 4; ++i) record.tlwh[i] = track.tlwh[i];
+            record.score = track.score;
+            replay[frame].emplace_back(record);
+        }
+    }
+    normalize_track_ids(replay);
+    return replay;
+}
+
+/// 返回第一个不同的帧，相同时返回 -1
+static int compare_track_replay(const TrackReplay& a, const TrackReplay& b){
+    if(a.size() != b.size()) return min(a.size(), b.size());
+    for(size_t frame = 0; frame < a.size(); ++frame){
+        if(a[frame].size() != b[frame].size()) return frame;
+        for(size_t i = 0; i < a[frame].size(); ++i){
+            auto& x = a[frame][i];
+            auto& y = b[frame][i];
+            if(x.track_id != y.track_id || x.score != y.score || memcmp(x.tlwh, y.tlwh, sizeof(x.tlwh)) != 0)
+                return frame;
+        }
+    }
+    return -1;
+}
+
+/// replay_file 不存在时生成场景并把检测框和跟踪结果写入 replay_file；存在时回放其中的检测框，结果必须逐帧完全相同
+void bench_tracker(int num_frames, int num_objects, const string& replay_file){
+    TrackScene scene;
+    TrackReplay expected;
+    bool replay = !replay_file.empty() && iLogger::exists(replay_file);
+    if(replay){
+        if(!load_track_replay(replay_file, scene, expected)) return;
+    }
+    else{
+        scene = make_track_scene(num_frames, num_objects, 1234);
+    }
+
+    int num_detections = 0;
+    for(auto& objects : scene) num_detections += objects.size();
+    printf("BYTETracker: %d frames, %.1f detections per frame%s\n", (int)scene.size(),
+           num_detections / (float)max<size_t>(1, scene.size()), replay ? (", replay " + replay_file).c_str() : "");
+
+    vector<double> frame_ms, dense_ms;
+    auto result = run_tracker(scene, true, &frame_ms);
+    auto dense  = run_tracker(scene, false, &dense_ms);
+    if(replay){
+        int frame = compare_track_replay(expected, result);
+        if(frame == -1) printf("  replay: same as %s\n", replay_file.c_str());
+        else            printf("  replay: DIFFERENT from frame %d\n", frame);
+    }
+    else if(!replay_file.empty() && save_track_replay(replay_file, scene, result)){
+        printf("  replay saved to %s\n", replay_file.c_str());
+    }
+
+    int num_tracks = 0;
+    for(auto& tracks : result) num_tracks += tracks.size();
+    printf("  %.1f tracks per frame, sparse association %s dense\n", num_tracks / (float)max<size_t>(1, scene.size()),
+           compare_track_replay(dense, result) == -1 ? "same as" : "DIFFERENT from");
+
+    auto print_latency = [](const char* name, vector<double>& ms){
+        sort(ms.begin(), ms.end());
+        double total = 0;
+        for(double value : ms) total += value;
+        printf("  %-7s mean %8.3f ms  p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms\n", name,
+               total / max<size_t>(1, ms.size()), ms[ms.size() / 2], ms[ms.size() * 99 / 100], ms.back());
+    };
+    print_latency("sparse", frame_ms);
+    print_latency("dense", dense_ms);
+}
+
+/// 多类别：每个类别一个 BYTETracker（检测框按类别分发）对比一个 class_aware 的 BYTETracker，以及忽略类别的 BYTETracker
+/// class_aware 的结果按类别拆开之后必须与对应类别的 tracker 完全相同（track_id 一一对应）
+void bench_tracker_classes(int num_frames, int num_objects, int num_classes){
+    TrackScene scene = make_track_scene(num_frames, num_objects, 1234, num_classes);
+    int num_detections = 0;
+    for(auto& objects : scene) num_detections += objects.size();
+    printf("BYTETracker multi-class: %d frames, %.1f detections per frame, %d classes\n", num_frames,
+           num_detections / (float)max(1, num_frames), num_classes);
+
+    vector<unique_ptr<BYTETracker>> class_trackers;
+    for(int c = 0; c < num_classes; ++c) class_trackers.emplace_back(new BYTETracker());
+    vector<vector<Object>> class_objects(num_classes);
+    vector<vector<vector<STrack>>> class_outputs(num_frames, vector<vector<STrack>>(num_classes));
+    double class_ms = 0;
+    for(int frame = 0; frame < num_frames; ++frame){
+        double tic = now_ms();
+        for(auto& objects : class_objects) objects.clear();
+        for(auto& obj : scene[frame]) class_objects[obj.label].emplace_back(obj);
+        for(int c = 0; c < num_classes; ++c)
+            class_outputs[frame][c] = class_trackers[c]->update(class_objects[c]);
+        class_ms += now_ms() - tic;
+    }
+
+    auto run_single = [&](bool class_aware, vector<vector<STrack>>* outputs){
+        BYTETracker tracker;
+        tracker.config().set_class_aware(class_aware);
+        double total = 0;
+        for(int frame = 0; frame < num_frames; ++frame){
+            double tic = now_ms();
+            const auto& tracks = tracker.update(scene[frame]);
+            total += now_ms() - tic;
+            if(outputs) outputs->emplace_back(tracks);
+        }
+        return total;
+    };
+    vector<vector<STrack>> aware_outputs;
+    double aware_ms = run_single(true, &aware_outputs);
+    double agnostic_ms = run_single(false, nullptr);
+
+    // 按类别拆开，逐帧比较顺序、框、分数，track_id 要求一一对应
+    bool same = true;
+    vector<map<int, int>> id_map(num_classes);
+    for(int frame = 0; frame < num_frames && same; ++frame){
+        vector<int> position(num_classes, 0);
+        for(auto& track : aware_outputs[frame]){
+            auto& expected = class_outputs[frame][track.label];
+            int& i = position[track.label];
+            if(i >= expected.size() || memcmp(track.tlwh, expected[i].tlwh, sizeof(track.tlwh)) != 0 || track.score != expected[i].score){
+                same = false;
+                break;
+            }
+            auto it = id_map[track.label].emplace(track.track_id, expected[i].track_id).first;
+            same = same && it->second == expected[i].track_id;
+            i++;
+        }
+        for(int c = 0; c < num_classes && same; ++c)
+            same = position[c] == class_outputs[frame][c].size();
+    }
+
+    printf("  tracker per class  %8.3f ms per frame\n", class_ms / num_frames);
+    printf("  class aware        %8.3f ms per frame (%s)\n", aware_ms / num_frames, same ? "same as tracker per class" : "DIFFERENT from tracker per class");
+    printf("  class agnostic     %8.3f ms per frame\n", agnostic_ms / num_frames);
+}
+
+static float tlwh_iou(const float* a, const float* b){
+    float w = min(a[0] + a[2], b[0] + b[2]) - max(a[0], b[0]);
+    float h = min(a[1] + a[3], b[1] + b[3]) - max(a[1], b[1]);
+    if(w <= 0 || h <= 0) return 0;
+    float inter = w * h;
+    return inter / (a[2] * a[3] + b[2] * b[3] - inter);
+}
+
+/// 跟踪结果的评估：每帧按 IoU >= 0.5 把轨迹和真值一一对应，上一次的对应仍满足时优先保留，其余按 IoU 从大到小贪心
+/// MOTA = 1 - (FN + FP + IDSW) / 真值数，IDSW 为真值对应的轨迹与它上一次对应的轨迹不同的次数
+/// IDF1 求整个序列上真值 id 与轨迹 id 的一一对应，使对应上的帧数 IDTP 最大，只统计每帧对应上的 (真值, 轨迹)
+class TrackEvaluator{
+public:
+    void add_frame(const vector<TruthBox>& truth, const vector<STrack>& tracks){
+        num_truth_  += truth.size();
+        num_tracks_ += tracks.size();
+        truth_used_.assign(truth.size(), 0);
+        track_used_.assign(tracks.size(), 0);
+        frame_matches_.clear();
+
+        track_index_.clear();
+        for(int j = 0; j < tracks.size(); ++j)
+            track_index_[tracks[j].track_id] = j;
+        for(int i = 0; i < truth.size(); ++i){
+            auto last = last_match_.find(truth[i].id);
+            if(last == last_match_.end()) continue;
+            auto it = track_index_.find(last->second);
+            if(it == track_index_.end() || tlwh_iou(truth[i].rect, tracks[it->second].tlwh) < 0.5f) continue;
+            match(i, it->second);
+        }
+
+        candidates_.clear();
+        for(int i = 0; i < truth.size(); ++i){
+            if(truth_used_[i]) continue;
+            for(int j = 0; j < tracks.size(); ++j){
+                if(track_used_[j]) continue;
+                float iou = tlwh_iou(truth[i].rect, tracks[j].tlwh);
+                if(iou >= 0.5f) candidates_.emplace_back(iou, i, j);
+            }
+        }
+        sort(candidates_.begin(), candidates_.end(), [](const tuple<float, int, int>& a, const tuple<float, int, int>& b){
+            return get<0>(a) > get<0>(b);
+        });
+        for(auto& item : candidates_){
+            if(!truth_used_[get<1>(item)] && !track_used_[get<2>(item)])
+                match(get<1>(item), get<2>(item));
+        }
+
+        for(auto& item : frame_matches_){
+            int truth_id = truth[item.first].id, track_id = tracks[item.second].track_id;
+            auto last = last_match_.find(truth_id);
+            if(last != last_match_.end() && last->second != track_id)
+                id_switches_++;
+            last_match_[truth_id] = track_id;
+            pair_frames_[{truth_id, track_id}]++;
+        }
+        matches_ += frame_matches_.size();
+    }
+
+    long long false_positives() const{ return num_tracks_ - matches_; }
+    long long false_negatives() const{ return num_truth_ - matches_; }
+    long long id_switches() const{ return id_switches_; }
+
+    double mota() const{
+        return 1 - (double)(false_negatives() + false_positives() + id_switches_) / max(1LL, num_truth_);
+    }
+
+    /// 真值 id 和轨迹 id 构成二分图，按共同出现过的对拆成连通分量，每个分量用 lapjv 求 IDTP 最大的一一对应
+    double idf1() const{
+        map<int, int> truth_node, track_node;
+        for(auto& item : pair_frames_){
+            truth_node.emplace(item.first.first, 0);
+            track_node.emplace(item.first.second, 0);
+        }
+        int num_nodes = 0;
+        for(auto& item : truth_node) item.second = num_nodes++;
+        for(auto& item : track_node) item.second = num_nodes++;
+
+        vector<int> parent(num_nodes);
+        for(int i = 0; i < num_nodes; ++i) parent[i] = i;
+        function<int(int)> find = [&](int i){ return parent[i] == i ? i : parent[i] = find(parent[i]); };
+        for(auto& item : pair_frames_)
+            parent[find(truth_node[item.first.first])] = find(track_node[item.first.second]);
+
+        // 每条边：所在的分量、行（真值）、列（轨迹）、帧数
+        map<int, vector<tuple<int, int, long long>>> components;
+        for(auto& item : pair_frames_){
+            int row = truth_node[item.first.first], col = track_node[item.first.second];
+            components[find(row)].emplace_back(row, col, item.second);
+        }
+
+        long long idtp = 0;
+        LapjvWorkspace<double> workspace;
+        for(auto& component : components){
+            map<int, int> rows, cols;
+            for(auto& edge : component.second){
+                rows.emplace(get<0>(edge), rows.size());
+                cols.emplace(get<1>(edge), cols.size());
+            }
+            int n = max(rows.size(), cols.size());
+            vector<double> cost(n * n, 0);
+            for(auto& edge : component.second)
+                cost[rows[get<0>(edge)] * n + cols[get<1>(edge)]] = -(double)get<2>(edge);
+
+            vector<int> x(n), y(n);
+            lapjv_dense<double>(n, cost.data(), x.data(), y.data(), workspace);
+            for(int r = 0; r < n; ++r)
+                idtp -= (long long)cost[r * n + x[r]];
+        }
+        return 2.0 * idtp / max(1LL, num_truth_ + num_tracks_);
+    }
+
+private:
+    void match(int truth_index, int track_index){
+        truth_used_[truth_index] = 1;
+        track_used_[track_index] = 1;
+        frame_matches_.emplace_back(truth_index, track_index);
+    }
+
+    long long num_truth_ = 0, num_tracks_ = 0, matches_ = 0, id_switches_ = 0;
+    map<int, int> last_match_;                  // 真值 id -> 上一次对应的轨迹 id
+    map<pair<int, int>, long long> pair_frames_; // (真值 id, 轨迹 id) 对应上的帧数
+    map<int, int> track_index_;
+    vector<char> truth_used_, track_used_;
+    vector<pair<int, int>> frame_matches_;
+    vector<tuple<float, int, int>> candidates_;
+};
+
+/// 马氏距离门限：同一个场景分别不用门限、用 xyah 4 维和只用中心位置的门限，比较每帧耗时和 MOTA / IDSW / IDF1
+/// 稀疏关联中门限只作用在 IoU 候选上，稠密关联中对每个 (轨迹, 检测框) 计算
+void bench_tracker_gating(int num_frames, int num_objects){
+    TrackSceneGenerator generator(num_objects, 2468);
+    TrackScene scene(num_frames);
+    vector<vector<TruthBox>> truth(num_frames);
+    int num_detections = 0;
+    for(int frame = 0; frame < num_frames; ++frame){
+        generator.next(scene[frame], &truth[frame]);
+        num_detections += scene[frame].size();
+    }
+    printf("BYTETracker gating: %d frames, %.1f detections per frame\n", num_frames, num_detections / (float)max(1, num_frames));
+
+    struct Case{ const char* name; bool gating; bool only_position; };
+    const Case cases[] = {
+        {"no gating",   false, false},
+        {"gating xyah", true,  false},
+        {"gating xy",   true,  true}
+    };
+    for(bool sparse : {true, false}){
+        for(auto& item : cases){
+            BYTETracker tracker;
+            tracker.config().set_sparse_association(sparse).set_gating(item.gating).set_gating_only_position(item.only_position);
+            TrackEvaluator evaluator;
+            double total = 0;
+            for(int frame = 0; frame < num_frames; ++frame){
+                double tic = now_ms();
+                const auto& tracks = tracker.update(scene[frame]);
+                total += now_ms() - tic;
+                evaluator.add_frame(truth[frame], tracks);
+            }
+            printf("  %-6s %-12s %8.3f ms per frame  MOTA %6.2f%%  FP %7lld  FN %7lld  IDSW %5lld  IDF1 %6.2f%%\n",
+                   sparse ? "sparse" : "dense", item.name, total / num_frames, evaluator.mota() * 100,
+                   evaluator.false_positives(), evaluator.false_negatives(), evaluator.id_switches(), evaluator.idf1() * 100);
+        }
+    }
+}
+
+/// 隔帧检测：同一个场景分别每帧检测、固定间隔检测、按协方差自适应间隔检测，比较检测器的负载和 MOTA / IDSW / IDF1
+/// 检测器的耗时按每次 detect_ms 估算，每帧的代价 = 检测的比例 * detect_ms + tracker 的耗时
+void bench_tracker_keyframe(int num_frames, int num_objects, float detect_ms){
+    TrackSceneGenerator generator(num_objects, 1357);
+    TrackScene scene(num_frames);
+    vector<vector<TruthBox>> truth(num_frames);
+    for(int frame = 0; frame < num_frames; ++frame)
+        generator.next(scene[frame], &truth[frame]);
+    printf("BYTETracker keyframe: %d frames, %d objects, detector %.1f ms\n", num_frames, num_objects, detect_ms);
+
+    struct Case{ const char* name; int max_interval; float uncertainty; float motion; };
+    const Case cases[] = {
+        {"every frame",       1, 0,     0},
+        {"k = 2",             2, 1e9f,  0},
+        {"k = 3",             3, 1e9f,  0},
+        {"k = 5",             5, 1e9f,  0},
+        {"adaptive 0.12",     8, 0.12f, 0},
+        {"adaptive 0.15",     8, 0.15f, 0},
+        {"adaptive 0.20",     8, 0.20f, 0},
+        {"adaptive 0.20+mv",  8, 0.20f, 0.25f},
+        {"max 5, default",    5, KeyframeConfig().detect_uncertainty, KeyframeConfig().detect_motion}     // config.yaml 中打开隔帧检测的示例
+    };
+    for(auto& item : cases){
+        KeyframeTracker tracker;
+        tracker.keyframe_config() = KeyframeConfig{item.max_interval, item.uncertainty, item.motion};
+        TrackEvaluator evaluator;
+        double total = 0;
+        for(int frame = 0; frame < num_frames; ++frame){
+            double tic = now_ms();
+            const auto& tracks = tracker.need_detection() ? tracker.update(scene[frame]) : tracker.predict();
+            total += now_ms() - tic;
+            evaluator.add_frame(truth[frame], tracks);
+        }
+        double ratio = tracker.detections() / (double)max(1LL, tracker.frames());
+        printf("  %-17s detect %5.1f%% (%4.2fx less)  tracker %6.3f ms  cost %7.3f ms per frame  MOTA %6.2f%%  IDSW %5lld  IDF1 %6.2f%%\n",
+               item.name, ratio * 100, 1 / max(ratio, 1e-9), total / num_frames, ratio * detect_ms + total / num_frames,
+               evaluator.mota() * 100, evaluator.id_switches(), evaluator.idf1() * 100);
+    }
+}
+
+/// 长时间运行：逐帧生成场景并跟踪，每 1/10 的帧输出一次这一段的耗时、轨迹池大小和仍被引用的已移除轨迹数
+/// 目标不断离开、补充，已移除的轨迹持续产生，轨迹池和每帧耗时应当保持平稳
+void bench_tracker_soak(long long num_frames, int num_objects){
+    printf("BYTETracker soak: %lld frames, %d objects\n", num_frames, num_objects);
+    TrackSceneGenerator generator(num_objects, 4321);
+    BYTETracker tracker;
+    vector<Object> objects;
+
+    long long window = max(1LL, num_frames / 10);
+    double window_ms = 0, window_max_ms = 0, begin = now_ms();
+    int max_pool = 0, max_removed = 0, last_id = 0;
+    for(long long frame = 1; frame <= num_frames; ++frame){
+        generator.next(objects);
+        double tic = now_ms();
+        const auto& tracks = tracker.update(objects);
+        double ms = now_ms() - tic;
+        window_ms += ms;
+        window_max_ms = max(window_max_ms, ms);
+        max_pool = max(max_pool, tracker.pool_size());
+        max_removed = max(max_removed, tracker.removed_size());
+        for(auto& track : tracks) last_id = max(last_id, track.track_id);
+
+        if(frame % window == 0 || frame == num_frames){
+            long long count = frame % window == 0 ? window : frame % window;
+            printf("  %11lld frames  mean %7.4f ms  max %7.3f ms  pool %5d (max %5d)  removed %4d (max %4d)  track id %d  %.0f s\n",
+                   frame, window_ms / count, window_max_ms, tracker.pool_size(), max_pool, tracker.removed_size(), max_removed,
+                   last_id, (now_ms() - begin) / 1000);
+            window_ms = window_max_ms = 0;
+        }
+    }
+}
+
+/// 多路：每一路的目标数在 num_objects 的 0.5 ~ 2 倍之间，各路负载不均匀
+/// 逐路依次调用 BYTETracker::update（单线程）对比 TrackerManager 在工作窃取线程池上并行更新，每一路的结果必须完全相同
+void bench_tracker_streams(int num_streams, int num_frames, int num_objects, int num_threads){
+    vector<TrackScene> scenes;
+    int num_detections = 0;
+    for(int s = 0; s < num_streams; ++s){
+        scenes.emplace_back(make_track_scene(num_frames, num_objects * (1 + s % 4) / 2, 100 + s));
+        for(auto& objects : scenes.back()) num_detections += objects.size();
+    }
+
+    TrackerManager manager(num_streams, num_threads);
+    printf("TrackerManager: %d streams x %d frames, %.1f detections per stream-frame, %d worker threads + caller\n",
+           num_streams, num_frames, num_detections / (float)max(1, num_streams * num_frames), manager.num_threads());
+
+    auto record = [](const vector<STrack>& tracks, vector<TrackRecord>& output){
+        for(auto& track : tracks){
+            TrackRecord r;
+            r.track_id = track.track_id;
+            for(int i = 0; i < 4; ++i) r.tlwh[i] = track.tlwh[i];
+            r.score = track.score;
+            output.emplace_back(r);
+        }
+    };
+
+    vector<TrackReplay> expected(num_streams, TrackReplay(num_frames));
+    {
+        vector<unique_ptr<BYTETracker>> trackers;
+        for(int s = 0; s < num_streams; ++s) trackers.emplace_back(new BYTETracker());
+        double tic = now_ms();
+        for(int frame = 0; frame < num_frames; ++frame)
+            for(int s = 0; s < num_streams; ++s)
+                record(trackers[s]->update(scenes[s][frame]), expected[s][frame]);
+        double ms = now_ms() - tic;
+        printf("  sequential      %8.3f ms per batch  %9.0f stream-frames/s\n", ms / num_frames, num_streams * num_frames / ms * 1000);
+    }
+
+    vector<TrackReplay> result(num_streams, TrackReplay(num_frames));
+    vector<int> stream_ids(num_streams);
+    vector<vector<Object>> batch(num_streams);
+    for(int s = 0; s < num_streams; ++s) stream_ids[s] = s;
+    double total_ms = 0;
+    long long num_stolen = 0;
+    int num_leftover = 0;       // update 返回之后线程池中仍有任务计数的批次，不为 0 说明计数有误，空闲的线程会空转
+    for(int frame = 0; frame < num_frames; ++frame){
+        for(int s = 0; s < num_streams; ++s) batch[s] = scenes[s][frame];
+        double tic = now_ms();
+        manager.update(stream_ids, batch);
+        total_ms += now_ms() - tic;
+        num_stolen += manager.num_stolen();
+        if(manager.num_queued() != 0) num_leftover++;
+        for(int s = 0; s < num_streams; ++s) record(manager.tracks(s), result[s][frame]);
+    }
+
+    int num_different = 0;
+    for(int s = 0; s < num_streams; ++s)
+        if(compare_track_replay(expected[s], result[s]) != -1) num_different++;
+    printf("  TrackerManager  %8.3f ms per batch  %9.0f stream-frames/s  %.1f tasks stolen per batch, %s\n",
+           total_ms / num_frames, num_streams * num_frames / total_ms * 1000, num_stolen / (float)num_frames,
+           num_different == 0 ? "all streams same as sequential" : iLogger::format("%d streams DIFFERENT", num_different).c_str());
+    if(num_leftover != 0)
+        printf("  WARNING: %d batches left a non-zero queued count in the pool\n", num_leftover);
+
+    // 各路 update 耗时的 p99：最小、中位、最大的三路
+    vector<TrackerStreamStats> stats;
+    for(int s = 0; s < num_streams; ++s) stats.emplace_back(manager.stats(s));
+    sort(stats.begin(), stats.end(), [](const TrackerStreamStats& a, const TrackerStreamStats& b){
+        return a.latency.percentile(0.99) < b.latency.percentile(0.99);
+    });
+    for(int i : {0, num_streams / 2, num_streams - 1}){
+        auto& st = stats[i];
+        printf("  stream %3d  frames %5llu  tracks %4d  update p50 %7.3f ms  p99 %7.3f ms  max %7.3f ms\n",
+               st.stream, (unsigned long long)st.frames, st.tracks, st.latency.percentile(0.5) / 1000,
+               st.latency.percentile(0.99) / 1000, st.latency.max_us / 1000.0);
+    }
+}
+
+/// ---------------------------------- kalman ----------------------------------
+/// 每帧所有轨迹 predict 一次、update 一次：KalmanFilter 逐个轨迹（Eigen 8x8）对比 KalmanBatch 的标量和 SIMD 版本
+/// 轨迹下标打乱，与轨迹池中不连续的下标相同；结果要求逐位一致
+void bench_kalman(int repeat){
+    byte_kalman::KalmanFilter kalman_filter;
+    auto& config = kalman_filter.config();
+    printf("Kalman predict + update per frame: best of %d, AVX2 %s\n", repeat, byte_kalman::is_simd_available() ? "yes" : "no");
+
+    int counts[] = {100, 500, 2000};
+    for(int count : counts){
+        mt19937 rng(count);
+        uniform_real_distribution<float> uniform(0, 1);
+        vector<int> indices(count);
+        for(int i = 0; i < count; ++i) indices[i] = i;
+        shuffle(indices.begin(), indices.end(), rng);
+
+        vector<DETECTBOX> initial(count);
+        vector<float> measurements(count * 4);
+        for(int i = 0; i < count; ++i){
+            initial[i] << uniform(rng) * 1920, uniform(rng) * 1080, 0.3f + uniform(rng) * 0.2f, 40 + uniform(rng) * 100;
+            for(int k = 0; k < 4; ++k)
+                measurements[i * 4 + k] = initial[i][k] * (0.98f + uniform(rng) * 0.04f);
+        }
+
+        vector<KAL_MEAN> means(count);
+        vector<KAL_COVA> covariances(count);
+        auto run_legacy = [&]{
+            for(int i = 0; i < count; ++i){
+                auto state = kalman_filter.initiate(initial[i]);
+                means[i] = state.first;
+                covariances[i] = state.second;
+            }
+            for(int frame = 0; frame < 3; ++frame){
+                for(int i = 0; i < count; ++i){
+                    kalman_filter.predict(means[i], covariances[i]);
+                    DETECTBOX measurement(measurements.data() + i * 4);
+                    auto state = kalman_filter.update(means[i], covariances[i], measurement);
+                    means[i] = state.first;
+                    covariances[i] = state.second;
+                }
+            }
+        };
+
+        byte_kalman::KalmanBatch batch(config);
+        batch.reserve(count);
+        vector<float> ordered_measurements(count * 4);
+        for(int i = 0; i < count; ++i)
+            copy(measurements.begin() + indices[i] * 4, measurements.begin() + indices[i] * 4 + 4, ordered_measurements.begin() + i * 4);
+
+        auto run_batch = [&]{
+            for(int i = 0; i < count; ++i)
+                batch.initiate(i, initial[i]);
+            for(int frame = 0; frame < 3; ++frame){
+                batch.predict(indices.data(), count);
+                batch.update(indices.data(), ordered_measurements.data(), count);
+            }
+        };
+
+        auto same_as_legacy = [&]{
+            KAL_MEAN mean;
+            KAL_COVA covariance;
+            for(int i = 0; i < count; ++i){
+                batch.get_mean(i, mean);
+                batch.get_covariance(i, covariance);
+                if(memcmp(mean.data(), means[i].data(), sizeof(mean)) != 0 ||
+                   memcmp(covariance.data(), covariances[i].data(), sizeof(covariance)) != 0)
+                    return false;
+            }
+            return true;
+        };
+
+        // 初始化 + 3 帧，计时的是每帧 predict + update 的时间
+        double legacy_ms = bench_warp_once(repeat, run_legacy) / 3;
+        byte_kalman::set_simd_enabled(false);
+        double scalar_ms = bench_warp_once(repeat, run_batch) / 3;
+        bool scalar_same = same_as_legacy();
+        byte_kalman::set_simd_enabled(true);
+        double simd_ms = bench_warp_once(repeat, run_batch) / 3;
+        bool simd_same = same_as_legacy();
+
+        printf("  %5d tracks  KalmanFilter %8.3f ms  batch scalar %7.3f ms (%s)  batch simd %7.3f ms (%s)\n",
+               count, legacy_ms, scalar_ms, scalar_same ? "same" : "DIFFERENT", simd_ms, simd_same ? "same" : "DIFFERENT");
+    }
+}
+
+/// ---------------------------------- lapjv ----------------------------------
+/// n x n 的随机代价矩阵：lapjv_internal（行指针，每次求解都拷贝矩阵、分配工作数组）对比 lapjv_dense 的 double、float 标量和 float SIMD 版本
+/// lapjv_dense 复用同一个工作区，计时期间统计堆分配次数；各版本的分配结果与 lapjv_internal 对比
+void bench_lapjv(int repeat){
+    printf("LAPJV on random n x n cost: best of %d, AVX2 %s\n", repeat, lapjv_simd_available() ? "yes" : "no");
+
+    int sizes[] = {10, 50, 100, 500, 1000, 2000};
+    for(int n : sizes){
+        mt19937 rng(n);
+        uniform_real_distribution<float> uniform(0, 1);
+        vector<float> cost_float((size_t)n * n);
+        for(auto& value : cost_float) value = uniform(rng);
+        vector<double> cost_double(cost_float.begin(), cost_float.end());
+        vector<double*> rows(n);
+        for(int i = 0; i < n; ++i) rows[i] = cost_double.data() + (size_t)i * n;
+
+        vector<int> x_legacy(n), y_legacy(n), x_double(n), y_double(n), x_scalar(n), y_scalar(n), x_simd(n), y_simd(n);
+        LapjvWorkspace<double> workspace_double;
+        LapjvWorkspace<float> workspace_float;
+        function<void()> solve_legacy = [&]{ lapjv_internal(n, rows.data(), x_legacy.data(), y_legacy.data()); };
+        function<void()> solve_double = [&]{ lapjv_dense(n, cost_double.data(), x_double.data(), y_double.data(), workspace_double); };
+        function<void()> solve_scalar = [&]{ lapjv_dense(n, cost_float.data(), x_scalar.data(), y_scalar.data(), workspace_float); };
+        function<void()> solve_simd   = [&]{ lapjv_dense(n, cost_float.data(), x_simd.data(), y_simd.data(), workspace_float); };
+
+        double legacy_ms = bench_warp_once(repeat, solve_legacy);
+
+        // 第一次调用为工作区分配内存（double、float 各 6 个数组），之后不再分配
+        g_num_allocs = 0;
+        g_count_allocs = true;
+        double double_ms = bench_warp_once(repeat, solve_double);
+        lapjv_set_simd_enabled(false);
+        double scalar_ms = bench_warp_once(repeat, solve_scalar);
+        lapjv_set_simd_enabled(true);
+        double simd_ms = bench_warp_once(repeat, solve_simd);
+        g_count_allocs = false;
+        double steady_allocs = (double)g_num_allocs.load() - 12;
+
+        auto status = [&](const vector<int>& x){ return x == x_legacy ? "same" : "DIFFERENT"; };
+        printf("  n = %4d  lapjv_internal %9.3f ms  double %9.3f ms (%s)  float scalar %9.3f ms (%s)  float simd %9.3f ms (%s)  allocs %s\n",
+               n, legacy_ms, double_ms, status(x_double), scalar_ms, status(x_scalar), simd_ms, status(x_simd),
+               format_allocs("%.0f", steady_allocs).c_str());
+    }
+}
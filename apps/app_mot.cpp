@@ -1,7 +1,8 @@
 #include "trt_common/ilogger.hpp"
+#include "trt_common/trace.hpp"
 #include "yolo/yolo.hpp"
 #include <opencv2/opencv.hpp>
-#include "bytetrack/BYTETracker.h"
+#include "bytetrack/keyframeTracker.h"
 #include <cstdio>
 #include <filesystem>
 
@@ -52,7 +53,8 @@ void inference_bytetrack(const string& engine_file, int gpuid, Yolo::Type type,
     auto fps = cap.get(cv::CAP_PROP_FPS);
     int width = cap.get(cv::CAP_PROP_FRAME_WIDTH);
     int height = cap.get(cv::CAP_PROP_FRAME_HEIGHT);
-    BYTETracker tracker;
+    // config.yaml 中 max_detect_interval > 1 时按轨迹的不确定度隔帧检测，中间的帧只做卡尔曼预测（default_keyframe_config()），默认每帧检测
+    KeyframeTracker tracker;
     cv::Mat image;
     cv::Mat prev_image;
     tracker.config().set_initiate_state({0.1,  0.1,  0.1,  0.1,
@@ -69,26 +71,33 @@ void inference_bytetrack(const string& engine_file, int gpuid, Yolo::Type type,
     }
 
     cv::VideoWriter writer(output_path, cv::VideoWriter::fourcc('M', 'P', 'E', 'G'), fps, cv::Size(width, height));
-    auto cond = [](const Yolo::Box& b){return b.label == 0;};
+    // 轨迹按类别关联（config().class_aware），所有类别一起跟踪
+    auto cond = [](const Yolo::Box& b){return true;};
 
+    TRACE_THREAD_NAME("mot.main");
     shared_future<vector<Yolo::Box>> prev_fut;
     int t = 0;
     while(cap.read(image)){
+        TRACE_SCOPE("mot.frame");
         t++;
         /// 高性能的关键：
         /// 先缓存一帧图像，使得读图预处理和推理后处理的时序图有重叠
-        if(prev_fut.valid()){
-            const auto& boxes = prev_fut.get();
-            auto tracks = tracker.update(det2tracks(boxes, cond));
+        /// 上一帧没有提交检测时 prev_fut 为空，只做预测
+        if(!prev_image.empty()){
+            if(prev_fut.valid()){
+                TRACE_SCOPE("mot.wait");
+                prev_fut.wait();
+            }
+            const auto& tracks = prev_fut.valid() ? tracker.update(det2tracks(prev_fut.get(), cond)) : tracker.predict();
             for(auto& track : tracks){
 
-                vector<float> tlwh = track.tlwh;
-                // 通过宽高比和面积过滤掉
-                bool vertical = tlwh[2] / tlwh[3] > 1.6;
+                const float* tlwh = track.tlwh;
+                // 通过宽高比和面积过滤掉，宽高比只对行人（label 0）过滤
+                bool vertical = track.label == 0 && tlwh[2] / tlwh[3] > 1.6;
                 if (tlwh[2] * tlwh[3] > 20 && !vertical)
                 {
                     auto s = tracker.get_color(track.track_id);
-                    putText(prev_image, cv::format("%d", track.track_id), cv::Point(tlwh[0], tlwh[1] - 10),
+                    putText(prev_image, cv::format("%d:%d", track.label, track.track_id), cv::Point(tlwh[0], tlwh[1] - 10),
                             0, 2, cv::Scalar(0, 0, 255), 3, cv::LINE_AA);
                     rectangle(prev_image, cv::Rect(tlwh[0], tlwh[1], tlwh[2], tlwh[3]),
                               cv::Scalar(get<0>(s), get<1>(s), get<2>(s)), 3);
@@ -99,10 +108,13 @@ void inference_bytetrack(const string& engine_file, int gpuid, Yolo::Type type,
         }
 
         image.copyTo(prev_image);
-        prev_fut = engine->commit(image);
+        if(tracker.need_detection())
+            prev_fut = engine->commit(image);
+        else
+            prev_fut = shared_future<vector<Yolo::Box>>();
 
     }
 
     writer.release();
-    printf("Done.\n");
+    printf("Done. detector ran on %lld of %lld frames\n", tracker.detections(), tracker.frames());
 }
\ No newline at end of file
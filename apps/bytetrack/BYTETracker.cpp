@@ -1,4 +1,6 @@
 #include "BYTETracker.h"
+#include "trt_common/trace.hpp"
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
@@ -17,225 +19,318 @@ BYTETracker::~BYTETracker()
 {
 }
 
-vector<STrack> BYTETracker::update(const vector<Object>& objects)
+int BYTETracker::alloc_track(const STrack& detection)
 {
+	int index;
+	if (!free_slots.empty())
+	{
+		index = free_slots.back();
+		free_slots.pop_back();
+		track_pool[index] = detection;
+	}
+	else
+	{
+		index = track_pool.size();
+		track_pool.push_back(detection);
+		slot_mark.push_back(0);
+		slot_removed.push_back(0);
+		kalman_batch.reserve(track_pool.size());
+	}
+	slot_mark[index] = 0;
+	slot_removed[index] = 0;
+	return index;
+}
+
+void BYTETracker::free_track(int index)
+{
+	free_slots.push_back(index);
+}
+
+/// 已移除的轨迹只能通过 tracked / lost 列表再次访问，两个列表都不再引用时释放其位置，并从 removed_stracks 中去掉
+/// 因此 removed_stracks 和轨迹池的大小只与活动轨迹的数量有关，长时间运行不会增长
+void BYTETracker::release_removed_stracks()
+{
+	int stamp = ++mark_stamp;
+	for (int index : this->tracked_stracks)
+		slot_mark[index] = stamp;
+	for (int index : this->lost_stracks)
+		slot_mark[index] = stamp;
+
+	list_swap.clear();
+	for (int index : this->removed_stracks)
+	{
+		if (slot_mark[index] == stamp)
+			list_swap.push_back(index);
+		else
+			free_track(index);
+	}
+	this->removed_stracks.swap(list_swap);
+}
+
+void BYTETracker::multi_predict(const vector<int>& stracks)
+{
+	for (int index : stracks)
+	{
+		if (track_pool[index].state != TrackState::Tracked)
+		{
+			kalman_batch.mean(index, 7) = 0;
+		}
+	}
+
+	kalman_batch.predict(stracks.data(), stracks.size());
+	for (int index : stracks)
+	{
+		STrack& track = track_pool[index];
+		kalman_batch.get_mean(index, track.mean);
+		track.static_tlwh();
+		track.static_tlbr();
+	}
+}
+
+/// matches 中的轨迹用对应的检测框做一次卡尔曼更新，之后再由 STrack::update / re_activate 更新其余的状态
+void BYTETracker::kalman_update(const vector<int>& stracks, const vector<int>& dets)
+{
+	batch_indices.clear();
+	batch_measurements.clear();
+	for (auto& match : matches)
+	{
+		DETECTBOX xyah = detections[dets[match.second]].to_xyah();
+		batch_indices.push_back(stracks[match.first]);
+		batch_measurements.insert(batch_measurements.end(), xyah.data(), xyah.data() + 4);
+	}
+
+	kalman_batch.update(batch_indices.data(), batch_measurements.data(), batch_indices.size());
+	for (int index : batch_indices)
+	{
+		kalman_batch.get_mean(index, track_pool[index].mean);
+	}
+}
+
+const vector<STrack>& BYTETracker::update(const vector<Object>& objects)
+{
+	TRACE_SCOPE("BYTETracker::update");
 
 	////////////////// Step 1: Get detections //////////////////
 	this->frame_id++;
-	vector<STrack> activated_stracks;
-	vector<STrack> refind_stracks;
-	vector<STrack> removed_stracks;
-	vector<STrack> lost_stracks;
-	vector<STrack> detections;
-	vector<STrack> detections_low;
-
-	vector<STrack> detections_cp;
-	vector<STrack> tracked_stracks_swap;
-	vector<STrack> resa, resb;
-	vector<STrack> output_stracks;
-
-	vector<STrack*> unconfirmed;
-	vector<STrack*> tracked_stracks;
-	vector<STrack*> strack_pool;
-	vector<STrack*> r_tracked_stracks;
-
-	if (objects.size() > 0)
-	{
-		for (int i = 0; i < objects.size(); i++)
+	activated.clear();
+	refind.clear();
+	lost.clear();
+	removed.clear();
+	detections.clear();
+	detections_high.clear();
+	detections_low.clear();
+	detections_remain.clear();
+	unconfirmed.clear();
+	tracked.clear();
+	r_tracked.clear();
+
+	for (int i = 0; i < objects.size(); i++)
+	{
+		float tlbr_[4];
+		tlbr_[0] = objects[i].rect[0];
+		tlbr_[1] = objects[i].rect[1];
+		tlbr_[2] = objects[i].rect[0] + objects[i].rect[2];
+		tlbr_[3] = objects[i].rect[1] + objects[i].rect[3];
+
+		float score = objects[i].prob;
+		detections.emplace_back(tlbr_, score, objects[i].label);
+		if (score >= _config.track_thresh)
 		{
-			vector<float> tlbr_;
-			tlbr_.resize(4);
-			tlbr_[0] = objects[i].rect[0];
-			tlbr_[1] = objects[i].rect[1];
-			tlbr_[2] = objects[i].rect[0] + objects[i].rect[2];
-			tlbr_[3] = objects[i].rect[1] + objects[i].rect[3];
-
-			float score = objects[i].prob;
-
-			STrack strack(STrack::tlbr_to_tlwh(tlbr_), score);
-			if (score >= _config.track_thresh)
-			{
-				detections.push_back(strack);
-			}
-			else
-			{
-				detections_low.push_back(strack);
-			}
-			
+			detections_high.push_back(i);
+		}
+		else
+		{
+			detections_low.push_back(i);
 		}
 	}
 
 	// Add newly detected tracklets to tracked_stracks
-	for (int i = 0; i < this->tracked_stracks.size(); i++)
+	for (int index : this->tracked_stracks)
 	{
-		if (!this->tracked_stracks[i].is_activated)
-			unconfirmed.push_back(&this->tracked_stracks[i]);
+		if (!track_pool[index].is_activated)
+			unconfirmed.push_back(index);
 		else
-			tracked_stracks.push_back(&this->tracked_stracks[i]);
+			tracked.push_back(index);
 	}
 
 	////////////////// Step 2: First association, with IoU //////////////////
-	strack_pool = joint_stracks(tracked_stracks, this->lost_stracks);
-	STrack::multi_predict(strack_pool, this->kalman_filter);
-
-	vector<vector<float> > dists;
-	int dist_size = 0, dist_size_size = 0;
-	dists = iou_distance(strack_pool, detections, dist_size, dist_size_size);
+	joint_stracks(tracked, this->lost_stracks, strack_pool);
+	multi_predict(strack_pool);
 
-	vector<vector<int> > matches;
-	vector<int> u_track, u_detection;
-	linear_assignment(dists, dist_size, dist_size_size, _config.match_thresh, matches, u_track, u_detection);
+	associate(track_pool.data(), strack_pool, detections.data(), detections_high, _config.match_thresh, matches, u_track, u_detection);
+	kalman_update(strack_pool, detections_high);
 
-	for (int i = 0; i < matches.size(); i++)
+	for (auto& match : matches)
 	{
-		STrack *track = strack_pool[matches[i][0]];
-		STrack *det = &detections[matches[i][1]];
-		if (track->state == TrackState::Tracked)
+		int index = strack_pool[match.first];
+		STrack &track = track_pool[index];
+		const STrack &det = detections[detections_high[match.second]];
+		if (track.state == TrackState::Tracked)
 		{
-			track->update(*det, this->frame_id);
-			activated_stracks.push_back(*track);
+			track.update(det, this->frame_id);
+			activated.push_back(index);
 		}
 		else
 		{
-			track->re_activate(*det, this->frame_id, false);
-			refind_stracks.push_back(*track);
+			track.re_activate(det, this->frame_id);
+			refind.push_back(index);
 		}
 	}
 
 	////////////////// Step 3: Second association, using low score dets //////////////////
-	for (int i = 0; i < u_detection.size(); i++)
+	for (int i : u_detection)
 	{
-		detections_cp.push_back(detections[u_detection[i]]);
+		detections_remain.push_back(detections_high[i]);
 	}
-	detections.clear();
-	detections.assign(detections_low.begin(), detections_low.end());
-	
-	for (int i = 0; i < u_track.size(); i++)
+
+	for (int i : u_track)
 	{
-		if (strack_pool[u_track[i]]->state == TrackState::Tracked)
+		if (track_pool[strack_pool[i]].state == TrackState::Tracked)
 		{
-			r_tracked_stracks.push_back(strack_pool[u_track[i]]);
+			r_tracked.push_back(strack_pool[i]);
 		}
 	}
 
-	dists.clear();
-	dists = iou_distance(r_tracked_stracks, detections, dist_size, dist_size_size);
+	associate(track_pool.data(), r_tracked, detections.data(), detections_low, 0.5, matches, u_track, u_detection);
+	kalman_update(r_tracked, detections_low);
 
-	matches.clear();
-	u_track.clear();
-	u_detection.clear();
-	linear_assignment(dists, dist_size, dist_size_size, 0.5, matches, u_track, u_detection);
-
-	for (int i = 0; i < matches.size(); i++)
+	for (auto& match : matches)
 	{
-		STrack *track = r_tracked_stracks[matches[i][0]];
-		STrack *det = &detections[matches[i][1]];
-		if (track->state == TrackState::Tracked)
+		int index = r_tracked[match.first];
+		STrack &track = track_pool[index];
+		const STrack &det = detections[detections_low[match.second]];
+		if (track.state == TrackState::Tracked)
 		{
-			track->update(*det, this->frame_id);
-			activated_stracks.push_back(*track);
+			track.update(det, this->frame_id);
+			activated.push_back(index);
 		}
 		else
 		{
-			track->re_activate(*det, this->frame_id, false);
-			refind_stracks.push_back(*track);
+			track.re_activate(det, this->frame_id);
+			refind.push_back(index);
 		}
 	}
 
-	for (int i = 0; i < u_track.size(); i++)
+	for (int i : u_track)
 	{
-		STrack *track = r_tracked_stracks[u_track[i]];
-		if (track->state != TrackState::Lost)
+		STrack &track = track_pool[r_tracked[i]];
+		if (track.state != TrackState::Lost)
 		{
-			track->mark_lost();
-			lost_stracks.push_back(*track);
+			track.mark_lost();
+			lost.push_back(r_tracked[i]);
 		}
 	}
 
 	// Deal with unconfirmed tracks, usually tracks with only one beginning frame
-	detections.clear();
-	detections.assign(detections_cp.begin(), detections_cp.end());
+	associate(track_pool.data(), unconfirmed, detections.data(), detections_remain, 0.7, matches, u_track, u_detection);
+	kalman_update(unconfirmed, detections_remain);
 
-	dists.clear();
-	dists = iou_distance(unconfirmed, detections, dist_size, dist_size_size);
-
-	matches.clear();
-	vector<int> u_unconfirmed;
-	u_detection.clear();
-	linear_assignment(dists, dist_size, dist_size_size, 0.7, matches, u_unconfirmed, u_detection);
-
-	for (int i = 0; i < matches.size(); i++)
+	for (auto& match : matches)
 	{
-		unconfirmed[matches[i][0]]->update(detections[matches[i][1]], this->frame_id);
-		activated_stracks.push_back(*unconfirmed[matches[i][0]]);
+		int index = unconfirmed[match.first];
+		track_pool[index].update(detections[detections_remain[match.second]], this->frame_id);
+		activated.push_back(index);
 	}
 
-	for (int i = 0; i < u_unconfirmed.size(); i++)
+	for (int i : u_track)
 	{
-		STrack *track = unconfirmed[u_unconfirmed[i]];
-		track->mark_removed();
-		removed_stracks.push_back(*track);
+		int index = unconfirmed[i];
+		track_pool[index].mark_removed();
+		removed.push_back(index);
 	}
 
 	////////////////// Step 4: Init new stracks //////////////////
-	for (int i = 0; i < u_detection.size(); i++)
+	for (int i : u_detection)
 	{
-		STrack *track = &detections[u_detection[i]];
-		if (track->score < this->_config.high_thresh)
+		STrack &det = detections[detections_remain[i]];
+		if (det.score < this->_config.high_thresh)
 			continue;
-		track->activate(this->kalman_filter, this->frame_id);
-		activated_stracks.push_back(*track);
+		det.activate(this->frame_id, ++this->track_id_count);
+		int index = alloc_track(det);
+		kalman_batch.initiate(index, det.tlwh_to_xyah(det._tlwh));
+		kalman_batch.get_mean(index, track_pool[index].mean);
+		activated.push_back(index);
 	}
 
 	////////////////// Step 5: Update state //////////////////
-	for (int i = 0; i < this->lost_stracks.size(); i++)
+	for (int index : this->lost_stracks)
 	{
-		if (this->frame_id - this->lost_stracks[i].end_frame() > this->_config.max_time_lost)
+		STrack &track = track_pool[index];
+		if (this->frame_id - track.end_frame() > this->_config.max_time_lost)
 		{
-			this->lost_stracks[i].mark_removed();
-			removed_stracks.push_back(this->lost_stracks[i]);
+			track.mark_removed();
+			removed.push_back(index);
 		}
 	}
-	
-	for (int i = 0; i < this->tracked_stracks.size(); i++)
+
+	list_swap.clear();
+	for (int index : this->tracked_stracks)
 	{
-		if (this->tracked_stracks[i].state == TrackState::Tracked)
+		if (track_pool[index].state == TrackState::Tracked)
 		{
-			tracked_stracks_swap.push_back(this->tracked_stracks[i]);
+			list_swap.push_back(index);
 		}
 	}
-	this->tracked_stracks.clear();
-	this->tracked_stracks.assign(tracked_stracks_swap.begin(), tracked_stracks_swap.end());
-
-	this->tracked_stracks = joint_stracks(this->tracked_stracks, activated_stracks);
-	this->tracked_stracks = joint_stracks(this->tracked_stracks, refind_stracks);
+	joint_stracks(list_swap, activated, resa);
+	joint_stracks(resa, refind, this->tracked_stracks);
 
-	//std::cout << activated_stracks.size() << std::endl;
-
-	this->lost_stracks = sub_stracks(this->lost_stracks, this->tracked_stracks);
-	for (int i = 0; i < lost_stracks.size(); i++)
+	// lost = (lost - tracked + 本帧丢失的) - 之前各帧移除的，按 track_id 排序
+	// 本帧移除的轨迹要到下一帧才从 lost 中去掉，与原来的实现一致
+	sub_stracks(this->lost_stracks, this->tracked_stracks, list_swap);
+	list_swap.insert(list_swap.end(), lost.begin(), lost.end());
+	this->lost_stracks.clear();
+	for (int index : list_swap)
 	{
-		this->lost_stracks.push_back(lost_stracks[i]);
+		if (!slot_removed[index])
+			this->lost_stracks.push_back(index);
 	}
+	sort(this->lost_stracks.begin(), this->lost_stracks.end(), [this](int a, int b){
+		return track_pool[a].track_id < track_pool[b].track_id;
+	});
 
-	this->lost_stracks = sub_stracks(this->lost_stracks, this->removed_stracks);
-	for (int i = 0; i < removed_stracks.size(); i++)
+	for (int index : removed)
 	{
-		this->removed_stracks.push_back(removed_stracks[i]);
+		if (slot_removed[index])
+			continue;
+		slot_removed[index] = 1;
+		this->removed_stracks.push_back(index);
 	}
-	
+
 	remove_duplicate_stracks(resa, resb, this->tracked_stracks, this->lost_stracks);
+	this->tracked_stracks.swap(resa);
+	this->lost_stracks.swap(resb);
+	release_removed_stracks();
 
-	this->tracked_stracks.clear();
-	this->tracked_stracks.assign(resa.begin(), resa.end());
-	this->lost_stracks.clear();
-	this->lost_stracks.assign(resb.begin(), resb.end());
-	
-	for (int i = 0; i < this->tracked_stracks.size(); i++)
+	return collect_output_stracks();
+}
+
+/// frame_id 照常增加，丢失的轨迹按帧数（而不是检测的次数）超时移除
+const vector<STrack>& BYTETracker::predict()
+{
+	TRACE_SCOPE("BYTETracker::predict");
+
+	this->frame_id++;
+	tracked.clear();
+	for (int index : this->tracked_stracks)
+	{
+		if (track_pool[index].is_activated)
+			tracked.push_back(index);
+	}
+	joint_stracks(tracked, this->lost_stracks, strack_pool);
+	multi_predict(strack_pool);
+
+	return collect_output_stracks();
+}
+
+const vector<STrack>& BYTETracker::collect_output_stracks()
+{
+	output_stracks.clear();
+	for (int index : this->tracked_stracks)
 	{
-		if (this->tracked_stracks[i].is_activated)
+		if (track_pool[index].is_activated)
 		{
-			output_stracks.push_back(this->tracked_stracks[i]);
+			output_stracks.push_back(track_pool[index]);
+			kalman_batch.get_covariance(index, output_stracks.back().covariance);
 		}
 	}
 	return output_stracks;
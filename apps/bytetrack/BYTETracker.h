@@ -1,6 +1,8 @@
 #pragma once
 
 #include "STrack.h"
+#include "kalmanBatch.h"
+#include "lapjvWorkspace.h"
 
 struct Object
 {
@@ -10,38 +12,110 @@ struct Object
     float prob;
 };
 
+/// 所有轨迹存放在轨迹池 track_pool 中，tracked / lost / removed 列表只保存池中的下标，轨迹在各列表之间移动时不再拷贝
+/// 检测框、下标列表、代价矩阵、lapjv 的工作区等都是成员，容量只增不减，稳定之后 update 不再分配内存
 class BYTETracker
 {
 public:
 	BYTETracker();
 	~BYTETracker();
 
-	vector<STrack> update(const vector<Object>& objects);
+	/// 返回已确认的轨迹，引用在下一次 update 之前有效
+	const vector<STrack>& update(const vector<Object>& objects);
+
+	/// 没有检测结果的帧：已确认和丢失的轨迹各预测一步（与 update 中的预测相同），不做关联，轨迹的状态不变
+	/// 返回已确认的轨迹，框为预测的位置，引用在下一次 update / predict 之前有效
+	const vector<STrack>& predict();
 	tuple<uint8_t, uint8_t, uint8_t> get_color(int idx);
 	byte_kalman::Config& config();
 
+	/// 轨迹池的大小和仍被引用的已移除轨迹数，用于观察长时间运行时的内存
+	int pool_size() const{ return track_pool.size(); }
+	int removed_size() const{ return removed_stracks.size(); }
+
 private:
-	vector<STrack*> joint_stracks(vector<STrack*> &tlista, vector<STrack> &tlistb);
-	vector<STrack> joint_stracks(vector<STrack> &tlista, vector<STrack> &tlistb);
+	int alloc_track(const STrack& detection);
+	void free_track(int index);
+	void release_removed_stracks();
+	void multi_predict(const vector<int>& stracks);
+	void kalman_update(const vector<int>& stracks, const vector<int>& dets);
+	const vector<STrack>& collect_output_stracks();
+
+	void joint_stracks(const vector<int> &tlista, const vector<int> &tlistb, vector<int> &res);
+	void sub_stracks(const vector<int> &tlista, const vector<int> &tlistb, vector<int> &res);
+	void remove_duplicate_stracks(vector<int> &resa, vector<int> &resb, const vector<int> &stracksa, const vector<int> &stracksb);
+
+	/// 按 config().sparse_association 选择稠密或稀疏的关联，两者的结果相同
+	/// config().class_aware 时不同类别的对代价为 1，不会被匹配；稀疏关联中直接跳过，代价矩阵按类别拆成互不相连的分量
+	/// config().gating 时先用马氏距离排除不可能的对，atracks 必须是轨迹池
+	void associate(const STrack* atracks, const vector<int> &aindex, const STrack* btracks, const vector<int> &bindex, float thresh,
+		vector<pair<int, int> > &matches, vector<int> &unmatched_a, vector<int> &unmatched_b);
+	void linear_assignment(const vector<float> &cost_matrix, int cost_matrix_size, int cost_matrix_size_size, float thresh,
+		vector<pair<int, int> > &matches, vector<int> &unmatched_a, vector<int> &unmatched_b);
+	void sparse_assignment(const STrack* atracks, const vector<int> &aindex, const STrack* btracks, const vector<int> &bindex, float thresh,
+		vector<pair<int, int> > &matches, vector<int> &unmatched_a, vector<int> &unmatched_b);
+	/// cost_matrix 为 aindex.size() x bindex.size() 的行优先矩阵
+	/// gating 时 atracks 是轨迹池，btracks 是检测框，被 gate_pair 排除的对与不同类别的对一样处理
+	void iou_distance(const STrack* atracks, const vector<int> &aindex, const STrack* btracks, const vector<int> &bindex,
+		vector<float> &cost_matrix, bool gating = false);
 
-	vector<STrack> sub_stracks(vector<STrack> &tlista, vector<STrack> &tlistb);
-	void remove_duplicate_stracks(vector<STrack> &resa, vector<STrack> &resb, vector<STrack> &stracksa, vector<STrack> &stracksb);
+	/// 代价小于 max_cost 的 (a, b) 对，用 b 的均匀网格找出可能重叠的框，不计算不相交的框
+	struct CostEntry { int row; int col; float cost; };
+	void iou_candidates(const STrack* atracks, const vector<int> &aindex, const STrack* btracks, const vector<int> &bindex,
+		double max_cost, vector<CostEntry> &entries, bool gating = false);
 
-	void linear_assignment(vector<vector<float> > &cost_matrix, int cost_matrix_size, int cost_matrix_size_size, float thresh,
-		vector<vector<int> > &matches, vector<int> &unmatched_a, vector<int> &unmatched_b);
-	vector<vector<float> > iou_distance(vector<STrack*> &atracks, vector<STrack> &btracks, int &dist_size, int &dist_size_size);
-	vector<vector<float> > iou_distance(vector<STrack> &atracks, vector<STrack> &btracks);
-	vector<vector<float> > ious(vector<vector<float> > &atlbrs, vector<vector<float> > &btlbrs);
+	/// 马氏距离门限：prepare_gating 计算各轨迹的投影和各检测框的 xyah，gate_pair(i, j) 为 true 表示 aindex[i] 与 bindex[j] 不可能匹配
+	void prepare_gating(const vector<int> &aindex, const STrack* btracks, const vector<int> &bindex);
+	bool gate_pair(int i, int j) const;
+	int find_component(int node);
 
-	double lapjv(const vector<vector<float> > &cost, vector<int> &rowsol, vector<int> &colsol, 
+	/// cost 为 n_rows x n_cols 的行优先矩阵，扩展之后的矩阵和求解用的数组都在成员中复用
+	double lapjv(const float* cost, int n_rows, int n_cols, vector<int> &rowsol, vector<int> &colsol,
 		bool extend_cost = false, float cost_limit = LONG_MAX, bool return_cost = true);
 
 private:
 	int frame_id;
+	int track_id_count = 0;             // 本 tracker 分配过的最大 track_id
+
+	vector<STrack> track_pool;
+	vector<int> free_slots;
+	vector<int> slot_mark;              // 列表求并、求差时的标记，与 mark_stamp 相等表示已标记，不需要每帧清零
+	vector<unsigned char> slot_removed; // 是否已移除，位置释放之前一直保留，被重新找回的轨迹也不会再进入 lost
+	int mark_stamp = 0;
+
+	vector<int> tracked_stracks;
+	vector<int> lost_stracks;
+	vector<int> removed_stracks;       // 已移除但仍在 tracked / lost 中的轨迹，不再被引用时释放
+
+	// 每帧的临时列表，下标指向 track_pool（轨迹）或 detections（检测框）
+	vector<STrack> detections;
+	vector<int> detections_high, detections_low, detections_remain;
+	vector<int> activated, refind, lost, removed;
+	vector<int> unconfirmed, tracked, strack_pool, r_tracked;
+	vector<int> list_swap, resa, resb;
+	vector<float> dists;
+	vector<pair<int, int> > matches;
+	vector<int> u_track, u_detection;
+	vector<int> rowsol, colsol;
+	vector<float> lapjv_cost;
+	vector<int> lapjv_x, lapjv_y;
+	LapjvWorkspace<float> lapjv_workspace;
+
+	// 稀疏关联：网格（按格子排好的 b 下标）、候选对、并查集、各连通分量的行列
+	vector<int> grid_start, grid_items, grid_cell, col_stamp;
+	int col_mark = 0;
+	vector<CostEntry> cost_entries;
+	vector<int> component_parent, component_id, component_start, component_items;
+	vector<int> sub_rows, sub_cols;
+	vector<int> sparse_rowsol, sparse_colsol;
+	vector<float> gate_means, gate_inv_std, gate_measurements;
+	int gate_dims = 4;
+	float gate_threshold = 0;
+	vector<int> batch_indices;
+	vector<float> batch_measurements;
+	vector<STrack> output_stracks;
 
-	vector<STrack> tracked_stracks;
-	vector<STrack> lost_stracks;
-	vector<STrack> removed_stracks;
 	byte_kalman::KalmanFilter kalman_filter;
 	byte_kalman::Config& _config = kalman_filter.config();
+	byte_kalman::KalmanBatch kalman_batch{kalman_filter.config()};
 };
\ No newline at end of file
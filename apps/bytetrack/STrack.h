@@ -6,35 +6,38 @@ using namespace std;
 
 enum TrackState { New = 0, Tracked, Lost, Removed };
 
+/// 轨迹和检测框共用的结构，不含堆上的成员，可以直接放在 BYTETracker 的轨迹池中复用
+/// 卡尔曼状态由 BYTETracker 的 KalmanBatch 批量计算，mean 随之写回；covariance 只在 update 返回的轨迹中填写
 class STrack
 {
 public:
-	STrack(vector<float> tlwh_, float score);
+	STrack();
+	STrack(const float tlbr_[4], float score, int label = 0);
 	~STrack();
 
-	vector<float> static tlbr_to_tlwh(vector<float> &tlbr);
-	void static multi_predict(vector<STrack*> &stracks, byte_kalman::KalmanFilter &kalman_filter);
 	void static_tlwh();
 	void static_tlbr();
-	vector<float> tlwh_to_xyah(vector<float> tlwh_tmp);
-	vector<float> to_xyah();
+	DETECTBOX tlwh_to_xyah(const float tlwh_tmp[4]) const;
+	DETECTBOX to_xyah() const;
 	void mark_lost();
 	void mark_removed();
-	int next_id();
-	int end_frame();
-	
-	void activate(byte_kalman::KalmanFilter &kalman_filter, int frame_id);
-	void re_activate(STrack &new_track, int frame_id, bool new_id = false);
-	void update(STrack &new_track, int frame_id);
+	int end_frame() const;
+
+	/// 调用之前 mean 已经是初始化 / 更新之后的值
+	/// track_id 由 BYTETracker 分配，每个 tracker 各自编号，多个 tracker 可以在不同的线程上运行
+	void activate(int frame_id, int track_id);
+	void re_activate(const STrack &new_track, int frame_id, int new_id = 0);
+	void update(const STrack &new_track, int frame_id);
 
 public:
 	bool is_activated;
 	int track_id;
 	int state;
+	int label;                  // 检测框的类别，轨迹沿用创建它的检测框的类别
 
-	vector<float> _tlwh;
-	vector<float> tlwh;
-	vector<float> tlbr;
+	float _tlwh[4];
+	float tlwh[4];
+	float tlbr[4];
 	int frame_id;
 	int tracklet_len;
 	int start_frame;
@@ -42,7 +45,4 @@ public:
 	KAL_MEAN mean;
 	KAL_COVA covariance;
 	float score;
-
-private:
-	byte_kalman::KalmanFilter kalman_filter;
 };
\ No newline at end of file
@@ -0,0 +1,260 @@
+#include "kalmanBatch.h"
+#include <cmath>
+#include <atomic>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BYTE_KALMAN_X86
+#endif
+
+namespace byte_kalman
+{
+	static std::atomic<bool> g_simd_enabled{true};
+
+	// _data 中各行的位置
+	enum Row{ MEAN = 0, P00 = 8, P01 = 12, P10 = 16, P11 = 20, NUM_ROWS = 24 };
+
+	bool is_simd_available()
+	{
+#ifdef BYTE_KALMAN_X86
+		static bool available = __builtin_cpu_supports("avx2");
+		return available;
+#else
+		return false;
+#endif
+	}
+
+	void set_simd_enabled(bool enabled)
+	{
+		g_simd_enabled = enabled;
+	}
+
+	static bool simd_enabled()
+	{
+		return g_simd_enabled.load(std::memory_order_relaxed) && is_simd_available();
+	}
+
+	KalmanBatch::KalmanBatch(const Config& config)
+		: _config(config)
+	{
+	}
+
+	void KalmanBatch::reserve(int capacity)
+	{
+		if (capacity <= _capacity)
+			return;
+
+		int new_capacity = std::max(capacity, std::max(_capacity * 2, 64));
+		std::vector<float> data((size_t)NUM_ROWS * new_capacity);
+		for (int k = 0; k < NUM_ROWS; k++)
+			std::copy(row(k), row(k) + _capacity, data.data() + (size_t)k * new_capacity);
+
+		_data.swap(data);
+		_capacity = new_capacity;
+	}
+
+	void KalmanBatch::initiate(int index, const DETECTBOX& measurement)
+	{
+		float h = measurement[3];
+		for (int c = 0; c < 4; c++)
+		{
+			float std_pos = c == 2 ? _config.initiate_state[2] : _config.initiate_state[c] * h;
+			float std_vel = c == 2 ? _config.initiate_state[6] : _config.initiate_state[c + 4] * h;
+			row(MEAN + c)[index] = measurement[c];
+			row(MEAN + c + 4)[index] = 0;
+			row(P00 + c)[index] = std_pos * std_pos;
+			row(P01 + c)[index] = 0;
+			row(P10 + c)[index] = 0;
+			row(P11 + c)[index] = std_vel * std_vel;
+		}
+	}
+
+	void KalmanBatch::get_mean(int index, KAL_MEAN& mean) const
+	{
+		for (int k = 0; k < 8; k++)
+			mean(k) = _data[(size_t)(MEAN + k) * _capacity + index];
+	}
+
+	void KalmanBatch::get_covariance(int index, KAL_COVA& covariance) const
+	{
+		auto at = [&](int k){ return _data[(size_t)k * _capacity + index]; };
+		covariance.setZero();
+		for (int c = 0; c < 4; c++)
+		{
+			covariance(c, c) = at(P00 + c);
+			covariance(c, c + 4) = at(P01 + c);
+			covariance(c + 4, c) = at(P10 + c);
+			covariance(c + 4, c + 4) = at(P11 + c);
+		}
+	}
+
+	/// 与 KalmanFilter::project 相同的测量噪声，std = (noise[0] * h, noise[1] * h, noise[2], noise[3] * h)
+	void KalmanBatch::project(const int* indices, int count, float* means, float* inv_std) const
+	{
+		for (int i = 0; i < count; i++)
+		{
+			int index = indices[i];
+			float h = row(MEAN + 3)[index];
+			for (int c = 0; c < 4; c++)
+			{
+				float std_noise = c == 2 ? _config.noise[2] : _config.noise[c] * h;
+				means[4 * i + c] = row(MEAN + c)[index];
+				inv_std[4 * i + c] = 1.0f / std::sqrt(row(P00 + c)[index] + std_noise * std_noise);
+			}
+		}
+	}
+
+	/// mean' = F * mean，P' = F * P * F^T + Q，逐块展开：
+	/// p00' = (p00 + p10) + (p01 + p11) + q_pos²，p01' = p01 + p11，p10' = p10 + p11，p11' = p11 + q_vel²
+	void KalmanBatch::predict_one(int index)
+	{
+		float h = row(MEAN + 3)[index];
+		for (int c = 0; c < 4; c++)
+		{
+			float std_pos = c == 2 ? _config.per_frame_motion[2] : _config.per_frame_motion[c] * h;
+			float std_vel = c == 2 ? _config.per_frame_motion[6] : _config.per_frame_motion[c + 4] * h;
+			float p00 = row(P00 + c)[index], p01 = row(P01 + c)[index];
+			float p10 = row(P10 + c)[index], p11 = row(P11 + c)[index];
+
+			row(MEAN + c)[index] += row(MEAN + c + 4)[index];
+			row(P00 + c)[index] = ((p00 + p10) + (p01 + p11)) + std_pos * std_pos;
+			row(P01 + c)[index] = p01 + p11;
+			row(P10 + c)[index] = p10 + p11;
+			row(P11 + c)[index] = p11 + std_vel * std_vel;
+		}
+	}
+
+	/// S = p00 + r²，对角的 S 做 Cholesky 之后 K = P * H^T * S^-1 每个块只剩两项：
+	/// k0 = p00 * (1 / sqrt(S)) * (1 / sqrt(S))，k1 = p10 * ...（与 Eigen 的三角求解相同，乘以倒数）
+	/// mean' = mean + innovation * K，P' = P - (K * S) * K^T
+	void KalmanBatch::update_one(int index, const float* measurement)
+	{
+		float h = row(MEAN + 3)[index];
+		for (int c = 0; c < 4; c++)
+		{
+			float std_noise = c == 2 ? _config.noise[2] : _config.noise[c] * h;
+			float p00 = row(P00 + c)[index], p01 = row(P01 + c)[index];
+			float p10 = row(P10 + c)[index], p11 = row(P11 + c)[index];
+
+			float s = p00 + std_noise * std_noise;
+			float inv = 1.0f / std::sqrt(s);
+			float k0 = (p00 * inv) * inv;
+			float k1 = (p10 * inv) * inv;
+			float innovation = measurement[c] - row(MEAN + c)[index];
+
+			row(MEAN + c)[index] += innovation * k0;
+			row(MEAN + c + 4)[index] += innovation * k1;
+			float ks0 = k0 * s, ks1 = k1 * s;
+			row(P00 + c)[index] = p00 - ks0 * k0;
+			row(P01 + c)[index] = p01 - ks0 * k1;
+			row(P10 + c)[index] = p10 - ks1 * k0;
+			row(P11 + c)[index] = p11 - ks1 * k1;
+		}
+	}
+
+#ifdef BYTE_KALMAN_X86
+
+	/// 下标不连续，用 gather 读取 8 个轨迹，计算之后逐个写回
+	__attribute__((target("avx2")))
+	static inline __m256 gather8(const float* base, __m256i index)
+	{
+		return _mm256_i32gather_ps(base, index, 4);
+	}
+
+	__attribute__((target("avx2")))
+	static inline void scatter8(float* base, const int* indices, __m256 value)
+	{
+		alignas(32) float lanes[8];
+		_mm256_store_ps(lanes, value);
+		for (int i = 0; i < 8; i++)
+			base[indices[i]] = lanes[i];
+	}
+
+	__attribute__((target("avx2")))
+	void KalmanBatch::predict8(const int* indices)
+	{
+		__m256i index = _mm256_loadu_si256((const __m256i*)indices);
+		__m256 h = gather8(row(MEAN + 3), index);
+		for (int c = 0; c < 4; c++)
+		{
+			__m256 std_pos = c == 2 ? _mm256_set1_ps(_config.per_frame_motion[2]) : _mm256_mul_ps(_mm256_set1_ps(_config.per_frame_motion[c]), h);
+			__m256 std_vel = c == 2 ? _mm256_set1_ps(_config.per_frame_motion[6]) : _mm256_mul_ps(_mm256_set1_ps(_config.per_frame_motion[c + 4]), h);
+			__m256 pos = gather8(row(MEAN + c), index);
+			__m256 vel = gather8(row(MEAN + c + 4), index);
+			__m256 p00 = gather8(row(P00 + c), index), p01 = gather8(row(P01 + c), index);
+			__m256 p10 = gather8(row(P10 + c), index), p11 = gather8(row(P11 + c), index);
+
+			scatter8(row(MEAN + c), indices, _mm256_add_ps(pos, vel));
+			scatter8(row(P00 + c), indices, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(p00, p10), _mm256_add_ps(p01, p11)), _mm256_mul_ps(std_pos, std_pos)));
+			scatter8(row(P01 + c), indices, _mm256_add_ps(p01, p11));
+			scatter8(row(P10 + c), indices, _mm256_add_ps(p10, p11));
+			scatter8(row(P11 + c), indices, _mm256_add_ps(p11, _mm256_mul_ps(std_vel, std_vel)));
+		}
+		// 编译器不会在 target("avx2") 函数的出口插入 vzeroupper
+		_mm256_zeroupper();
+	}
+
+	__attribute__((target("avx2")))
+	void KalmanBatch::update8(const int* indices, const float* measurements)
+	{
+		__m256i index = _mm256_loadu_si256((const __m256i*)indices);
+		__m256i lane_offset = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+		__m256 h = gather8(row(MEAN + 3), index);
+		const __m256 one = _mm256_set1_ps(1.0f);
+		for (int c = 0; c < 4; c++)
+		{
+			__m256 std_noise = c == 2 ? _mm256_set1_ps(_config.noise[2]) : _mm256_mul_ps(_mm256_set1_ps(_config.noise[c]), h);
+			__m256 pos = gather8(row(MEAN + c), index);
+			__m256 vel = gather8(row(MEAN + c + 4), index);
+			__m256 p00 = gather8(row(P00 + c), index), p01 = gather8(row(P01 + c), index);
+			__m256 p10 = gather8(row(P10 + c), index), p11 = gather8(row(P11 + c), index);
+			__m256 measurement = gather8(measurements + c, lane_offset);
+
+			__m256 s = _mm256_add_ps(p00, _mm256_mul_ps(std_noise, std_noise));
+			__m256 inv = _mm256_div_ps(one, _mm256_sqrt_ps(s));
+			__m256 k0 = _mm256_mul_ps(_mm256_mul_ps(p00, inv), inv);
+			__m256 k1 = _mm256_mul_ps(_mm256_mul_ps(p10, inv), inv);
+			__m256 innovation = _mm256_sub_ps(measurement, pos);
+			__m256 ks0 = _mm256_mul_ps(k0, s), ks1 = _mm256_mul_ps(k1, s);
+
+			scatter8(row(MEAN + c), indices, _mm256_add_ps(pos, _mm256_mul_ps(innovation, k0)));
+			scatter8(row(MEAN + c + 4), indices, _mm256_add_ps(vel, _mm256_mul_ps(innovation, k1)));
+			scatter8(row(P00 + c), indices, _mm256_sub_ps(p00, _mm256_mul_ps(ks0, k0)));
+			scatter8(row(P01 + c), indices, _mm256_sub_ps(p01, _mm256_mul_ps(ks0, k1)));
+			scatter8(row(P10 + c), indices, _mm256_sub_ps(p10, _mm256_mul_ps(ks1, k0)));
+			scatter8(row(P11 + c), indices, _mm256_sub_ps(p11, _mm256_mul_ps(ks1, k1)));
+		}
+		_mm256_zeroupper();
+	}
+
+#endif // BYTE_KALMAN_X86
+
+	void KalmanBatch::predict(const int* indices, int count)
+	{
+		int i = 0;
+#ifdef BYTE_KALMAN_X86
+		if (simd_enabled())
+		{
+			for (; i + 8 <= count; i += 8)
+				predict8(indices + i);
+		}
+#endif
+		for (; i < count; i++)
+			predict_one(indices[i]);
+	}
+
+	void KalmanBatch::update(const int* indices, const float* measurements, int count)
+	{
+		int i = 0;
+#ifdef BYTE_KALMAN_X86
+		if (simd_enabled())
+		{
+			for (; i + 8 <= count; i += 8)
+				update8(indices + i, measurements + 4 * i);
+		}
+#endif
+		for (; i < count; i++)
+			update_one(indices[i], measurements + 4 * i);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "kalmanFilter.h"
+
+namespace byte_kalman
+{
+	/// 一批轨迹的卡尔曼状态，按下标（BYTETracker 轨迹池的下标）以 SoA 存放，x86 上用 AVX2 一次处理 8 个轨迹
+	/// 匀速模型的 _motion_mat = [I I; 0 I]、_update_mat = [I 0]，初始协方差和各噪声都是对角阵，
+	/// 因此 x / y / a / h 各自与对应的速度构成 4 个互不相关的 2x2 块，8x8 的协方差只需要保存这 4 个块
+	/// 运算顺序与 KalmanFilter 中 Eigen 的计算相同，结果逐位一致
+	class KalmanBatch
+	{
+	public:
+		KalmanBatch(const Config& config);
+
+		/// 容量只增不减，已有的状态保留
+		void reserve(int capacity);
+		int capacity() const{ return _capacity; }
+
+		void initiate(int index, const DETECTBOX& measurement);
+
+		/// indices 中的轨迹各预测一步
+		void predict(const int* indices, int count);
+
+		/// indices[i] 用 measurements[4 * i, 4 * i + 4)（xyah）更新，indices 中不能有重复
+		void update(const int* indices, const float* measurements, int count);
+
+		/// 投影到测量空间，S = H * P * H^T + R 是对角阵：indices[i] 的 xyah 写入 means[4 * i, 4 * i + 4)，
+		/// 1 / sqrt(S) 的对角写入 inv_std[4 * i, 4 * i + 4)，马氏距离平方为 sum(((z - mean) * inv_std)²)
+		void project(const int* indices, int count, float* means, float* inv_std) const;
+
+		float& mean(int index, int k){ return _data[k * _capacity + index]; }
+		void get_mean(int index, KAL_MEAN& mean) const;
+		void get_covariance(int index, KAL_COVA& covariance) const;
+
+	private:
+		float* row(int k){ return _data.data() + (size_t)k * _capacity; }
+		const float* row(int k) const{ return _data.data() + (size_t)k * _capacity; }
+		void predict_one(int index);
+		void update_one(int index, const float* measurement);
+		void predict8(const int* indices);
+		void update8(const int* indices, const float* measurements);
+
+		const Config& _config;
+		std::vector<float> _data;   // 24 行：均值 8 行，每个块 p00 / p01 / p10 / p11 各 4 行
+		int _capacity = 0;
+	};
+
+	/// CPU 是否支持 AVX2
+	bool is_simd_available();
+
+	/// 默认开启，关闭之后使用标量实现，用于对比和验证
+	void set_simd_enabled(bool enabled);
+}
\ No newline at end of file
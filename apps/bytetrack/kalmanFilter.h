@@ -20,6 +20,18 @@ namespace byte_kalman
 		float match_thresh = 0.8;
 		int max_time_lost = 30;
 
+		// /** 关联时只对网格中相邻的框计算 IoU，代价矩阵按连通分量拆开分别求解，结果与稠密矩阵相同 **/
+		bool sparse_association = true;
+
+		// /** 只关联 label 相同的轨迹和检测框，各类别的轨迹互不影响；关闭时忽略 label **/
+		bool class_aware = true;
+
+		// /** 关联之前用马氏距离（与 gating_distance 相同）排除不可能的轨迹 - 检测框对，默认关闭 **/
+		bool gating = false;
+		bool gating_only_position = false;
+		// /** 马氏距离平方的阈值，<= 0 时使用 chi2inv95 中对应自由度（4，只用位置时为 2）的值 **/
+		float gating_threshold = 0;
+
 		Config& set_initiate_state(const std::vector<float>& values);
 		Config& set_per_frame_motion(const std::vector<float>& values);
 		Config& set_noise(const std::vector<float>& values);
@@ -27,6 +39,11 @@ namespace byte_kalman
 		Config& set_high_thresh(float value){this->high_thresh = value; return *this;};
 		Config& set_match_thresh(float value){this->match_thresh = value; return *this;};
 		Config& set_max_time_lost(int value){this->max_time_lost = value; return *this;};
+		Config& set_sparse_association(bool value){this->sparse_association = value; return *this;};
+		Config& set_class_aware(bool value){this->class_aware = value; return *this;};
+		Config& set_gating(bool value){this->gating = value; return *this;};
+		Config& set_gating_only_position(bool value){this->gating_only_position = value; return *this;};
+		Config& set_gating_threshold(float value){this->gating_threshold = value; return *this;};
 
 		Config();
 	};
@@ -0,0 +1,56 @@
+#include "keyframeTracker.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+KeyframeTracker::KeyframeTracker()
+	: _keyframe(default_keyframe_config())
+{
+}
+
+bool KeyframeTracker::need_detection() const
+{
+	if (num_frames == 0 || num_tracks == 0 || since_detection + 1 >= _keyframe.max_detect_interval)
+		return true;
+
+	if (last_uncertainty > _keyframe.detect_uncertainty)
+		return true;
+	return _keyframe.detect_motion > 0 && last_motion > _keyframe.detect_motion;
+}
+
+const vector<STrack>& KeyframeTracker::update(const vector<Object>& objects)
+{
+	num_frames++;
+	num_detections++;
+	since_detection = 0;
+	const vector<STrack>& tracks = tracker.update(objects);
+	measure(tracks);
+	return tracks;
+}
+
+const vector<STrack>& KeyframeTracker::predict()
+{
+	num_frames++;
+	since_detection++;
+	const vector<STrack>& tracks = tracker.predict();
+	measure(tracks);
+	return tracks;
+}
+
+/// 协方差按 xyah 排列，位置的方差为 P(0, 0) + P(1, 1)，速度为 mean(4)、mean(5)
+void KeyframeTracker::measure(const vector<STrack>& tracks)
+{
+	num_tracks = tracks.size();
+	last_uncertainty = 0;
+	last_motion = 0;
+	for (auto& track : tracks)
+	{
+		float h = max(track.mean(3), 1.0f);
+		last_uncertainty += sqrt(track.covariance(0, 0) + track.covariance(1, 1)) / h;
+		float speed = sqrt(track.mean(4) * track.mean(4) + track.mean(5) * track.mean(5));
+		last_motion = max(last_motion, speed * (since_detection + 1) / h);
+	}
+	if (num_tracks > 0)
+		last_uncertainty /= num_tracks;
+}
\ No newline at end of file
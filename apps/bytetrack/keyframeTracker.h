@@ -0,0 +1,66 @@
+#pragma once
+
+#include "BYTETracker.h"
+
+/// 隔帧检测的参数，只在这里定义；KeyframeTracker 创建时复制 default_keyframe_config()，main.cpp 从 config.yaml 中读取
+/// （max_detect_interval / detect_uncertainty / detect_motion），因此不需要改 app 的代码
+/// 默认每帧检测，隔帧检测需要设置 max_detect_interval > 1；设为 5 时合成场景中检测器的负载约降到 1/3（bench 的 tracker_keyframe）
+struct KeyframeConfig
+{
+	// /** 两次检测最多间隔的帧数，1 表示每帧检测，此时后两项不起作用 **/
+	int max_detect_interval = 1;
+	// /** 轨迹位置的标准差 sqrt(Pxx + Pyy) 与框高之比（所有轨迹的均值）超过该值时下一帧检测 **/
+	float detect_uncertainty = 0.12f;
+	// /** 上次检测之后的位移 |v| * 帧数与框高之比（所有轨迹的最大值）超过该值时下一帧检测，<= 0 时不使用 **/
+	float detect_motion = 0.25f;
+};
+
+inline KeyframeConfig& default_keyframe_config()
+{
+	static KeyframeConfig config;
+	return config;
+}
+
+/// 隔帧检测：检测器不必每帧运行，没有检测的帧只用卡尔曼预测推进轨迹（BYTETracker::predict）
+/// 每帧之后根据输出轨迹的协方差决定下一帧是否检测，检测的间隔随协方差的增长自适应：
+/// 位置的不确定度超过 keyframe_config().detect_uncertainty、位移超过 detect_motion，或者已经间隔 max_detect_interval 帧时检测
+/// 没有轨迹时每帧检测；新出现的目标最多晚 max_detect_interval - 1 帧被发现
+class KeyframeTracker
+{
+public:
+	KeyframeTracker();
+
+	/// 卡尔曼噪声和关联的参数，与 BYTETracker::config() 相同
+	byte_kalman::Config& config(){ return tracker.config(); }
+	KeyframeConfig& keyframe_config(){ return _keyframe; }
+
+	/// 下一帧是否需要运行检测器
+	bool need_detection() const;
+
+	/// 运行了检测器的帧
+	const vector<STrack>& update(const vector<Object>& objects);
+
+	/// 没有运行检测器的帧，轨迹的框为预测的位置
+	const vector<STrack>& predict();
+
+	tuple<uint8_t, uint8_t, uint8_t> get_color(int idx){ return tracker.get_color(idx); }
+
+	/// 已处理的帧数和其中运行了检测器的帧数
+	long long frames() const{ return num_frames; }
+	long long detections() const{ return num_detections; }
+
+	/// 最近一帧所有轨迹 sqrt(Pxx + Pyy) / h 的均值
+	float uncertainty() const{ return last_uncertainty; }
+
+private:
+	void measure(const vector<STrack>& tracks);
+
+	BYTETracker tracker;
+	KeyframeConfig _keyframe;
+	long long num_frames = 0;
+	long long num_detections = 0;
+	int since_detection = 0;        // 上一次检测之后的帧数
+	int num_tracks = 0;
+	float last_uncertainty = 0;
+	float last_motion = 0;          // 到下一帧时距上一次检测的位移 / h，所有轨迹的最大值
+};
\ No newline at end of file
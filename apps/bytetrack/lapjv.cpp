@@ -3,14 +3,57 @@
 #include <string.h>
 
 #include "lapjv.h"
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LAPJV_X86
+#endif
+
+static std::atomic<bool> g_simd_enabled{true};
+
+bool lapjv_simd_available()
+{
+#ifdef LAPJV_X86
+	static bool available = __builtin_cpu_supports("avx2");
+	return available;
+#else
+	return false;
+#endif
+}
+
+void lapjv_set_simd_enabled(bool enabled)
+{
+	g_simd_enabled = enabled;
+}
+
+static bool simd_enabled()
+{
+	return g_simd_enabled.load(std::memory_order_relaxed) && lapjv_simd_available();
+}
+
+template<typename T>
+void LapjvWorkspace<T>::reserve(unsigned int n)
+{
+	if (free_rows.size() >= n)
+		return;
+
+	free_rows.resize(n);
+	cols.resize(n);
+	pred.resize(n);
+	v.resize(n);
+	d.resize(n);
+	unique.resize(n);
+}
+
 
 /** Column-reduction and reduction transfer for a dense cost matrix.
  */
-int_t _ccrrt_dense(const uint_t n, cost_t *cost[],
-	int_t *free_rows, int_t *x, int_t *y, cost_t *v)
+template<typename T>
+static int_t _ccrrt_dense(const uint_t n, const T *cost,
+	int_t *free_rows, int_t *x, int_t *y, T *v, boolean *unique)
 {
 	int_t n_free_rows;
-	boolean *unique;
 
 	for (uint_t i = 0; i < n; i++) {
 		x[i] = -1;
@@ -18,18 +61,15 @@ int_t _ccrrt_dense(const uint_t n, cost_t *cost[],
 		y[i] = 0;
 	}
 	for (uint_t i = 0; i < n; i++) {
+		const T *row = cost + (size_t)i * n;
 		for (uint_t j = 0; j < n; j++) {
-			const cost_t c = cost[i][j];
+			const T c = row[j];
 			if (c < v[j]) {
 				v[j] = c;
 				y[j] = i;
 			}
-			PRINTF("i=%d, j=%d, c[i,j]=%f, v[j]=%f y[j]=%d\n", i, j, c, v[j], y[j]);
 		}
 	}
-	PRINT_COST_ARRAY(v, n);
-	PRINT_INDEX_ARRAY(y, n);
-	NEW(unique, boolean, n);
 	memset(unique, TRUE, n);
 	{
 		int_t j = n;
@@ -51,73 +91,187 @@ int_t _ccrrt_dense(const uint_t n, cost_t *cost[],
 			free_rows[n_free_rows++] = i;
 		}
 		else if (unique[i]) {
+			const T *row = cost + (size_t)i * n;
 			const int_t j = x[i];
-			cost_t min = LARGE;
+			T min = LARGE;
 			for (uint_t j2 = 0; j2 < n; j2++) {
 				if (j2 == (uint_t)j) {
 					continue;
 				}
-				const cost_t c = cost[i][j2] - v[j2];
+				const T c = row[j2] - v[j2];
 				if (c < min) {
 					min = c;
 				}
 			}
-			PRINTF("v[%d] = %f - %f\n", j, v[j], min);
 			v[j] -= min;
 		}
 	}
-	FREE(unique);
 	return n_free_rows;
 }
 
 
+/** Smallest and second smallest reduced cost row[j] - v[j] of a row.
+ *  Ties are broken by the lower column index, columns with cost >= LARGE other than 0 are skipped.
+ */
+template<typename T>
+static void _find_min2(const uint_t n, const T *row, const T *v,
+	int_t *pj1, T *pv1, int_t *pj2, T *pv2)
+{
+	int_t j1 = 0, j2 = -1;
+	T v1 = row[0] - v[0], v2 = LARGE;
+	for (uint_t j = 1; j < n; j++) {
+		const T c = row[j] - v[j];
+		if (c < v2) {
+			if (c >= v1) {
+				v2 = c;
+				j2 = j;
+			}
+			else {
+				v2 = v1;
+				v1 = c;
+				j2 = j1;
+				j1 = j;
+			}
+		}
+	}
+	*pj1 = j1;
+	*pv1 = v1;
+	*pj2 = j2;
+	*pv2 = v2;
+}
+
+#ifdef LAPJV_X86
+
+// Each lane keeps the two smallest (cost, column) pairs of its own columns with the same update rule,
+// visiting its columns in increasing order; the lanes are then merged by (cost, column), which gives
+// exactly the pairs found by the sequential loop above.
+// Lane state: the two smallest (cost, column) pairs seen by one lane.
+struct Min2Lanes
+{
+	__m256 v1, v2;
+	__m256i j1, j2;
+};
+
+__attribute__((target("avx2")))
+static inline void min2_lanes_update(Min2Lanes &lanes, __m256 c, __m256i index)
+{
+	__m256 lt2 = _mm256_cmp_ps(c, lanes.v2, _CMP_LT_OQ);
+	__m256 ge1 = _mm256_cmp_ps(c, lanes.v1, _CMP_GE_OQ);
+	__m256 lowers = _mm256_andnot_ps(ge1, lt2);
+	lanes.v2 = _mm256_blendv_ps(lanes.v2, _mm256_blendv_ps(lanes.v1, c, ge1), lt2);
+	lanes.j2 = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(lanes.j2),
+		_mm256_blendv_ps(_mm256_castsi256_ps(lanes.j1), _mm256_castsi256_ps(index), ge1), lt2));
+	lanes.v1 = _mm256_blendv_ps(lanes.v1, c, lowers);
+	lanes.j1 = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(lanes.j1), _mm256_castsi256_ps(index), lowers));
+}
+
+// Each lane keeps the two smallest (cost, column) pairs of its own columns with the same update rule,
+// visiting its columns in increasing order; the lanes are then merged by (cost, column), which gives
+// exactly the pairs found by the sequential loop above. Two sets of lanes break the dependency chain.
+__attribute__((target("avx2")))
+static void _find_min2_avx2(const uint_t n, const float *row, const float *v,
+	int_t *pj1, float *pv1, int_t *pj2, float *pv2)
+{
+	Min2Lanes lanes[2];
+	for (auto &l : lanes) {
+		l.v1 = l.v2 = _mm256_set1_ps(LARGE);
+		l.j1 = l.j2 = _mm256_set1_epi32(-1);
+	}
+	__m256i index = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 8);
+	const __m256i step = _mm256_set1_epi32(8);
+	uint_t j = 1;
+	for (; j + 16 <= n; j += 16) {
+		min2_lanes_update(lanes[0], _mm256_sub_ps(_mm256_loadu_ps(row + j), _mm256_loadu_ps(v + j)), index);
+		index = _mm256_add_epi32(index, step);
+		min2_lanes_update(lanes[1], _mm256_sub_ps(_mm256_loadu_ps(row + j + 8), _mm256_loadu_ps(v + j + 8)), index);
+		index = _mm256_add_epi32(index, step);
+	}
+
+	alignas(32) float lane_v[32];
+	alignas(32) int_t lane_j[32];
+	for (int k = 0; k < 2; k++) {
+		_mm256_store_ps(lane_v + 16 * k, lanes[k].v1);
+		_mm256_store_ps(lane_v + 16 * k + 8, lanes[k].v2);
+		_mm256_store_si256((__m256i*)(lane_j + 16 * k), lanes[k].j1);
+		_mm256_store_si256((__m256i*)(lane_j + 16 * k + 8), lanes[k].j2);
+	}
+	_mm256_zeroupper();
+
+	int_t best_j = 0, second_j = -1;
+	float best_v = row[0] - v[0], second_v = LARGE;
+	auto insert = [&](float c, int_t column) {
+		if (c < best_v || (c == best_v && column < best_j)) {
+			second_v = best_v;
+			second_j = best_j;
+			best_v = c;
+			best_j = column;
+		}
+		else if (c < second_v || (c == second_v && column < second_j)) {
+			second_v = c;
+			second_j = column;
+		}
+	};
+	for (int m = 0; m < 32; m++) {
+		if (lane_j[m] >= 0)
+			insert(lane_v[m], lane_j[m]);
+	}
+	for (; j < n; j++) {
+		const float c = row[j] - v[j];
+		if (c < LARGE)
+			insert(c, j);
+	}
+	*pj1 = best_j;
+	*pv1 = best_v;
+	*pj2 = second_j;
+	*pv2 = second_v;
+}
+
+#endif // LAPJV_X86
+
+template<typename T>
+static void find_min2(const uint_t n, const T *row, const T *v,
+	int_t *pj1, T *pv1, int_t *pj2, T *pv2)
+{
+	_find_min2(n, row, v, pj1, pv1, pj2, pv2);
+}
+
+#ifdef LAPJV_X86
+template<>
+void find_min2<float>(const uint_t n, const float *row, const float *v,
+	int_t *pj1, float *pv1, int_t *pj2, float *pv2)
+{
+	if (simd_enabled())
+		_find_min2_avx2(n, row, v, pj1, pv1, pj2, pv2);
+	else
+		_find_min2(n, row, v, pj1, pv1, pj2, pv2);
+}
+#endif
+
+
 /** Augmenting row reduction for a dense cost matrix.
  */
-int_t _carr_dense(
-	const uint_t n, cost_t *cost[],
+template<typename T>
+static int_t _carr_dense(
+	const uint_t n, const T *cost,
 	const uint_t n_free_rows,
-	int_t *free_rows, int_t *x, int_t *y, cost_t *v)
+	int_t *free_rows, int_t *x, int_t *y, T *v)
 {
 	uint_t current = 0;
 	int_t new_free_rows = 0;
 	uint_t rr_cnt = 0;
-	PRINT_INDEX_ARRAY(x, n);
-	PRINT_INDEX_ARRAY(y, n);
-	PRINT_COST_ARRAY(v, n);
-	PRINT_INDEX_ARRAY(free_rows, n_free_rows);
 	while (current < n_free_rows) {
 		int_t i0;
 		int_t j1, j2;
-		cost_t v1, v2, v1_new;
+		T v1, v2, v1_new;
 		boolean v1_lowers;
 
 		rr_cnt++;
-		PRINTF("current = %d rr_cnt = %d\n", current, rr_cnt);
 		const int_t free_i = free_rows[current++];
-		j1 = 0;
-		v1 = cost[free_i][0] - v[0];
-		j2 = -1;
-		v2 = LARGE;
-		for (uint_t j = 1; j < n; j++) {
-			PRINTF("%d = %f %d = %f\n", j1, v1, j2, v2);
-			const cost_t c = cost[free_i][j] - v[j];
-			if (c < v2) {
-				if (c >= v1) {
-					v2 = c;
-					j2 = j;
-				}
-				else {
-					v2 = v1;
-					v1 = c;
-					j2 = j1;
-					j1 = j;
-				}
-			}
-		}
+		const T *row = cost + (size_t)free_i * n;
+		find_min2(n, row, v, &j1, &v1, &j2, &v2);
 		i0 = y[j1];
 		v1_new = v[j1] - (v2 - v1);
 		v1_lowers = v1_new < v[j1];
-		PRINTF("%d %d 1=%d,%f 2=%d,%f v1'=%f(%d,%g) \n", free_i, i0, j1, v1, j2, v2, v1_new, v1_lowers, v[j1] - v1_new);
 		if (rr_cnt < current * n) {
 			if (v1_lowers) {
 				v[j1] = v1_new;
@@ -136,7 +290,6 @@ int_t _carr_dense(
 			}
 		}
 		else {
-			PRINTF("rr_cnt=%d >= %d (current=%d * n=%d)\n", rr_cnt, current * n, current, n);
 			if (i0 >= 0) {
 				free_rows[new_free_rows++] = i0;
 			}
@@ -150,10 +303,11 @@ int_t _carr_dense(
 
 /** Find columns with minimum d[j] and put them on the SCAN list.
  */
-uint_t _find_dense(const uint_t n, uint_t lo, cost_t *d, int_t *cols, int_t *y)
+template<typename T>
+static uint_t _find_dense(const uint_t n, uint_t lo, const T *d, int_t *cols)
 {
 	uint_t hi = lo + 1;
-	cost_t mind = d[cols[lo]];
+	T mind = d[cols[lo]];
 	for (uint_t k = hi; k < n; k++) {
 		int_t j = cols[k];
 		if (d[j] <= mind) {
@@ -171,30 +325,103 @@ uint_t _find_dense(const uint_t n, uint_t lo, cost_t *d, int_t *cols, int_t *y)
 
 // Scan all columns in TODO starting from arbitrary column in SCAN
 // and try to decrease d of the TODO columns using the SCAN column.
-int_t _scan_dense(const uint_t n, cost_t *cost[],
+template<typename T>
+static int_t _scan_dense(const uint_t n, const T *cost,
 	uint_t *plo, uint_t*phi,
-	cost_t *d, int_t *cols, int_t *pred,
-	int_t *y, cost_t *v)
+	T *d, int_t *cols, int_t *pred,
+	int_t *y, const T *v)
 {
 	uint_t lo = *plo;
 	uint_t hi = *phi;
-	cost_t h, cred_ij;
+	T h, cred_ij;
 
 	while (lo != hi) {
 		int_t j = cols[lo++];
 		const int_t i = y[j];
-		const cost_t mind = d[j];
-		h = cost[i][j] - v[j] - mind;
-		PRINTF("i=%d j=%d h=%f\n", i, j, h);
+		const T *row = cost + (size_t)i * n;
+		const T mind = d[j];
+		h = row[j] - v[j] - mind;
 		// For all columns in TODO
 		for (uint_t k = hi; k < n; k++) {
 			j = cols[k];
-			cred_ij = cost[i][j] - v[j] - h;
+			cred_ij = row[j] - v[j] - h;
+			if (cred_ij < d[j]) {
+				d[j] = cred_ij;
+				pred[j] = i;
+				if (cred_ij == mind) {
+					if (y[j] < 0) {
+						return j;
+					}
+					cols[k] = cols[hi];
+					cols[hi++] = j;
+				}
+			}
+		}
+	}
+	*plo = lo;
+	*phi = hi;
+	return -1;
+}
+
+
+#ifdef LAPJV_X86
+
+// float version of _scan_dense: the TODO columns are read 8 at a time with gathers,
+// lanes with cred_ij < d[j] are then handled one by one in column order exactly as above.
+// Swaps only touch cols[hi..k], so the column indices already loaded stay valid.
+__attribute__((target("avx2")))
+static int_t _scan_dense_avx2(const uint_t n, const float *cost,
+	uint_t *plo, uint_t*phi,
+	float *d, int_t *cols, int_t *pred,
+	int_t *y, const float *v)
+{
+	uint_t lo = *plo;
+	uint_t hi = *phi;
+
+	while (lo != hi) {
+		int_t j = cols[lo++];
+		const int_t i = y[j];
+		const float *row = cost + (size_t)i * n;
+		const float mind = d[j];
+		const float h = row[j] - v[j] - mind;
+		const __m256 hv = _mm256_set1_ps(h);
+		uint_t k = hi;
+		for (; k + 8 <= n; k += 8) {
+			__m256i index = _mm256_loadu_si256((const __m256i*)(cols + k));
+			__m256 cred = _mm256_sub_ps(_mm256_sub_ps(
+				_mm256_i32gather_ps(row, index, 4), _mm256_i32gather_ps(v, index, 4)), hv);
+			int mask = _mm256_movemask_ps(_mm256_cmp_ps(cred, _mm256_i32gather_ps(d, index, 4), _CMP_LT_OQ));
+			if (mask == 0)
+				continue;
+
+			alignas(32) float lanes[8];
+			alignas(32) int_t lane_cols[8];
+			_mm256_store_ps(lanes, cred);
+			_mm256_store_si256((__m256i*)lane_cols, index);
+			for (; mask != 0; mask &= mask - 1) {
+				int m = __builtin_ctz(mask);
+				j = lane_cols[m];
+				d[j] = lanes[m];
+				pred[j] = i;
+				if (lanes[m] == mind) {
+					if (y[j] < 0) {
+						_mm256_zeroupper();
+						return j;
+					}
+					cols[k + m] = cols[hi];
+					cols[hi++] = j;
+				}
+			}
+		}
+		for (; k < n; k++) {
+			j = cols[k];
+			const float cred_ij = row[j] - v[j] - h;
 			if (cred_ij < d[j]) {
 				d[j] = cred_ij;
 				pred[j] = i;
 				if (cred_ij == mind) {
 					if (y[j] < 0) {
+						_mm256_zeroupper();
 						return j;
 					}
 					cols[k] = cols[hi];
@@ -205,45 +432,63 @@ int_t _scan_dense(const uint_t n, cost_t *cost[],
 	}
 	*plo = lo;
 	*phi = hi;
+	_mm256_zeroupper();
 	return -1;
 }
 
+#endif // LAPJV_X86
+
+template<typename T>
+static int_t scan_dense(const uint_t n, const T *cost,
+	uint_t *plo, uint_t*phi,
+	T *d, int_t *cols, int_t *pred,
+	int_t *y, const T *v)
+{
+	return _scan_dense(n, cost, plo, phi, d, cols, pred, y, v);
+}
+
+#ifdef LAPJV_X86
+template<>
+int_t scan_dense<float>(const uint_t n, const float *cost,
+	uint_t *plo, uint_t*phi,
+	float *d, int_t *cols, int_t *pred,
+	int_t *y, const float *v)
+{
+	if (simd_enabled())
+		return _scan_dense_avx2(n, cost, plo, phi, d, cols, pred, y, v);
+	return _scan_dense(n, cost, plo, phi, d, cols, pred, y, v);
+}
+#endif
+
 
 /** Single iteration of modified Dijkstra shortest path algorithm as explained in the JV paper.
  *
- * This is a dense matrix version.
+ * This is a dense matrix version. cols and d are scratch arrays of size n from the workspace.
  *
  * \return The closest free column index.
  */
-int_t find_path_dense(
-	const uint_t n, cost_t *cost[],
+template<typename T>
+static int_t find_path_dense(
+	const uint_t n, const T *cost,
 	const int_t start_i,
-	int_t *y, cost_t *v,
-	int_t *pred)
+	int_t *y, T *v,
+	int_t *pred, int_t *cols, T *d)
 {
 	uint_t lo = 0, hi = 0;
 	int_t final_j = -1;
 	uint_t n_ready = 0;
-	int_t *cols;
-	cost_t *d;
-
-	NEW(cols, int_t, n);
-	NEW(d, cost_t, n);
+	const T *row = cost + (size_t)start_i * n;
 
 	for (uint_t i = 0; i < n; i++) {
 		cols[i] = i;
 		pred[i] = start_i;
-		d[i] = cost[start_i][i] - v[i];
+		d[i] = row[i] - v[i];
 	}
-	PRINT_COST_ARRAY(d, n);
 	while (final_j == -1) {
 		// No columns left on the SCAN list.
 		if (lo == hi) {
-			PRINTF("%d..%d -> find\n", lo, hi);
 			n_ready = lo;
-			hi = _find_dense(n, lo, d, cols, y);
-			PRINTF("check %d..%d\n", lo, hi);
-			PRINT_INDEX_ARRAY(cols, n);
+			hi = _find_dense(n, lo, d, cols);
 			for (uint_t k = lo; k < hi; k++) {
 				const int_t j = cols[k];
 				if (y[j] < 0) {
@@ -252,58 +497,42 @@ int_t find_path_dense(
 			}
 		}
 		if (final_j == -1) {
-			PRINTF("%d..%d -> scan\n", lo, hi);
-			final_j = _scan_dense(
+			final_j = scan_dense(
 				n, cost, &lo, &hi, d, cols, pred, y, v);
-			PRINT_COST_ARRAY(d, n);
-			PRINT_INDEX_ARRAY(cols, n);
-			PRINT_INDEX_ARRAY(pred, n);
 		}
 	}
 
-	PRINTF("found final_j=%d\n", final_j);
-	PRINT_INDEX_ARRAY(cols, n);
 	{
-		const cost_t mind = d[cols[lo]];
+		const T mind = d[cols[lo]];
 		for (uint_t k = 0; k < n_ready; k++) {
 			const int_t j = cols[k];
 			v[j] += d[j] - mind;
 		}
 	}
 
-	FREE(cols);
-	FREE(d);
-
 	return final_j;
 }
 
 
 /** Augment for a dense cost matrix.
  */
-int_t _ca_dense(
-	const uint_t n, cost_t *cost[],
+template<typename T>
+static int_t _ca_dense(
+	const uint_t n, const T *cost,
 	const uint_t n_free_rows,
-	int_t *free_rows, int_t *x, int_t *y, cost_t *v)
+	int_t *free_rows, int_t *x, int_t *y, T *v,
+	int_t *pred, int_t *cols, T *d)
 {
-	int_t *pred;
-
-	NEW(pred, int_t, n);
-
 	for (int_t *pfree_i = free_rows; pfree_i < free_rows + n_free_rows; pfree_i++) {
 		int_t i = -1, j;
 		uint_t k = 0;
 
-		PRINTF("looking at free_i=%d\n", *pfree_i);
-		j = find_path_dense(n, cost, *pfree_i, y, v, pred);
+		j = find_path_dense(n, cost, *pfree_i, y, v, pred, cols, d);
 		ASSERT(j >= 0);
 		ASSERT(j < n);
 		while (i != *pfree_i) {
-			PRINTF("augment %d\n", j);
-			PRINT_INDEX_ARRAY(pred, n);
 			i = pred[j];
-			PRINTF("y[%d]=%d -> %d\n", j, y[j], i);
 			y[j] = i;
-			PRINT_INDEX_ARRAY(x, n);
 			SWAP_INDICES(j, x[i]);
 			k++;
 			if (k >= n) {
@@ -311,33 +540,55 @@ int_t _ca_dense(
 			}
 		}
 	}
-	FREE(pred);
 	return 0;
 }
 
 
-/** Solve dense sparse LAP.
+/** Solve dense LAP, cost is a contiguous row-major n x n matrix.
  */
-int lapjv_internal(
-	const uint_t n, cost_t *cost[],
-	int_t *x, int_t *y)
+template<typename T>
+int_t lapjv_dense(
+	const uint_t n, const T *cost,
+	int_t *x, int_t *y, LapjvWorkspace<T> &workspace)
 {
-	int ret;
-	int_t *free_rows;
-	cost_t *v;
+	int_t ret;
 
-	NEW(free_rows, int_t, n);
-	NEW(v, cost_t, n);
-	ret = _ccrrt_dense(n, cost, free_rows, x, y, v);
+	if (n == 0)
+		return 0;
+
+	workspace.reserve(n);
+	int_t *free_rows = workspace.free_rows.data();
+	T *v = workspace.v.data();
+	ret = _ccrrt_dense(n, cost, free_rows, x, y, v, workspace.unique.data());
 	int i = 0;
 	while (ret > 0 && i < 2) {
 		ret = _carr_dense(n, cost, ret, free_rows, x, y, v);
 		i++;
 	}
 	if (ret > 0) {
-		ret = _ca_dense(n, cost, ret, free_rows, x, y, v);
+		ret = _ca_dense(n, cost, ret, free_rows, x, y, v,
+			workspace.pred.data(), workspace.cols.data(), workspace.d.data());
 	}
-	FREE(v);
-	FREE(free_rows);
 	return ret;
+}
+
+template struct LapjvWorkspace<float>;
+template struct LapjvWorkspace<double>;
+template int_t lapjv_dense<float>(const uint_t, const float *, int_t *, int_t *, LapjvWorkspace<float> &);
+template int_t lapjv_dense<double>(const uint_t, const double *, int_t *, int_t *, LapjvWorkspace<double> &);
+
+
+/** Solve dense LAP given as row pointers, kept for the original interface.
+ *  Copies the matrix and allocates a workspace on every call, use lapjv_dense for repeated solves.
+ */
+int lapjv_internal(
+	const uint_t n, cost_t *cost[],
+	int_t *x, int_t *y)
+{
+	std::vector<cost_t> dense((size_t)n * n);
+	for (uint_t i = 0; i < n; i++)
+		memcpy(dense.data() + (size_t)i * n, cost[i], sizeof(cost_t) * n);
+
+	LapjvWorkspace<cost_t> workspace;
+	return lapjv_dense(n, dense.data(), x, y, workspace);
 }
\ No newline at end of file
@@ -60,4 +60,6 @@ extern int_t lapjv_internal(
 	const uint_t n, cost_t *cost[],
 	int_t *x, int_t *y);
 
+#include "lapjvWorkspace.h"
+
 #endif // LAPJV_H
\ No newline at end of file
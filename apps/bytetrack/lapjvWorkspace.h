@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+
+/// lapjv_dense 的工作区，数组只增不减，同一个工作区反复求解时不再分配内存
+/// 一个工作区同一时间只能在一个线程上使用
+template<typename T>
+struct LapjvWorkspace
+{
+	std::vector<int> free_rows;
+	std::vector<int> cols;
+	std::vector<int> pred;
+	std::vector<T> v;
+	std::vector<T> d;
+	std::vector<char> unique;
+
+	void reserve(unsigned int n);
+};
+
+/// 与 lapjv_internal 相同的算法，cost 是 n x n 的行优先连续矩阵，T 为 float 或 double
+/// x[i] 为第 i 行匹配的列，y[j] 为第 j 列匹配的行，成功时返回 0
+template<typename T>
+int lapjv_dense(
+	const unsigned int n, const T *cost,
+	int *x, int *y, LapjvWorkspace<T> &workspace);
+
+/// CPU 是否支持 AVX2，float 版本的 lapjv_dense 在扫描列时使用
+bool lapjv_simd_available();
+
+/// 默认开启，关闭之后使用标量实现，用于对比和验证
+void lapjv_set_simd_enabled(bool enabled);
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "trackerManager.h"
+#include "trt_common/trace.hpp"
+#include "trt_common/ilogger.hpp"
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+
+static const vector<STrack> empty_tracks;
+
+TrackerManager::TrackerManager(int num_streams, int num_threads)
+	: pool(num_threads)
+{
+	for (int i = 0; i < num_streams; i++)
+	{
+		streams.emplace_back(new Stream());
+	}
+	batch_stamp.resize(num_streams, 0);
+}
+
+byte_kalman::Config& TrackerManager::config(int stream)
+{
+	return streams[stream]->tracker.config();
+}
+
+bool TrackerManager::update(const vector<int>& stream_ids, const vector<vector<Object> >& objects)
+{
+	TRACE_SCOPE("TrackerManager::update");
+	if (stream_ids.size() != objects.size())
+	{
+		INFOE("TrackerManager: %d streams but %d detection lists", (int)stream_ids.size(), (int)objects.size());
+		return false;
+	}
+
+	batch_count++;
+	batch.clear();
+	for (int i = 0; i < stream_ids.size(); i++)
+	{
+		int stream = stream_ids[i];
+		if (stream < 0 || stream >= streams.size() || batch_stamp[stream] == batch_count)
+		{
+			INFOE("TrackerManager: invalid or duplicated stream %d in a batch", stream);
+			for (int index : batch)
+				streams[index]->objects = nullptr;
+			return false;
+		}
+		batch_stamp[stream] = batch_count;
+		streams[stream]->objects = &objects[i];
+		batch.push_back(stream);
+	}
+
+	pool.run(batch.size(), [this](int i){ update_stream(batch[i]); });
+	return true;
+}
+
+void TrackerManager::update_stream(int stream)
+{
+	Stream& s = *streams[stream];
+	auto tic = chrono::steady_clock::now();
+	s.tracks = &s.tracker.update(*s.objects);
+	auto us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - tic).count();
+
+	s.objects = nullptr;
+	s.latency.record(us);
+	s.num_tracks.store(s.tracks->size(), memory_order_relaxed);
+	s.frames.fetch_add(1, memory_order_relaxed);
+}
+
+const vector<STrack>& TrackerManager::tracks(int stream) const
+{
+	const Stream& s = *streams[stream];
+	return s.tracks ? *s.tracks : empty_tracks;
+}
+
+TrackerStreamStats TrackerManager::stats(int stream) const
+{
+	const Stream& s = *streams[stream];
+	TrackerStreamStats output;
+	output.stream = stream;
+	output.frames = s.frames.load(memory_order_relaxed);
+	output.tracks = s.num_tracks.load(memory_order_relaxed);
+	output.latency = s.latency.snapshot();
+	return output;
+}
+
+string TrackerManager::report() const
+{
+	string output;
+	char line[256];
+	for (int i = 0; i < streams.size(); i++)
+	{
+		auto s = stats(i);
+		snprintf(line, sizeof(line), "stream %3d  frames %8llu  tracks %4d  update p50 %7.3f ms  p99 %7.3f ms  max %7.3f ms\n",
+			i, (unsigned long long)s.frames, s.tracks, s.latency.percentile(0.5) / 1000, s.latency.percentile(0.99) / 1000, s.latency.max_us / 1000.0);
+		output += line;
+	}
+	return output;
+}
\ No newline at end of file
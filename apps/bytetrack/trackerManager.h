@@ -0,0 +1,70 @@
+#pragma once
+
+#include "BYTETracker.h"
+#include "trt_common/infer_metrics.hpp"
+#include "trt_common/work_stealing_pool.hpp"
+#include <atomic>
+#include <memory>
+#include <string>
+
+/// 一路视频流的统计
+struct TrackerStreamStats
+{
+	int stream;
+	uint64_t frames;
+	int tracks;                 // 最近一帧输出的轨迹数
+	HistogramSnapshot latency;  // 每帧 update 的耗时，单位 us
+};
+
+/// 多路视频流的跟踪：每一路一个 BYTETracker，track_id 在各路内部从 1 开始编号，结果与执行的线程、顺序无关
+/// update 接收一批检测结果（每路最多一帧），各路的 update 在工作窃取线程池上并行执行，调用线程也参与
+class TrackerManager
+{
+public:
+	/// num_threads 为工作线程数，不含调用 update 的线程；< 0 时为 CPU 核数 - 1
+	TrackerManager(int num_streams, int num_threads = -1);
+
+	int num_streams() const{ return streams.size(); }
+	int num_threads() const{ return pool.num_threads(); }
+
+	/// 最近一次 update 中被其他线程窃取的任务数
+	int num_stolen() const{ return pool.num_stolen(); }
+
+	/// 线程池中还没有被取走的任务数，update 返回之后应当为 0
+	int num_queued() const{ return pool.num_queued(); }
+
+	/// 在这一路第一次 update 之前设置参数
+	byte_kalman::Config& config(int stream);
+
+	/// stream_ids[i] 这一路的一帧检测为 objects[i]，全部完成之后返回
+	/// stream 超出范围或者同一批中重复出现时返回 false，不做任何更新
+	bool update(const vector<int>& stream_ids, const vector<vector<Object> >& objects);
+
+	/// 这一路最近一帧的轨迹，引用在这一路下一次 update 之前有效
+	const vector<STrack>& tracks(int stream) const;
+
+	/// 可以在 update 的同时从其他线程调用
+	TrackerStreamStats stats(int stream) const;
+
+	/// 一行一路：帧数、轨迹数、update 耗时的 p50 / p99 / max（ms）
+	std::string report() const;
+
+private:
+	struct Stream
+	{
+		BYTETracker tracker;
+		const vector<STrack>* tracks = nullptr;
+		const vector<Object>* objects = nullptr;
+		LatencyHistogram latency;
+		std::atomic<uint64_t> frames{0};
+		std::atomic<int> num_tracks{0};
+	};
+
+	void update_stream(int stream);
+
+	vector<std::unique_ptr<Stream> > streams;
+	vector<int> batch;          // 本批各任务对应的 stream
+	vector<int> batch_stamp;    // 与 batch_count 相等表示这一路已经在本批中
+	int batch_count = 0;
+	WorkStealingPool pool;
+};
\ No newline at end of file
@@ -1,126 +1,158 @@
 #include "BYTETracker.h"
 #include "lapjv.h"
-#include <map>
+#include "trt_common/trace.hpp"
+#include <algorithm>
 #include <iostream>
+#include <numeric>
+#include <cfloat>
+#include <climits>
+#include <cmath>
 
 using namespace std;
 
-vector<STrack*> BYTETracker::joint_stracks(vector<STrack*> &tlista, vector<STrack> &tlistb)
+/// 1 - IoU，宽高加 1 的算法与原来的 ious 相同
+static inline float iou_cost(const float* atlbr, const float* btlbr)
 {
-	map<int, int> exists;
-	vector<STrack*> res;
-	for (int i = 0; i < tlista.size(); i++)
+	float iou = 0.0;
+	float iw = min(atlbr[2], btlbr[2]) - max(atlbr[0], btlbr[0]) + 1;
+	if (iw > 0)
 	{
-		exists.insert(pair<int, int>(tlista[i]->track_id, 1));
-		res.push_back(tlista[i]);
-	}
-	for (int i = 0; i < tlistb.size(); i++)
-	{
-		int tid = tlistb[i].track_id;
-		if (!exists[tid] || exists.count(tid) == 0)
+		float ih = min(atlbr[3], btlbr[3]) - max(atlbr[1], btlbr[1]) + 1;
+		if(ih > 0)
 		{
-			exists[tid] = 1;
-			res.push_back(&tlistb[i]);
+			float box_area = (btlbr[2] - btlbr[0] + 1)*(btlbr[3] - btlbr[1] + 1);
+			float ua = (atlbr[2] - atlbr[0] + 1)*(atlbr[3] - atlbr[1] + 1) + box_area - iw * ih;
+			iou = iw * ih / ua;
 		}
 	}
-	return res;
+	return 1 - iou;
+}
+
+/// class_aware 时只有相同类别的轨迹 / 检测框可以关联
+static inline bool same_class(bool class_aware, const STrack& a, const STrack& b)
+{
+	return !class_aware || a.label == b.label;
 }
 
-vector<STrack> BYTETracker::joint_stracks(vector<STrack> &tlista, vector<STrack> &tlistb)
+static inline bool finite_box(const float* tlbr)
 {
-	map<int, int> exists;
-	vector<STrack> res;
-	for (int i = 0; i < tlista.size(); i++)
+	return isfinite(tlbr[0]) && isfinite(tlbr[1]) && isfinite(tlbr[2]) && isfinite(tlbr[3]);
+}
+
+void BYTETracker::joint_stracks(const vector<int> &tlista, const vector<int> &tlistb, vector<int> &res)
+{
+	int stamp = ++mark_stamp;
+	res.clear();
+	for (int index : tlista)
 	{
-		exists.insert(pair<int, int>(tlista[i].track_id, 1));
-		res.push_back(tlista[i]);
+		slot_mark[index] = stamp;
+		res.push_back(index);
 	}
-	for (int i = 0; i < tlistb.size(); i++)
+	for (int index : tlistb)
 	{
-		int tid = tlistb[i].track_id;
-		if (!exists[tid] || exists.count(tid) == 0)
+		if (slot_mark[index] != stamp)
 		{
-			exists[tid] = 1;
-			res.push_back(tlistb[i]);
+			slot_mark[index] = stamp;
+			res.push_back(index);
 		}
 	}
-	return res;
 }
 
-vector<STrack> BYTETracker::sub_stracks(vector<STrack> &tlista, vector<STrack> &tlistb)
+void BYTETracker::sub_stracks(const vector<int> &tlista, const vector<int> &tlistb, vector<int> &res)
 {
-	map<int, STrack> stracks;
-	for (int i = 0; i < tlista.size(); i++)
+	int stamp = ++mark_stamp;
+	res.clear();
+	for (int index : tlistb)
 	{
-		stracks.insert(pair<int, STrack>(tlista[i].track_id, tlista[i]));
+		slot_mark[index] = stamp;
 	}
-	for (int i = 0; i < tlistb.size(); i++)
+	for (int index : tlista)
 	{
-		int tid = tlistb[i].track_id;
-		if (stracks.count(tid) != 0)
+		if (slot_mark[index] != stamp)
 		{
-			stracks.erase(tid);
+			slot_mark[index] = stamp;
+			res.push_back(index);
 		}
 	}
-
-	vector<STrack> res;
-	std::map<int, STrack>::iterator  it;
-	for (it = stracks.begin(); it != stracks.end(); ++it)
-	{
-		res.push_back(it->second);
-	}
-
-	return res;
+	sort(res.begin(), res.end(), [this](int a, int b){
+		return track_pool[a].track_id < track_pool[b].track_id;
+	});
 }
 
-void BYTETracker::remove_duplicate_stracks(vector<STrack> &resa, vector<STrack> &resb, vector<STrack> &stracksa, vector<STrack> &stracksb)
+void BYTETracker::remove_duplicate_stracks(vector<int> &resa, vector<int> &resb, const vector<int> &stracksa, const vector<int> &stracksb)
 {
-	vector<vector<float> > pdist = iou_distance(stracksa, stracksb);
-	vector<pair<int, int> > pairs;
-	for (int i = 0; i < pdist.size(); i++)
+	// stracksa 与 stracksb 没有相同的轨迹，用同一个标记值表示重复
+	int stamp = ++mark_stamp;
+	auto mark_duplicate = [&](int i, int j)
+	{
+		const STrack &a = track_pool[stracksa[i]];
+		const STrack &b = track_pool[stracksb[j]];
+		int timep = a.frame_id - a.start_frame;
+		int timeq = b.frame_id - b.start_frame;
+		if (timep > timeq)
+			slot_mark[stracksb[j]] = stamp;
+		else
+			slot_mark[stracksa[i]] = stamp;
+	};
+
+	if (_config.sparse_association)
 	{
-		for (int j = 0; j < pdist[i].size(); j++)
+		iou_candidates(track_pool.data(), stracksa, track_pool.data(), stracksb, 0.15, cost_entries);
+		for (auto& entry : cost_entries)
+			mark_duplicate(entry.row, entry.col);
+	}
+	else
+	{
+		iou_distance(track_pool.data(), stracksa, track_pool.data(), stracksb, dists);
+		for (int i = 0; i < dists.size(); i++)
 		{
-			if (pdist[i][j] < 0.15)
-			{
-				pairs.push_back(pair<int, int>(i, j));
-			}
+			if (dists[i] < 0.15)
+				mark_duplicate(i / stracksb.size(), i % stracksb.size());
 		}
 	}
 
-	vector<int> dupa, dupb;
-	for (int i = 0; i < pairs.size(); i++)
+	resa.clear();
+	resb.clear();
+	for (int index : stracksa)
 	{
-		int timep = stracksa[pairs[i].first].frame_id - stracksa[pairs[i].first].start_frame;
-		int timeq = stracksb[pairs[i].second].frame_id - stracksb[pairs[i].second].start_frame;
-		if (timep > timeq)
-			dupb.push_back(pairs[i].second);
-		else
-			dupa.push_back(pairs[i].first);
+		if (slot_mark[index] != stamp)
+			resa.push_back(index);
+		else if (!slot_removed[index])
+			free_track(index);
 	}
-
-	for (int i = 0; i < stracksa.size(); i++)
+	for (int index : stracksb)
 	{
-		vector<int>::iterator iter = find(dupa.begin(), dupa.end(), i);
-		if (iter == dupa.end())
-		{
-			resa.push_back(stracksa[i]);
-		}
+		if (slot_mark[index] != stamp)
+			resb.push_back(index);
+		else if (!slot_removed[index])
+			free_track(index);
 	}
+}
 
-	for (int i = 0; i < stracksb.size(); i++)
+void BYTETracker::associate(const STrack* atracks, const vector<int> &aindex, const STrack* btracks, const vector<int> &bindex, float thresh,
+	vector<pair<int, int> > &matches, vector<int> &unmatched_a, vector<int> &unmatched_b)
+{
+	bool gating = _config.gating && !aindex.empty() && !bindex.empty();
+	if (gating)
+		prepare_gating(aindex, btracks, bindex);
+
+	// thresh >= 1 时不相交的框（代价为 1）也可能被匹配，网格剪枝不再成立
+	if (_config.sparse_association && thresh < 1)
 	{
-		vector<int>::iterator iter = find(dupb.begin(), dupb.end(), i);
-		if (iter == dupb.end())
-		{
-			resb.push_back(stracksb[i]);
-		}
+		sparse_assignment(atracks, aindex, btracks, bindex, thresh, matches, unmatched_a, unmatched_b);
+		return;
 	}
+
+	iou_distance(atracks, aindex, btracks, bindex, dists, gating);
+	linear_assignment(dists, aindex.size(), bindex.size(), thresh, matches, unmatched_a, unmatched_b);
 }
 
-void BYTETracker::linear_assignment(vector<vector<float> > &cost_matrix, int cost_matrix_size, int cost_matrix_size_size, float thresh,
-	vector<vector<int> > &matches, vector<int> &unmatched_a, vector<int> &unmatched_b)
+void BYTETracker::linear_assignment(const vector<float> &cost_matrix, int cost_matrix_size, int cost_matrix_size_size, float thresh,
+	vector<pair<int, int> > &matches, vector<int> &unmatched_a, vector<int> &unmatched_b)
 {
+	matches.clear();
+	unmatched_a.clear();
+	unmatched_b.clear();
 	if (cost_matrix.size() == 0)
 	{
 		for (int i = 0; i < cost_matrix_size; i++)
@@ -134,16 +166,12 @@ void BYTETracker::linear_assignment(vector<vector<float> > &cost_matrix, int cos
 		return;
 	}
 
-	vector<int> rowsol; vector<int> colsol;
-	float c = lapjv(cost_matrix, rowsol, colsol, true, thresh);
+	lapjv(cost_matrix.data(), cost_matrix_size, cost_matrix_size_size, rowsol, colsol, true, thresh);
 	for (int i = 0; i < rowsol.size(); i++)
 	{
 		if (rowsol[i] >= 0)
 		{
-			vector<int> match;
-			match.push_back(i);
-			match.push_back(rowsol[i]);
-			matches.push_back(match);
+			matches.emplace_back(i, rowsol[i]);
 		}
 		else
 		{
@@ -160,123 +188,318 @@ void BYTETracker::linear_assignment(vector<vector<float> > &cost_matrix, int cos
 	}
 }
 
-vector<vector<float> > BYTETracker::ious(vector<vector<float> > &atlbrs, vector<vector<float> > &btlbrs)
+void BYTETracker::iou_distance(const STrack* atracks, const vector<int> &aindex, const STrack* btracks, const vector<int> &bindex,
+	vector<float> &cost_matrix, bool gating)
 {
-	vector<vector<float> > ious;
-	if (atlbrs.size()*btlbrs.size() == 0)
-		return ious;
+	cost_matrix.resize(aindex.size() * bindex.size());
 
-	ious.resize(atlbrs.size());
-	for (int i = 0; i < ious.size(); i++)
+	//bbox_ious
+	bool class_aware = _config.class_aware;
+	float* cost = cost_matrix.data();
+	for (int n = 0; n < aindex.size(); n++)
 	{
-		ious[i].resize(btlbrs.size());
+		const STrack& a = atracks[aindex[n]];
+		for (int k = 0; k < bindex.size(); k++)
+		{
+			const STrack& b = btracks[bindex[k]];
+			bool possible = same_class(class_aware, a, b) && !(gating && gate_pair(n, k));
+			*cost++ = possible ? iou_cost(a.tlbr, b.tlbr) : 1.0f;
+		}
 	}
+}
 
-	//bbox_ious
-	for (int k = 0; k < btlbrs.size(); k++)
+void BYTETracker::iou_candidates(const STrack* atracks, const vector<int> &aindex, const STrack* btracks, const vector<int> &bindex,
+	double max_cost, vector<CostEntry> &entries, bool gating)
+{
+	entries.clear();
+	if (aindex.empty() || bindex.empty())
+		return;
+
+	// 网格覆盖所有 b 框，格子边长取 b 框宽高的平均值，格子数不超过 b 框数的 4 倍
+	// 框的范围两边各放宽 2 个像素，包含 iou_cost 中宽高加 1 之后刚好接触的框
+	const float pad = 2;
+	float min_x = FLT_MAX, min_y = FLT_MAX, max_x = -FLT_MAX, max_y = -FLT_MAX;
+	double size = 0;
+	int num_boxes = 0;
+	for (int index : bindex)
+	{
+		const float* tlbr = btracks[index].tlbr;
+		if (!finite_box(tlbr))
+			continue;
+
+		min_x = min(min_x, tlbr[0] - pad);
+		min_y = min(min_y, tlbr[1] - pad);
+		max_x = max(max_x, tlbr[2] + pad);
+		max_y = max(max_y, tlbr[3] + pad);
+		size += (tlbr[2] - tlbr[0]) + (tlbr[3] - tlbr[1]);
+		num_boxes++;
+	}
+	if (num_boxes == 0)
+		return;
+
+	float cell = max(1.0, size / (2 * num_boxes));
+	int grid_w, grid_h;
+	for (;;)
+	{
+		grid_w = (int)min((max_x - min_x) / cell + 1, 65536.0f);
+		grid_h = (int)min((max_y - min_y) / cell + 1, 65536.0f);
+		if ((long long)grid_w * grid_h <= 4LL * num_boxes + 16)
+			break;
+		cell *= 2;
+	}
+
+	auto cell_range = [&](const float* tlbr, int& x0, int& y0, int& x1, int& y1)
+	{
+		x0 = max(0, (int)((tlbr[0] - pad - min_x) / cell));
+		y0 = max(0, (int)((tlbr[1] - pad - min_y) / cell));
+		x1 = min(grid_w - 1, (int)((tlbr[2] + pad - min_x) / cell));
+		y1 = min(grid_h - 1, (int)((tlbr[3] + pad - min_y) / cell));
+	};
+
+	// 计数排序：grid_start[c] 是第 c 个格子在 grid_items 中的起点
+	int num_cells = grid_w * grid_h;
+	grid_start.assign(num_cells + 1, 0);
+	for (int j = 0; j < bindex.size(); j++)
+	{
+		const float* tlbr = btracks[bindex[j]].tlbr;
+		if (!finite_box(tlbr))
+			continue;
+
+		int x0, y0, x1, y1;
+		cell_range(tlbr, x0, y0, x1, y1);
+		for (int y = y0; y <= y1; y++)
+			for (int x = x0; x <= x1; x++)
+				grid_start[y * grid_w + x + 1]++;
+	}
+	for (int c = 0; c < num_cells; c++)
+		grid_start[c + 1] += grid_start[c];
+
+	grid_cell.assign(grid_start.begin(), grid_start.end() - 1);
+	grid_items.resize(grid_start[num_cells]);
+	for (int j = 0; j < bindex.size(); j++)
+	{
+		const float* tlbr = btracks[bindex[j]].tlbr;
+		if (!finite_box(tlbr))
+			continue;
+
+		int x0, y0, x1, y1;
+		cell_range(tlbr, x0, y0, x1, y1);
+		for (int y = y0; y <= y1; y++)
+			for (int x = x0; x <= x1; x++)
+				grid_items[grid_cell[y * grid_w + x]++] = j;
+	}
+
+	// 一个 b 框可能在多个格子中，col_stamp 保证每对只计算一次
+	if (col_stamp.size() < bindex.size())
+		col_stamp.resize(bindex.size(), 0);
+
+	bool class_aware = _config.class_aware;
+	for (int i = 0; i < aindex.size(); i++)
 	{
-		vector<float> ious_tmp;
-		float box_area = (btlbrs[k][2] - btlbrs[k][0] + 1)*(btlbrs[k][3] - btlbrs[k][1] + 1);
-		for (int n = 0; n < atlbrs.size(); n++)
+		const STrack& a = atracks[aindex[i]];
+		const float* atlbr = a.tlbr;
+		if (!finite_box(atlbr) || atlbr[2] + pad < min_x || atlbr[0] - pad > max_x || atlbr[3] + pad < min_y || atlbr[1] - pad > max_y)
+			continue;
+
+		if (++col_mark == INT_MAX)
+		{
+			fill(col_stamp.begin(), col_stamp.end(), 0);
+			col_mark = 1;
+		}
+
+		int x0, y0, x1, y1;
+		cell_range(atlbr, x0, y0, x1, y1);
+		for (int y = y0; y <= y1; y++)
 		{
-			float iw = min(atlbrs[n][2], btlbrs[k][2]) - max(atlbrs[n][0], btlbrs[k][0]) + 1;
-			if (iw > 0)
+			for (int x = x0; x <= x1; x++)
 			{
-				float ih = min(atlbrs[n][3], btlbrs[k][3]) - max(atlbrs[n][1], btlbrs[k][1]) + 1;
-				if(ih > 0)
+				int c = y * grid_w + x;
+				for (int k = grid_start[c]; k < grid_start[c + 1]; k++)
 				{
-					float ua = (atlbrs[n][2] - atlbrs[n][0] + 1)*(atlbrs[n][3] - atlbrs[n][1] + 1) + box_area - iw * ih;
-					ious[n][k] = iw * ih / ua;
+					int j = grid_items[k];
+					if (col_stamp[j] == col_mark)
+						continue;
+
+					col_stamp[j] = col_mark;
+					const STrack& b = btracks[bindex[j]];
+					if (!same_class(class_aware, a, b) || (gating && gate_pair(i, j)))
+						continue;
+
+					float cost = iou_cost(atlbr, b.tlbr);
+					if (cost < max_cost)
+						entries.push_back({i, j, cost});
 				}
-				else
-				{
-					ious[n][k] = 0.0;
-				}
-			}
-			else
-			{
-				ious[n][k] = 0.0;
 			}
 		}
 	}
+}
+
+void BYTETracker::prepare_gating(const vector<int> &aindex, const STrack* btracks, const vector<int> &bindex)
+{
+	gate_means.resize(aindex.size() * 4);
+	gate_inv_std.resize(aindex.size() * 4);
+	kalman_batch.project(aindex.data(), aindex.size(), gate_means.data(), gate_inv_std.data());
 
-	return ious;
+	gate_measurements.resize(bindex.size() * 4);
+	for (int j = 0; j < bindex.size(); j++)
+	{
+		DETECTBOX xyah = btracks[bindex[j]].to_xyah();
+		copy(xyah.data(), xyah.data() + 4, gate_measurements.data() + 4 * j);
+	}
+
+	gate_dims = _config.gating_only_position ? 2 : 4;
+	gate_threshold = _config.gating_threshold > 0 ? _config.gating_threshold : byte_kalman::KalmanFilter::chi2inv95[gate_dims];
 }
 
-vector<vector<float> > BYTETracker::iou_distance(vector<STrack*> &atracks, vector<STrack> &btracks, int &dist_size, int &dist_size_size)
+bool BYTETracker::gate_pair(int i, int j) const
 {
-	vector<vector<float> > cost_matrix;
-	if (atracks.size() * btracks.size() == 0)
+	const float* mean = gate_means.data() + 4 * i;
+	const float* inv_std = gate_inv_std.data() + 4 * i;
+	const float* measurement = gate_measurements.data() + 4 * j;
+	float distance = 0;
+	for (int c = 0; c < gate_dims; c++)
 	{
-		dist_size = atracks.size();
-		dist_size_size = btracks.size();
-		return cost_matrix;
+		float z = (measurement[c] - mean[c]) * inv_std[c];
+		distance += z * z;
 	}
-	vector<vector<float> > atlbrs, btlbrs;
-	for (int i = 0; i < atracks.size(); i++)
+	return distance > gate_threshold;
+}
+
+int BYTETracker::find_component(int node)
+{
+	while (component_parent[node] != node)
 	{
-		atlbrs.push_back(atracks[i]->tlbr);
+		component_parent[node] = component_parent[component_parent[node]];
+		node = component_parent[node];
 	}
-	for (int i = 0; i < btracks.size(); i++)
+	return node;
+}
+
+/// 只有代价小于 thresh 的对可能被匹配（否则两边都不匹配的代价 thresh 更小），这些对构成的二分图按连通分量拆开，
+/// 各分量的最优解合起来就是整个矩阵的最优解；分量内部仍用原来的 lapjv 求解，只有一对的分量直接匹配
+void BYTETracker::sparse_assignment(const STrack* atracks, const vector<int> &aindex, const STrack* btracks, const vector<int> &bindex, float thresh,
+	vector<pair<int, int> > &matches, vector<int> &unmatched_a, vector<int> &unmatched_b)
+{
+	TRACE_SCOPE("sparse_assignment");
+	int rows = aindex.size();
+	int cols = bindex.size();
+	sparse_rowsol.assign(rows, -1);
+	sparse_colsol.assign(cols, -1);
+	bool gating = _config.gating;
+	iou_candidates(atracks, aindex, btracks, bindex, thresh, cost_entries, gating);
+
+	// 行是 [0, rows)，列是 [rows, rows + cols)
+	int num_nodes = rows + cols;
+	component_parent.resize(num_nodes);
+	iota(component_parent.begin(), component_parent.end(), 0);
+	for (auto& entry : cost_entries)
 	{
-		btlbrs.push_back(btracks[i].tlbr);
+		int a = find_component(entry.row);
+		int b = find_component(rows + entry.col);
+		if (a != b)
+			component_parent[max(a, b)] = min(a, b);
 	}
 
-	dist_size = atracks.size();
-	dist_size_size = btracks.size();
+	// 有边的节点按分量分组，组内按节点顺序，即行、列各自从小到大
+	component_id.assign(num_nodes, -1);
+	for (auto& entry : cost_entries)
+	{
+		component_id[entry.row] = 0;
+		component_id[rows + entry.col] = 0;
+	}
 
-	vector<vector<float> > _ious = ious(atlbrs, btlbrs);
-	
-	for (int i = 0; i < _ious.size();i++)
+	int num_components = 0;
+	component_start.assign(1, 0);
+	for (int node = 0; node < num_nodes; node++)
 	{
-		vector<float> _iou;
-		for (int j = 0; j < _ious[i].size(); j++)
+		if (component_id[node] == -1)
+			continue;
+
+		int root = find_component(node);
+		if (root == node)
 		{
-			_iou.push_back(1 - _ious[i][j]);
+			component_id[node] = num_components++;
+			component_start.push_back(0);
 		}
-		cost_matrix.push_back(_iou);
+		else
+		{
+			component_id[node] = component_id[root];
+		}
+		component_start[component_id[node] + 1]++;
 	}
+	for (int c = 0; c < num_components; c++)
+		component_start[c + 1] += component_start[c];
 
-	return cost_matrix;
-}
-
-vector<vector<float> > BYTETracker::iou_distance(vector<STrack> &atracks, vector<STrack> &btracks)
-{
-	vector<vector<float> > atlbrs, btlbrs;
-	for (int i = 0; i < atracks.size(); i++)
+	component_items.resize(component_start[num_components]);
+	grid_cell.assign(component_start.begin(), component_start.end() - 1);
+	for (int node = 0; node < num_nodes; node++)
 	{
-		atlbrs.push_back(atracks[i].tlbr);
-	}
-	for (int i = 0; i < btracks.size(); i++)
-	{
-		btlbrs.push_back(btracks[i].tlbr);
+		if (component_id[node] != -1)
+			component_items[grid_cell[component_id[node]]++] = node;
 	}
 
-	vector<vector<float> > _ious = ious(atlbrs, btlbrs);
-	vector<vector<float> > cost_matrix;
-	for (int i = 0; i < _ious.size(); i++)
+	for (int c = 0; c < num_components; c++)
 	{
-		vector<float> _iou;
-		for (int j = 0; j < _ious[i].size(); j++)
+		sub_rows.clear();
+		sub_cols.clear();
+		for (int k = component_start[c]; k < component_start[c + 1]; k++)
+		{
+			int node = component_items[k];
+			if (node < rows)
+				sub_rows.push_back(node);
+			else
+				sub_cols.push_back(node - rows);
+		}
+
+		if (sub_rows.size() == 1 && sub_cols.size() == 1)
+		{
+			sparse_rowsol[sub_rows[0]] = sub_cols[0];
+			sparse_colsol[sub_cols[0]] = sub_rows[0];
+			continue;
+		}
+
+		// 分量内的对都是同一个类别（class_aware 时不同类别之间没有边），被门限排除的对代价为 1，与稠密矩阵相同
+		dists.resize(sub_rows.size() * sub_cols.size());
+		float* cost = dists.data();
+		for (int r = 0; r < sub_rows.size(); r++)
 		{
-			_iou.push_back(1 - _ious[i][j]);
+			const float* atlbr = atracks[aindex[sub_rows[r]]].tlbr;
+			for (int k = 0; k < sub_cols.size(); k++)
+				*cost++ = gating && gate_pair(sub_rows[r], sub_cols[k]) ? 1.0f : iou_cost(atlbr, btracks[bindex[sub_cols[k]]].tlbr);
+		}
+
+		lapjv(dists.data(), sub_rows.size(), sub_cols.size(), rowsol, colsol, true, thresh);
+		for (int r = 0; r < sub_rows.size(); r++)
+		{
+			if (rowsol[r] >= 0)
+			{
+				sparse_rowsol[sub_rows[r]] = sub_cols[rowsol[r]];
+				sparse_colsol[sub_cols[rowsol[r]]] = sub_rows[r];
+			}
 		}
-		cost_matrix.push_back(_iou);
 	}
 
-	return cost_matrix;
+	matches.clear();
+	unmatched_a.clear();
+	unmatched_b.clear();
+	for (int i = 0; i < rows; i++)
+	{
+		if (sparse_rowsol[i] >= 0)
+			matches.emplace_back(i, sparse_rowsol[i]);
+		else
+			unmatched_a.push_back(i);
+	}
+	for (int i = 0; i < cols; i++)
+	{
+		if (sparse_colsol[i] < 0)
+			unmatched_b.push_back(i);
+	}
 }
 
-double BYTETracker::lapjv(const vector<vector<float> > &cost, vector<int> &rowsol, vector<int> &colsol,
+double BYTETracker::lapjv(const float* cost, int n_rows, int n_cols, vector<int> &rowsol, vector<int> &colsol,
 	bool extend_cost, float cost_limit, bool return_cost)
 {
-	vector<vector<float> > cost_c;
-	cost_c.assign(cost.begin(), cost.end());
-
-	vector<vector<float> > cost_c_extended;
-
-	int n_rows = cost.size();
-	int n_cols = cost[0].size();
+	TRACE_SCOPE("lapjv");
 	rowsol.resize(n_rows);
 	colsol.resize(n_cols);
 
@@ -294,80 +517,49 @@ double BYTETracker::lapjv(const vector<vector<float> > &cost, vector<int> &rowso
 			exit(0);
 		}
 	}
-		
+
+	// 不扩展时直接在 cost 上求解，扩展时 [0, n_rows) x [0, n_cols) 是 cost，右下角为 0，其余为 cost_limit / 2
+	const float* cost_ptr = cost;
 	if (extend_cost || cost_limit < LONG_MAX)
 	{
 		n = n_rows + n_cols;
-		cost_c_extended.resize(n);
-		for (int i = 0; i < cost_c_extended.size(); i++)
-			cost_c_extended[i].resize(n);
-
+		float fill_value;
 		if (cost_limit < LONG_MAX)
 		{
-			for (int i = 0; i < cost_c_extended.size(); i++)
-			{
-				for (int j = 0; j < cost_c_extended[i].size(); j++)
-				{
-					cost_c_extended[i][j] = cost_limit / 2.0;
-				}
-			}
+			fill_value = cost_limit / 2.0;
 		}
 		else
 		{
 			float cost_max = -1;
-			for (int i = 0; i < cost_c.size(); i++)
+			for (int i = 0; i < n_rows * n_cols; i++)
 			{
-				for (int j = 0; j < cost_c[i].size(); j++)
-				{
-					if (cost_c[i][j] > cost_max)
-						cost_max = cost_c[i][j];
-				}
-			}
-			for (int i = 0; i < cost_c_extended.size(); i++)
-			{
-				for (int j = 0; j < cost_c_extended[i].size(); j++)
-				{
-					cost_c_extended[i][j] = cost_max + 1;
-				}
+				if (cost[i] > cost_max)
+					cost_max = cost[i];
 			}
+			fill_value = cost_max + 1;
 		}
 
-		for (int i = n_rows; i < cost_c_extended.size(); i++)
+		lapjv_cost.resize((size_t)n * n);
+		for (int i = 0; i < n; i++)
 		{
-			for (int j = n_cols; j < cost_c_extended[i].size(); j++)
+			float* row = lapjv_cost.data() + (size_t)i * n;
+			if (i < n_rows)
 			{
-				cost_c_extended[i][j] = 0;
+				copy(cost + (size_t)i * n_cols, cost + (size_t)(i + 1) * n_cols, row);
+				fill(row + n_cols, row + n, fill_value);
 			}
-		}
-		for (int i = 0; i < n_rows; i++)
-		{
-			for (int j = 0; j < n_cols; j++)
+			else
 			{
-				cost_c_extended[i][j] = cost_c[i][j];
+				fill(row, row + n_cols, fill_value);
+				fill(row + n_cols, row + n, 0.0f);
 			}
 		}
-
-		cost_c.clear();
-		cost_c.assign(cost_c_extended.begin(), cost_c_extended.end());
-	}
-
-	double **cost_ptr;
-	cost_ptr = new double *[sizeof(double *) * n];
-	for (int i = 0; i < n; i++)
-		cost_ptr[i] = new double[sizeof(double) * n];
-
-	for (int i = 0; i < n; i++)
-	{
-		for (int j = 0; j < n; j++)
-		{
-			cost_ptr[i][j] = cost_c[i][j];
-		}
+		cost_ptr = lapjv_cost.data();
 	}
 
-	int* x_c = new int[sizeof(int) * n];
-	int *y_c = new int[sizeof(int) * n];
-
-	int ret = lapjv_internal(n, cost_ptr, x_c, y_c);
+	lapjv_x.resize(n);
+	lapjv_y.resize(n);
+	int ret = lapjv_dense(n, cost_ptr, lapjv_x.data(), lapjv_y.data(), lapjv_workspace);
 	if (ret != 0)
 	{
 		cout << "Calculate Wrong!" << endl;
@@ -375,54 +567,24 @@ double BYTETracker::lapjv(const vector<vector<float> > &cost, vector<int> &rowso
 		exit(0);
 	}
 
-	double opt = 0.0;
-
-	if (n != n_rows)
+	for (int i = 0; i < n_rows; i++)
 	{
-		for (int i = 0; i < n; i++)
-		{
-			if (x_c[i] >= n_cols)
-				x_c[i] = -1;
-			if (y_c[i] >= n_rows)
-				y_c[i] = -1;
-		}
-		for (int i = 0; i < n_rows; i++)
-		{
-			rowsol[i] = x_c[i];
-		}
-		for (int i = 0; i < n_cols; i++)
-		{
-			colsol[i] = y_c[i];
-		}
-
-		if (return_cost)
-		{
-			for (int i = 0; i < rowsol.size(); i++)
-			{
-				if (rowsol[i] != -1)
-				{
-					//cout << i << "\t" << rowsol[i] << "\t" << cost_ptr[i][rowsol[i]] << endl;
-					opt += cost_ptr[i][rowsol[i]];
-				}
-			}
-		}
+		rowsol[i] = lapjv_x[i] < n_cols ? lapjv_x[i] : -1;
 	}
-	else if (return_cost)
+	for (int i = 0; i < n_cols; i++)
 	{
-		for (int i = 0; i < rowsol.size(); i++)
-		{
-			opt += cost_ptr[i][rowsol[i]];
-		}
+		colsol[i] = lapjv_y[i] < n_rows ? lapjv_y[i] : -1;
 	}
 
-	for (int i = 0; i < n; i++)
+	double opt = 0.0;
+	if (return_cost)
 	{
-		delete[]cost_ptr[i];
+		for (int i = 0; i < n_rows; i++)
+		{
+			if (rowsol[i] != -1)
+				opt += cost_ptr[(size_t)i * n + rowsol[i]];
+		}
 	}
-	delete[]cost_ptr;
-	delete[]x_c;
-	delete[]y_c;
-
 	return opt;
 }
 
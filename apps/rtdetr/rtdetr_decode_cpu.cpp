@@ -0,0 +1,60 @@
+
+/// rtdetr_decode.cu 中核函数的 host 版本，供 CPU 后端使用
+
+namespace RTDETR{
+
+    static const int NUM_BOX_ELEMENT = 7;      // left, top, right, bottom, confidence, class, keepflag
+
+    static inline void affine_project(const float* matrix, float x, float y, float* ox, float* oy){
+        *ox = matrix[0] * x + matrix[1] * y + matrix[2];
+        *oy = matrix[3] * x + matrix[4] * y + matrix[5];
+    }
+
+    void decode_cpu_invoker(const float* predict, int num_bboxes, int num_classes, float confidence_threshold,
+                            int scale_expand, const float* invert_affine_matrix, float* parray, int max_objects){
+
+        parray[0] = 0;
+        for(int position = 0; position < num_bboxes; ++position){
+            const float* pitem = predict + (4 + num_classes) * position;
+            const float* class_confidence = pitem + 4;
+            float confidence = *class_confidence++;
+            int label = 0;
+            for(int i = 1; i < num_classes; ++i, ++class_confidence){
+                if(*class_confidence > confidence){
+                    confidence = *class_confidence;
+                    label = i;
+                }
+            }
+
+            if(confidence < confidence_threshold)
+                continue;
+
+            int index = (int)parray[0];
+            parray[0] += 1;
+            if(index >= max_objects)
+                continue;
+
+            float cx     = *pitem++;
+            float cy     = *pitem++;
+            float width  = *pitem++;
+            float height = *pitem++;
+            float left = (cx - width * 0.5f) * scale_expand;
+            float top = (cy - height * 0.5f) * scale_expand;
+            float right = (cx + width * 0.5f) * scale_expand;
+            float bottom = (cy + height * 0.5f) * scale_expand;
+
+            affine_project(invert_affine_matrix, left,  top,    &left,  &top);
+            affine_project(invert_affine_matrix, right, bottom, &right, &bottom);
+
+            float* pout_item = parray + 1 + index * NUM_BOX_ELEMENT;
+            *pout_item++ = left;
+            *pout_item++ = top;
+            *pout_item++ = right;
+            *pout_item++ = bottom;
+            *pout_item++ = confidence;
+            *pout_item++ = label;
+            *pout_item++ = 1; // 1 = keep, 0 = ignore
+        }
+    }
+
+}
@@ -4,8 +4,11 @@
 #include "trt_common/trt_infer.hpp"
 #include "trt_common/ilogger.hpp"
 #include "trt_common/infer_controller.hpp"
+#include "trt_common/replica_pool.hpp"
 #include "trt_common/preprocess_kernel.cuh"
+#include "trt_common/preprocess_kernel_cpu.hpp"
 #include "trt_common/tensor_allocator.hpp"
+#include "trt_common/cpu_nms.hpp"
 #include "trt_common/cuda_tools.hpp"
 
 namespace Yolo{
@@ -22,16 +25,24 @@ namespace Yolo{
         }
     }
 
+    /// column_major：V8 导出时不转置的原生输出 [4 + C, N]，一列一个框；否则为 [N, 4 + C] / [N, 5 + C]，一行一个框
     void decode_kernel_invoker(
         float* predict, int num_bboxes, int num_classes, float confidence_threshold, 
         float* invert_affine_matrix, float* parray,
-        int max_objects, Type type, cudaStream_t stream
+        int max_objects, Type type, bool column_major, cudaStream_t stream
     );
 
     void nms_kernel_invoker(
         float* parray, float nms_threshold, int max_objects, cudaStream_t stream
     );
 
+    void decode_cpu_invoker(
+        const float* predict, int num_bboxes, int num_classes, float confidence_threshold,
+        const float* invert_affine_matrix, float* parray, int max_objects, Type type, bool column_major
+    );
+
+    void nms_cpu_invoker(float* parray, float nms_threshold, int max_objects);
+
     struct AffineMatrix{
         float i2d[6];       // image to dst(network), 2x3 matrix
         float d2i[6];       // dst to image, 2x3 matrix
@@ -54,39 +65,6 @@ namespace Yolo{
         }
     };
 
-    static float iou(const Box& a, const Box& b){
-        float cross_left   = std::max(a.left, b.left);
-        float cross_top    = std::max(a.top, b.top);
-        float cross_right  = std::min(a.right, b.right);
-        float cross_bottom = std::min(a.bottom, b.bottom);
-
-        float cross_area = std::max(0.0f, cross_right - cross_left) * std::max(0.0f, cross_bottom - cross_top);
-        float union_area = std::max(0.0f, a.right - a.left) * std::max(0.0f, a.bottom - a.top)
-                           + std::max(0.0f, b.right - b.left) * std::max(0.0f, b.bottom - b.top) - cross_area;
-        if(cross_area == 0.f || union_area == 0.f) return 0.0f;
-        return cross_area / union_area;
-    }
-
-    static BoxArray cpu_nms(BoxArray& boxes, float threshold){
-        std::sort(boxes.begin(), boxes.end(), [](Box& a, Box& b){return a.confidence > b.confidence;});
-        vector<Box> box_result(boxes.size());
-        vector<bool> remove_flags(boxes.size());
-        for(int i = 0; i < boxes.size(); ++i){
-            if(remove_flags[i]) continue;
-            auto& a = boxes[i];
-            box_result.emplace_back(a);
-            for(int j = i + 1; j < boxes.size(); ++j){
-                if(remove_flags[j]) continue;
-                auto& b = boxes[j];
-                if(b.label == a.label){
-                    if(iou(a, b) >= threshold)
-                        remove_flags[j] = true;
-                }
-            }
-        }
-        return box_result;
-    }
-
     using ControllerImpl = InferController<cv::Mat, BoxArray, tuple<string, int>, AffineMatrix>;
 
     class InferImpl : public Infer, public ControllerImpl{
@@ -121,6 +99,22 @@ namespace Yolo{
             return ControllerImpl::startup(make_tuple(file, gpuid));
         }
 
+        /// V8 导出时不转置的输出是 [batch, 4 + C, N]，框数总是多于 4 + C，据此区分两种布局，返回是否为 [4 + C, N]
+        bool parse_output_shape(const shared_ptr<TRT::Tensor>& output, int& num_bboxes, int& num_classes) const{
+            if(type_ == Type::V8 && output->shape(1) < output->shape(2)){
+                num_bboxes  = output->shape(2);
+                num_classes = output->shape(1) - 4;
+                return true;
+            }
+
+            num_bboxes = output->shape(1);
+            if(type_ == Type::V8)   // 84
+                num_classes = output->shape(2) - 4;
+            else   // 85
+                num_classes = output->shape(2) - 5;
+            return false;
+        }
+
         void worker(promise<bool>& result) override{
             // load model
             string file = get<0>(start_param_);
@@ -135,17 +129,19 @@ namespace Yolo{
             }
 
             model->print();
+            use_job_keys(model.get());
+            if(model->device() == CPU_DEVICE_ID){
+                cpu_worker(model, result);
+                return;
+            }
 
             const int MAX_IMAGE_BBOX  = max_objects_;
             const int NUM_BOX_ELEMENT = 7;   // left, top, right, bottom, confidence, class, keepflag
             int max_batch_size = model->get_max_batch_size();
             auto input = model->input();
             auto output = model->output();
-            int num_classes;
-            if(type_ == Type::V8)   // 84
-                num_classes = output->shape(2) - 4;
-            else   // 85
-                num_classes = output->shape(2) - 5;
+            int num_classes, num_bboxes;
+            bool column_major = parse_output_shape(output, num_bboxes, num_classes);
             input_width_  = input->shape(3);
             input_height_ = input->shape(2);
             stream_       = model->get_stream();
@@ -172,6 +168,7 @@ namespace Yolo{
 
             vector<Job> fetch_jobs;
             while(get_jobs_and_wait(fetch_jobs, max_batch_size)){
+                TRACE_SCOPE("worker");
                 int infer_batch_size = fetch_jobs.size();
                 input->resize_single_dim(0, infer_batch_size);
 
@@ -190,6 +187,7 @@ namespace Yolo{
                 }
                 
                 // 进行推理，一次推理一批
+                bind_job_keys(model.get(), fetch_jobs);
                 model->forward(false);
                 
                 output_array_device.to_gpu(false);
@@ -200,8 +198,8 @@ namespace Yolo{
                     float* output_array_ptr   = output_array_device.gpu<float>(ibatch);
                     auto affine_matrix = affine_matrix_device.gpu<float>(ibatch);
                     checkCudaRuntime(cudaMemsetAsync(output_array_ptr, 0, sizeof(int), stream_));
-                    decode_kernel_invoker(predict_batch, output->shape(1), num_classes, confidence_threshold_,
-                                          affine_matrix, output_array_ptr, MAX_IMAGE_BBOX, type_, stream_);
+                    decode_kernel_invoker(predict_batch, num_bboxes, num_classes, confidence_threshold_,
+                                          affine_matrix, output_array_ptr, MAX_IMAGE_BBOX, type_, column_major, stream_);
 
                     if(nms_method_ == NMSMethod::CUDA){
                         nms_kernel_invoker(output_array_ptr, nms_threshold_, MAX_IMAGE_BBOX, stream_);
@@ -213,20 +211,9 @@ namespace Yolo{
                     float* parray = output_array_device.cpu<float>(ibatch);
                     int count     = min(MAX_IMAGE_BBOX, (int)*parray);
                     auto& job = fetch_jobs[ibatch];
-                    auto& image_based_boxes = job.output;
-                    for(int i = 0; i < count; ++i){
-                        float* pbox  = parray + 1 + i * NUM_BOX_ELEMENT;
-                        int label    = pbox[5];
-                        int keepflag = pbox[6];
-                        if(keepflag == 1){
-                            image_based_boxes.emplace_back(pbox[0], pbox[1], pbox[2], pbox[3], pbox[4], label);
-                        }
-                    }
-
-                    if(nms_method_ == NMSMethod::CPU){
-                        image_based_boxes = cpu_nms(image_based_boxes, nms_threshold_);
-                    }
-                    job.pro->set_value(image_based_boxes);
+                    // 只拷贝有效的部分，解析和 CPU nms 在 postprocess 里做，可以和下一次 forward 重叠
+                    job.host_output.assign(parray, parray + 1 + count * NUM_BOX_ELEMENT);
+                    finish(std::move(job));
                 }
                 fetch_jobs.clear();
             }
@@ -235,6 +222,117 @@ namespace Yolo{
             INFO("Engine destroy.");
         }
 
+        /// CPU 后端：预处理、decode、nms 全部在 host 上完成，输出布局与 GPU 路径一致
+        void cpu_worker(shared_ptr<TRT::Infer> model, promise<bool>& result){
+
+            const int MAX_IMAGE_BBOX  = max_objects_;
+            const int NUM_BOX_ELEMENT = 7;   // left, top, right, bottom, confidence, class, keepflag
+            int max_batch_size = model->get_max_batch_size();
+            auto input = model->input();
+            auto output = model->output();
+            int num_classes, num_bboxes;
+            bool column_major = parse_output_shape(output, num_bboxes, num_classes);
+            input_width_  = input->shape(3);
+            input_height_ = input->shape(2);
+            stream_       = nullptr;
+            cpu_backend_  = true;
+            tensor_allocator_.reset(new TensorAllocator(max_batch_size * 2));
+
+            result.set_value(true);
+
+            input->resize_single_dim(0, max_batch_size).to_cpu();
+            vector<float> output_array(1 + MAX_IMAGE_BBOX * NUM_BOX_ELEMENT);
+
+            vector<Job> fetch_jobs;
+            while(get_jobs_and_wait(fetch_jobs, max_batch_size)){
+                TRACE_SCOPE("worker");
+                int infer_batch_size = fetch_jobs.size();
+                input->resize_single_dim(0, infer_batch_size);
+
+                for(int ibatch = 0; ibatch < infer_batch_size; ++ibatch){
+                    auto& job = fetch_jobs[ibatch];
+                    auto& mono_tensor = job.mono_tensor->data();
+                    input->copy_from_cpu(input->offset(ibatch), mono_tensor->cpu(), mono_tensor->count());
+                    job.mono_tensor->release();
+                }
+
+                bind_job_keys(model.get(), fetch_jobs);
+                model->forward(true);
+
+                for(int ibatch = 0; ibatch < infer_batch_size; ++ibatch){
+                    auto& job = fetch_jobs[ibatch];
+                    float* parray = output_array.data();
+                    decode_cpu_invoker(output->cpu<float>(ibatch), num_bboxes, num_classes, confidence_threshold_,
+                                       job.additional.d2i, parray, MAX_IMAGE_BBOX, type_, column_major);
+
+                    // CPU 后端没有 CUDA nms，两种 NMSMethod 都在 host 上做
+                    if(nms_method_ == NMSMethod::CUDA)
+                        nms_cpu_invoker(parray, nms_threshold_, MAX_IMAGE_BBOX);
+
+                    int count = min(MAX_IMAGE_BBOX, (int)*parray);
+                    job.host_output.assign(parray, parray + 1 + count * NUM_BOX_ELEMENT);
+                    finish(std::move(job));
+                }
+                fetch_jobs.clear();
+            }
+            tensor_allocator_.reset();
+            INFO("Engine destroy.");
+        }
+
+        /// 解析 decode 的结果（counter + bboxes），postprocess_threads > 0 时在后处理线程上调用
+        void postprocess(Job& job) override{
+            const int NUM_BOX_ELEMENT = 7;   // left, top, right, bottom, confidence, class, keepflag
+            float* parray = job.host_output.data();
+            int count     = (job.host_output.size() - 1) / NUM_BOX_ELEMENT;
+            auto& image_based_boxes = job.output;
+            image_based_boxes.reserve(count);
+            for(int i = 0; i < count; ++i){
+                float* pbox  = parray + 1 + i * NUM_BOX_ELEMENT;
+                int label    = pbox[5];
+                int keepflag = pbox[6];
+                if(keepflag == 1){
+                    image_based_boxes.emplace_back(pbox[0], pbox[1], pbox[2], pbox[3], pbox[4], label);
+                }
+            }
+
+            if(nms_method_ == NMSMethod::CPU){
+                TRACE_SCOPE("cpu_nms");
+                NMS::Config nms_config;
+                nms_config.iou_threshold = nms_threshold_;
+                image_based_boxes = NMS::cpu_nms(image_based_boxes, nms_config);
+            }
+        }
+
+        /// 预处理线程在 commit 返回之后才读取图像，调用者可能复用同一块内存（比如 VideoCapture）
+        cv::Mat copy_input(const cv::Mat& image) override{
+            return image.clone();
+        }
+
+        const char* metrics_name() const override{
+            return "yolo";
+        }
+
+        bool preprocess_cpu(Job& job, const cv::Mat& image){
+
+            auto& tensor = job.mono_tensor->data();
+            if(tensor == nullptr){
+                tensor = make_shared<TRT::Tensor>(nullptr, CPU_DEVICE_ID);
+                tensor->set_owner("yolo.preprocess");
+            }
+
+            cv::Size input_size(input_width_, input_height_);
+            job.additional.compute(image.size(), input_size);
+            tensor->resize(1, 3, input_height_, input_width_);
+
+            CPUKernel::warp_affine_bilinear_and_normalize_plane(
+                image.data,           image.cols * 3,       image.cols,       image.rows,
+                tensor->cpu<float>(), input_width_,         input_height_,
+                job.additional.d2i,   114,
+                normalize_
+            );
+            return true;
+        }
+
         bool preprocess(Job& job, const cv::Mat& image) override{
             if(tensor_allocator_ == nullptr){
                 INFOE("tensor_allocator_ is nullptr.");
@@ -245,11 +343,13 @@ namespace Yolo{
                 return false;
             }
             // 向 allocator 申请一个 tensor
-            job.mono_tensor = tensor_allocator_->query();
-            if(job.mono_tensor == nullptr){
-                INFOE("Tensor allocator query failed.");
+            // 按 overload 策略申请，拒绝/超时返回空
+            job.mono_tensor = acquire_tensor(job);
+            if(job.mono_tensor == nullptr)
                 return false;
-            }
+
+            if(cpu_backend_)
+                return preprocess_cpu(job, image);
 
             CUDATools::AutoDevice auto_device(gpu_);
             auto& tensor = job.mono_tensor->data();
@@ -258,7 +358,9 @@ namespace Yolo{
             if(tensor == nullptr){
                 // not init
                 tensor = make_shared<TRT::Tensor>();
+                tensor->set_owner("yolo.preprocess");
                 tensor->set_workspace(make_shared<TRT::MixMemory>()); // 新创建一个workspace
+                tensor->get_workspace()->set_owner("yolo.preprocess");
 
                 if(use_multi_preprocess_stream_){
                     checkCudaRuntime(cudaStreamCreate(&preprocess_stream));
@@ -313,6 +415,18 @@ namespace Yolo{
             return ControllerImpl::commit(image);
         }
 
+        std::shared_future<BoxArray> commit(const cv::Mat& image, int stream_id) override{
+            return ControllerImpl::commit(image, stream_id);
+        }
+
+        void commit(const cv::Mat& image, ResultCallback callback) override{
+            ControllerImpl::commit(image, -1, std::move(callback));
+        }
+
+        void commit(const cv::Mat& image, int stream_id, ResultCallback callback) override{
+            ControllerImpl::commit(image, stream_id, std::move(callback));
+        }
+
     private:
         int input_width_            = 0;
         int input_height_           = 0;
@@ -323,22 +437,47 @@ namespace Yolo{
         NMSMethod nms_method_       = NMSMethod::CUDA;
         TRT::CUStream stream_       = nullptr;
         bool use_multi_preprocess_stream_ = false;
+        bool cpu_backend_           = false;
         CUDAKernel::Norm normalize_;
         Type type_;
     };
 
+    /// 多副本：一个 Infer 句柄后面挂多个 InferImpl，见 default_replica_config
+    using ReplicaInferImpl = ReplicaInfer<Infer, cv::Mat, BoxArray, InferImpl>;
+
     shared_ptr<Infer> create_infer(
         const string& engine_file, Type type, int gpuid, 
         float confidence_threshold, float nms_threshold,
         NMSMethod nms_method, int max_objects,
         bool use_multi_preprocess_stream
     ){
-        shared_ptr<InferImpl> instance(new InferImpl{});
-        if(!instance->startup(engine_file, type, gpuid, confidence_threshold,
-                              nms_threshold, nms_method, max_objects, use_multi_preprocess_stream)){
-            instance.reset();
+        auto& replica = default_replica_config();
+        if(replica.num_replicas <= 1){
+            shared_ptr<InferImpl> instance(new InferImpl{});
+            if(!instance->startup(engine_file, type, gpuid, confidence_threshold,
+                                  nms_threshold, nms_method, max_objects, use_multi_preprocess_stream)){
+                instance.reset();
+            }
+            return instance;
+        }
+
+        // 多个副本：各自加载模型、创建 stream 和 worker 线程
+        vector<shared_ptr<InferImpl>> replicas;
+        for(int i = 0; i < replica.num_replicas; ++i){
+            int id = replica.gpuids.empty() ? gpuid : replica.gpuids[i % replica.gpuids.size()];
+            shared_ptr<InferImpl> instance(new InferImpl{});
+            if(!instance->startup(engine_file, type, id, confidence_threshold,
+                                  nms_threshold, nms_method, max_objects, use_multi_preprocess_stream)){
+                INFOE("Startup replica %d on device %d failed", i, id);
+                return nullptr;
+            }
+            replicas.emplace_back(instance);
         }
-        return instance;
+
+        shared_ptr<ReplicaInferImpl> pool(new ReplicaInferImpl{});
+        if(!pool->startup(replicas))
+            pool.reset();
+        return pool;
     }
 
 }
\ No newline at end of file
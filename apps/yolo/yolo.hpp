@@ -5,6 +5,7 @@
 #include <memory>
 #include <string>
 #include <future>
+#include <functional>
 #include <opencv2/opencv.hpp>
 #include "trt_common/trt_tensor.hpp"
 
@@ -42,10 +43,17 @@ namespace Yolo{
 
     const char* type_name(Type type);
 
+    using ResultCallback = function<void(BoxArray&& boxes)>;
+
     class Infer{
     public:
         virtual shared_future<BoxArray> commit(const cv::Mat& image) = 0;
+        /// stream_id 标识视频流，overload 策略为 keep_latest 时同一路只保留最新一帧
+        virtual shared_future<BoxArray> commit(const cv::Mat& image, int stream_id) = 0;
         virtual vector<shared_future<BoxArray>> commits(const vector<cv::Mat>& images) = 0;
+        /// 结果移动给 callback（在 worker 或后处理线程上调用），不分配 promise，也没有 future::get 的拷贝
+        virtual void commit(const cv::Mat& image, ResultCallback callback) = 0;
+        virtual void commit(const cv::Mat& image, int stream_id, ResultCallback callback) = 0;
     };
 
     shared_ptr<Infer> create_infer(
@@ -57,6 +57,53 @@ namespace Yolo{
         *pout_item++ = 1; // 1 = keep, 0 = ignore
     }
 
+    /// V8 导出时不转置的输出 [4 + C, N]：第 k 个分量在 predict[k * num_bboxes + position]，相邻线程读相邻地址
+    static __global__ void decode_kernel_v8_column_major(float* predict, int num_bboxes, int num_classes, float confidence_threshold,
+                                                       float* invert_affine_matrix, float* parray, int max_objects){
+
+        int position = blockDim.x * blockIdx.x + threadIdx.x;
+        if (position >= num_bboxes) return;
+
+        float* pitem = predict + position;
+        float* class_confidence = pitem + 4 * num_bboxes;
+        float confidence = *class_confidence;
+        int label = 0;
+        for(int i = 1; i < num_classes; ++i){
+            class_confidence += num_bboxes;
+            if(*class_confidence > confidence){
+                confidence = *class_confidence;
+                label = i;
+            }
+        }
+
+        if(confidence < confidence_threshold)
+            return;
+
+        int index = atomicAdd(parray, 1);
+        if(index >= max_objects)
+            return;
+
+        float cx     = pitem[0];
+        float cy     = pitem[num_bboxes];
+        float width  = pitem[2 * num_bboxes];
+        float height = pitem[3 * num_bboxes];
+        float left   = cx - width * 0.5f;
+        float top    = cy - height * 0.5f;
+        float right  = cx + width * 0.5f;
+        float bottom = cy + height * 0.5f;
+        affine_project(invert_affine_matrix, left,  top,    &left,  &top);
+        affine_project(invert_affine_matrix, right, bottom, &right, &bottom);
+
+        float* pout_item = parray + 1 + index * NUM_BOX_ELEMENT;
+        *pout_item++ = left;
+        *pout_item++ = top;
+        *pout_item++ = right;
+        *pout_item++ = bottom;
+        *pout_item++ = confidence;
+        *pout_item++ = label;
+        *pout_item++ = 1; // 1 = keep, 0 = ignore
+    }
+
     static __global__ void decode_kernel_common(float* predict, int num_bboxes, int num_classes, float confidence_threshold,
                                                 float* invert_affine_matrix, float* parray, int max_objects){
 
@@ -160,11 +207,15 @@ namespace Yolo{
     /// ------------------ 核函数调用 ------------------
 
     void decode_kernel_invoker(float* predict, int num_bboxes, int num_classes, float confidence_threshold, float* invert_affine_matrix,
-                               float* parray, int max_objects, Type type, cudaStream_t stream){
+                               float* parray, int max_objects, Type type, bool column_major, cudaStream_t stream){
         
         auto grid = CUDATools::grid_dims(num_bboxes);
         auto block = CUDATools::block_dims(num_bboxes);
-        if(type == Type::V8){
+        if(type == Type::V8 && column_major){
+            checkCudaKernel(decode_kernel_v8_column_major<<<grid, block, 0, stream>>>(
+                    predict, num_bboxes, num_classes, confidence_threshold, invert_affine_matrix, parray, max_objects));
+        }
+        else if(type == Type::V8){
             checkCudaKernel(decode_kernel_v8<<<grid, block, 0, stream>>>(
                     predict, num_bboxes, num_classes, confidence_threshold, invert_affine_matrix, parray, max_objects));
         }
@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "yolo.hpp"
+#include "trt_common/preprocess_kernel_cpu.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define YOLO_DECODE_X86
+#endif
+
+/// yolo_decode.cu 中核函数的 host 版本，供 CPU 后端使用
+/// 输出布局与 CUDA 版本相同：parray = [count, (left, top, right, bottom, confidence, class, keepflag) * count]
+/// 按位置分成条带并行解码，每个条带先写入自己的缓冲区，再按条带顺序合并，结果与逐个位置顺序解码完全相同
+/// 先用向量化的 max 判断阈值，只有通过阈值的框才找 argmax（类别号）
+
+namespace Yolo{
+
+    static const int NUM_BOX_ELEMENT = 7;      // left, top, right, bottom, confidence, class, keepflag
+    static const int STRIPE_SIZE     = 1024;   // 每个条带的位置数
+
+    static inline void affine_project(const float* matrix, float x, float y, float* ox, float* oy){
+        *ox = matrix[0] * x + matrix[1] * y + matrix[2];
+        *oy = matrix[3] * x + matrix[4] * y + matrix[5];
+    }
+
+    /// 条带缓冲区里的框，与 parray 中的格式相同（不含 counter）
+    static inline void push_box(std::vector<float>& output, const float* invert_affine_matrix,
+                                float cx, float cy, float width, float height, float confidence, int label){
+
+        float left   = cx - width * 0.5f;
+        float top    = cy - height * 0.5f;
+        float right  = cx + width * 0.5f;
+        float bottom = cy + height * 0.5f;
+        affine_project(invert_affine_matrix, left,  top,    &left,  &top);
+        affine_project(invert_affine_matrix, right, bottom, &right, &bottom);
+
+        float item[NUM_BOX_ELEMENT] = {left, top, right, bottom, confidence, (float)label, 1}; // 1 = keep, 0 = ignore
+        output.insert(output.end(), item, item + NUM_BOX_ELEMENT);
+    }
+
+    /// 第一个最大值的下标，与 CUDA 核函数中 ">" 比较的结果相同
+    static inline int argmax(const float* values, int count, int stride, float* max_value){
+        float value = values[0];
+        int label   = 0;
+        for(int i = 1; i < count; ++i){
+            if(values[i * stride] > value){
+                value = values[i * stride];
+                label = i;
+            }
+        }
+        *max_value = value;
+        return label;
+    }
+
+    struct DecodeParam{
+        const float* predict;
+        int num_bboxes;
+        int num_classes;
+        float confidence_threshold;
+        const float* invert_affine_matrix;
+        Type type;
+        bool column_major;      // V8 的原生输出 [4 + C, N]，一列一个框
+    };
+
+    /// [N, 4 + C]（V8）或 [N, 5 + C]（V5/X/V7），一行一个框
+    static void decode_rows_scalar(const DecodeParam& p, int begin, int end, std::vector<float>& output){
+        for(int position = begin; position < end; ++position){
+            float confidence;
+            int label;
+            if(p.type == Type::V8){
+                const float* pitem = p.predict + (4 + p.num_classes) * position;
+                label = argmax(pitem + 4, p.num_classes, 1, &confidence);
+                if(confidence < p.confidence_threshold)
+                    continue;
+
+                push_box(output, p.invert_affine_matrix, pitem[0], pitem[1], pitem[2], pitem[3], confidence, label);
+            }
+            else{
+                const float* pitem = p.predict + (5 + p.num_classes) * position;
+                float objectness = pitem[4];
+                if(objectness < p.confidence_threshold)
+                    continue;
+
+                label = argmax(pitem + 5, p.num_classes, 1, &confidence);
+                confidence *= objectness;
+                if(confidence < p.confidence_threshold)
+                    continue;
+
+                push_box(output, p.invert_affine_matrix, pitem[0], pitem[1], pitem[2], pitem[3], confidence, label);
+            }
+        }
+    }
+
+    /// V8 导出时不转置的 [4 + C, N]：一列一个框
+    static void decode_columns_scalar(const DecodeParam& p, int begin, int end, std::vector<float>& output){
+        const int n = p.num_bboxes;
+        for(int position = begin; position < end; ++position){
+            const float* pitem = p.predict + position;
+            float confidence;
+            int label = argmax(pitem + 4 * n, p.num_classes, n, &confidence);
+            if(confidence < p.confidence_threshold)
+                continue;
+
+            push_box(output, p.invert_affine_matrix, pitem[0], pitem[n], pitem[2 * n], pitem[3 * n], confidence, label);
+        }
+    }
+
+#ifdef YOLO_DECODE_X86
+
+    __attribute__((target("avx2")))
+    static inline float max_avx2(const float* values, int count){
+        int i = 0;
+        float value = values[0];
+        if(count >= 8){
+            __m256 best = _mm256_loadu_ps(values);
+            for(i = 8; i + 8 <= count; i += 8)
+                best = _mm256_max_ps(best, _mm256_loadu_ps(values + i));
+
+            __m128 half = _mm_max_ps(_mm256_castps256_ps128(best), _mm256_extractf128_ps(best, 1));
+            half  = _mm_max_ps(half, _mm_movehl_ps(half, half));
+            half  = _mm_max_ss(half, _mm_shuffle_ps(half, half, 1));
+            value = _mm_cvtss_f32(half);
+
+            // 后面是 push_box 等标量代码（可能调用库函数），先清掉 ymm 的高位，避免 SSE/AVX 切换的代价
+            _mm256_zeroupper();
+        }
+        for(; i < count; ++i)
+            value = std::max(value, values[i]);
+        return value;
+    }
+
+    /// 一行一个框：行内的类别分数连续，向量化求 max 之后判断阈值
+    __attribute__((target("avx2")))
+    static void decode_rows_avx2(const DecodeParam& p, int begin, int end, std::vector<float>& output){
+        const int head = p.type == Type::V8 ? 4 : 5;
+        for(int position = begin; position < end; ++position){
+            const float* pitem = p.predict + (head + p.num_classes) * position;
+            float objectness = 1;
+            if(p.type != Type::V8){
+                objectness = pitem[4];
+                if(objectness < p.confidence_threshold)
+                    continue;
+            }
+
+            float confidence = max_avx2(pitem + head, p.num_classes);
+            if(p.type != Type::V8) confidence *= objectness;
+            if(confidence < p.confidence_threshold)
+                continue;
+
+            float max_value;
+            int label = argmax(pitem + head, p.num_classes, 1, &max_value);
+            push_box(output, p.invert_affine_matrix, pitem[0], pitem[1], pitem[2], pitem[3], confidence, label);
+        }
+    }
+
+    /// 一列一个框：相邻 8 个框的同一类别分数连续，一次比较 8 个框，只有通过阈值的框再逐个找 argmax
+    __attribute__((target("avx2")))
+    static void decode_columns_avx2(const DecodeParam& p, int begin, int end, std::vector<float>& output){
+        const int n = p.num_bboxes;
+        const float* scores = p.predict + 4 * n;
+        const __m256 threshold = _mm256_set1_ps(p.confidence_threshold);
+
+        int position = begin;
+        for(; position + 8 <= end; position += 8){
+            __m256 best = _mm256_loadu_ps(scores + position);
+            for(int c = 1; c < p.num_classes; ++c)
+                best = _mm256_max_ps(best, _mm256_loadu_ps(scores + c * n + position));
+
+            int mask = _mm256_movemask_ps(_mm256_cmp_ps(best, threshold, _CMP_GE_OQ));
+            if(mask != 0) _mm256_zeroupper();
+            for(int lane = 0; mask != 0; ++lane, mask >>= 1){
+                if((mask & 1) == 0) continue;
+
+                const float* pitem = p.predict + position + lane;
+                float confidence;
+                int label = argmax(pitem + 4 * n, p.num_classes, n, &confidence);
+                push_box(output, p.invert_affine_matrix, pitem[0], pitem[n], pitem[2 * n], pitem[3 * n], confidence, label);
+            }
+        }
+        _mm256_zeroupper();
+        decode_columns_scalar(p, position, end, output);
+    }
+
+#endif // YOLO_DECODE_X86
+
+    void decode_cpu_invoker(const float* predict, int num_bboxes, int num_classes, float confidence_threshold,
+                            const float* invert_affine_matrix, float* parray, int max_objects, Type type, bool column_major){
+
+        DecodeParam param{predict, num_bboxes, num_classes, confidence_threshold, invert_affine_matrix, type, column_major && type == Type::V8};
+        auto decode = param.column_major ? decode_columns_scalar : decode_rows_scalar;
+#ifdef YOLO_DECODE_X86
+        if(CPUKernel::is_simd_enabled())
+            decode = param.column_major ? decode_columns_avx2 : decode_rows_avx2;
+#endif
+
+        // 缓冲区留在调用线程（worker）上复用；parallel_for_ 的线程上 thread_local 是各自的空副本，
+        // 因此先在调用线程上取得引用，lambda 中只通过引用访问
+        thread_local std::vector<std::vector<float>> thread_stripes;
+        auto& stripes = thread_stripes;
+        int num_stripes = (num_bboxes + STRIPE_SIZE - 1) / STRIPE_SIZE;
+        if(stripes.size() < (size_t)num_stripes)
+            stripes.resize(num_stripes);
+
+        cv::parallel_for_(cv::Range(0, num_stripes), [&](const cv::Range& range){
+            for(int i = range.start; i < range.end; ++i){
+                stripes[i].clear();
+                decode(param, i * STRIPE_SIZE, std::min(num_bboxes, (i + 1) * STRIPE_SIZE), stripes[i]);
+            }
+        });
+
+        // 与 CUDA 版本一样，counter 是通过阈值的框的总数，可能超过 max_objects
+        int count = 0;
+        for(int i = 0; i < num_stripes; ++i){
+            int num_boxes = stripes[i].size() / NUM_BOX_ELEMENT;
+            int num_copy  = std::max(0, std::min(num_boxes, max_objects - count));
+            std::copy(stripes[i].begin(), stripes[i].begin() + num_copy * NUM_BOX_ELEMENT, parray + 1 + count * NUM_BOX_ELEMENT);
+            count += num_boxes;
+        }
+        parray[0] = count;
+    }
+
+    static inline float iou_host(
+        float aleft, float atop, float aright, float abottom,
+        float bleft, float btop, float bright, float bbottom
+    ){
+
+        float cleft   = std::max(aleft, bleft);
+        float ctop    = std::max(atop, btop);
+        float cright  = std::min(aright, bright);
+        float cbottom = std::min(abottom, bbottom);
+
+        float c_area = std::max(cright - cleft, 0.0f) * std::max(cbottom - ctop, 0.0f);
+        if(c_area == 0.0f)
+            return 0.0f;
+
+        float a_area = std::max(0.0f, aright - aleft) * std::max(0.0f, abottom - atop);
+        float b_area = std::max(0.0f, bright - bleft) * std::max(0.0f, bbottom - btop);
+        return c_area / (a_area + b_area - c_area);
+    }
+
+    /// 与 nms_kernel 相同的判定规则，只修改 keepflag
+    void nms_cpu_invoker(float* parray, float nms_threshold, int max_objects){
+
+        int count = std::min((int)*parray, max_objects);
+        for(int position = 0; position < count; ++position){
+            float* pcurrent = parray + 1 + position * NUM_BOX_ELEMENT;
+            for(int i = 0; i < count; ++i){
+                float* pitem = parray + 1 + i * NUM_BOX_ELEMENT;
+                if(i == position || pcurrent[5] != pitem[5]) continue;
+
+                if(pitem[4] >= pcurrent[4]){
+                    if(pitem[4] == pcurrent[4] && i < position)
+                        continue;
+
+                    float iou = iou_host(
+                        pcurrent[0], pcurrent[1], pcurrent[2], pcurrent[3],
+                        pitem[0],    pitem[1],    pitem[2],    pitem[3]
+                    );
+
+                    if(iou > nms_threshold){
+                        pcurrent[6] = 0;  // 1=keep, 0=ignore
+                        break;
+                    }
+                }
+            }
+        }
+    }
+};
@@ -5,6 +5,8 @@
 #include "trt_common/ilogger.hpp"
 #include "trt_common/preprocess_kernel.cuh"
 #include "trt_common/cuda_tools.hpp"
+#include "trt_common/trace.hpp"
+#include "trt_common/cpu_nms.hpp"
 
 namespace YoloP{
 
@@ -57,37 +59,6 @@ namespace YoloP{
         }
     };
 
-    static float iou(const Box& a, const Box& b){
-        float cross_left   = std::max(a.left, b.left);
-        float cross_top    = std::max(a.top, b.top);
-        float cross_right  = std::min(a.right, b.right);
-        float cross_bottom = std::min(a.bottom, b.bottom);
-
-        float cross_area = std::max(0.0f, cross_right - cross_left) * std::max(0.0f, cross_bottom - cross_top);
-        float union_area = std::max(0.0f, a.right - a.left) * std::max(0.0f, a.bottom - a.top)
-                           + std::max(0.0f, b.right - b.left) * std::max(0.0f, b.bottom - b.top) - cross_area;
-        if(cross_area == 0.f || union_area == 0.f) return 0.0f;
-        return cross_area / union_area;
-    }
-
-    static BoxArray cpu_nms(BoxArray& boxes, float threshold){
-        std::sort(boxes.begin(), boxes.end(), [](Box& a, Box& b){return a.confidence > b.confidence;});
-        BoxArray box_result(boxes.size());
-        vector<bool> remove_flags(boxes.size());
-        for(int i = 0; i < boxes.size(); ++i){
-            if(remove_flags[i]) continue;
-            auto& a = boxes[i];
-            box_result.emplace_back(a);
-            for(int j = i + 1; j < boxes.size(); ++j){
-                if(remove_flags[j]) continue;
-                auto& b = boxes[j];
-                if(iou(a, b) >= threshold)
-                    remove_flags[j] = true;
-            }
-        }
-        return box_result;
-    }
-
     class DetectorImpl : public Detector{
     public:
         ~DetectorImpl() = default;
@@ -209,7 +180,11 @@ namespace YoloP{
                 }
             }
             if(nms_method_ == NMSMethod::CPU){
-                image_based_boxes = cpu_nms(image_based_boxes, nms_threshold_);
+                TRACE_SCOPE("cpu_nms");
+                NMS::Config nms_config;
+                nms_config.iou_threshold  = nms_threshold_;
+                nms_config.class_agnostic = true;
+                image_based_boxes = NMS::cpu_nms(image_based_boxes, nms_config);
             }
 
             // 将 3张图 拷贝回 Host memory
@@ -5,7 +5,9 @@
 #include "trt_common/trt_infer.hpp"
 #include "trt_common/ilogger.hpp"
 #include "trt_common/infer_controller.hpp"
+#include "trt_common/replica_pool.hpp"
 #include "trt_common/preprocess_kernel.cuh"
+#include "trt_common/preprocess_kernel_cpu.hpp"
 #include "trt_common/tensor_allocator.hpp"
 #include "trt_common/cuda_tools.hpp"
 
@@ -20,6 +22,11 @@ namespace YOLOV10{
             int max_objects, cudaStream_t stream
     );
 
+    void decode_cpu_invoker(
+            const float* predict, int num_bboxes, float confidence_threshold,
+            const float* invert_affine_matrix, float* parray, int max_objects
+    );
+
     struct AffineMatrix{
         float i2d[6];       // image to dst(network), 2x3 matrix
         float d2i[6];       // dst to image, 2x3 matrix
@@ -75,6 +82,11 @@ namespace YOLOV10{
             }
 
             model->print();
+            use_job_keys(model.get());
+            if(model->device() == CPU_DEVICE_ID){
+                cpu_worker(model, result);
+                return;
+            }
 
             const int MAX_IMAGE_BBOX  = max_objects_;
             const int NUM_BOX_ELEMENT = 7;   // left, top, right, bottom, confidence, class, keepflag
@@ -108,6 +120,7 @@ namespace YOLOV10{
 
             vector<Job> fetch_jobs;
             while(get_jobs_and_wait(fetch_jobs, max_batch_size)){
+                TRACE_SCOPE("worker");
                 int infer_batch_size = fetch_jobs.size();
                 input->resize_single_dim(0, infer_batch_size);
 
@@ -126,6 +139,7 @@ namespace YOLOV10{
                 }
 
                 // 进行推理，一次推理一批
+                bind_job_keys(model.get(), fetch_jobs);
                 model->forward(false);
 
                 output_array_device.to_gpu(false);
@@ -145,17 +159,9 @@ namespace YOLOV10{
                     float* parray = output_array_device.cpu<float>(ibatch);
                     int count     = min(MAX_IMAGE_BBOX, (int)*parray);
                     auto& job = fetch_jobs[ibatch];
-                    auto& image_based_boxes = job.output;
-                    for(int i = 0; i < count; ++i){
-                        float* pbox  = parray + 1 + i * NUM_BOX_ELEMENT;
-                        int label    = pbox[5];
-                        int keepflag = pbox[6];
-                        if(keepflag == 1){
-                            image_based_boxes.emplace_back(pbox[0], pbox[1], pbox[2], pbox[3], pbox[4], label);
-                        }
-                    }
-
-                    job.pro->set_value(image_based_boxes);
+                    // 只拷贝有效的部分，解析和 CPU nms 在 postprocess 里做，可以和下一次 forward 重叠
+                    job.host_output.assign(parray, parray + 1 + count * NUM_BOX_ELEMENT);
+                    finish(std::move(job));
                 }
                 fetch_jobs.clear();
             }
@@ -164,6 +170,105 @@ namespace YOLOV10{
             INFO("Engine destroy.");
         }
 
+        /// CPU 后端：预处理、decode 全部在 host 上完成，输出布局与 GPU 路径一致
+        void cpu_worker(shared_ptr<TRT::Infer> model, promise<bool>& result){
+
+            const int MAX_IMAGE_BBOX  = max_objects_;
+            const int NUM_BOX_ELEMENT = 7;   // left, top, right, bottom, confidence, class, keepflag
+
+            int max_batch_size = model->get_max_batch_size();
+            auto input = model->input();
+            auto output = model->output();
+            input_width_  = input->shape(3);
+            input_height_ = input->shape(2);
+            stream_       = nullptr;
+            cpu_backend_  = true;
+            tensor_allocator_.reset(new TensorAllocator(max_batch_size * 2));
+
+            result.set_value(true);
+
+            input->resize_single_dim(0, max_batch_size).to_cpu();
+            vector<float> output_array(1 + MAX_IMAGE_BBOX * NUM_BOX_ELEMENT);
+
+            vector<Job> fetch_jobs;
+            while(get_jobs_and_wait(fetch_jobs, max_batch_size)){
+                TRACE_SCOPE("worker");
+                int infer_batch_size = fetch_jobs.size();
+                input->resize_single_dim(0, infer_batch_size);
+
+                for(int ibatch = 0; ibatch < infer_batch_size; ++ibatch){
+                    auto& job = fetch_jobs[ibatch];
+                    auto& mono_tensor = job.mono_tensor->data();
+                    input->copy_from_cpu(input->offset(ibatch), mono_tensor->cpu(), mono_tensor->count());
+                    job.mono_tensor->release();
+                }
+
+                bind_job_keys(model.get(), fetch_jobs);
+                model->forward(true);
+
+                for(int ibatch = 0; ibatch < infer_batch_size; ++ibatch){
+                    auto& job = fetch_jobs[ibatch];
+                    float* parray = output_array.data();
+                    decode_cpu_invoker(output->cpu<float>(ibatch), output->shape(1), confidence_threshold_,
+                                       job.additional.d2i, parray, MAX_IMAGE_BBOX);
+
+                    int count = min(MAX_IMAGE_BBOX, (int)*parray);
+                    job.host_output.assign(parray, parray + 1 + count * NUM_BOX_ELEMENT);
+                    finish(std::move(job));
+                }
+                fetch_jobs.clear();
+            }
+            tensor_allocator_.reset();
+            INFO("Engine destroy.");
+        }
+
+        /// 解析 decode 的结果（counter + bboxes），postprocess_threads > 0 时在后处理线程上调用
+        void postprocess(Job& job) override{
+            const int NUM_BOX_ELEMENT = 7;   // left, top, right, bottom, confidence, class, keepflag
+            float* parray = job.host_output.data();
+            int count     = (job.host_output.size() - 1) / NUM_BOX_ELEMENT;
+            auto& image_based_boxes = job.output;
+            image_based_boxes.reserve(count);
+            for(int i = 0; i < count; ++i){
+                float* pbox  = parray + 1 + i * NUM_BOX_ELEMENT;
+                int label    = pbox[5];
+                int keepflag = pbox[6];
+                if(keepflag == 1){
+                    image_based_boxes.emplace_back(pbox[0], pbox[1], pbox[2], pbox[3], pbox[4], label);
+                }
+            }
+        }
+
+        /// 预处理线程在 commit 返回之后才读取图像，调用者可能复用同一块内存（比如 VideoCapture）
+        cv::Mat copy_input(const cv::Mat& image) override{
+            return image.clone();
+        }
+
+        const char* metrics_name() const override{
+            return "yolov10";
+        }
+
+        bool preprocess_cpu(Job& job, const cv::Mat& image){
+
+            auto& tensor = job.mono_tensor->data();
+            if(tensor == nullptr){
+                tensor = make_shared<TRT::Tensor>(nullptr, CPU_DEVICE_ID);
+                tensor->set_owner("yolov10.preprocess");
+            }
+
+            cv::Size input_size(input_width_, input_height_);
+            job.additional.compute(image.size(), input_size);
+            tensor->resize(1, 3, input_height_, input_width_);
+
+            CPUKernel::warp_affine_bilinear_and_normalize_plane(
+                    image.data,           image.cols * 3,       image.cols,       image.rows,
+                    tensor->cpu<float>(), input_width_,         input_height_,
+                    job.additional.d2i,   114,
+                    normalize_
+            );
+            return true;
+        }
+
         bool preprocess(Job& job, const cv::Mat& image) override{
             if(tensor_allocator_ == nullptr){
                 INFOE("tensor_allocator_ is nullptr.");
@@ -174,11 +279,13 @@ namespace YOLOV10{
                 return false;
             }
             // 向 allocator 申请一个 tensor
-            job.mono_tensor = tensor_allocator_->query();
-            if(job.mono_tensor == nullptr){
-                INFOE("Tensor allocator query failed.");
+            // 按 overload 策略申请，拒绝/超时返回空
+            job.mono_tensor = acquire_tensor(job);
+            if(job.mono_tensor == nullptr)
                 return false;
-            }
+
+            if(cpu_backend_)
+                return preprocess_cpu(job, image);
 
             CUDATools::AutoDevice auto_device(gpu_);
             auto& tensor = job.mono_tensor->data();
@@ -187,7 +294,9 @@ namespace YOLOV10{
             if(tensor == nullptr){
                 // not init
                 tensor = make_shared<TRT::Tensor>();
+                tensor->set_owner("yolov10.preprocess");
                 tensor->set_workspace(make_shared<TRT::MixMemory>()); // 新创建一个workspace
+                tensor->get_workspace()->set_owner("yolov10.preprocess");
 
                 if(use_multi_preprocess_stream_){
                     checkCudaRuntime(cudaStreamCreate(&preprocess_stream));
@@ -242,6 +351,18 @@ namespace YOLOV10{
             return ControllerImpl::commit(image);
         }
 
+        std::shared_future<BoxArray> commit(const cv::Mat& image, int stream_id) override{
+            return ControllerImpl::commit(image, stream_id);
+        }
+
+        void commit(const cv::Mat& image, ResultCallback callback) override{
+            ControllerImpl::commit(image, -1, std::move(callback));
+        }
+
+        void commit(const cv::Mat& image, int stream_id, ResultCallback callback) override{
+            ControllerImpl::commit(image, stream_id, std::move(callback));
+        }
+
     private:
         int input_width_            = 0;
         int input_height_           = 0;
@@ -250,20 +371,45 @@ namespace YOLOV10{
         int max_objects_            = 300;
         TRT::CUStream stream_       = nullptr;
         bool use_multi_preprocess_stream_ = false;
+        bool cpu_backend_           = false;
         CUDAKernel::Norm normalize_;
 
     };
 
+    /// 多副本：一个 Infer 句柄后面挂多个 InferImpl，见 default_replica_config
+    using ReplicaInferImpl = ReplicaInfer<Infer, cv::Mat, BoxArray, InferImpl>;
+
     shared_ptr<Infer> create_infer(
             const string& engine_file, int gpuid,
             float confidence_threshold, int max_objects,
             bool use_multi_preprocess_stream
     ) {
-        shared_ptr<InferImpl> instance(new InferImpl{});
-        if (!instance->startup(engine_file, gpuid, confidence_threshold,
-                               max_objects, use_multi_preprocess_stream)) {
-            instance.reset();
+        auto& replica = default_replica_config();
+        if (replica.num_replicas <= 1) {
+            shared_ptr<InferImpl> instance(new InferImpl{});
+            if (!instance->startup(engine_file, gpuid, confidence_threshold,
+                                   max_objects, use_multi_preprocess_stream)) {
+                instance.reset();
+            }
+            return instance;
         }
-        return instance;
+
+        // 多个副本：各自加载模型、创建 stream 和 worker 线程
+        vector<shared_ptr<InferImpl>> replicas;
+        for (int i = 0; i < replica.num_replicas; ++i) {
+            int id = replica.gpuids.empty() ? gpuid : replica.gpuids[i % replica.gpuids.size()];
+            shared_ptr<InferImpl> instance(new InferImpl{});
+            if (!instance->startup(engine_file, id, confidence_threshold,
+                                   max_objects, use_multi_preprocess_stream)) {
+                INFOE("Startup replica %d on device %d failed", i, id);
+                return nullptr;
+            }
+            replicas.emplace_back(instance);
+        }
+
+        shared_ptr<ReplicaInferImpl> pool(new ReplicaInferImpl{});
+        if (!pool->startup(replicas))
+            pool.reset();
+        return pool;
     }
 }
\ No newline at end of file
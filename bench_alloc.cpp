@@ -0,0 +1,41 @@
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+void bench_set_alloc_hooked();
+void bench_count_alloc();
+void bench_job_alloc(int num_frames);
+void bench_lapjv(int repeat);
+
+// Count heap allocations for the job_alloc / lapjv benches. The global operator new is replaced
+// only in this executable, libLinfer and pro keep the default allocator.
+void *operator new(size_t size)
+{
+    bench_count_alloc();
+    if (void *p = malloc(size == 0 ? 1 : size))
+        return p;
+    throw bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+// usage: ./bench_alloc [num_frames=100000] [lapjv_repeat=5]
+int main(int argc, char **argv)
+{
+    int num_frames = argc > 1 ? atoi(argv[1]) : 100000;
+    int repeat = argc > 2 ? atoi(argv[2]) : 5;
+    if (num_frames <= 0 || repeat <= 0)
+    {
+        fprintf(stderr, "usage: %s [num_frames] [lapjv_repeat]\n", argv[0]);
+        return 1;
+    }
+
+    // The counter sees every thread, run lapjv before job_alloc starts the controller's background threads
+    bench_set_alloc_hooked();
+    bench_lapjv(repeat);
+    bench_job_alloc(num_frames);
+    return 0;
+}
@@ -7,6 +7,13 @@
 #include "apps/yolo/yolo.hpp"
 #include "apps/yolop/yolop.hpp"
 #include "apps/rtdetr/rtdetr.hpp" // Include the header for RTDETR
+#include "trt_common/trt_infer.hpp"
+#include "trt_common/infer_controller.hpp"
+#include "trt_common/replica_pool.hpp"
+#include "trt_common/infer_metrics.hpp"
+#include "trt_common/trace.hpp"
+#include "trt_common/ilogger.hpp"
+#include "apps/bytetrack/keyframeTracker.h"
 
 using namespace std;
 
@@ -26,6 +33,21 @@ void inference_yolop(const string &engine_file, YoloP::Type type, int gpuid, con
 void performance_seg(const string &engine_file, int gpuid, const string &input_dir);
 void inference_seg(const string &engine_file, int gpuid, const string &input_img, const string &output_img_path);
 bool test_ptq();
+void bench_job_queue(int num_items);
+void bench_job_alloc(int num_frames);
+void bench_mix_memory(int num_frames);
+void bench_logger(int num_threads, int num_logs);
+void bench_warp_affine(int repeat);
+void bench_nms(int repeat);
+void bench_decode(int repeat, int num_threads);
+void bench_tracker(int num_frames, int num_objects, const string &replay_file);
+void bench_tracker_soak(long long num_frames, int num_objects);
+void bench_tracker_classes(int num_frames, int num_objects, int num_classes);
+void bench_tracker_streams(int num_streams, int num_frames, int num_objects, int num_threads);
+void bench_tracker_gating(int num_frames, int num_objects);
+void bench_tracker_keyframe(int num_frames, int num_objects, float detect_ms);
+void bench_kalman(int repeat);
+void bench_lapjv(int repeat);
 
 // Helper function to convert string to Yolo::Type
 Yolo::Type stringToYoloType(const string &typeStr)
@@ -51,6 +73,69 @@ YoloP::Type stringToYoloPType(const string &typeStr)
     throw std::runtime_error("Unknown YoloP type: " + typeStr);
 }
 
+// Helper function to convert string to iLogger::LogLevel
+iLogger::LogLevel stringToLogLevel(const string &levelStr)
+{
+    if (levelStr == "debug") return iLogger::LogLevel::Debug;
+    if (levelStr == "verbo") return iLogger::LogLevel::Verbose;
+    if (levelStr == "info") return iLogger::LogLevel::Info;
+    if (levelStr == "warn") return iLogger::LogLevel::Warning;
+    if (levelStr == "error") return iLogger::LogLevel::Error;
+    if (levelStr == "fatal") return iLogger::LogLevel::Fatal;
+    throw std::runtime_error("Unknown log level: " + levelStr);
+}
+
+// Helper function to apply the runtime keys of a config node:
+// "backend" / "cpu_threads" / "cpu_max_batch_size" / "capture" / "max_batch_size" / "max_queue_delay_us" /
+// "overload_policy" / "block_timeout_ms" / "replicas" / "replica_gpuids" /
+// "preprocess_threads" / "postprocess_threads" / "pipeline_queue_size" /
+// "max_detect_interval" / "detect_uncertainty" / "detect_motion"
+void applyRuntimeConfig(const YAML::Node &node)
+{
+    if (node["backend"])
+    {
+        TRT::Backend backend;
+        string backend_str = node["backend"].as<string>();
+        if (!TRT::parse_backend(backend_str, backend))
+            throw std::runtime_error("Unknown backend: " + backend_str);
+        TRT::set_default_backend(backend);
+    }
+    if (node["cpu_threads"])
+        TRT::set_cpu_num_threads(node["cpu_threads"].as<int>());
+    if (node["cpu_max_batch_size"])
+        TRT::set_cpu_max_batch_size(node["cpu_max_batch_size"].as<int>());
+    if (node["capture"])
+        TRT::set_capture_enabled(node["capture"].as<bool>());
+    if (node["max_batch_size"])
+        default_batching_config().max_batch_size = node["max_batch_size"].as<int>();
+    if (node["max_queue_delay_us"])
+        default_batching_config().max_queue_delay_us = node["max_queue_delay_us"].as<int>();
+    if (node["overload_policy"])
+    {
+        string policy_str = node["overload_policy"].as<string>();
+        if (!parse_overload_policy(policy_str, default_overload_config().policy))
+            throw std::runtime_error("Unknown overload policy: " + policy_str);
+    }
+    if (node["block_timeout_ms"])
+        default_overload_config().block_timeout_ms = node["block_timeout_ms"].as<int>();
+    if (node["replicas"])
+        default_replica_config().num_replicas = node["replicas"].as<int>();
+    if (node["replica_gpuids"])
+        default_replica_config().gpuids = node["replica_gpuids"].as<vector<int>>();
+    if (node["preprocess_threads"])
+        default_pipeline_config().preprocess_threads = node["preprocess_threads"].as<int>();
+    if (node["postprocess_threads"])
+        default_pipeline_config().postprocess_threads = node["postprocess_threads"].as<int>();
+    if (node["pipeline_queue_size"])
+        default_pipeline_config().queue_size = node["pipeline_queue_size"].as<int>();
+    if (node["max_detect_interval"])
+        default_keyframe_config().max_detect_interval = node["max_detect_interval"].as<int>();
+    if (node["detect_uncertainty"])
+        default_keyframe_config().detect_uncertainty = node["detect_uncertainty"].as<float>();
+    if (node["detect_motion"])
+        default_keyframe_config().detect_motion = node["detect_motion"].as<float>();
+}
+
 int main(int argc, char *argv[])
 {
     if (argc != 2)
@@ -60,6 +145,7 @@ int main(int argc, char *argv[])
     }
 
     const string config_file_path = argv[1];
+    string trace_file;
 
     try
     {
@@ -71,6 +157,59 @@ int main(int argc, char *argv[])
             return 1;
         }
 
+        applyRuntimeConfig(config);
+        const TRT::Backend global_backend = TRT::get_default_backend();
+        const bool global_capture = TRT::is_capture_enabled();
+        const BatchingConfig global_batching = default_batching_config();
+        const OverloadConfig global_overload = default_overload_config();
+        const ReplicaConfig global_replica = default_replica_config();
+        const PipelineConfig global_pipeline = default_pipeline_config();
+        const KeyframeConfig global_keyframe = default_keyframe_config();
+
+        // Process-wide only: buffers keep the allocator they were created with
+        if (config["memory_allocator"])
+        {
+            string allocator_str = config["memory_allocator"].as<string>();
+            if (allocator_str == "system")
+                TRT::set_memory_allocator(TRT::create_system_allocator());
+            else if (allocator_str != "caching")
+                throw std::runtime_error("Unknown memory allocator: " + allocator_str);
+        }
+        const bool memory_report = config["memory_report"] && config["memory_report"].as<bool>();
+
+        // Process-wide only: logger level, files and rotation
+        if (config["log_level"])
+            iLogger::set_logger_level(stringToLogLevel(config["log_level"].as<string>()));
+        if (config["log_async"])
+            iLogger::set_logger_async(config["log_async"].as<bool>());
+        if (config["log_rotate_mb"] || config["log_rotate_minutes"])
+        {
+            double rotate_mb = config["log_rotate_mb"] ? config["log_rotate_mb"].as<double>() : 0;
+            int rotate_minutes = config["log_rotate_minutes"] ? config["log_rotate_minutes"].as<int>() : 0;
+            iLogger::set_logger_rotate((size_t)(rotate_mb * 1024 * 1024), rotate_minutes * 60);
+        }
+        if (config["log_dir"])
+            iLogger::set_logger_save_directory(config["log_dir"].as<string>());
+
+        // Process-wide only: per-stage latency of every controller in Prometheus text format
+        if (config["metrics_file"])
+        {
+            int interval_ms = config["metrics_interval_ms"] ? config["metrics_interval_ms"].as<int>() : 5000;
+            if (!start_metrics_dump(config["metrics_file"].as<string>(), interval_ms))
+                throw std::runtime_error("Invalid metrics_file / metrics_interval_ms");
+        }
+
+        // Process-wide only: spans of all threads, saved as Chrome trace JSON when the tasks are done
+        if (config["trace_file"])
+        {
+            trace_file = config["trace_file"].as<string>();
+#ifndef LINFER_WITH_TRACE
+            cerr << "Warning: trace_file is set but the build has no trace spans (cmake -DUSE_TRACE=ON)" << endl;
+#endif
+            Trace::start(config["trace_max_events"] ? config["trace_max_events"].as<int>() : 1 << 16);
+            TRACE_THREAD_NAME("main");
+        }
+
         for (const auto &task_node : config["tasks"])
         {
             string task_name = task_node["task"].as<string>();
@@ -86,6 +225,16 @@ int main(int argc, char *argv[])
             {
                 string subtask_type = subtask_node["type"].as<string>();
 
+                // A subtask may override the global runtime settings
+                TRT::set_default_backend(global_backend);
+                TRT::set_capture_enabled(global_capture);
+                default_batching_config() = global_batching;
+                default_overload_config() = global_overload;
+                default_replica_config() = global_replica;
+                default_pipeline_config() = global_pipeline;
+                default_keyframe_config() = global_keyframe;
+                applyRuntimeConfig(subtask_node);
+
                 cout << "  Subtask: " << subtask_type << endl;
                 if (task_name == "rtdetr")
                 {
@@ -231,24 +380,129 @@ int main(int argc, char *argv[])
                         cerr << "  Error: Unknown subtask type for seg: " << subtask_type << endl;
                     }
                 }
+                else if (task_name == "bench")
+                {
+                    if (subtask_type == "job_queue")
+                    {
+                        int num_items = subtask_node["num_items"] ? subtask_node["num_items"].as<int>() : 1 << 20;
+                        bench_job_queue(num_items);
+                    }
+                    else if (subtask_type == "job_alloc")
+                    {
+                        int num_frames = subtask_node["num_frames"] ? subtask_node["num_frames"].as<int>() : 100000;
+                        bench_job_alloc(num_frames);
+                    }
+                    else if (subtask_type == "memory")
+                    {
+                        int num_frames = subtask_node["num_frames"] ? subtask_node["num_frames"].as<int>() : 20000;
+                        bench_mix_memory(num_frames);
+                    }
+                    else if (subtask_type == "logger")
+                    {
+                        int num_threads = subtask_node["num_threads"] ? subtask_node["num_threads"].as<int>() : 32;
+                        int num_logs = subtask_node["num_logs"] ? subtask_node["num_logs"].as<int>() : 20000;
+                        bench_logger(num_threads, num_logs);
+                    }
+                    else if (subtask_type == "warp_affine")
+                    {
+                        int repeat = subtask_node["repeat"] ? subtask_node["repeat"].as<int>() : 50;
+                        bench_warp_affine(repeat);
+                    }
+                    else if (subtask_type == "nms")
+                    {
+                        int repeat = subtask_node["repeat"] ? subtask_node["repeat"].as<int>() : 10;
+                        bench_nms(repeat);
+                    }
+                    else if (subtask_type == "decode")
+                    {
+                        int repeat = subtask_node["repeat"] ? subtask_node["repeat"].as<int>() : 50;
+                        int num_threads = subtask_node["num_threads"] ? subtask_node["num_threads"].as<int>() : 4;
+                        bench_decode(repeat, num_threads);
+                    }
+                    else if (subtask_type == "tracker")
+                    {
+                        int num_frames = subtask_node["num_frames"] ? subtask_node["num_frames"].as<int>() : 1000;
+                        int num_objects = subtask_node["num_objects"] ? subtask_node["num_objects"].as<int>() : 500;
+                        string replay_file = subtask_node["replay_file"] ? subtask_node["replay_file"].as<string>() : "";
+                        bench_tracker(num_frames, num_objects, replay_file);
+                    }
+                    else if (subtask_type == "tracker_soak")
+                    {
+                        long long num_frames = subtask_node["num_frames"] ? subtask_node["num_frames"].as<long long>() : 10000000;
+                        int num_objects = subtask_node["num_objects"] ? subtask_node["num_objects"].as<int>() : 20;
+                        bench_tracker_soak(num_frames, num_objects);
+                    }
+                    else if (subtask_type == "tracker_classes")
+                    {
+                        int num_frames = subtask_node["num_frames"] ? subtask_node["num_frames"].as<int>() : 1000;
+                        int num_objects = subtask_node["num_objects"] ? subtask_node["num_objects"].as<int>() : 500;
+                        int num_classes = subtask_node["num_classes"] ? subtask_node["num_classes"].as<int>() : 80;
+                        bench_tracker_classes(num_frames, num_objects, num_classes);
+                    }
+                    else if (subtask_type == "tracker_streams")
+                    {
+                        int num_streams = subtask_node["num_streams"] ? subtask_node["num_streams"].as<int>() : 64;
+                        int num_frames = subtask_node["num_frames"] ? subtask_node["num_frames"].as<int>() : 500;
+                        int num_objects = subtask_node["num_objects"] ? subtask_node["num_objects"].as<int>() : 50;
+                        int num_threads = subtask_node["num_threads"] ? subtask_node["num_threads"].as<int>() : -1;
+                        bench_tracker_streams(num_streams, num_frames, num_objects, num_threads);
+                    }
+                    else if (subtask_type == "tracker_gating")
+                    {
+                        int num_frames = subtask_node["num_frames"] ? subtask_node["num_frames"].as<int>() : 1000;
+                        int num_objects = subtask_node["num_objects"] ? subtask_node["num_objects"].as<int>() : 300;
+                        bench_tracker_gating(num_frames, num_objects);
+                    }
+                    else if (subtask_type == "tracker_keyframe")
+                    {
+                        int num_frames = subtask_node["num_frames"] ? subtask_node["num_frames"].as<int>() : 1000;
+                        int num_objects = subtask_node["num_objects"] ? subtask_node["num_objects"].as<int>() : 100;
+                        float detect_ms = subtask_node["detect_ms"] ? subtask_node["detect_ms"].as<float>() : 10;
+                        bench_tracker_keyframe(num_frames, num_objects, detect_ms);
+                    }
+                    else if (subtask_type == "kalman")
+                    {
+                        int repeat = subtask_node["repeat"] ? subtask_node["repeat"].as<int>() : 20;
+                        bench_kalman(repeat);
+                    }
+                    else if (subtask_type == "lapjv")
+                    {
+                        int repeat = subtask_node["repeat"] ? subtask_node["repeat"].as<int>() : 5;
+                        bench_lapjv(repeat);
+                    }
+                    else
+                    {
+                        cerr << "  Error: Unknown subtask type for bench: " << subtask_type << endl;
+                    }
+                }
                 else
                 {
                     cerr << "  Error: Unknown task: " << task_name << endl;
                 }
             }
+            if (memory_report)
+                cout << "Memory by owner:" << TRT::memory_stats_string() << endl;
             cout << endl;
         }
     }
     catch (const YAML::Exception &e)
     {
         cerr << "Error parsing YAML file: " << e.what() << endl;
+        stop_metrics_dump();
         return 1;
     }
     catch (const std::runtime_error &e)
     {
         cerr << "Error: " << e.what() << endl;
+        stop_metrics_dump();
         return 1;
     }
 
+    stop_metrics_dump();
+    if (!trace_file.empty())
+    {
+        Trace::stop();
+        Trace::save(trace_file);
+    }
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,365 @@
+
+/// CPU 后端：用 ONNX Runtime 在 CPU 线程上执行 ONNX 模型
+/// 对外同样是 TRT::Infer 接口，输入输出依旧是 TRT::Tensor（CPU_DEVICE_ID，纯 host 内存），
+/// binding 顺序、动态维度（batch 维度先设为 1）以及 run_dims 语义与 TensorRT 后端保持一致
+
+#include "trt_infer.hpp"
+#include <thread>
+#include <cstring>
+#include <algorithm>
+#include "ilogger.hpp"
+#include "trace.hpp"
+
+#ifdef LINFER_WITH_ONNXRUNTIME
+#include <onnxruntime_cxx_api.h>
+#endif
+
+using namespace std;
+
+namespace TRT {
+
+    static int g_cpu_num_threads    = 0;
+    static int g_cpu_max_batch_size = 16;
+
+    void set_cpu_num_threads(int num_threads){
+        g_cpu_num_threads = max(0, num_threads);
+    }
+
+    void set_cpu_max_batch_size(int max_batch_size){
+        g_cpu_max_batch_size = max(1, max_batch_size);
+    }
+
+#ifdef LINFER_WITH_ONNXRUNTIME
+
+    static Ort::Env& ort_env(){
+        // 每个进程只需要一个 Env
+        static Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "Linfer");
+        return env;
+    }
+
+    class CPUInferImpl : public Infer {
+    public:
+        bool load(const string& file);
+        void forward(bool sync) override;
+        std::shared_ptr<Tensor> input(int index) override;
+        std::shared_ptr<Tensor> output(int index) override;
+        std::shared_ptr<Tensor> tensor(const std::string& name) override;
+        void set_input(int index, std::shared_ptr<Tensor> tensor) override;
+        void set_output(int index, std::shared_ptr<Tensor> tensor) override;
+        bool has_dynamic_dim() override;
+        std::vector<int> run_dims(const std::string &name) override;
+        std::vector<int> run_dims(int ibinding) override;
+        std::vector<int> static_dims(const std::string &name) override;
+        std::vector<int> static_dims(int ibinding) override;
+        bool set_run_dims(const std::string &name, const std::vector<int> &dims) override;
+        bool set_run_dims(int ibinding, const std::vector<int> &dims) override;
+        int num_bindings() override;
+        int num_input() override;
+        int num_output() override;
+        std::string get_input_name(int index) override;
+        std::string get_output_name(int index) override;
+        bool is_input_name(const std::string& name) override;
+        bool is_output_name(const std::string& name) override;
+        bool is_input(int ibinding) override;
+        void print() override;
+        void set_stream(CUStream stream) override {}
+        CUStream get_stream() override { return nullptr; }
+        int get_max_batch_size() override;
+        void synchronize() override {}
+        int device() override { return CPU_DEVICE_ID; }
+        size_t get_device_memory_size() override { return 0; }
+        std::shared_ptr<MixMemory> get_workspace() override { return workspace_; }
+
+    private:
+        unique_ptr<Ort::Session> session_;
+        Ort::MemoryInfo memory_info_{Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault)};
+        int num_threads_ = 0;
+
+        vector<shared_ptr<Tensor>> inputs_;
+        vector<shared_ptr<Tensor>> outputs_;
+        vector<string> inputs_names_;
+        vector<string> outputs_names_;
+        vector<const char*> inputs_names_ptr_;
+        vector<const char*> outputs_names_ptr_;
+        // binding 顺序：先全部输入，再全部输出
+        vector<vector<int>> static_dims_;
+        vector<vector<int>> run_dims_;
+        map<string, int> Blobs_name_mapper_;
+        shared_ptr<MixMemory> workspace_;
+    };
+
+    bool CPUInferImpl::load(const string& file) {
+        try{
+            num_threads_ = g_cpu_num_threads > 0 ? g_cpu_num_threads : (int)thread::hardware_concurrency();
+
+            Ort::SessionOptions options;
+            options.SetIntraOpNumThreads(num_threads_);
+            options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+            session_.reset(new Ort::Session(ort_env(), file.c_str(), options));
+        }catch(const Ort::Exception& e){
+            INFOE("Load onnx model failed: %s, %s", file.c_str(), e.what());
+            return false;
+        }
+
+        workspace_.reset(new MixMemory{CPU_DEVICE_ID});
+        Ort::AllocatorWithDefaultOptions allocator;
+
+        auto add_binding = [&](const string& name, Ort::TypeInfo type_info, bool is_input){
+            auto info = type_info.GetTensorTypeAndShapeInfo();
+            if(info.GetElementType() != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT){
+                INFOE("Binding '%s' is not float32, unsupported by CPU backend", name.c_str());
+                return false;
+            }
+
+            auto shape = info.GetShape();
+            vector<int> dims(shape.begin(), shape.end());
+            vector<int> setup_dims = dims;
+            // 和 TensorRT 后端一致：动态维度先设置为 1
+            for(auto& d : setup_dims)
+                if(d < 0) d = 1;
+
+            auto newTensor = make_shared<Tensor>(setup_dims, nullptr, CPU_DEVICE_ID);
+            newTensor->set_workspace(workspace_);
+            if(is_input){
+                inputs_.push_back(newTensor);
+                inputs_names_.push_back(name);
+            }else{
+                outputs_.push_back(newTensor);
+                outputs_names_.push_back(name);
+            }
+            Blobs_name_mapper_[name] = static_dims_.size();
+            static_dims_.push_back(dims);
+            run_dims_.push_back(setup_dims);
+            return true;
+        };
+
+        size_t ninput  = session_->GetInputCount();
+        size_t noutput = session_->GetOutputCount();
+        for(size_t i = 0; i < ninput; ++i){
+            auto name = session_->GetInputNameAllocated(i, allocator);
+            if(!add_binding(name.get(), session_->GetInputTypeInfo(i), true))
+                return false;
+        }
+
+        for(size_t i = 0; i < noutput; ++i){
+            auto name = session_->GetOutputNameAllocated(i, allocator);
+            if(!add_binding(name.get(), session_->GetOutputTypeInfo(i), false))
+                return false;
+        }
+
+        for(auto& name : inputs_names_)  inputs_names_ptr_.push_back(name.c_str());
+        for(auto& name : outputs_names_) outputs_names_ptr_.push_back(name.c_str());
+        return true;
+    }
+
+    void CPUInferImpl::forward(bool sync) {
+        TRACE_SCOPE("forward");
+        int inputBatchSize = inputs_[0]->shape(0);
+
+        vector<Ort::Value> input_values;
+        input_values.reserve(inputs_.size());
+        for(int i = 0; i < inputs_.size(); ++i){
+            auto& tensor = inputs_[i];
+            run_dims_[i] = tensor->dims();
+            vector<int64_t> shape(tensor->dims().begin(), tensor->dims().end());
+            input_values.emplace_back(Ort::Value::CreateTensor<float>(
+                memory_info_, tensor->cpu<float>(), tensor->count(), shape.data(), shape.size()));
+        }
+
+        // 输出的形状如果可以确定（只有 batch 维度是动态的），则直接写入 output Tensor，避免一次拷贝
+        vector<Ort::Value> output_values;
+        vector<bool> output_bound(outputs_.size(), false);
+        for(int i = 0; i < outputs_.size(); ++i){
+            auto dims = static_dims_[inputs_.size() + i];
+            if(!dims.empty() && dims[0] < 0) dims[0] = inputBatchSize;
+
+            bool known = all_of(dims.begin(), dims.end(), [](int d){ return d >= 0; });
+            if(!known){
+                output_values.emplace_back(nullptr);
+                continue;
+            }
+
+            auto& tensor = outputs_[i];
+            tensor->resize(dims);
+            vector<int64_t> shape(dims.begin(), dims.end());
+            output_values.emplace_back(Ort::Value::CreateTensor<float>(
+                memory_info_, tensor->cpu<float>(), tensor->count(), shape.data(), shape.size()));
+            output_bound[i] = true;
+        }
+
+        try{
+            session_->Run(Ort::RunOptions{nullptr},
+                          inputs_names_ptr_.data(), input_values.data(), input_values.size(),
+                          outputs_names_ptr_.data(), output_values.data(), output_values.size());
+        }catch(const Ort::Exception& e){
+            INFOE("CPU forward failed: %s", e.what());
+            return;
+        }
+
+        for(int i = 0; i < outputs_.size(); ++i){
+            auto& tensor = outputs_[i];
+            if(!output_bound[i]){
+                auto shape = output_values[i].GetTensorTypeAndShapeInfo().GetShape();
+                tensor->resize(vector<int>(shape.begin(), shape.end()));
+                memcpy(tensor->cpu<float>(), output_values[i].GetTensorData<float>(), tensor->bytes());
+            }
+            run_dims_[inputs_.size() + i] = tensor->dims();
+        }
+    }
+
+    std::shared_ptr<Tensor> CPUInferImpl::input(int index) {
+        if(index < 0 || index >= inputs_.size())
+            INFOF("Input index[%d] out of range [size=%d]", index, inputs_.size());
+        return inputs_[index];
+    }
+
+    std::shared_ptr<Tensor> CPUInferImpl::output(int index) {
+        if(index < 0 || index >= outputs_.size())
+            INFOF("Output index[%d] out of range [size=%d]", index, outputs_.size());
+        return outputs_[index];
+    }
+
+    std::shared_ptr<Tensor> CPUInferImpl::tensor(const string &name) {
+        auto node = Blobs_name_mapper_.find(name);
+        if(node == Blobs_name_mapper_.end())
+            INFOF("Could not find the input/output node '%s', please check your model.", name.c_str());
+
+        int ibinding = node->second;
+        if(ibinding < inputs_.size())
+            return inputs_[ibinding];
+        return outputs_[ibinding - inputs_.size()];
+    }
+
+    void CPUInferImpl::set_input(int index, std::shared_ptr<Tensor> tensor) {
+        if(index < 0 || index >= inputs_.size()){
+            INFOF("Input index[%d] out of range [size=%d]", index, inputs_.size());
+        }
+        inputs_[index] = tensor;
+    }
+
+    void CPUInferImpl::set_output(int index, std::shared_ptr<Tensor> tensor) {
+        if(index < 0 || index >= outputs_.size()){
+            INFOF("Output index[%d] out of range [size=%d]", index, outputs_.size());
+        }
+        outputs_[index] = tensor;
+    }
+
+    bool CPUInferImpl::has_dynamic_dim() {
+        for(auto& dims : static_dims_){
+            for(int d : dims)
+                if(d < 0) return true;
+        }
+        return false;
+    }
+
+    std::vector<int> CPUInferImpl::run_dims(const std::string &name) {
+        return run_dims(Blobs_name_mapper_[name]);
+    }
+
+    std::vector<int> CPUInferImpl::run_dims(int ibinding) {
+        return run_dims_[ibinding];
+    }
+
+    std::vector<int> CPUInferImpl::static_dims(const std::string &name) {
+        return static_dims(Blobs_name_mapper_[name]);
+    }
+
+    std::vector<int> CPUInferImpl::static_dims(int ibinding) {
+        return static_dims_[ibinding];
+    }
+
+    bool CPUInferImpl::set_run_dims(const std::string &name, const std::vector<int> &dims) {
+        return this->set_run_dims(Blobs_name_mapper_[name], dims);
+    }
+
+    bool CPUInferImpl::set_run_dims(int ibinding, const std::vector<int> &dims) {
+        if(ibinding < 0 || ibinding >= inputs_.size()){
+            INFOE("set_run_dims only supports input binding, got %d", ibinding);
+            return false;
+        }
+
+        auto& static_dim = static_dims_[ibinding];
+        if(dims.size() != static_dim.size()) return false;
+        for(int i = 0; i < dims.size(); ++i){
+            if(static_dim[i] >= 0 && static_dim[i] != dims[i])
+                return false;
+        }
+        run_dims_[ibinding] = dims;
+        inputs_[ibinding]->resize(dims);
+        return true;
+    }
+
+    int CPUInferImpl::num_bindings() {
+        return static_dims_.size();
+    }
+
+    int CPUInferImpl::num_input() {
+        return inputs_.size();
+    }
+
+    int CPUInferImpl::num_output() {
+        return outputs_.size();
+    }
+
+    std::string CPUInferImpl::get_input_name(int index) {
+        if(index < 0 || index >= inputs_names_.size())
+            INFOF("Input index[%d] out of range [size=%d]", index, inputs_names_.size());
+        return inputs_names_[index];
+    }
+
+    std::string CPUInferImpl::get_output_name(int index) {
+        if(index < 0 || index >= outputs_names_.size())
+            INFOF("Output index[%d] out of range [size=%d]", index, outputs_names_.size());
+        return outputs_names_[index];
+    }
+
+    bool CPUInferImpl::is_input_name(const string &name) {
+        return find(inputs_names_.begin(), inputs_names_.end(), name) != inputs_names_.end();
+    }
+
+    bool CPUInferImpl::is_output_name(const string &name) {
+        return find(outputs_names_.begin(), outputs_names_.end(), name) != outputs_names_.end();
+    }
+
+    bool CPUInferImpl::is_input(int ibinding) {
+        return ibinding >= 0 && ibinding < inputs_.size();
+    }
+
+    int CPUInferImpl::get_max_batch_size() {
+        int batch = static_dims_.empty() || static_dims_[0].empty() ? 1 : static_dims_[0][0];
+        return batch > 0 ? batch : g_cpu_max_batch_size;
+    }
+
+    void CPUInferImpl::print() {
+        INFO(" Infer %p detail", this);
+        INFO("\tBase device: CPU [%d threads]", num_threads_);
+        INFO("\tMax Batch Size: %d", this->get_max_batch_size());
+        INFO("\tInputs: %d", inputs_.size());
+        for(int i = 0; i < inputs_.size(); ++i){
+            auto& tensor = inputs_[i];
+            auto& name = inputs_names_[i];
+            INFO("\t\t%d.%s : shape {%s}", i, name.c_str(), tensor->shape_string());
+        }
+        INFO("\tOutputs: %d", outputs_.size());
+        for(int i = 0; i < outputs_.size(); ++i){
+            auto& tensor = outputs_[i];
+            auto& name = outputs_names_[i];
+            INFO("\t\t%d.%s : shape {%s}", i, name.c_str(), tensor->shape_string());
+        }
+    }
+
+    shared_ptr<Infer> load_cpu_infer(const string& file){
+        shared_ptr<CPUInferImpl> instance{new CPUInferImpl{}};
+        if(!instance->load(file)) instance.reset();
+        return instance;
+    }
+
+#else
+
+    shared_ptr<Infer> load_cpu_infer(const string& file){
+        INFOE("CPU backend is not available, rebuild with -DUSE_ONNXRUNTIME=ON to load %s", file.c_str());
+        return nullptr;
+    }
+
+#endif // LINFER_WITH_ONNXRUNTIME
+}
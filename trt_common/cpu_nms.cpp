@@ -0,0 +1,342 @@
+#include "cpu_nms.hpp"
+#include <cmath>
+#include <atomic>
+#include <limits>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPU_NMS_X86
+#endif
+
+using namespace std;
+
+namespace NMS{
+
+    static atomic<bool> g_simd_enabled{true};
+
+    struct Query{
+        float left, top, right, bottom, area;
+    };
+
+    /// q 与 list 中 [begin, end) 的 IoU（diou 时减去中心距离惩罚），写入 output[0, end - begin)
+    /// 与原来 Yolo::iou 的运算顺序相同：union = area(list) + area(q) - cross，cross 或 union 为 0 时 IoU 为 0
+    template<class List>
+    static void iou_scalar(const List& list, int begin, int end, const Query& q, bool diou, float* output){
+        for(int i = begin; i < end; ++i){
+            float cross_left   = max(list.left[i],   q.left);
+            float cross_top    = max(list.top[i],    q.top);
+            float cross_right  = min(list.right[i],  q.right);
+            float cross_bottom = min(list.bottom[i], q.bottom);
+            float cross_area   = max(0.0f, cross_right - cross_left) * max(0.0f, cross_bottom - cross_top);
+            float union_area   = list.area[i] + q.area - cross_area;
+            float value        = (cross_area == 0.f || union_area == 0.f) ? 0.0f : cross_area / union_area;
+
+            if(diou){
+                float dx = (list.left[i] + list.right[i]) * 0.5f - (q.left + q.right) * 0.5f;
+                float dy = (list.top[i] + list.bottom[i]) * 0.5f - (q.top + q.bottom) * 0.5f;
+                float cw = max(list.right[i], q.right) - min(list.left[i], q.left);
+                float ch = max(list.bottom[i], q.bottom) - min(list.top[i], q.top);
+                float diagonal = cw * cw + ch * ch;
+                if(diagonal > 0) value -= (dx * dx + dy * dy) / diagonal;
+            }
+            output[i - begin] = value;
+        }
+    }
+
+#ifdef CPU_NMS_X86
+
+    template<class List>
+    __attribute__((target("avx2")))
+    static void iou_avx2(const List& list, int begin, int end, const Query& q, bool diou, float* output){
+
+        const __m256 zero    = _mm256_setzero_ps();
+        const __m256 half    = _mm256_set1_ps(0.5f);
+        const __m256 qleft   = _mm256_set1_ps(q.left);
+        const __m256 qtop    = _mm256_set1_ps(q.top);
+        const __m256 qright  = _mm256_set1_ps(q.right);
+        const __m256 qbottom = _mm256_set1_ps(q.bottom);
+        const __m256 qarea   = _mm256_set1_ps(q.area);
+        const __m256 qcx     = _mm256_set1_ps((q.left + q.right) * 0.5f);
+        const __m256 qcy     = _mm256_set1_ps((q.top + q.bottom) * 0.5f);
+
+        int i = begin;
+        for(; i + 8 <= end; i += 8){
+            __m256 left   = _mm256_loadu_ps(list.left.data() + i);
+            __m256 top    = _mm256_loadu_ps(list.top.data() + i);
+            __m256 right  = _mm256_loadu_ps(list.right.data() + i);
+            __m256 bottom = _mm256_loadu_ps(list.bottom.data() + i);
+
+            __m256 cross_w    = _mm256_max_ps(zero, _mm256_sub_ps(_mm256_min_ps(right, qright), _mm256_max_ps(left, qleft)));
+            __m256 cross_h    = _mm256_max_ps(zero, _mm256_sub_ps(_mm256_min_ps(bottom, qbottom), _mm256_max_ps(top, qtop)));
+            __m256 cross_area = _mm256_mul_ps(cross_w, cross_h);
+            __m256 union_area = _mm256_sub_ps(_mm256_add_ps(_mm256_loadu_ps(list.area.data() + i), qarea), cross_area);
+            __m256 invalid    = _mm256_or_ps(_mm256_cmp_ps(cross_area, zero, _CMP_EQ_OQ), _mm256_cmp_ps(union_area, zero, _CMP_EQ_OQ));
+
+            // 同一类别里大多数框互不相交，8 个都不相交时省掉除法
+            __m256 value = zero;
+            if(_mm256_movemask_ps(invalid) != 0xFF)
+                value = _mm256_andnot_ps(invalid, _mm256_div_ps(cross_area, union_area));
+
+            if(diou){
+                __m256 dx = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(left, right), half), qcx);
+                __m256 dy = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(top, bottom), half), qcy);
+                __m256 cw = _mm256_sub_ps(_mm256_max_ps(right, qright), _mm256_min_ps(left, qleft));
+                __m256 ch = _mm256_sub_ps(_mm256_max_ps(bottom, qbottom), _mm256_min_ps(top, qtop));
+                __m256 diagonal = _mm256_add_ps(_mm256_mul_ps(cw, cw), _mm256_mul_ps(ch, ch));
+                __m256 distance = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+                __m256 penalty  = _mm256_and_ps(_mm256_cmp_ps(diagonal, zero, _CMP_GT_OQ), _mm256_div_ps(distance, diagonal));
+                value = _mm256_sub_ps(value, penalty);
+            }
+            _mm256_storeu_ps(output + i - begin, value);
+        }
+
+        // 编译器不会在 target("avx2") 函数的出口插入 vzeroupper，回到 SSE 代码之后每条指令都会有切换的代价
+        _mm256_zeroupper();
+        iou_scalar(list, i, end, q, diou, output + i - begin);
+    }
+
+#endif // CPU_NMS_X86
+
+    bool is_simd_available(){
+#ifdef CPU_NMS_X86
+        static bool available = __builtin_cpu_supports("avx2");
+        return available;
+#else
+        return false;
+#endif
+    }
+
+    void set_simd_enabled(bool enabled){
+        g_simd_enabled = enabled;
+    }
+
+    template<class List>
+    static void compute_iou(const List& list, int begin, int end, const Query& q, bool diou, float* output){
+#ifdef CPU_NMS_X86
+        if(g_simd_enabled.load(memory_order_relaxed) && is_simd_available()){
+            iou_avx2(list, begin, end, q, diou, output);
+            return;
+        }
+#endif
+        iou_scalar(list, begin, end, q, diou, output);
+    }
+
+    static inline float box_area(float left, float top, float right, float bottom){
+        return max(0.0f, right - left) * max(0.0f, bottom - top);
+    }
+
+    void Suppressor::BoxList::clear(){
+        left.clear();  top.clear();  right.clear();  bottom.clear();  area.clear();  index.clear();
+        min_left   = min_top    = numeric_limits<float>::max();
+        max_right  = max_bottom = numeric_limits<float>::lowest();
+    }
+
+    void Suppressor::BoxList::push(float l, float t, float r, float b, int i){
+        left.push_back(l);
+        top.push_back(t);
+        right.push_back(r);
+        bottom.push_back(b);
+        area.push_back(box_area(l, t, r, b));
+        index.push_back(i);
+        min_left   = min(min_left, l);
+        min_top    = min(min_top, t);
+        max_right  = max(max_right, r);
+        max_bottom = max(max_bottom, b);
+    }
+
+    void Suppressor::clear(){
+        left_.clear();  top_.clear();  right_.clear();  bottom_.clear();
+        scores_.clear();  labels_.clear();
+    }
+
+    void Suppressor::reserve(int count){
+        left_.reserve(count);  top_.reserve(count);  right_.reserve(count);  bottom_.reserve(count);
+        scores_.reserve(count);  labels_.reserve(count);
+    }
+
+    void Suppressor::add(float left, float top, float right, float bottom, float score, int label){
+        left_.push_back(left);
+        top_.push_back(top);
+        right_.push_back(right);
+        bottom_.push_back(bottom);
+        scores_.push_back(score);
+        labels_.push_back(label);
+    }
+
+    /// 过滤 score_threshold，top_k 预筛选，按分数从高到低排序（分数相同时按 add 的顺序）
+    void Suppressor::sort_candidates(const Config& config){
+        order_.clear();
+        for(int i = 0; i < size(); ++i){
+            if(scores_[i] >= config.score_threshold)
+                order_.push_back(i);
+        }
+
+        auto greater = [this](int a, int b){
+            return scores_[a] > scores_[b] || (scores_[a] == scores_[b] && a < b);
+        };
+
+        if(config.top_k > 0 && order_.size() > (size_t)config.top_k){
+            nth_element(order_.begin(), order_.begin() + config.top_k, order_.end(), greater);
+            order_.resize(config.top_k);
+        }
+        sort(order_.begin(), order_.end(), greater);
+    }
+
+    /// bucket_of_[i] 为第 i 个框所在的桶，label 范围不大时直接用数组映射
+    void Suppressor::assign_buckets(const Config& config){
+        bucket_of_.resize(size());
+        if(config.class_agnostic || order_.empty()){
+            for(int i : order_) bucket_of_[i] = 0;
+            num_buckets_ = 1;
+        }else{
+            int min_label = labels_[order_[0]], max_label = min_label;
+            for(int i : order_){
+                min_label = min(min_label, labels_[i]);
+                max_label = max(max_label, labels_[i]);
+            }
+
+            if((int64_t)max_label - min_label < 4096){
+                for(int i : order_) bucket_of_[i] = labels_[i] - min_label;
+                num_buckets_ = max_label - min_label + 1;
+            }else{
+                unordered_map<int, int> label_to_bucket;
+                for(int i : order_){
+                    auto it = label_to_bucket.emplace(labels_[i], (int)label_to_bucket.size()).first;
+                    bucket_of_[i] = it->second;
+                }
+                num_buckets_ = label_to_bucket.size();
+            }
+        }
+
+        if(buckets_.size() < (size_t)num_buckets_)
+            buckets_.resize(num_buckets_);
+        for(int i = 0; i < num_buckets_; ++i)
+            buckets_[i].clear();
+    }
+
+    /// 候选框只和同一桶里已经保留的框比较，与"保留一个、删除后面所有重叠的"结果相同
+    void Suppressor::run_hard(const Config& config){
+        const bool diou      = config.mode == Mode::DIoU;
+        const float threshold = config.iou_threshold;
+
+        // threshold <= 0 时不相交的框也会被抑制，不能按外接范围跳过
+        const bool prune     = threshold > 0;
+        const int block      = 64;
+        if(ious_.size() < (size_t)block) ious_.resize(block);
+
+        for(int i : order_){
+            auto& kept = buckets_[bucket_of_[i]];
+            Query q{left_[i], top_[i], right_[i], bottom_[i], box_area(left_[i], top_[i], right_[i], bottom_[i])};
+
+            bool suppressed = false;
+            bool disjoint   = q.left > kept.max_right || q.right < kept.min_left || q.top > kept.max_bottom || q.bottom < kept.min_top;
+            if(!(prune && disjoint)){
+                // 分块计算，多数候选框会被排在前面的（分数更高的）框抑制，可以提前结束
+                for(int begin = 0; begin < kept.size() && !suppressed; begin += block){
+                    int end = min(kept.size(), begin + block);
+                    compute_iou(kept, begin, end, q, diou, ious_.data());
+                    for(int j = 0; j < end - begin; ++j){
+                        if(ious_[j] >= threshold){
+                            suppressed = true;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            if(suppressed) continue;
+            kept.push(q.left, q.top, q.right, q.bottom, i);
+            keep_.push_back(i);
+            if(config.max_det > 0 && keep_.size() >= (size_t)config.max_det)
+                break;
+        }
+    }
+
+    /// 每个桶内反复取出分数最高的框，衰减剩下的框，最后所有桶合并排序
+    void Suppressor::run_soft(const Config& config){
+        for(int i : order_){
+            buckets_[bucket_of_[i]].push(left_[i], top_[i], right_[i], bottom_[i], i);
+        }
+
+        const bool gaussian = config.mode == Mode::SoftGaussian;
+        for(int b = 0; b < num_buckets_; ++b){
+            auto& alive = buckets_[b];
+            int picked_in_bucket = 0;
+            while(alive.size() > 0){
+
+                // 分数最高的，相同时取 add 顺序靠前的
+                int best = 0;
+                for(int j = 1; j < alive.size(); ++j){
+                    int a = alive.index[j], c = alive.index[best];
+                    if(scores_[a] > scores_[c] || (scores_[a] == scores_[c] && a < c))
+                        best = j;
+                }
+
+                int index = alive.index[best];
+                keep_.push_back(index);
+                if(config.max_det > 0 && ++picked_in_bucket >= config.max_det)
+                    break;
+
+                Query q{alive.left[best], alive.top[best], alive.right[best], alive.bottom[best], alive.area[best]};
+
+                // 把选中的框换到末尾移除
+                int last = alive.size() - 1;
+                swap(alive.left[best], alive.left[last]);     alive.left.pop_back();
+                swap(alive.top[best], alive.top[last]);       alive.top.pop_back();
+                swap(alive.right[best], alive.right[last]);   alive.right.pop_back();
+                swap(alive.bottom[best], alive.bottom[last]); alive.bottom.pop_back();
+                swap(alive.area[best], alive.area[last]);     alive.area.pop_back();
+                swap(alive.index[best], alive.index[last]);   alive.index.pop_back();
+
+                int count = alive.size();
+                if(ious_.size() < (size_t)count) ious_.resize(count);
+                compute_iou(alive, 0, count, q, false, ious_.data());
+
+                int write = 0;
+                for(int j = 0; j < count; ++j){
+                    int k = alive.index[j];
+                    float iou = ious_[j];
+                    if(gaussian)
+                        scores_[k] *= expf(-iou * iou / config.soft_sigma);
+                    else if(iou >= config.iou_threshold)
+                        scores_[k] *= 1 - iou;
+
+                    if(scores_[k] < config.score_threshold || scores_[k] <= 0)
+                        continue;
+
+                    alive.left[write]   = alive.left[j];
+                    alive.top[write]    = alive.top[j];
+                    alive.right[write]  = alive.right[j];
+                    alive.bottom[write] = alive.bottom[j];
+                    alive.area[write]   = alive.area[j];
+                    alive.index[write]  = k;
+                    write++;
+                }
+                alive.left.resize(write);  alive.top.resize(write);  alive.right.resize(write);
+                alive.bottom.resize(write);  alive.area.resize(write);  alive.index.resize(write);
+            }
+        }
+
+        sort(keep_.begin(), keep_.end(), [this](int a, int b){
+            return scores_[a] > scores_[b] || (scores_[a] == scores_[b] && a < b);
+        });
+        if(config.max_det > 0 && keep_.size() > (size_t)config.max_det)
+            keep_.resize(config.max_det);
+    }
+
+    const vector<int>& Suppressor::run(const Config& config){
+        keep_.clear();
+        sort_candidates(config);
+        assign_buckets(config);
+
+        if(config.mode == Mode::SoftLinear || config.mode == Mode::SoftGaussian)
+            run_soft(config);
+        else
+            run_hard(config);
+        return keep_;
+    }
+
+}; // namespace NMS
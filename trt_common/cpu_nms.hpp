@@ -0,0 +1,98 @@
+#ifndef CPU_NMS_HPP
+#define CPU_NMS_HPP
+
+/// host 端的 NMS
+/// 候选框按分数从高到低逐个与同一类别已经保留的框比较，类别分桶之后不再做逐对的 label 判断；
+/// 已保留的框以 SoA 存放，x86 上用 AVX2 一次计算 8 个 IoU，和已保留框的外接范围不相交的候选框直接跳过
+/// 比较次数为 候选框数 x 保留框数，配合 max_det 不会随候选框数平方增长
+
+#include <vector>
+
+namespace NMS{
+
+    enum class Mode : int{
+        Hard         = 0,   // IoU >= iou_threshold 的框被抑制
+        DIoU         = 1,   // 同 Hard，判定用 IoU - 中心距离² / 外接框对角线²
+        SoftLinear   = 2,   // IoU >= iou_threshold 的框分数乘以 (1 - IoU)
+        SoftGaussian = 3    // 所有框分数乘以 exp(-IoU² / soft_sigma)
+    };
+
+    struct Config{
+        float iou_threshold   = 0.45f;
+        Mode mode             = Mode::Hard;
+        bool class_agnostic   = false;
+        float soft_sigma      = 0.5f;
+        float score_threshold = 0.0f;    // 分数低于它的框不参与；Soft-NMS 中衰减到它以下的框被丢弃，通常设为 0.001
+        int top_k             = 0;       // >0 时只对分数最高的 top_k 个候选框做 NMS
+        int max_det           = 0;       // >0 时最多保留 max_det 个框（所有类别合计）
+    };
+
+    /// 内部缓冲区只增不减，可以反复使用；一个实例同一时间只能在一个线程上使用
+    class Suppressor{
+    public:
+        void clear();
+        void reserve(int count);
+        void add(float left, float top, float right, float bottom, float score, int label);
+        int size() const{ return (int)labels_.size(); }
+
+        /// 返回保留下来的框在 add 顺序中的下标，按（衰减之后的）分数从高到低
+        const std::vector<int>& run(const Config& config);
+
+        /// run 之后第 i 个框的分数，Soft-NMS 时为衰减之后的分数
+        float score(int i) const{ return scores_[i]; }
+
+    private:
+        struct BoxList{
+            std::vector<float> left, top, right, bottom, area;
+            std::vector<int> index;
+            float min_left, min_top, max_right, max_bottom;
+
+            void clear();
+            void push(float l, float t, float r, float b, int i);
+            int size() const{ return (int)index.size(); }
+        };
+
+        void sort_candidates(const Config& config);
+        void assign_buckets(const Config& config);
+        void run_hard(const Config& config);
+        void run_soft(const Config& config);
+
+        std::vector<float> left_, top_, right_, bottom_, scores_;
+        std::vector<int> labels_;
+        std::vector<int> order_;
+        std::vector<int> bucket_of_;
+        std::vector<BoxList> buckets_;
+        std::vector<float> ious_;
+        std::vector<int> keep_;
+        int num_buckets_ = 0;
+    };
+
+    /// CPU 是否支持 AVX2
+    bool is_simd_available();
+
+    /// 默认开启，关闭之后使用标量实现，用于对比和验证
+    void set_simd_enabled(bool enabled);
+
+    /// Box 需要 left / top / right / bottom / confidence / label 成员（Yolo::Box、YoloP::Box 等）
+    /// 返回保留下来的框，按分数从高到低；Soft-NMS 时 confidence 为衰减之后的分数
+    template<class Box>
+    std::vector<Box> cpu_nms(const std::vector<Box>& boxes, const Config& config){
+        thread_local Suppressor suppressor;
+        suppressor.clear();
+        suppressor.reserve(boxes.size());
+        for(auto& box : boxes)
+            suppressor.add(box.left, box.top, box.right, box.bottom, box.confidence, box.label);
+
+        auto& keep = suppressor.run(config);
+        std::vector<Box> output;
+        output.reserve(keep.size());
+        for(int index : keep){
+            output.emplace_back(boxes[index]);
+            output.back().confidence = suppressor.score(index);
+        }
+        return output;
+    }
+
+}; // namespace NMS
+
+#endif // CPU_NMS_HPP
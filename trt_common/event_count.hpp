@@ -0,0 +1,69 @@
+/**
+ * EventCount
+ * 无锁数据结构的阻塞等待：条件满足时不碰 mutex，只有真正需要睡眠时才加锁
+ **/
+
+#ifndef EVENT_COUNT_HPP
+#define EVENT_COUNT_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+/// 等待/唤醒原语：等待方先 prepare_wait，再检查一次条件，条件不满足才 wait
+/// 唤醒方在改变条件之后 notify，没有等待者时 notify 只是一次原子读
+class EventCount{
+public:
+    uint64_t prepare_wait(){
+        num_waiters_.fetch_add(1, std::memory_order_seq_cst);
+        return epoch_.load(std::memory_order_seq_cst);
+    }
+
+    void cancel_wait(){
+        num_waiters_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    void wait(uint64_t key){
+        std::unique_lock<std::mutex> l(lock_);
+        cv_.wait(l, [&](){ return epoch_.load(std::memory_order_relaxed) != key; });
+        num_waiters_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    /// 返回 false 表示超时
+    template<class Clock, class Duration>
+    bool wait_until(uint64_t key, const std::chrono::time_point<Clock, Duration>& deadline){
+        std::unique_lock<std::mutex> l(lock_);
+        bool state = cv_.wait_until(l, deadline, [&](){ return epoch_.load(std::memory_order_relaxed) != key; });
+        num_waiters_.fetch_sub(1, std::memory_order_seq_cst);
+        return state;
+    }
+
+    /// 每次只多出一个元素/空位，唤醒一个就够了，避免惊群
+    void notify_one(){ notify(false); }
+    void notify_all(){ notify(true); }
+
+private:
+    void notify(bool all){
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(num_waiters_.load(std::memory_order_seq_cst) == 0)
+            return;
+
+        {
+            // 在锁内修改 epoch，保证等待方不会在检查 epoch 之后、睡眠之前错过唤醒
+            std::unique_lock<std::mutex> l(lock_);
+            epoch_.fetch_add(1, std::memory_order_seq_cst);
+        }
+        if(all) cv_.notify_all();
+        else    cv_.notify_one();
+    }
+
+private:
+    std::atomic<uint64_t> epoch_{0};
+    std::atomic<int> num_waiters_{0};
+    std::mutex lock_;
+    std::condition_variable cv_;
+};
+
+#endif // EVENT_COUNT_HPP
@@ -14,6 +14,9 @@
 #include <sstream>
 #include <stack>
 #include <functional>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <signal.h>
 #include <dirent.h>
 #include <sys/stat.h>
@@ -236,110 +239,343 @@ namespace iLogger{
         return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
     }
 
+    /// ----------------------------------- logger -----------------------------------
+
+    /// 单生产者（所属线程）单消费者（持有 drain_lock_ 的线程）的字节环形缓冲区
+    /// 一条记录为 RecordHeader + "[file:line]:message"，时间字符串、颜色由消费者生成
+    struct LogRing{
+        static const size_t CAPACITY = 64 * 1024;   // 2 的幂
+
+        struct RecordHeader{
+            uint32_t size;      // 消息的字节数
+            int32_t level;
+            int64_t time_us;    // system_clock
+        };
+
+        char data[CAPACITY];
+        atomic<uint64_t> head{0};     // 消费者读到的位置
+        atomic<uint64_t> tail{0};     // 生产者写到的位置
+        atomic<bool> alive{true};     // 所属线程已经退出时为 false，读空之后移除
+
+        size_t used() const{
+            return tail.load(memory_order_relaxed) - head.load(memory_order_relaxed);
+        }
+
+        bool try_push(LogLevel level, int64_t time_us, const char* message, uint32_t size){
+            RecordHeader header{size, (int32_t)level, time_us};
+            uint64_t t = tail.load(memory_order_relaxed);
+            uint64_t h = head.load(memory_order_acquire);
+            if(CAPACITY - (t - h) < sizeof(header) + size)
+                return false;
+
+            copy_in(t, &header, sizeof(header));
+            copy_in(t + sizeof(header), message, size);
+            tail.store(t + sizeof(header) + size, memory_order_release);
+            return true;
+        }
+
+        template<class Fn>
+        void consume(Fn&& fn){
+            uint64_t h = head.load(memory_order_relaxed);
+            uint64_t t = tail.load(memory_order_acquire);
+            string message;
+            while(h < t){
+                RecordHeader header;
+                copy_out(h, &header, sizeof(header));
+                message.resize(header.size);
+                copy_out(h + sizeof(header), &message[0], header.size);
+                h += sizeof(header) + header.size;
+                fn((LogLevel)header.level, header.time_us, message);
+            }
+            head.store(h, memory_order_release);
+        }
+
+    private:
+        void copy_in(uint64_t pos, const void* src, size_t n){
+            size_t offset = pos & (CAPACITY - 1);
+            size_t first  = std::min(n, CAPACITY - offset);
+            memcpy(data + offset, src, first);
+            memcpy(data, (const char*)src + first, n - first);
+        }
+
+        void copy_out(uint64_t pos, void* dst, size_t n){
+            size_t offset = pos & (CAPACITY - 1);
+            size_t first  = std::min(n, CAPACITY - offset);
+            memcpy(dst, data + offset, first);
+            memcpy((char*)dst + first, data, n - first);
+        }
+    };
+
     static struct Logger{
-        mutex logger_lock_;
-        string logger_directory;
-        LogLevel logger_level{LogLevel::Info};
-        vector<string> cache_, local_;
+
+        struct Record{
+            LogLevel level;
+            int64_t time_us;
+            string message;
+        };
+
+        mutex registry_lock_;                    // 保护 rings_，只在线程第一次写日志时加
+        vector<shared_ptr<LogRing>> rings_;
+        mutex drain_lock_;                       // 消费者锁：flush 线程、同步输出、flush_logger
+        mutex flush_lock_;
+        condition_variable flush_cond_;
         shared_ptr<thread> flush_thread_;
         atomic<bool> keep_run_{false};
-        shared_ptr<FILE> handler;
-        bool logger_shutdown{false};
-
-        void write(const string& line) {
+        atomic<bool> logger_shutdown{false};
+        atomic<bool> async_{true};
+        atomic<bool> console_{true};
 
-            lock_guard<mutex> l(logger_lock_);
-            if(logger_shutdown) 
-                return;
+        // 以下只在持有 drain_lock_ 时访问
+        string logger_directory;
+        size_t max_file_bytes_ = 0;
+        int max_file_seconds_  = 0;
+        shared_ptr<FILE> handler;
+        string file_date_;
+        int file_index_        = 0;
+        size_t file_bytes_     = 0;
+        long long file_open_ms_ = 0;
+        vector<Record> records_;
+        string console_text_, error_text_, file_text_;
+        time_t cached_second_  = 0;
+        char cached_time_[20]{};
+
+        /// 调用线程的环形缓冲区，线程退出时标记，缓冲区由 flush 线程读空后释放
+        LogRing* this_thread_ring(){
+            struct Holder{
+                shared_ptr<LogRing> ring;
+                ~Holder(){ if(ring) ring->alive = false; }
+            };
+            thread_local Holder holder;
+            if(holder.ring == nullptr){
+                holder.ring = make_shared<LogRing>();
+                lock_guard<mutex> l(registry_lock_);
+                rings_.emplace_back(holder.ring);
+            }
+            return holder.ring.get();
+        }
 
-            if (!keep_run_) {
+        void start_flush_thread(){
+            lock_guard<mutex> l(flush_lock_);
+            if(keep_run_ || logger_shutdown) return;
+            keep_run_ = true;
+            flush_thread_.reset(new thread(std::bind(&Logger::flush_job, this)));
+        }
 
-                if(flush_thread_) 
-                    return;
+        /// 缓冲区满时等待 flush 线程腾出空间，logger 关闭之后返回 false，由调用者同步输出
+        bool push(LogLevel level, int64_t time_us, const char* message, uint32_t size){
+            if(logger_shutdown) return false;
+            if(!keep_run_) start_flush_thread();
 
-                cache_.reserve(1000);
-                keep_run_ = true;
-                flush_thread_.reset(new thread(std::bind(&Logger::flush_job, this)));
+            auto ring = this_thread_ring();
+            while(!ring->try_push(level, time_us, message, size)){
+                if(logger_shutdown || !keep_run_) return false;
+                flush_cond_.notify_one();
+                this_thread::yield();
             }
-            cache_.emplace_back(line);
+
+            // 超过一半时提前唤醒，否则由 flush 线程按周期读取
+            if(ring->used() > LogRing::CAPACITY / 2)
+                flush_cond_.notify_one();
+            return true;
         }
 
-        void flush() {
+        /// 同步输出：先把缓冲区里更早的日志输出，再输出这一条
+        void write_now(LogLevel level, int64_t time_us, const char* message, uint32_t size){
+            lock_guard<mutex> l(drain_lock_);
+            collect();
+            records_.push_back(Record{level, time_us, string(message, size)});
+            output();
+        }
 
-            if (cache_.empty())
-                return;
+        void drain(){
+            lock_guard<mutex> l(drain_lock_);
+            collect();
+            output();
+        }
 
+        /// 读出所有缓冲区的记录，按时间排序（不同线程之间的顺序以时间为准）
+        void collect(){
+            vector<shared_ptr<LogRing>> rings;
             {
-                std::lock_guard<mutex> l(logger_lock_);
-                std::swap(local_, cache_);
+                lock_guard<mutex> l(registry_lock_);
+                rings = rings_;
             }
 
-            if (!local_.empty() and !logger_directory.empty()) {
+            for(auto& ring : rings){
+                ring->consume([&](LogLevel level, int64_t time_us, const string& message){
+                    records_.push_back(Record{level, time_us, message});
+                });
+            }
+            std::stable_sort(records_.begin(), records_.end(), [](const Record& a, const Record& b){ return a.time_us < b.time_us; });
 
-                auto now = date_now();
-                auto file = format("%s%s.txt", logger_directory.c_str(), now.c_str());
-                if (!exists(file)) {
-                    handler.reset(fopen_mkdirs(file, "wb"), fclose);
-                }
-                else if (!handler) {
-                    handler.reset(fopen_mkdirs(file, "a+"), fclose);
+            // 已经退出的线程，读空之后移除
+            lock_guard<mutex> l(registry_lock_);
+            rings_.erase(std::remove_if(rings_.begin(), rings_.end(), [](const shared_ptr<LogRing>& ring){
+                return !ring->alive && ring->used() == 0;
+            }), rings_.end());
+        }
+
+        const char* time_string(int64_t time_us){
+            time_t second = time_us / 1000000;
+            if(second != cached_second_){
+                tm t{};
+                localtime_r(&second, &t);
+                snprintf(cached_time_, sizeof(cached_time_), "%04d-%02d-%02d %02d:%02d:%02d",
+                         t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+                cached_second_ = second;
+            }
+            return cached_time_;
+        }
+
+        static const char* level_color(LogLevel level){
+            switch(level){
+                case LogLevel::Fatal:
+                case LogLevel::Error:   return "\033[31m";
+                case LogLevel::Warning: return "\033[33m";
+                case LogLevel::Info:    return "\033[35m";
+                case LogLevel::Verbose: return "\033[34m";
+                default: return nullptr;
+            }
+        }
+
+        void output(){
+            if(records_.empty()) return;
+
+            bool console = console_;
+            bool save    = !logger_directory.empty() && !logger_shutdown;
+            char prefix[128];
+            for(auto& record : records_){
+                const char* now = time_string(record.time_us);
+                if(console){
+                    const char* color = level_color(record.level);
+                    if(color) snprintf(prefix, sizeof(prefix), "[%s][%s%s\033[0m]", now, color, level_string(record.level));
+                    else      snprintf(prefix, sizeof(prefix), "[%s][%s]", now, level_string(record.level));
+
+                    auto& text = record.level <= LogLevel::Error ? error_text_ : console_text_;
+                    text += prefix;
+                    text += record.message;
+                    text += '\n';
                 }
 
-                if (handler) {
-                    for (auto& line : local_)
-                        fprintf(handler.get(), "%s\n", line.c_str());
-                    fflush(handler.get());
-                    handler.reset();
+                if(save){
+                    snprintf(prefix, sizeof(prefix), "[%s][%s]", now, level_string(record.level));
+                    file_text_ += prefix;
+                    file_text_ += record.message;
+                    file_text_ += '\n';
+
+                    // 分块写入，轮转的检查粒度不会因为一次读出很多日志而变粗
+                    if(file_text_.size() >= 64 * 1024){
+                        write_file(file_text_);
+                        file_text_.clear();
+                    }
                 }
             }
-            local_.clear();
+            records_.clear();
+
+            if(!console_text_.empty()){
+                fwrite(console_text_.data(), 1, console_text_.size(), stdout);
+                fflush(stdout);
+                console_text_.clear();
+            }
+
+            if(!error_text_.empty()){
+                fwrite(error_text_.data(), 1, error_text_.size(), stderr);
+                error_text_.clear();
+            }
+
+            if(!file_text_.empty()){
+                write_file(file_text_);
+                file_text_.clear();
+            }
         }
 
-        void flush_job() {
+        string file_path(const string& date, int index){
+            if(index == 0) return format("%s%s.txt", logger_directory.c_str(), date.c_str());
+            return format("%s%s.%d.txt", logger_directory.c_str(), date.c_str(), index);
+        }
 
-            auto tick_begin = timestamp_now();
-            std::vector<string> local;
-            while (keep_run_) {
+        void write_file(const string& text){
+
+            auto date = date_now();
+            auto now_ms = timestamp_now();
+            bool rotate = handler && (
+                date != file_date_ ||
+                (max_file_bytes_ > 0 && file_bytes_ >= max_file_bytes_) ||
+                (max_file_seconds_ > 0 && now_ms - file_open_ms_ >= max_file_seconds_ * 1000ll)
+            );
+
+            if(rotate){
+                handler.reset();
+                file_index_ = date != file_date_ ? 0 : file_index_ + 1;
+                file_date_  = date;
+                open_file(false);
+            }else if(!handler){
+                file_date_  = date;
+                file_index_ = 0;
+                open_file(true);
+            }
 
-                if (timestamp_now() - tick_begin < 1000) {
-                    this_thread::sleep_for(std::chrono::milliseconds(100));
-                    continue;
-                }
+            if(handler){
+                fwrite(text.data(), 1, text.size(), handler.get());
+                fflush(handler.get());
+                file_bytes_ += text.size();
+            }
+        }
 
-                tick_begin = timestamp_now();
-                flush();
+        /// append：进程重启时接着写当天最后一个没有写满的文件
+        void open_file(bool append){
+            string file = file_path(file_date_, file_index_);
+            while(exists(file) && (!append || (max_file_bytes_ > 0 && file_size(file) >= max_file_bytes_)))
+                file = file_path(file_date_, ++file_index_);
+
+            handler.reset(fopen_mkdirs(file, "a+"), fclose);
+            file_bytes_   = handler ? file_size(file) : 0;
+            file_open_ms_ = timestamp_now();
+        }
+
+        void flush_job() {
+            while (keep_run_) {
+                {
+                    unique_lock<mutex> l(flush_lock_);
+                    flush_cond_.wait_for(l, std::chrono::milliseconds(10));
+                }
+                drain();
             }
-            flush();
+            drain();
         }
 
         void set_save_directory(const string& loggerDirectory) {
+            lock_guard<mutex> l(drain_lock_);
+            handler.reset();
             logger_directory = loggerDirectory;
 
             if (logger_directory.empty())
-                logger_directory = ".";
+                return;
 
             if (logger_directory.back() not_eq '/') {
                 logger_directory.push_back('/');
             }
-
         }
 
-        void set_logger_level(LogLevel level){
-            logger_level = level;
+        void set_rotate(size_t max_file_bytes, int max_file_seconds){
+            lock_guard<mutex> l(drain_lock_);
+            max_file_bytes_   = max_file_bytes;
+            max_file_seconds_ = max_file_seconds;
         }
 
         void close(){
-            {
-                lock_guard<mutex> l(logger_lock_);
-                if (logger_shutdown) return;
+            if (logger_shutdown.exchange(true)) return;
 
-                logger_shutdown = true;
-            };
-
-            if (!keep_run_) return;
-            keep_run_ = false;
+            {
+                lock_guard<mutex> l(flush_lock_);
+                if (!keep_run_) return;
+                keep_run_ = false;
+            }
+            flush_cond_.notify_all();
             flush_thread_->join();
             flush_thread_.reset();
+
+            lock_guard<mutex> l(drain_lock_);
             handler.reset();
         }
 
@@ -352,85 +588,71 @@ namespace iLogger{
         __g_logger.close();
     }
 
-    static void remove_color_text(char* buffer){
-        
-        //"\033[31m%s\033[0m"
-        char* p = buffer;
-        while(*p){
-
-            if(*p == 0x1B){
-                char np = *(p + 1);
-                if(np == '['){
-                    // has token
-                    char* t = p + 2;
-                    while(*t){
-                        if(*t == 'm'){
-                            t = t + 1;
-                            char* k = p;
-                            while(*t){
-                                *k++ = *t++;
-                            }
-                            *k = 0;
-                            break;
-                        }
-                        t++;
-                    }
-                }
-            }
-            p++;
-        }
+    void set_logger_level(LogLevel level){
+        __logger_level = (int)level;
     }
 
+    LogLevel get_logger_level(){
+        return (LogLevel)__logger_level.load();
+    }
 
-    void __log_func(const char* file, int line, LogLevel level, const char* fmt, ...) {
+    void set_logger_save_directory(const string& directory){
+        __g_logger.set_save_directory(directory);
+    }
 
-        if(level > __g_logger.logger_level)
-            return;
+    string get_logger_save_directory(){
+        lock_guard<mutex> l(__g_logger.drain_lock_);
+        return __g_logger.logger_directory;
+    }
 
-        string now = time_now();
-        va_list vl;
-        va_start(vl, fmt);
-        
-        char buffer[2048];
-        string filename = file_name(file, true);
-        int n = snprintf(buffer, sizeof(buffer), "[%s]", now.c_str());
+    void set_logger_rotate(size_t max_file_bytes, int max_file_seconds){
+        __g_logger.set_rotate(max_file_bytes, max_file_seconds);
+    }
 
-        if (level == LogLevel::Fatal or level == LogLevel::Error) {
-            n += snprintf(buffer + n, sizeof(buffer) - n, "[\033[31m%s\033[0m]", level_string(level));
-        }
-        else if (level == LogLevel::Warning) {
-            n += snprintf(buffer + n, sizeof(buffer) - n, "[\033[33m%s\033[0m]", level_string(level));
-        }
-        else if (level == LogLevel::Info) {
-            n += snprintf(buffer + n, sizeof(buffer) - n, "[\033[35m%s\033[0m]", level_string(level));
-        }
-        else if (level == LogLevel::Verbose) {
-            n += snprintf(buffer + n, sizeof(buffer) - n, "[\033[34m%s\033[0m]", level_string(level));
-        }
-        else {
-            n += snprintf(buffer + n, sizeof(buffer) - n, "[%s]", level_string(level));
-        }
+    void set_logger_async(bool async){
+        if(!async) __g_logger.drain();
+        __g_logger.async_ = async;
+    }
 
-        n += snprintf(buffer + n, sizeof(buffer) - n, "[%s:%d]:", filename.c_str(), line);
-        vsnprintf(buffer + n, sizeof(buffer) - n, fmt, vl);
+    bool is_logger_async(){
+        return __g_logger.async_;
+    }
 
-        if (level == LogLevel::Fatal or level == LogLevel::Error) {
-            fprintf(stderr, "%s\n", buffer);
-        }
-        else if (level == LogLevel::Warning) {
-            fprintf(stdout, "%s\n", buffer);
-        }
-        else {
-            fprintf(stdout, "%s\n", buffer);
-        }
+    void set_logger_console(bool console){
+        __g_logger.drain();
+        __g_logger.console_ = console;
+    }
 
-        if(!__g_logger.logger_directory.empty()){
-            // remove save color txt
-            remove_color_text(buffer);
-            __g_logger.write(buffer);
-            if (level == LogLevel::Fatal) {
-                __g_logger.flush();
-            }
+    bool is_logger_console(){
+        return __g_logger.console_;
+    }
+
+    void flush_logger(){
+        __g_logger.drain();
+    }
+
+    void __log_func(const char* file, int line, LogLevel level, const char* fmt, ...) {
+
+        // 直接调用 __log_func 时宏里的判断不生效，这里再判断一次
+        if((int)level > __logger_level.load(memory_order_relaxed))
+            return;
+
+        // 调用线程只做消息本身的格式化，不分配内存
+        thread_local char buffer[2048];
+        const char* filename = strrchr(file, '/');
+        filename = filename ? filename + 1 : file;
+
+        int n = snprintf(buffer, sizeof(buffer), "[%s:%d]:", filename, line);
+        va_list vl;
+        va_start(vl, fmt);
+        n += vsnprintf(buffer + n, sizeof(buffer) - n, fmt, vl);
+        va_end(vl);
+        n = std::min(n, (int)sizeof(buffer) - 1);
+
+        int64_t time_us = chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+        bool sync = !__g_logger.async_ || level <= LogLevel::Error;
+        if (sync || !__g_logger.push(level, time_us, buffer, n)) {
+            __g_logger.write_now(level, time_us, buffer, n);
         }
 
         if (level == LogLevel::Fatal) {
@@ -439,7 +661,6 @@ namespace iLogger{
         }
     }
 
-
     bool alphabet_equal(char a, char b, bool ignore_case){
         if (ignore_case){
             a = a > 'a' and a < 'z' ? a - 'a' + 'A' : a;
@@ -545,7 +766,7 @@ namespace iLogger{
             handle = opendir(search_path.c_str());
             if (handle not_eq 0)
             {
-                while (fileinfo = readdir(handle))
+                while ((fileinfo = readdir(handle)) != nullptr)
                 {
                     struct stat file_stat;
                     if (strcmp(fileinfo->d_name, ".") == 0 or strcmp(fileinfo->d_name, "..") == 0)
@@ -554,8 +775,8 @@ namespace iLogger{
                     if (lstat((search_path + fileinfo->d_name).c_str(), &file_stat) < 0)
                         continue;
 
-                    if (!findDirectory and !S_ISDIR(file_stat.st_mode) or
-                        findDirectory and S_ISDIR(file_stat.st_mode))
+                    if ((!findDirectory and !S_ISDIR(file_stat.st_mode)) or
+                        (findDirectory and S_ISDIR(file_stat.st_mode)))
                     {
                         if (pattern_match(fileinfo->d_name, filter.c_str()))
                             out.push_back(search_path + fileinfo->d_name);
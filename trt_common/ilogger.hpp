@@ -6,6 +6,12 @@
 #include <vector>
 #include <tuple>
 #include <ctime>
+#include <atomic>
+
+/// 编译期日志等级：等级高于它的宏直接展开为空（参数也不会求值），例如 -DLINFER_LOG_LEVEL=3 去掉 INFOD / INFOV
+#ifndef LINFER_LOG_LEVEL
+#define LINFER_LOG_LEVEL 5
+#endif
 
 
 namespace iLogger{
@@ -21,12 +27,38 @@ namespace iLogger{
         Fatal   = 0
     };
 
-    #define INFOD(...)			iLogger::__log_func(__FILE__, __LINE__, iLogger::LogLevel::Debug, __VA_ARGS__)
-    #define INFOV(...)			iLogger::__log_func(__FILE__, __LINE__, iLogger::LogLevel::Verbose, __VA_ARGS__)
-    #define INFO(...)			iLogger::__log_func(__FILE__, __LINE__, iLogger::LogLevel::Info, __VA_ARGS__)
-    #define INFOW(...)			iLogger::__log_func(__FILE__, __LINE__, iLogger::LogLevel::Warning, __VA_ARGS__)
-    #define INFOE(...)			iLogger::__log_func(__FILE__, __LINE__, iLogger::LogLevel::Error, __VA_ARGS__)
-    #define INFOF(...)			iLogger::__log_func(__FILE__, __LINE__, iLogger::LogLevel::Fatal, __VA_ARGS__)
+    /// 运行期日志等级，宏先判断它再调用 __log_func，被过滤的日志不会格式化
+    inline atomic<int> __logger_level{(int)LogLevel::Info};
+
+    #define __INFO_IMPL(level, ...)		do{ if((int)(level) <= iLogger::__logger_level.load(std::memory_order_relaxed)) \
+                                            iLogger::__log_func(__FILE__, __LINE__, level, __VA_ARGS__); }while(0)
+
+    #if LINFER_LOG_LEVEL >= 5
+    #define INFOD(...)			__INFO_IMPL(iLogger::LogLevel::Debug, __VA_ARGS__)
+    #else
+    #define INFOD(...)			((void)0)
+    #endif
+
+    #if LINFER_LOG_LEVEL >= 4
+    #define INFOV(...)			__INFO_IMPL(iLogger::LogLevel::Verbose, __VA_ARGS__)
+    #else
+    #define INFOV(...)			((void)0)
+    #endif
+
+    #if LINFER_LOG_LEVEL >= 3
+    #define INFO(...)			__INFO_IMPL(iLogger::LogLevel::Info, __VA_ARGS__)
+    #else
+    #define INFO(...)			((void)0)
+    #endif
+
+    #if LINFER_LOG_LEVEL >= 2
+    #define INFOW(...)			__INFO_IMPL(iLogger::LogLevel::Warning, __VA_ARGS__)
+    #else
+    #define INFOW(...)			((void)0)
+    #endif
+
+    #define INFOE(...)			__INFO_IMPL(iLogger::LogLevel::Error, __VA_ARGS__)
+    #define INFOF(...)			__INFO_IMPL(iLogger::LogLevel::Fatal, __VA_ARGS__)
 
     string date_now();
     string time_now();
@@ -60,10 +92,33 @@ namespace iLogger{
 
 
     // 关于logger的api
+    // 默认异步：调用线程只格式化消息并写入自己的无锁环形缓冲区，由 flush 线程输出到控制台和文件
+    // error / fatal 同步输出（先输出缓冲区里更早的日志），保证崩溃前的错误信息不丢
     const char* level_string(LogLevel level);
     void __log_func(const char* file, int line, LogLevel level, const char* fmt, ...);
     void destroy_logger();
 
+    void set_logger_level(LogLevel level);
+    LogLevel get_logger_level();
+
+    /// 日志文件目录，文件名为 <date>.txt，轮转之后为 <date>.1.txt、<date>.2.txt ...；空字符串表示不写文件（默认）
+    void set_logger_save_directory(const string& directory);
+    string get_logger_save_directory();
+
+    /// 当前文件超过 max_file_bytes 或者打开超过 max_file_seconds 时换一个新文件，0 表示不限制，日期变化总是换文件
+    void set_logger_rotate(size_t max_file_bytes, int max_file_seconds);
+
+    /// false 时在调用线程上直接输出（原来的行为，多线程时会争抢同一把锁）
+    void set_logger_async(bool async);
+    bool is_logger_async();
+
+    /// 是否输出到控制台，默认 true
+    void set_logger_console(bool console);
+    bool is_logger_console();
+
+    /// 等待所有已经提交的日志输出完成
+    void flush_logger();
+
     inline int upbound(int n, int align = 32) { return (n + align - 1) / align * align;}
 }
 
@@ -0,0 +1,52 @@
+#ifndef INFER_CAPTURE_HPP
+#define INFER_CAPTURE_HPP
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <fstream>
+#include "trt_infer.hpp"
+
+namespace TRT {
+
+    /// ------------------------------------------------------------------------
+    /// ---------- 录制 forward 的输出，供 Replay 后端在任意机器上原样回放 ----------------
+    /// ------------------------------------------------------------------------
+
+    /// capture 文件格式（小端、原生字节序）：
+    ///     header : magic[8] version max_batch num_input num_output
+    ///              每个 binding（先输入后输出）：name_len name ndims dims[ndims]
+    ///     item   : stream frame  每个输出：ndims dims[ndims] bytes data[bytes]
+    /// 一个 item 对应 batch 中的一张图（一个 job），dims 不含 batch 维度，(stream, frame) 为 job 的 JobKey
+    /// 版本 1 的 item 只有全局的 seq，多副本、多个 stream 时回放的顺序和录制的 job 对不上，不再支持
+    static const char CAPTURE_MAGIC[8] = {'L', 'I', 'N', 'F', 'C', 'A', 'P', '\0'};
+    static const int  CAPTURE_VERSION  = 2;
+
+    class InferCapture {
+    public:
+        /// 同一个文件只会打开一次，多个 Infer 实例（多副本）共享同一个 InferCapture
+        static std::shared_ptr<InferCapture> open(const std::string& file, Infer* infer);
+        ~InferCapture();
+
+        /// outputs[i] 指向第 i 个输出在 host 上的数据，布局为 [batch, dims[i]...]
+        /// keys[ibatch] 为第 ibatch 项的 job；keys 的大小不等于 batch 时按录制的顺序编号，stream 为 -1
+        void record(int batch, const std::vector<JobKey>& keys, const std::vector<const void*>& outputs, const std::vector<std::vector<int>>& dims);
+
+        const std::string& file() const { return file_; }
+        uint64_t num_records() const { return seq_; }
+
+    private:
+        InferCapture() = default;
+        bool write_header(Infer* infer);
+
+    private:
+        std::string file_;
+        std::ofstream out_;
+        std::mutex lock_;
+        uint64_t seq_ = 0;      // 已录制的条数
+    };
+
+}
+
+#endif //INFER_CAPTURE_HPP
@@ -6,23 +6,161 @@
 /// 避免重复书写生产者消费者的代码
 
 #include <string>
+#include <vector>
+#include <algorithm>
 #include <future>
 #include <memory>
 #include <mutex>
 #include <thread>
-#include <queue>
-#include <condition_variable>
+#include <chrono>
+#include <map>
+#include <functional>
 #include "tensor_allocator.hpp"
+#include "trt_infer.hpp"
+#include "mpmc_queue.hpp"
+#include "object_pool.hpp"
+#include "infer_metrics.hpp"
+#include "trace.hpp"
+#include "ilogger.hpp"
+
+/// 动态 batch 策略：worker 取任务时，最多等待 max_queue_delay_us 来凑满 batch
+/// 等待时间从队列中最早的任务提交时开始计算，凑满或超时立即返回
+struct BatchingConfig{
+    int max_batch_size     = 0;   // 0 表示使用模型的 max batch，否则取两者较小值
+    int max_queue_delay_us = 0;   // 0 表示队列非空就立即返回（不等待）
+};
+
+/// 进程级默认配置，controller 在 startup 时复制一份，因此所有 app 无需改代码即可生效
+inline BatchingConfig& default_batching_config(){
+    static BatchingConfig config;
+    return config;
+}
+
+/// 实际取到的 batch 大小分布，histogram[n] 为 batch 大小为 n 的次数
+struct BatchStats{
+    uint64_t num_batches = 0;
+    uint64_t num_jobs    = 0;
+    std::vector<uint64_t> histogram;
+
+    float average_batch_size() const{ return num_batches == 0 ? 0 : num_jobs / (float)num_batches; }
+
+    std::string to_string() const{
+        std::string output = iLogger::format("%llu batches, %llu jobs, avg batch %.2f",
+                                             (unsigned long long)num_batches, (unsigned long long)num_jobs, average_batch_size());
+        for(int i = 1; i < histogram.size(); ++i){
+            if(histogram[i] == 0) continue;
+            output += iLogger::format(", [%d]=%llu(%.1f%%)", i, (unsigned long long)histogram[i], histogram[i] * 100.0f / num_batches);
+        }
+        return output;
+    }
+};
+
+/// 推理跟不上时 commit 的处理方式
+enum class OverloadPolicy : int{
+    Block               = 0,   // 阻塞等待空闲的 tensor，超过 block_timeout_ms 失败（原行为）
+    RejectNewest        = 1,   // 没有空闲的 tensor 时，直接拒绝当前提交
+    DropOldest          = 2,   // 丢弃队列中最早的、还没开始推理的任务，把位置让给当前提交
+    KeepLatestPerStream = 3    // 同一个 stream 在队列中最多保留一帧，新帧到来时丢弃旧帧；没有 stream id 时按 Block 处理
+};
+
+struct OverloadConfig{
+    OverloadPolicy policy = OverloadPolicy::Block;
+    int block_timeout_ms  = 10000;
+};
+
+inline OverloadConfig& default_overload_config(){
+    static OverloadConfig config;
+    return config;
+}
+
+inline const char* overload_policy_name(OverloadPolicy policy){
+    switch(policy){
+        case OverloadPolicy::Block:               return "block";
+        case OverloadPolicy::RejectNewest:        return "reject_newest";
+        case OverloadPolicy::DropOldest:          return "drop_oldest";
+        case OverloadPolicy::KeepLatestPerStream: return "keep_latest";
+        default: return "unknow";
+    }
+}
+
+/// "block" / "reject_newest" / "drop_oldest" / "keep_latest"，无法识别时返回 false
+inline bool parse_overload_policy(const std::string& name, OverloadPolicy& policy){
+    for(auto item : {OverloadPolicy::Block, OverloadPolicy::RejectNewest, OverloadPolicy::DropOldest, OverloadPolicy::KeepLatestPerStream}){
+        if(name == overload_policy_name(item)){
+            policy = item;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// 三段流水线：预处理线程池 -> worker（只负责喂模型）-> 后处理线程池，阶段之间用有界队列连接
+struct PipelineConfig{
+    int preprocess_threads  = 0;    // 0 表示在调用 commit 的线程上预处理（原行为）
+    int postprocess_threads = 0;    // 0 表示在 worker 线程上后处理（原行为）
+    int queue_size          = 64;   // 预处理、后处理队列的容量，满了之后 commit / worker 阻塞
+};
+
+inline PipelineConfig& default_pipeline_config(){
+    static PipelineConfig config;
+    return config;
+}
+
+/// 每个 stream 已提交的帧数，(stream_id, 帧序号) 标识一个 job，录制 / Replay 按它对应输出
+/// 多副本共享同一个计数器，帧序号与 job 被分到哪个副本无关
+/// stream_id 在 [-1, MAX_FAST_STREAMS - 1) 内时只有一次 fetch_add，更大的 id 才走加锁的 map
+class StreamFrameCounter{
+public:
+    static const int MAX_FAST_STREAMS = 256;
+
+    uint64_t next(int stream_id){
+        int slot = stream_id + 1;
+        if(slot >= 0 && slot < MAX_FAST_STREAMS)
+            return fast_[slot].fetch_add(1, std::memory_order_relaxed);
+
+        std::unique_lock<std::mutex> l(lock_);
+        return frames_[stream_id]++;
+    }
+
+private:
+    std::atomic<uint64_t> fast_[MAX_FAST_STREAMS]{};
+    std::mutex lock_;
+    std::map<int, uint64_t> frames_;
+};
+
+struct OverloadStats{
+    uint64_t num_rejected = 0;   // commit 时就被拒绝的任务
+    uint64_t num_dropped  = 0;   // 已经入队、在推理前被丢弃的任务
+};
 
 template<class Input, class Output, class StartParam=std::tuple<std::string, int>, class JobAdditional=int>
 class InferController{
 public:
+    /// 完成回调，在 worker 线程上调用，结果通过右值移交给调用者
+    using Callback = std::function<void(Output&& output)>;
+
     struct Job{
         Input input;
         Output output;
         JobAdditional additional;
         TensorAllocator::MonoDataPtr mono_tensor;
+        std::vector<float> host_output;              // worker 拷贝出来的 decode 结果，由 postprocess 解析成 output
+        std::shared_ptr<std::promise<Output>> pro;   // 与 callback 二选一
+        Callback callback;
+        JobTimes times;                              // times.enqueue 也是凑 batch 等待的起点
+        int stream_id = -1;
+        uint64_t frame = 0;                          // stream_id 内的提交序号
+        // 只有 KeepLatestPerStream 需要：0 排队中，1 已被 worker 取走，2 已被丢弃
+        std::shared_ptr<std::atomic<int>> state;
+    };
+
+    /// KeepLatestPerStream 中每个 stream 还在排队的那一帧，只保留丢弃时需要的部分（释放 tensor、交付空结果），
+    /// 输入图像、host_output 等随 job 进入队列，不会多保留一帧
+    struct PendingJob{
+        std::shared_ptr<std::atomic<int>> state;
+        TensorAllocator::MonoDataPtr mono_tensor;
         std::shared_ptr<std::promise<Output>> pro;
+        Callback callback;
     };
 
     virtual ~InferController(){
@@ -30,54 +168,117 @@ public:
     }
 
     void stop(){
+        // 先停预处理线程，此时 worker 还在运行，阻塞在 allocator 上的预处理可以正常结束
+        if(!preprocess_threads_.empty()){
+            inputs_->close();
+            for(auto& t : preprocess_threads_) t.join();
+            preprocess_threads_.clear();
+        }
+
         run_ = false;
-        cond_.notify_all();
+        jobs_.close();
 
         // clean jobs
+        Job item;
+        while(jobs_.try_pop(item)){
+            if(claim(item, JOB_TAKEN))
+                complete(item, Output());
+        }
+
         {
-            std::unique_lock<std::mutex> l(jobs_lock_);
-            while(!jobs_.empty()){
-                auto& item = jobs_.front();
-                if(item.pro)
-                    item.pro->set_value(Output());
-                jobs_.pop();
-            }
+            std::unique_lock<std::mutex> l(streams_lock_);
+            pending_by_stream_.clear();
         }
 
+        bool stopped_worker = worker_ != nullptr;
         if(worker_){
             worker_->join();
             worker_.reset();
+
+            auto stats = batch_stats();
+            if(stats.num_batches > 0)
+                INFO("Batching: %s", stats.to_string().c_str());
+
+            auto overload = overload_stats();
+            if(overload.num_rejected > 0 || overload.num_dropped > 0)
+                INFO("Overload[%s]: %llu rejected, %llu dropped", overload_policy_name(overload_.policy),
+                     (unsigned long long)overload.num_rejected, (unsigned long long)overload.num_dropped);
+        }
+
+        // worker 退出后再停后处理线程，已经推理完的任务照常交付
+        if(!postprocess_threads_.empty()){
+            outputs_->close();
+            for(auto& t : postprocess_threads_) t.join();
+            postprocess_threads_.clear();
+        }
+
+        if(stopped_worker){
+            auto metrics = metrics_->snapshot();
+            if(metrics.num_completed > 0)
+                INFO("Latency %s", metrics.to_string().c_str());
         }
     }
 
     bool startup(const StartParam& param){
         run_ = true;
+        jobs_.open();
+        set_batching(default_batching_config());
+        overload_ = default_overload_config();
+
+        pipeline_ = default_pipeline_config();
+        inputs_.reset(pipeline_.preprocess_threads > 0 ? new MPMCQueue<Job>(pipeline_.queue_size) : nullptr);
+        outputs_.reset(pipeline_.postprocess_threads > 0 ? new MPMCQueue<Job>(pipeline_.queue_size) : nullptr);
+
+        register_infer_metrics(metrics_, metrics_name());
 
         std::promise<bool> pro;
         start_param_ = param;
-        worker_.reset(new std::thread(&InferController::worker, this, std::ref(pro)));
-        return pro.get_future().get();
+        worker_.reset(new std::thread([this, &pro](){
+            TRACE_THREAD_NAME(std::string(metrics_name()) + ".worker");
+            worker(pro);
+        }));
+        if(!pro.get_future().get())
+            return false;
+
+        for(int i = 0; i < pipeline_.preprocess_threads; ++i)
+            preprocess_threads_.emplace_back(&InferController::preprocess_loop, this);
+        for(int i = 0; i < pipeline_.postprocess_threads; ++i)
+            postprocess_threads_.emplace_back(&InferController::postprocess_loop, this);
+        return true;
     }
 
     virtual std::shared_future<Output> commit(const Input& input){
+        return commit(input, -1);
+    }
 
+    /// stream_id 标识输入来自哪一路视频，KeepLatestPerStream 策略据此丢弃同一路的旧帧
+    virtual std::shared_future<Output> commit(const Input& input, int stream_id){
         Job job;
-        job.pro = std::make_shared<std::promise<Output>>();
-        if(!preprocess(job, input)){
-            job.pro->set_value(Output());
-            return job.pro->get_future();
-        }
+        job.pro = make_pooled_promise<Output>();
+        std::shared_future<Output> future = job.pro->get_future();
+        submit(std::move(job), input, stream_id);
+        return future;
+    }
 
-        {
-            std::unique_lock<std::mutex> l(jobs_lock_);
-            jobs_.push(job);
-        };
-        cond_.notify_one();
-        return job.pro->get_future();
+    /// 不分配 promise，完成（或者失败、被丢弃）时调用 callback，失败时结果为空的 Output
+    /// 结果直接移动给 callback，在 worker 或者后处理线程上调用，callback 里不要做耗时的事情
+    virtual void commit(const Input& input, int stream_id, Callback callback){
+        Job job;
+        job.callback = std::move(callback);
+        submit(std::move(job), input, stream_id);
     }
 
     virtual std::vector<std::shared_future<Output>> commits(const std::vector<Input>& inputs){
 
+        if(inputs_){
+            // 有预处理线程时逐个入队即可，由预处理线程并行处理
+            std::vector<std::shared_future<Output>> results(inputs.size());
+            for(int i = 0; i < inputs.size(); ++i)
+                results[i] = commit(inputs[i], -1);
+            return results;
+        }
+
+        TRACE_SCOPE("commits");
         int batch_size = std::min((int)inputs.size(), this->tensor_allocator_->capacity());
         std::vector<Job> jobs(inputs.size());
         std::vector<std::shared_future<Output>> results(inputs.size());
@@ -87,69 +288,382 @@ public:
             int begin = epoch * batch_size;
             int end   = std::min((int)inputs.size(), begin + batch_size);
 
+            std::vector<bool> success(end - begin, true);
             for(int i = begin; i < end; ++i){
                 Job& job = jobs[i];
-                job.pro = std::make_shared<std::promise<Output>>();
+                if(job_keys_enabled_) job.frame = frame_counter_->next(-1);
+                job.pro = make_pooled_promise<Output>();
+                results[i] = job.pro->get_future();
+                job.times.submit = job.times.preprocess_begin = std::chrono::steady_clock::now();
                 if(!preprocess(job, inputs[i])){
-                    job.pro->set_value(Output{});
+                    complete(job, Output());
+                    success[i - begin] = false;
                 }
-                results[i] = job.pro->get_future();
             }
 
-            {
-                std::unique_lock<std::mutex> l(jobs_lock_);
-                for(int i = begin; i < end; ++i){
-                    jobs_.emplace(std::move(jobs[i]));
-                };
+            auto now = std::chrono::steady_clock::now();
+            for(int i = begin; i < end; ++i){
+                if(!success[i - begin]) continue;
+                jobs[i].times.enqueue = now;
+                enqueue(std::move(jobs[i]));
             }
-            cond_.notify_one();
         }
         return results;
     }
 
+    void set_batching(const BatchingConfig& config){
+        std::unique_lock<std::mutex> l(stats_lock_);
+        batching_ = config;
+    }
+
+    BatchStats batch_stats(){
+        std::unique_lock<std::mutex> l(stats_lock_);
+        return batch_stats_;
+    }
+
+    OverloadStats overload_stats() const{
+        OverloadStats stats;
+        stats.num_rejected = metrics_->num_rejected();
+        stats.num_dropped  = metrics_->num_dropped();
+        return stats;
+    }
+
+    /// 各阶段延迟、吞吐、batch 填充率的快照，所有 controller 的快照见 infer_metrics_snapshot
+    MetricsSnapshot metrics_snapshot() const{
+        return metrics_->snapshot();
+    }
+
+    /// 与 other 共用帧序号，ReplicaPool 让所有副本的同一个 stream 连续编号，需要在 commit 之前调用
+    void share_frames(const InferController& other){
+        frame_counter_ = other.frame_counter_;
+    }
+
+    /// 预处理 Tensor 池的占用情况，worker 未启动或已退出时返回空统计
+    TensorAllocator::Stats allocator_stats(){
+        auto allocator = tensor_allocator_.get();
+        return allocator ? allocator->stats() : TensorAllocator::Stats{};
+    }
+
 protected:
     virtual void worker(std::promise<bool>& result) = 0;
     virtual bool preprocess(Job& job, const Input& input) = 0;
-    
+
+    /// 把 worker 拷贝出来的 job.host_output 解析成 job.output，worker 自己填好 output 时不需要重写
+    /// postprocess_threads > 0 时在后处理线程上并发调用
+    virtual void postprocess(Job& job){}
+
+    /// preprocess_threads > 0 时输入在 commit 返回之后才被预处理，
+    /// 浅拷贝的输入（比如 cv::Mat）需要重写它做深拷贝，避免调用者复用同一块内存
+    virtual Input copy_input(const Input& input){
+        return input;
+    }
+
+    /// 统计里的 controller 标签，app 重写为自己的名字
+    virtual const char* metrics_name() const{
+        return "controller";
+    }
+
+    void submit(Job&& job, const Input& input, int stream_id){
+
+        TRACE_SCOPE("commit");
+        job.times.submit = std::chrono::steady_clock::now();
+        job.stream_id = stream_id;
+        if(job_keys_enabled_) job.frame = frame_counter_->next(stream_id);
+        bool keep_latest = overload_.policy == OverloadPolicy::KeepLatestPerStream && stream_id >= 0;
+        if(keep_latest){
+            job.state = std::allocate_shared<std::atomic<int>>(PoolAllocator<std::atomic<int>>(), JOB_QUEUED);
+            drop_pending(stream_id);
+        }
+
+        if(inputs_){
+            job.input = copy_input(input);
+            bool pushed = overload_.policy == OverloadPolicy::RejectNewest ? inputs_->try_push(std::move(job))
+                                                                           : inputs_->push(std::move(job));
+            if(!pushed){
+                // 失败时 job 没有被移走
+                if(run_) metrics_->add_rejected();
+                complete(job, Output());
+            }
+            return;
+        }
+        prepare(std::move(job), input);
+    }
+
+    /// 预处理并交给 worker，没有预处理线程时在 commit 的线程上调用
+    void prepare(Job&& job, const Input& input){
+
+        job.times.preprocess_begin = std::chrono::steady_clock::now();
+        bool ok = false;
+        {
+            TRACE_SCOPE("preprocess");
+            ok = preprocess(job, input);
+        }
+
+        if(!ok){
+            complete(job, Output());
+            return;
+        }
+
+        if(job.state){
+            std::unique_lock<std::mutex> l(streams_lock_);
+            pending_by_stream_[job.stream_id] = PendingJob{job.state, job.mono_tensor, job.pro, job.callback};
+        }
+
+        job.times.enqueue = std::chrono::steady_clock::now();
+        enqueue(std::move(job));
+    }
+
     virtual bool get_jobs_and_wait(std::vector<Job>& fetch_jobs, int max_size){
 
-        std::unique_lock<std::mutex> l(jobs_lock_);
-        cond_.wait(l, [&](){
-            return !run_ || !jobs_.empty();
-        });
+        BatchingConfig batching;
+        {
+            std::unique_lock<std::mutex> l(stats_lock_);
+            batching = batching_;
+        }
+
+        if(batching.max_batch_size > 0)
+            max_size = std::min(max_size, batching.max_batch_size);
 
-        if(!run_) return false;
-        
         fetch_jobs.clear();
-        for(int i = 0; i < max_size && !jobs_.empty(); ++i){
-            fetch_jobs.emplace_back(std::move(jobs_.front()));
-            jobs_.pop();
+        Job job;
+        bool popped = false;
+        while((popped = jobs_.pop(job)) && !claim(job, JOB_TAKEN));
+        if(!popped || !run_){
+            if(popped) complete(job, Output());
+            return false;
+        }
+        take(fetch_jobs, job);
+
+        if(batching.max_queue_delay_us > 0){
+            // 队列不足一个 batch 时，等到凑满或者最早的任务等待超过 max_queue_delay_us
+            auto deadline = fetch_jobs[0].times.enqueue + std::chrono::microseconds(batching.max_queue_delay_us);
+            while(fetch_jobs.size() < max_size && jobs_.pop_until(job, deadline))
+                if(claim(job, JOB_TAKEN)) take(fetch_jobs, job);
+        }else{
+            while(fetch_jobs.size() < max_size && jobs_.try_pop(job))
+                if(claim(job, JOB_TAKEN)) take(fetch_jobs, job);
+        }
+
+        if(!run_){
+            for(auto& item : fetch_jobs)
+                complete(item, Output());
+            fetch_jobs.clear();
+            return false;
         }
+
+        // host_output 复用之前任务的缓冲区，worker 拷贝 decode 结果时不需要重新分配
+        auto ready = std::chrono::steady_clock::now();
+        for(auto& item : fetch_jobs){
+            item.host_output = host_buffers_.acquire();
+            item.times.batch_ready = ready;
+        }
+
+        int batch = fetch_jobs.size();
+        metrics_->record_batch(batch, max_size);
+        std::unique_lock<std::mutex> l(stats_lock_);
+        if(batch_stats_.histogram.size() <= batch)
+            batch_stats_.histogram.resize(batch + 1);
+        batch_stats_.histogram[batch]++;
+        batch_stats_.num_batches++;
+        batch_stats_.num_jobs += batch;
         return true;
     }
 
     virtual bool get_job_and_wait(Job& fetch_job){
 
-        std::unique_lock<std::mutex> l(jobs_lock_);
-        cond_.wait(l, [&](){
-            return !run_ || !jobs_.empty();
-        });
+        bool popped = false;
+        while((popped = jobs_.pop(fetch_job)) && !claim(fetch_job, JOB_TAKEN));
+        if(!popped || !run_){
+            if(popped) complete(fetch_job, Output());
+            return false;
+        }
 
-        if(!run_) return false;
-        
-        fetch_job = std::move(jobs_.front());
-        jobs_.pop();
+        fetch_job.times.taken = fetch_job.times.batch_ready = std::chrono::steady_clock::now();
+        forget_pending(fetch_job);
+        metrics_->record_batch(1, 1);
         return true;
     }
 
+    /// 只有 model 在录制或者是 Replay 后端时才为 job 编号，其他时候 commit 不碰计数器
+    /// worker 加载 model 之后、result.set_value 之前调用，之后的 commit 都能看到
+    void use_job_keys(TRT::Infer* model){
+        job_keys_enabled_ = model->uses_job_keys();
+    }
+
+    /// 告诉 model 这个 batch 每一项对应的 job，worker 在 forward 之前调用，录制 / Replay 后端按它对应输出
+    void bind_job_keys(TRT::Infer* model, const std::vector<Job>& jobs){
+        if(!job_keys_enabled_) return;
+
+        job_keys_.resize(jobs.size());
+        for(int i = 0; i < jobs.size(); ++i)
+            job_keys_[i] = TRT::JobKey{jobs[i].stream_id, jobs[i].frame};
+        model->set_job_keys(job_keys_);
+    }
+
+    /// 按照 overload 策略向 allocator 申请预处理用的 tensor，app 的 preprocess 调用它
+    /// 返回空表示这次提交被拒绝（或者阻塞超时），job 不会入队
+    TensorAllocator::MonoDataPtr acquire_tensor(const Job& job){
+        TensorAllocator::MonoDataPtr mono;
+        switch(overload_.policy){
+            case OverloadPolicy::RejectNewest:
+                mono = tensor_allocator_->try_query();
+                if(mono == nullptr) metrics_->add_rejected();
+                return mono;
+
+            case OverloadPolicy::DropOldest:
+                for(;;){
+                    mono = tensor_allocator_->try_query();
+                    if(mono != nullptr) return mono;
+
+                    // 没有排队的任务可丢，说明 tensor 都在 worker 正在推理的 batch 里，等它结束即可
+                    Job oldest;
+                    if(!jobs_.try_pop(oldest)) break;
+                    if(claim(oldest, JOB_DROPPED)) drop(oldest);
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        mono = tensor_allocator_->query(overload_.block_timeout_ms);
+        if(mono == nullptr){
+            metrics_->add_rejected();
+            if(run_) INFOE("Tensor allocator query failed.");
+        }
+        return mono;
+    }
+
+    /// worker 处理完一个任务后调用，把 job.output 交给 promise 或者 callback
+    void deliver(Job& job){
+        complete(job, std::move(job.output));
+        metrics_->record_job(job.times, std::chrono::steady_clock::now());
+    }
+
+    /// worker forward 之后调用：有后处理线程时交给它们，否则直接在 worker 上 postprocess 并交付
+    void finish(Job&& job){
+        job.times.forward_end = std::chrono::steady_clock::now();
+        if(outputs_ && outputs_->push(std::move(job)))
+            return;
+
+        postprocess_and_deliver(job);
+    }
+
+    /// 入队，controller 已经 stop 时直接返回空结果
+    void enqueue(Job&& job){
+        if(jobs_.push(std::move(job)))
+            return;
+
+        // push 失败时 job 没有被移走，不需要事先拷贝 promise / callback
+        if(job.state && job.state->exchange(JOB_DROPPED) != JOB_QUEUED) return;
+        if(job.mono_tensor) job.mono_tensor->release();
+        complete(job, Output());
+    }
+
+private:
+    enum : int{ JOB_QUEUED = 0, JOB_TAKEN = 1, JOB_DROPPED = 2 };
+
+    /// 任务只能被取走或者丢弃其中一次，没有 state 的任务谁 pop 到就归谁
+    static bool claim(Job& job, int to){
+        if(!job.state) return true;
+        int expected = JOB_QUEUED;
+        return job.state->compare_exchange_strong(expected, to);
+    }
+
+    /// JobType 为 Job 或 PendingJob
+    template<class JobType>
+    static void complete(JobType& job, Output&& output){
+        if(job.callback) job.callback(std::move(output));
+        else if(job.pro) job.pro->set_value(std::move(output));
+    }
+
+    template<class JobType>
+    void drop(JobType& job){
+        if(job.mono_tensor) job.mono_tensor->release();
+        complete(job, Output());
+        metrics_->add_dropped();
+    }
+
+    void preprocess_loop(){
+        TRACE_THREAD_NAME(std::string(metrics_name()) + ".preprocess");
+        Job job;
+        while(inputs_->pop(job)){
+            Input input = std::move(job.input);
+            prepare(std::move(job), input);
+        }
+    }
+
+    void postprocess_loop(){
+        TRACE_THREAD_NAME(std::string(metrics_name()) + ".postprocess");
+        Job job;
+        while(outputs_->pop(job))
+            postprocess_and_deliver(job);
+    }
+
+    void postprocess_and_deliver(Job& job){
+        job.times.postprocess_begin = std::chrono::steady_clock::now();
+        {
+            TRACE_SCOPE("postprocess");
+            postprocess(job);
+        }
+        job.times.postprocess_end = std::chrono::steady_clock::now();
+        host_buffers_.release(std::move(job.host_output));
+        deliver(job);
+    }
+
+    void take(std::vector<Job>& fetch_jobs, Job& job){
+        job.times.taken = std::chrono::steady_clock::now();
+        forget_pending(job);
+        fetch_jobs.emplace_back(std::move(job));
+    }
+
+    /// 任务被 worker 取走之后不会再被丢弃，去掉 pending_by_stream_ 中它的记录，不再持有 promise / callback
+    void forget_pending(const Job& job){
+        if(!job.state) return;
+        std::unique_lock<std::mutex> l(streams_lock_);
+        auto iter = pending_by_stream_.find(job.stream_id);
+        if(iter != pending_by_stream_.end() && iter->second.state == job.state)
+            pending_by_stream_.erase(iter);
+    }
+
+    /// 丢弃 stream_id 还在排队的那一帧，它在队列里的位置会被 worker 跳过
+    void drop_pending(int stream_id){
+        PendingJob pending;
+        {
+            std::unique_lock<std::mutex> l(streams_lock_);
+            auto iter = pending_by_stream_.find(stream_id);
+            if(iter == pending_by_stream_.end()) return;
+            pending = std::move(iter->second);
+            pending_by_stream_.erase(iter);
+        }
+
+        int expected = JOB_QUEUED;
+        if(pending.state && pending.state->compare_exchange_strong(expected, JOB_DROPPED))
+            drop(pending);
+    }
+
 protected:
     StartParam start_param_;
     std::atomic<bool> run_{};
-    std::mutex jobs_lock_;  // 确保往队列里添加任务和取任务同一时间只能执行一种
-    std::queue<Job> jobs_;
+    MPMCQueue<Job> jobs_{1024};  // 无锁有界队列，commit 线程和 worker 之间不再争抢同一把锁
     std::unique_ptr<std::thread> worker_;
-    std::condition_variable cond_;
     std::unique_ptr<TensorAllocator> tensor_allocator_;
+    std::mutex stats_lock_;  // 只保护 batching_ / batch_stats_，每个 batch 加一次，不在任务路径上
+    BatchingConfig batching_;
+    BatchStats batch_stats_;
+    OverloadConfig overload_;
+    std::shared_ptr<InferMetrics> metrics_ = std::make_shared<InferMetrics>();   // 也记录 overload 的拒绝、丢弃数
+    std::mutex streams_lock_;  // 只有 KeepLatestPerStream 使用
+    std::map<int, PendingJob> pending_by_stream_;   // 每个 stream 还在排队的那一帧
+    std::shared_ptr<StreamFrameCounter> frame_counter_ = std::make_shared<StreamFrameCounter>();
+    std::vector<TRT::JobKey> job_keys_;         // bind_job_keys 复用的缓冲区，只在 worker 线程上使用
+    bool job_keys_enabled_ = false;             // 见 use_job_keys
+    PipelineConfig pipeline_;
+    std::unique_ptr<MPMCQueue<Job>> inputs_;    // commit -> 预处理线程，没有预处理线程时为空
+    std::unique_ptr<MPMCQueue<Job>> outputs_;   // worker -> 后处理线程，没有后处理线程时为空
+    std::vector<std::thread> preprocess_threads_;
+    std::vector<std::thread> postprocess_threads_;
+    ObjectPool<std::vector<float>> host_buffers_;   // job.host_output 的缓冲区
 };
 
 #endif // INFER_CONTROLLER_HPP
\ No newline at end of file
@@ -0,0 +1,310 @@
+#include "infer_metrics.hpp"
+#include <mutex>
+#include <thread>
+#include <cstdio>
+#include <algorithm>
+#include <condition_variable>
+#include "ilogger.hpp"
+
+using namespace std;
+
+const char* infer_stage_name(InferStage stage){
+    switch(stage){
+        case InferStage::QueueWait:     return "queue_wait";
+        case InferStage::Preprocess:    return "preprocess";
+        case InferStage::BatchAssembly: return "batch_assembly";
+        case InferStage::Forward:       return "forward";
+        case InferStage::Postprocess:   return "postprocess";
+        case InferStage::Delivery:      return "delivery";
+        case InferStage::Total:         return "total";
+        default: return "unknow";
+    }
+}
+
+/// ----------------------------------- LatencyHistogram -----------------------------------
+
+int LatencyHistogram::bucket_index(uint64_t us){
+    if(us < 4) return (int)us;
+
+    // us 落在 [2^k, 2^(k+1))，再按 2^(k-2) 分成 4 档
+    int k = 63 - __builtin_clzll((unsigned long long)us);
+    int index = 4 * (k - 1) + (int)((us >> (k - 2)) & 3);
+    return min(index, NUM_BUCKETS - 1);
+}
+
+uint64_t LatencyHistogram::bucket_upper(int index){
+    if(index < 4) return index;
+
+    int k = index / 4 + 1;
+    uint64_t step = (uint64_t)1 << (k - 2);
+    return (4 + index % 4) * step + step - 1;
+}
+
+void LatencyHistogram::record(uint64_t us){
+    buckets_[bucket_index(us)].fetch_add(1, memory_order_relaxed);
+    count_.fetch_add(1, memory_order_relaxed);
+    sum_us_.fetch_add(us, memory_order_relaxed);
+
+    uint64_t old_max = max_us_.load(memory_order_relaxed);
+    while(us > old_max && !max_us_.compare_exchange_weak(old_max, us, memory_order_relaxed));
+}
+
+HistogramSnapshot LatencyHistogram::snapshot() const{
+    HistogramSnapshot output;
+    output.buckets.resize(NUM_BUCKETS);
+    for(int i = 0; i < NUM_BUCKETS; ++i)
+        output.buckets[i] = buckets_[i].load(memory_order_relaxed);
+
+    output.count  = count_.load(memory_order_relaxed);
+    output.sum_us = sum_us_.load(memory_order_relaxed);
+    output.max_us = max_us_.load(memory_order_relaxed);
+    return output;
+}
+
+double HistogramSnapshot::percentile(double q) const{
+    uint64_t total = 0;
+    for(auto n : buckets) total += n;
+    if(total == 0) return 0;
+
+    uint64_t rank = max<uint64_t>(1, (uint64_t)(q * total + 0.5));
+    uint64_t seen = 0;
+    for(int i = 0; i < buckets.size(); ++i){
+        seen += buckets[i];
+        if(seen >= rank)
+            return (double)min(LatencyHistogram::bucket_upper(i), max_us);
+    }
+    return (double)max_us;
+}
+
+/// ----------------------------------- InferMetrics -----------------------------------
+
+InferMetrics::InferMetrics(){
+    start_time_ = chrono::steady_clock::now();
+}
+
+static bool is_set(const JobTimes::time_point& t){
+    return t.time_since_epoch().count() != 0;
+}
+
+void InferMetrics::record_job(const JobTimes& t, JobTimes::time_point delivered){
+
+    auto record = [&](InferStage stage, chrono::steady_clock::duration d){
+        auto us = chrono::duration_cast<chrono::microseconds>(d).count();
+        stages_[(int)stage].record(us < 0 ? 0 : (uint64_t)us);
+    };
+
+    // 任务可能没有经过某些阶段（没有预处理线程、worker 直接 deliver），两端都有时间点才统计
+    auto span = [&](const JobTimes::time_point& begin, const JobTimes::time_point& end){
+        return is_set(begin) && is_set(end) ? end - begin : chrono::steady_clock::duration::zero();
+    };
+
+    record(InferStage::QueueWait, span(t.submit, t.preprocess_begin) + span(t.enqueue, t.taken) + span(t.forward_end, t.postprocess_begin));
+    if(is_set(t.preprocess_begin) && is_set(t.enqueue)) record(InferStage::Preprocess, t.enqueue - t.preprocess_begin);
+    if(is_set(t.taken) && is_set(t.batch_ready))        record(InferStage::BatchAssembly, t.batch_ready - t.taken);
+    if(is_set(t.batch_ready) && is_set(t.forward_end))  record(InferStage::Forward, t.forward_end - t.batch_ready);
+    if(is_set(t.postprocess_begin) && is_set(t.postprocess_end))
+        record(InferStage::Postprocess, t.postprocess_end - t.postprocess_begin);
+    if(is_set(t.postprocess_end)) record(InferStage::Delivery, delivered - t.postprocess_end);
+    if(is_set(t.submit))          record(InferStage::Total, delivered - t.submit);
+    num_completed_.fetch_add(1, memory_order_relaxed);
+}
+
+void InferMetrics::record_batch(int batch, int capacity){
+    num_batches_.fetch_add(1, memory_order_relaxed);
+    batch_jobs_.fetch_add(batch, memory_order_relaxed);
+    batch_slots_.fetch_add(capacity, memory_order_relaxed);
+}
+
+MetricsSnapshot InferMetrics::snapshot() const{
+    MetricsSnapshot output;
+    output.controller    = controller_;
+    output.instance      = instance_;
+    output.uptime_s      = chrono::duration<double>(chrono::steady_clock::now() - start_time_).count();
+    output.num_completed = num_completed_.load(memory_order_relaxed);
+    output.num_rejected  = num_rejected_.load(memory_order_relaxed);
+    output.num_dropped   = num_dropped_.load(memory_order_relaxed);
+    output.num_batches   = num_batches_.load(memory_order_relaxed);
+    output.batch_jobs    = batch_jobs_.load(memory_order_relaxed);
+    output.batch_slots   = batch_slots_.load(memory_order_relaxed);
+    for(int i = 0; i < (int)InferStage::Count; ++i)
+        output.stages[i] = stages_[i].snapshot();
+    return output;
+}
+
+string MetricsSnapshot::to_string() const{
+    string output = iLogger::format("%s[%d]: %llu jobs, %.1f jobs/s, batch fill %.1f%%",
+                                    controller.c_str(), instance, (unsigned long long)num_completed,
+                                    throughput(), batch_fill() * 100);
+    for(int i = 0; i < (int)InferStage::Count; ++i){
+        auto& stage = stages[i];
+        if(stage.count == 0) continue;
+        output += iLogger::format("\n    %-15s p50 %8.3f ms, p90 %8.3f ms, p99 %8.3f ms, max %8.3f ms",
+                                  infer_stage_name((InferStage)i),
+                                  stage.percentile(0.5) / 1000, stage.percentile(0.9) / 1000,
+                                  stage.percentile(0.99) / 1000, stage.max_us / 1000.0);
+    }
+    return output;
+}
+
+/// ----------------------------------- registry -----------------------------------
+
+static mutex g_registry_lock;
+
+static vector<weak_ptr<InferMetrics>>& registry(){
+    static auto items = new vector<weak_ptr<InferMetrics>>();
+    return *items;
+}
+
+void register_infer_metrics(const shared_ptr<InferMetrics>& metrics, const string& controller){
+    unique_lock<mutex> l(g_registry_lock);
+    auto& items = registry();
+    items.erase(remove_if(items.begin(), items.end(), [](const weak_ptr<InferMetrics>& item){ return item.expired(); }), items.end());
+
+    int instance = 0;
+    for(auto& item : items){
+        auto other = item.lock();
+        if(other && other->controller_ == controller)
+            instance = max(instance, other->instance_ + 1);
+    }
+
+    metrics->controller_ = controller;
+    metrics->instance_   = instance;
+    metrics->start_time_ = chrono::steady_clock::now();
+    items.emplace_back(metrics);
+}
+
+vector<MetricsSnapshot> infer_metrics_snapshot(){
+    vector<shared_ptr<InferMetrics>> alive;
+    {
+        unique_lock<mutex> l(g_registry_lock);
+        for(auto& item : registry()){
+            auto metrics = item.lock();
+            if(metrics) alive.emplace_back(metrics);
+        }
+    }
+
+    vector<MetricsSnapshot> output;
+    for(auto& metrics : alive)
+        output.emplace_back(metrics->snapshot());
+    return output;
+}
+
+string infer_metrics_prometheus(const vector<MetricsSnapshot>& snapshots){
+
+    auto labels = [](const MetricsSnapshot& s){
+        return iLogger::format("controller=\"%s\",instance=\"%d\"", s.controller.c_str(), s.instance);
+    };
+
+    string output;
+    output += "# HELP linfer_stage_latency_seconds Latency of each stage between commit and result delivery.\n";
+    output += "# TYPE linfer_stage_latency_seconds summary\n";
+    for(auto& s : snapshots){
+        for(int i = 0; i < (int)InferStage::Count; ++i){
+            auto& stage = s.stages[i];
+            string stage_labels = labels(s) + iLogger::format(",stage=\"%s\"", infer_stage_name((InferStage)i));
+            for(double q : {0.5, 0.9, 0.99})
+                output += iLogger::format("linfer_stage_latency_seconds{%s,quantile=\"%g\"} %.6f\n", stage_labels.c_str(), q, stage.percentile(q) / 1e6);
+            output += iLogger::format("linfer_stage_latency_seconds_sum{%s} %.6f\n", stage_labels.c_str(), stage.sum_us / 1e6);
+            output += iLogger::format("linfer_stage_latency_seconds_count{%s} %llu\n", stage_labels.c_str(), (unsigned long long)stage.count);
+        }
+    }
+
+    output += "# HELP linfer_stage_latency_max_seconds Max latency of each stage since startup.\n";
+    output += "# TYPE linfer_stage_latency_max_seconds gauge\n";
+    for(auto& s : snapshots){
+        for(int i = 0; i < (int)InferStage::Count; ++i)
+            output += iLogger::format("linfer_stage_latency_max_seconds{%s,stage=\"%s\"} %.6f\n", labels(s).c_str(),
+                                      infer_stage_name((InferStage)i), s.stages[i].max_us / 1e6);
+    }
+
+    auto counter = [&](const char* name, const char* help, uint64_t MetricsSnapshot::* field){
+        output += iLogger::format("# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+        for(auto& s : snapshots)
+            output += iLogger::format("%s{%s} %llu\n", name, labels(s).c_str(), (unsigned long long)(s.*field));
+    };
+    counter("linfer_jobs_completed_total", "Jobs whose result was delivered.", &MetricsSnapshot::num_completed);
+    counter("linfer_jobs_rejected_total",  "Jobs rejected at commit by the overload policy.", &MetricsSnapshot::num_rejected);
+    counter("linfer_jobs_dropped_total",   "Queued jobs dropped by the overload policy.", &MetricsSnapshot::num_dropped);
+    counter("linfer_batches_total",        "Batches fed to the model.", &MetricsSnapshot::num_batches);
+    counter("linfer_batch_jobs_total",     "Sum of batch sizes.", &MetricsSnapshot::batch_jobs);
+    counter("linfer_batch_slots_total",    "Sum of batch capacities.", &MetricsSnapshot::batch_slots);
+
+    auto gauge = [&](const char* name, const char* help, double (*value)(const MetricsSnapshot&)){
+        output += iLogger::format("# HELP %s %s\n# TYPE %s gauge\n", name, help, name);
+        for(auto& s : snapshots)
+            output += iLogger::format("%s{%s} %.6f\n", name, labels(s).c_str(), value(s));
+    };
+    gauge("linfer_throughput_jobs_per_second", "Completed jobs per second since startup.", [](const MetricsSnapshot& s){ return s.throughput(); });
+    gauge("linfer_batch_fill_ratio", "Average batch size over batch capacity.", [](const MetricsSnapshot& s){ return s.batch_fill(); });
+    gauge("linfer_uptime_seconds", "Seconds since the controller started.", [](const MetricsSnapshot& s){ return s.uptime_s; });
+    return output;
+}
+
+/// ----------------------------------- periodic dump -----------------------------------
+
+struct MetricsDumper{
+    mutex lock;
+    condition_variable cond;
+    thread worker;
+    bool run = false;
+    string file;
+    int interval_ms = 5000;
+};
+
+static MetricsDumper& dumper(){
+    static auto instance = new MetricsDumper();
+    return *instance;
+}
+
+static bool write_metrics_file(const string& file){
+    string tmp = file + ".tmp";
+    if(!iLogger::save_file(tmp, infer_metrics_prometheus(infer_metrics_snapshot())))
+        return false;
+
+    if(::rename(tmp.c_str(), file.c_str()) != 0){
+        INFOE("Rename %s to %s failed", tmp.c_str(), file.c_str());
+        return false;
+    }
+    return true;
+}
+
+static void dump_loop(){
+    auto& d = dumper();
+    unique_lock<mutex> l(d.lock);
+    while(d.run){
+        if(d.cond.wait_for(l, chrono::milliseconds(d.interval_ms), [&](){ return !d.run; }))
+            break;
+
+        string file = d.file;
+        l.unlock();
+        write_metrics_file(file);
+        l.lock();
+    }
+}
+
+bool start_metrics_dump(const string& file, int interval_ms){
+    stop_metrics_dump();
+    if(file.empty() || interval_ms <= 0){
+        INFOE("Invalid metrics dump setting: file = [%s], interval = %d ms", file.c_str(), interval_ms);
+        return false;
+    }
+
+    auto& d = dumper();
+    unique_lock<mutex> l(d.lock);
+    d.file        = file;
+    d.interval_ms = interval_ms;
+    d.run         = true;
+    d.worker      = thread(dump_loop);
+    return true;
+}
+
+void stop_metrics_dump(){
+    auto& d = dumper();
+    {
+        unique_lock<mutex> l(d.lock);
+        if(!d.run) return;
+        d.run = false;
+    }
+    d.cond.notify_all();
+    d.worker.join();
+}
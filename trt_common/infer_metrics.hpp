@@ -0,0 +1,132 @@
+#ifndef INFER_METRICS_HPP
+#define INFER_METRICS_HPP
+
+/// InferController 的延迟统计
+/// 每个任务记录从 commit 到结果交付之间各个阶段的时间点，交付时写入无锁的直方图（只有原子加），
+/// 另外统计吞吐、batch 填充率，支持快照和周期性地以 Prometheus 文本格式写文件
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+enum class InferStage : int{
+    QueueWait     = 0,   // 在各个队列里等待的时间：commit -> 预处理、入队 -> worker 取走、forward 结束 -> 后处理
+    Preprocess    = 1,
+    BatchAssembly = 2,   // worker 取走任务之后等待凑 batch
+    Forward       = 3,   // 拷贝输入、forward、GPU decode、拷回 host
+    Postprocess   = 4,   // 解析 decode 结果、CPU nms
+    Delivery      = 5,   // set_value / callback
+    Total         = 6,   // commit -> 交付完成
+    Count         = 7
+};
+
+const char* infer_stage_name(InferStage stage);
+
+/// 任务经过各阶段的时间点，没有经过的阶段保持默认值，统计时跳过
+struct JobTimes{
+    using time_point = std::chrono::steady_clock::time_point;
+    time_point submit;
+    time_point preprocess_begin;
+    time_point enqueue;              // 预处理完成、进入 worker 队列，也是凑 batch 等待的起点
+    time_point taken;
+    time_point batch_ready;
+    time_point forward_end;
+    time_point postprocess_begin;
+    time_point postprocess_end;
+};
+
+struct HistogramSnapshot{
+    uint64_t count  = 0;
+    uint64_t sum_us = 0;
+    uint64_t max_us = 0;
+    std::vector<uint64_t> buckets;
+
+    /// q 取 [0, 1]，返回所在桶的上界（不超过 max），单位 us
+    double percentile(double q) const;
+    double mean_us() const{ return count == 0 ? 0 : sum_us / (double)count; }
+};
+
+/// 单位 us 的对数直方图：每个 2 的幂之间分 4 档，相对误差不超过 25%，最大约 67 秒
+/// record 只有 relaxed 原子操作，多个线程并发写不加锁；快照不是严格一致的切面，用于监控足够
+class LatencyHistogram{
+public:
+    static const int NUM_BUCKETS = 104;
+
+    void record(uint64_t us);
+    HistogramSnapshot snapshot() const;
+
+    static int bucket_index(uint64_t us);
+    static uint64_t bucket_upper(int index);
+
+private:
+    std::atomic<uint64_t> buckets_[NUM_BUCKETS]{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_us_{0};
+    std::atomic<uint64_t> max_us_{0};
+};
+
+struct MetricsSnapshot{
+    std::string controller;
+    int instance        = 0;
+    double uptime_s     = 0;
+    uint64_t num_completed = 0;
+    uint64_t num_rejected  = 0;
+    uint64_t num_dropped   = 0;
+    uint64_t num_batches   = 0;
+    uint64_t batch_jobs    = 0;   // 所有 batch 的任务数之和
+    uint64_t batch_slots   = 0;   // 所有 batch 的容量之和
+    HistogramSnapshot stages[(int)InferStage::Count];
+
+    double throughput() const{ return uptime_s <= 0 ? 0 : num_completed / uptime_s; }
+    double batch_fill() const{ return batch_slots == 0 ? 0 : batch_jobs / (double)batch_slots; }
+
+    /// 一行一个阶段：p50 / p90 / p99 / max，单位 ms
+    std::string to_string() const;
+};
+
+/// 一个 controller 的统计，由 controller 持有，注册到全局表之后可以被快照和 dump
+class InferMetrics{
+public:
+    InferMetrics();
+
+    void record_job(const JobTimes& times, JobTimes::time_point delivered);
+    void record_batch(int batch, int capacity);
+    void add_rejected(){ num_rejected_.fetch_add(1, std::memory_order_relaxed); }
+    void add_dropped(){ num_dropped_.fetch_add(1, std::memory_order_relaxed); }
+    uint64_t num_rejected() const{ return num_rejected_.load(std::memory_order_relaxed); }
+    uint64_t num_dropped() const{ return num_dropped_.load(std::memory_order_relaxed); }
+
+    MetricsSnapshot snapshot() const;
+
+private:
+    friend void register_infer_metrics(const std::shared_ptr<InferMetrics>& metrics, const std::string& controller);
+
+    std::string controller_ = "controller";
+    int instance_ = 0;
+    JobTimes::time_point start_time_;
+    LatencyHistogram stages_[(int)InferStage::Count];
+    std::atomic<uint64_t> num_completed_{0};
+    std::atomic<uint64_t> num_rejected_{0};
+    std::atomic<uint64_t> num_dropped_{0};
+    std::atomic<uint64_t> num_batches_{0};
+    std::atomic<uint64_t> batch_jobs_{0};
+    std::atomic<uint64_t> batch_slots_{0};
+};
+
+/// controller 在 startup 时注册，同名的 controller（比如多个副本）按注册顺序编号 instance
+/// 全局表只持有 weak_ptr，controller 析构之后不再出现在快照里
+void register_infer_metrics(const std::shared_ptr<InferMetrics>& metrics, const std::string& controller);
+std::vector<MetricsSnapshot> infer_metrics_snapshot();
+
+/// Prometheus text exposition format（summary + counter + gauge），时间单位为秒
+std::string infer_metrics_prometheus(const std::vector<MetricsSnapshot>& snapshots);
+
+/// 后台线程每 interval_ms 把所有 controller 的统计写到 file（先写临时文件再 rename，读取方不会读到一半）
+/// 文件里只有还存活的 controller；再次调用会替换之前的设置
+bool start_metrics_dump(const std::string& file, int interval_ms = 5000);
+void stop_metrics_dump();
+
+#endif // INFER_METRICS_HPP
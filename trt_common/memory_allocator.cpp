@@ -0,0 +1,209 @@
+#include "memory_allocator.hpp"
+#include <cstdlib>
+#include <algorithm>
+#include "ilogger.hpp"
+
+using namespace std;
+
+namespace TRT {
+
+    const char* memory_kind_name(MemoryKind kind){
+        switch(kind){
+            case MemoryKind::Host:   return "host";
+            case MemoryKind::Pinned: return "pinned";
+            case MemoryKind::Device: return "device";
+            default: return "unknow";
+        }
+    }
+
+    /// ----------------------------------- CachingAllocator -----------------------------------
+
+    CachingAllocator::CachingAllocator(shared_ptr<MemoryAllocator> upstream, size_t max_cached_bytes){
+        upstream_ = upstream;
+        max_cached_bytes_ = max_cached_bytes;
+    }
+
+    CachingAllocator::~CachingAllocator(){
+        trim();
+    }
+
+    size_t CachingAllocator::size_class(size_t size){
+        const size_t MIN_CLASS = 512;
+        if(size <= MIN_CLASS) return MIN_CLASS;
+
+        // size 落在 (2^k, 2^(k+1)]，按 2^(k-2) 向上取整
+        int k = 63 - __builtin_clzll((unsigned long long)(size - 1));
+        size_t step = (size_t)1 << (k - 2);
+        return (size + step - 1) / step * step;
+    }
+
+    MemoryBlock CachingAllocator::allocate(MemoryKind kind, int device_id, size_t size){
+
+        MemoryBlock block;
+        block.capacity = size_class(size);
+        {
+            unique_lock<mutex> l(lock_);
+            auto iter = free_blocks_.find(make_tuple((int)kind, device_id, block.capacity));
+            if(iter != free_blocks_.end() && !iter->second.empty()){
+                block.ptr = iter->second.back();
+                iter->second.pop_back();
+                cached_bytes_[(int)kind] -= block.capacity;
+                stats_.num_hit++;
+                return block;
+            }
+            stats_.num_miss++;
+        }
+
+        auto upstream_block = upstream_->allocate(kind, device_id, block.capacity);
+        if(upstream_block.ptr == nullptr){
+            // 可能是缓存占住了显存，释放缓存之后再试一次
+            trim();
+            upstream_block = upstream_->allocate(kind, device_id, block.capacity);
+        }
+
+        block.ptr = upstream_block.ptr;
+        if(block.ptr == nullptr) block.capacity = 0;
+        return block;
+    }
+
+    void CachingAllocator::deallocate(MemoryKind kind, int device_id, const MemoryBlock& block){
+
+        if(block.ptr == nullptr) return;
+
+        if(kind != MemoryKind::Host)
+            upstream_->synchronize(kind, device_id);
+
+        {
+            unique_lock<mutex> l(lock_);
+            if(cached_bytes_[(int)kind] + block.capacity <= max_cached_bytes_){
+                free_blocks_[make_tuple((int)kind, device_id, block.capacity)].push_back(block.ptr);
+                cached_bytes_[(int)kind] += block.capacity;
+                return;
+            }
+        }
+        upstream_->deallocate(kind, device_id, block);
+    }
+
+    void CachingAllocator::trim(){
+
+        decltype(free_blocks_) blocks;
+        {
+            unique_lock<mutex> l(lock_);
+            blocks.swap(free_blocks_);
+            fill(begin(cached_bytes_), end(cached_bytes_), 0);
+        }
+
+        for(auto& item : blocks){
+            MemoryKind kind = (MemoryKind)get<0>(item.first);
+            int device_id   = get<1>(item.first);
+            MemoryBlock block;
+            block.capacity  = get<2>(item.first);
+            for(auto ptr : item.second){
+                block.ptr = ptr;
+                upstream_->deallocate(kind, device_id, block);
+            }
+        }
+    }
+
+    CacheStats CachingAllocator::stats(){
+        unique_lock<mutex> l(lock_);
+        CacheStats output = stats_;
+        for(auto bytes : cached_bytes_)
+            output.cached_bytes += bytes;
+        return output;
+    }
+
+    /// ----------------------------------- host allocator -----------------------------------
+
+    class HostAllocator : public MemoryAllocator{
+    public:
+        MemoryBlock allocate(MemoryKind kind, int device_id, size_t size) override{
+            MemoryBlock block;
+            if(kind != MemoryKind::Host){
+                INFOE("Host allocator can not allocate %s memory", memory_kind_name(kind));
+                return block;
+            }
+
+            block.ptr = malloc(size);
+            block.capacity = block.ptr ? size : 0;
+            return block;
+        }
+
+        void deallocate(MemoryKind kind, int device_id, const MemoryBlock& block) override{
+            free(block.ptr);
+        }
+    };
+
+    shared_ptr<MemoryAllocator> create_host_allocator(){
+        return make_shared<HostAllocator>();
+    }
+
+    /// ----------------------------------- default allocator -----------------------------------
+
+    static mutex g_allocator_lock;
+
+    static shared_ptr<MemoryAllocator>& default_allocator(){
+        // 故意不析构：进程退出时 CUDA runtime 可能已经卸载，这时再 cudaFree 只会报错
+        static auto allocator = new shared_ptr<MemoryAllocator>();
+        return *allocator;
+    }
+
+    void set_memory_allocator(shared_ptr<MemoryAllocator> allocator){
+        unique_lock<mutex> l(g_allocator_lock);
+        default_allocator() = allocator;
+    }
+
+    shared_ptr<MemoryAllocator> get_memory_allocator(){
+        unique_lock<mutex> l(g_allocator_lock);
+        auto& allocator = default_allocator();
+        if(allocator == nullptr)
+            allocator = make_shared<CachingAllocator>(create_system_allocator());
+        return allocator;
+    }
+
+    /// ----------------------------------- memory stats -----------------------------------
+
+    static mutex g_stats_lock;
+
+    static map<pair<string, int>, MemoryStats>& stats_table(){
+        static auto table = new map<pair<string, int>, MemoryStats>();
+        return *table;
+    }
+
+    void update_memory_stats(const string& owner, MemoryKind kind, int64_t delta){
+        unique_lock<mutex> l(g_stats_lock);
+        auto& stats = stats_table()[make_pair(owner, (int)kind)];
+        if(stats.owner.empty()){
+            stats.owner = owner;
+            stats.kind  = kind;
+        }
+
+        if(delta > 0){
+            stats.num_alloc++;
+            stats.live_bytes += delta;
+            stats.peak_bytes = max(stats.peak_bytes, stats.live_bytes);
+        }else{
+            stats.live_bytes -= min(stats.live_bytes, (size_t)-delta);
+        }
+    }
+
+    vector<MemoryStats> memory_stats(){
+        unique_lock<mutex> l(g_stats_lock);
+        vector<MemoryStats> output;
+        for(auto& item : stats_table())
+            output.push_back(item.second);
+        return output;
+    }
+
+    string memory_stats_string(){
+        string output;
+        for(auto& stats : memory_stats()){
+            output += iLogger::format("\n    %-20s %-6s live %10.2f MB, peak %10.2f MB, %llu allocations",
+                                      stats.owner.c_str(), memory_kind_name(stats.kind),
+                                      stats.live_bytes / 1024.0 / 1024.0, stats.peak_bytes / 1024.0 / 1024.0,
+                                      (unsigned long long)stats.num_alloc);
+        }
+        return output;
+    }
+
+};
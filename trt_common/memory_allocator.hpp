@@ -0,0 +1,101 @@
+#ifndef MEMORY_ALLOCATOR_HPP
+#define MEMORY_ALLOCATOR_HPP
+
+/// MixMemory 的底层分配器
+/// 默认在 system 分配器（malloc / cudaMallocHost / cudaMalloc）前面挂一个按 size class 缓存的 CachingAllocator，
+/// 释放的块留在缓存里，下一次同一个 size class 的申请直接复用，不再调用 CUDA 的分配接口
+/// 另外按 owner 统计每种内存当前的占用和峰值
+
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+namespace TRT {
+
+    enum class MemoryKind : int{
+        Host   = 0,   // 普通的 host 内存（CPU_DEVICE_ID）
+        Pinned = 1,   // cudaMallocHost
+        Device = 2    // cudaMalloc
+    };
+
+    const char* memory_kind_name(MemoryKind kind);
+
+    struct MemoryBlock{
+        void* ptr       = nullptr;
+        size_t capacity = 0;      // 实际可用的大小，不小于申请的大小
+    };
+
+    class MemoryAllocator{
+    public:
+        virtual ~MemoryAllocator() = default;
+        virtual MemoryBlock allocate(MemoryKind kind, int device_id, size_t size) = 0;
+        virtual void deallocate(MemoryKind kind, int device_id, const MemoryBlock& block) = 0;
+
+        /// 块被复用之前调用，等待设备上可能还在使用它的操作完成（cudaFree / cudaFreeHost 本身就带这个同步）
+        virtual void synchronize(MemoryKind kind, int device_id){}
+
+        /// 把缓存的块还给系统
+        virtual void trim(){}
+    };
+
+    struct CacheStats{
+        uint64_t num_hit    = 0;
+        uint64_t num_miss   = 0;
+        size_t cached_bytes = 0;
+    };
+
+    /// 按 size class 缓存释放的块，真正的分配交给 upstream
+    class CachingAllocator : public MemoryAllocator{
+    public:
+        /// max_cached_bytes：每种 MemoryKind 最多缓存的字节数，超过时直接还给 upstream
+        explicit CachingAllocator(std::shared_ptr<MemoryAllocator> upstream, size_t max_cached_bytes = 512ull << 20);
+        ~CachingAllocator() override;
+
+        MemoryBlock allocate(MemoryKind kind, int device_id, size_t size) override;
+        void deallocate(MemoryKind kind, int device_id, const MemoryBlock& block) override;
+        void trim() override;
+        CacheStats stats();
+
+        /// 512 字节以下统一为 512，之后每个 2 的幂之间分 4 档，向上取整浪费不超过 25%
+        static size_t size_class(size_t size);
+
+    private:
+        std::mutex lock_;
+        std::shared_ptr<MemoryAllocator> upstream_;
+        size_t max_cached_bytes_ = 0;
+        std::map<std::tuple<int, int, size_t>, std::vector<void*>> free_blocks_;   // (kind, device_id, size class)
+        size_t cached_bytes_[3]{};
+        CacheStats stats_;
+    };
+
+    /// 只支持 MemoryKind::Host 的 malloc 实现，不依赖 CUDA，用来在没有 GPU 的机器上测试
+    std::shared_ptr<MemoryAllocator> create_host_allocator();
+
+    /// 直接调用 malloc / cudaMallocHost / cudaMalloc，不做缓存（原来 MixMemory 的行为）
+    std::shared_ptr<MemoryAllocator> create_system_allocator();
+
+    /// 之后新建的 MixMemory 使用的分配器，已经存在的 MixMemory 继续使用创建时的分配器
+    /// 默认为 CachingAllocator(create_system_allocator())
+    void set_memory_allocator(std::shared_ptr<MemoryAllocator> allocator);
+    std::shared_ptr<MemoryAllocator> get_memory_allocator();
+
+    struct MemoryStats{
+        std::string owner;
+        MemoryKind kind   = MemoryKind::Host;
+        size_t live_bytes = 0;
+        size_t peak_bytes = 0;
+        uint64_t num_alloc = 0;
+    };
+
+    /// MixMemory 分配 / 释放时调用，delta 为块的 capacity
+    void update_memory_stats(const std::string& owner, MemoryKind kind, int64_t delta);
+    std::vector<MemoryStats> memory_stats();
+    std::string memory_stats_string();
+
+};
+
+#endif // MEMORY_ALLOCATOR_HPP
@@ -0,0 +1,192 @@
+/**
+ * 有界无锁多生产者多消费者队列
+ * 数据路径基于 Dmitry Vyukov 的 bounded MPMC queue，每个 cell 带一个序号，push/pop 只做一次 CAS
+ * 阻塞等待用 EventCount 实现：只有真正需要睡眠时才会碰到 mutex，生产消费都不拥塞时不加锁
+ **/
+
+#ifndef MPMC_QUEUE_HPP
+#define MPMC_QUEUE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <utility>
+#include "event_count.hpp"
+
+template<class T>
+class MPMCQueue{
+public:
+    /// capacity 会向上取整到 2 的幂
+    explicit MPMCQueue(size_t capacity = 1024){
+        size_t size = 2;
+        while(size < capacity) size <<= 1;
+
+        mask_  = size - 1;
+        cells_.reset(new Cell[size]);
+        for(size_t i = 0; i < size; ++i)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MPMCQueue(const MPMCQueue&) = delete;
+    MPMCQueue& operator = (const MPMCQueue&) = delete;
+
+    virtual ~MPMCQueue(){
+        T value;
+        while(try_pop(value));
+    }
+
+    /// 非阻塞，队列满时返回 false
+    bool try_push(T&& value){
+        Cell* cell = nullptr;
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for(;;){
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if(diff == 0){
+                if(enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }else if(diff < 0){
+                return false;
+            }else{
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        new (cell->storage) T(std::move(value));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        not_empty_.notify_one();
+        return true;
+    }
+
+    /// 非阻塞，队列空时返回 false
+    bool try_pop(T& value){
+        Cell* cell = nullptr;
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        for(;;){
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if(diff == 0){
+                if(dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }else if(diff < 0){
+                return false;
+            }else{
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        T* pitem = reinterpret_cast<T*>(cell->storage);
+        value = std::move(*pitem);
+        pitem->~T();
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        not_full_.notify_one();
+        return true;
+    }
+
+    /// 阻塞，队列满时等待，队列被 close 时返回 false
+    bool push(T&& value){
+        for(;;){
+            if(closed_.load(std::memory_order_acquire)) return false;
+            if(try_push(std::move(value))) return true;
+
+            auto key = not_full_.prepare_wait();
+            if(closed_.load(std::memory_order_acquire)){
+                not_full_.cancel_wait();
+                return false;
+            }
+            if(try_push(std::move(value))){
+                not_full_.cancel_wait();
+                return true;
+            }
+            not_full_.wait(key);
+        }
+    }
+
+    bool push(const T& value){
+        T copy(value);
+        return push(std::move(copy));
+    }
+
+    /// 阻塞，队列空时等待；close 之后仍然可以取出剩余的元素，取完返回 false
+    bool pop(T& value){
+        for(;;){
+            if(try_pop(value)) return true;
+
+            auto key = not_empty_.prepare_wait();
+            if(try_pop(value)){
+                not_empty_.cancel_wait();
+                return true;
+            }
+            if(closed_.load(std::memory_order_acquire)){
+                not_empty_.cancel_wait();
+                return false;
+            }
+            not_empty_.wait(key);
+        }
+    }
+
+    /// 同 pop，超过 deadline 仍为空时返回 false
+    template<class Clock, class Duration>
+    bool pop_until(T& value, const std::chrono::time_point<Clock, Duration>& deadline){
+        for(;;){
+            if(try_pop(value)) return true;
+
+            auto key = not_empty_.prepare_wait();
+            if(try_pop(value)){
+                not_empty_.cancel_wait();
+                return true;
+            }
+            if(closed_.load(std::memory_order_acquire)){
+                not_empty_.cancel_wait();
+                return false;
+            }
+            if(!not_empty_.wait_until(key, deadline))
+                return try_pop(value);
+        }
+    }
+
+    /// 唤醒所有等待的生产者和消费者，之后 push 失败
+    void close(){
+        closed_.store(true, std::memory_order_release);
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+    void open(){
+        closed_.store(false, std::memory_order_release);
+    }
+
+    bool closed() const{
+        return closed_.load(std::memory_order_acquire);
+    }
+
+    /// 并发修改时只是近似值
+    size_t size() const{
+        size_t tail = enqueue_pos_.load(std::memory_order_relaxed);
+        size_t head = dequeue_pos_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    bool empty() const{ return size() == 0; }
+    size_t capacity() const{ return mask_ + 1; }
+
+private:
+    struct Cell{
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    static constexpr size_t CACHE_LINE = 64;
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+    alignas(CACHE_LINE) std::atomic<size_t> enqueue_pos_{0};
+    alignas(CACHE_LINE) std::atomic<size_t> dequeue_pos_{0};
+    alignas(CACHE_LINE) std::atomic<bool> closed_{false};
+    EventCount not_empty_;
+    EventCount not_full_;
+};
+
+#endif // MPMC_QUEUE_HPP
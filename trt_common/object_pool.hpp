@@ -0,0 +1,139 @@
+/**
+ * 对象池
+ * 每个任务都要用到的小对象（promise 的共享状态、shared_ptr 控制块、decode 结果的缓冲区）
+ * 在稳定运行后复用，不再每帧向堆申请
+ **/
+
+#ifndef OBJECT_POOL_HPP
+#define OBJECT_POOL_HPP
+
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <future>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <new>
+
+/// 固定大小内存块的空闲链表，按 (Size, Align) 区分，全进程共享一个实例
+/// 空闲块超过 MAX_FREE 时直接还给堆，池子的大小只和同时在途的任务数有关
+template<size_t Size, size_t Align>
+class BlockPool{
+public:
+    static_assert(Align <= alignof(std::max_align_t), "over-aligned type is not supported");
+
+    static BlockPool& instance(){
+        // 故意不析构，静态对象析构时可能还有 shared_future 持有池里的块
+        static BlockPool* pool = new BlockPool();
+        return *pool;
+    }
+
+    void* allocate(){
+        {
+            std::unique_lock<std::mutex> l(lock_);
+            if(free_ != nullptr){
+                Node* node = free_;
+                free_ = node->next;
+                num_free_--;
+                return node;
+            }
+        }
+        num_heap_.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(BLOCK_SIZE);
+    }
+
+    void deallocate(void* p){
+        {
+            std::unique_lock<std::mutex> l(lock_);
+            if(num_free_ < MAX_FREE){
+                Node* node = static_cast<Node*>(p);
+                node->next = free_;
+                free_ = node;
+                num_free_++;
+                return;
+            }
+        }
+        ::operator delete(p);
+    }
+
+    /// 累计向堆申请的块数，稳定运行后不再增长
+    size_t num_heap() const{ return num_heap_.load(std::memory_order_relaxed); }
+
+private:
+    struct Node{ Node* next; };
+
+    static constexpr size_t BLOCK_SIZE = Size < sizeof(Node) ? sizeof(Node) : Size;
+    static constexpr size_t MAX_FREE   = 4096;
+
+    std::mutex lock_;
+    Node* free_ = nullptr;
+    size_t num_free_ = 0;
+    std::atomic<size_t> num_heap_{0};
+};
+
+/// 标准库兼容的分配器，单个对象从 BlockPool 分配，用于 allocate_shared / promise(allocator_arg, ...)
+template<class T>
+class PoolAllocator{
+public:
+    using value_type = T;
+
+    PoolAllocator() = default;
+
+    template<class U>
+    PoolAllocator(const PoolAllocator<U>&){}
+
+    T* allocate(size_t n){
+        if(n != 1) return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(BlockPool<sizeof(T), alignof(T)>::instance().allocate());
+    }
+
+    void deallocate(T* p, size_t n){
+        if(n != 1){
+            ::operator delete(p);
+            return;
+        }
+        BlockPool<sizeof(T), alignof(T)>::instance().deallocate(p);
+    }
+
+    template<class U>
+    bool operator == (const PoolAllocator<U>&) const{ return true; }
+
+    template<class U>
+    bool operator != (const PoolAllocator<U>&) const{ return false; }
+};
+
+/// 可以复用容量的对象（比如 std::vector）的池，acquire 拿不到时返回默认构造的对象
+template<class T>
+class ObjectPool{
+public:
+    explicit ObjectPool(size_t max_free = 64) : max_free_(max_free){}
+
+    T acquire(){
+        std::unique_lock<std::mutex> l(lock_);
+        if(free_.empty()) return T();
+
+        T value = std::move(free_.back());
+        free_.pop_back();
+        return value;
+    }
+
+    void release(T&& value){
+        std::unique_lock<std::mutex> l(lock_);
+        if(free_.size() < max_free_)
+            free_.emplace_back(std::move(value));
+    }
+
+private:
+    std::mutex lock_;
+    std::vector<T> free_;
+    size_t max_free_ = 0;
+};
+
+/// promise 本身和它的共享状态都从池里分配
+template<class T>
+std::shared_ptr<std::promise<T>> make_pooled_promise(){
+    return std::allocate_shared<std::promise<T>>(PoolAllocator<std::promise<T>>(), std::allocator_arg, PoolAllocator<T>());
+}
+
+#endif // OBJECT_POOL_HPP
@@ -0,0 +1,288 @@
+#include "preprocess_kernel_cpu.hpp"
+#include <cmath>
+#include <atomic>
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPU_KERNEL_X86
+#endif
+
+namespace CPUKernel{
+
+    static std::atomic<bool> g_simd_enabled{true};
+
+    /// 逐像素与 warp_affine_bilinear_and_normalize_plane_kernel 相同的计算
+    static inline void warp_affine_bilinear_and_normalize_pixel(
+        const uint8_t* src, int src_line_size, int src_width, int src_height,
+        float* dst, int dst_width, int dst_height,
+        const float* m, uint8_t const_value_st, const Norm& norm, int dx, int dy){
+
+        float src_x = m[0] * dx + m[1] * dy + m[2];
+        float src_y = m[3] * dx + m[4] * dy + m[5];
+        float c0, c1, c2;
+
+        if(src_x <= -1 || src_x >= src_width || src_y <= -1 || src_y >= src_height){
+            // out of range
+            c0 = const_value_st;
+            c1 = const_value_st;
+            c2 = const_value_st;
+        }else{
+            int y_low = floorf(src_y);
+            int x_low = floorf(src_x);
+            int y_high = y_low + 1;
+            int x_high = x_low + 1;
+
+            uint8_t const_value[] = {const_value_st, const_value_st, const_value_st};
+            float ly    = src_y - y_low;
+            float lx    = src_x - x_low;
+            float hy    = 1 - ly;
+            float hx    = 1 - lx;
+            float w1    = hy * hx, w2 = hy * lx, w3 = ly * hx, w4 = ly * lx;
+            const uint8_t* v1 = const_value;
+            const uint8_t* v2 = const_value;
+            const uint8_t* v3 = const_value;
+            const uint8_t* v4 = const_value;
+            if(y_low >= 0){
+                if (x_low >= 0)
+                    v1 = src + y_low * src_line_size + x_low * 3;
+
+                if (x_high < src_width)
+                    v2 = src + y_low * src_line_size + x_high * 3;
+            }
+
+            if(y_high < src_height){
+                if (x_low >= 0)
+                    v3 = src + y_high * src_line_size + x_low * 3;
+
+                if (x_high < src_width)
+                    v4 = src + y_high * src_line_size + x_high * 3;
+            }
+
+            // same to opencv
+            c0 = floorf(w1 * v1[0] + w2 * v2[0] + w3 * v3[0] + w4 * v4[0] + 0.5f);
+            c1 = floorf(w1 * v1[1] + w2 * v2[1] + w3 * v3[1] + w4 * v4[1] + 0.5f);
+            c2 = floorf(w1 * v1[2] + w2 * v2[2] + w3 * v3[2] + w4 * v4[2] + 0.5f);
+        }
+
+        if(norm.channel_type == ChannelType::Invert){
+            float t = c2;
+            c2 = c0;  c0 = t;
+        }
+
+        if(norm.type == NormType::MeanStd){
+            c0 = (c0 * norm.alpha - norm.mean[0]) / norm.std[0];
+            c1 = (c1 * norm.alpha - norm.mean[1]) / norm.std[1];
+            c2 = (c2 * norm.alpha - norm.mean[2]) / norm.std[2];
+        }else if(norm.type == NormType::AlphaBeta){
+            c0 = c0 * norm.alpha + norm.beta;
+            c1 = c1 * norm.alpha + norm.beta;
+            c2 = c2 * norm.alpha + norm.beta;
+        }
+
+        int area = dst_width * dst_height;
+        float* pdst_c0 = dst + dy * dst_width + dx;
+        float* pdst_c1 = pdst_c0 + area;
+        float* pdst_c2 = pdst_c1 + area;
+        *pdst_c0 = c0;
+        *pdst_c1 = c1;
+        *pdst_c2 = c2;
+    }
+
+    static void warp_affine_rows_scalar(
+        const uint8_t* src, int src_line_size, int src_width, int src_height,
+        float* dst, int dst_width, int dst_height,
+        const float* m, uint8_t const_value, const Norm& norm, int y_begin, int y_end){
+
+        for(int dy = y_begin; dy < y_end; ++dy){
+            for(int dx = 0; dx < dst_width; ++dx){
+                warp_affine_bilinear_and_normalize_pixel(
+                    src, src_line_size, src_width, src_height,
+                    dst, dst_width, dst_height,
+                    m, const_value, norm, dx, dy
+                );
+            }
+        }
+    }
+
+#ifdef CPU_KERNEL_X86
+
+    /// 一次处理一行里连续的 8 个像素，每一步的运算顺序与标量版本相同（没有 FMA），结果逐位一致
+    /// 8 个像素的四个邻点都在图像内部时用 gather 一次读 4 字节（BGR + 下一个像素的 B，丢弃）；
+    /// 都在图像外时直接填常量；跨越边界的少数几组退回逐像素计算
+    __attribute__((target("avx2")))
+    static void warp_affine_rows_avx2(
+        const uint8_t* src, int src_line_size, int src_width, int src_height,
+        float* dst, int dst_width, int dst_height,
+        const float* m, uint8_t const_value, const Norm& norm, int y_begin, int y_end){
+
+        const __m256 lane        = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256 one         = _mm256_set1_ps(1.0f);
+        const __m256 minus_one   = _mm256_set1_ps(-1.0f);
+        const __m256 zero        = _mm256_setzero_ps();
+        const __m256 half        = _mm256_set1_ps(0.5f);
+        const __m256 width       = _mm256_set1_ps(src_width);
+        const __m256 height      = _mm256_set1_ps(src_height);
+
+        // gather 读 4 字节，x_low + 1 是最后一列时第 4 个字节会越过这一行的像素，这种情况走逐像素计算
+        const __m256 x_last      = _mm256_set1_ps(src_width - 3);
+        const __m256 y_last      = _mm256_set1_ps(src_height - 2);
+        const __m256i line       = _mm256_set1_epi32(src_line_size);
+        const __m256i three      = _mm256_set1_epi32(3);
+        const __m256i byte_mask  = _mm256_set1_epi32(0xFF);
+        const __m256 const_color = _mm256_set1_ps(const_value);
+
+        const bool invert   = norm.channel_type == ChannelType::Invert;
+        const __m256 alpha  = _mm256_set1_ps(norm.alpha);
+        const __m256 beta   = _mm256_set1_ps(norm.beta);
+        const __m256 mean[]  = {_mm256_set1_ps(norm.mean[0]), _mm256_set1_ps(norm.mean[1]), _mm256_set1_ps(norm.mean[2])};
+        const __m256 stdev[] = {_mm256_set1_ps(norm.std[0]),  _mm256_set1_ps(norm.std[1]),  _mm256_set1_ps(norm.std[2])};
+        const int area      = dst_width * dst_height;
+        const int* base     = reinterpret_cast<const int*>(src);
+
+        for(int dy = y_begin; dy < y_end; ++dy){
+
+            // 与标量版本一样按 (m0 * dx + m1 * dy) + m2 的顺序计算
+            const __m256 m1_dy = _mm256_set1_ps(m[1] * dy);
+            const __m256 m4_dy = _mm256_set1_ps(m[4] * dy);
+            float* pdst = dst + dy * dst_width;
+
+            int dx = 0;
+            for(; dx + 8 <= dst_width; dx += 8){
+                __m256 fdx   = _mm256_add_ps(_mm256_set1_ps(dx), lane);
+                __m256 src_x = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[0]), fdx), m1_dy), _mm256_set1_ps(m[2]));
+                __m256 src_y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[3]), fdx), m4_dy), _mm256_set1_ps(m[5]));
+
+                __m256 outside = _mm256_or_ps(
+                    _mm256_or_ps(_mm256_cmp_ps(src_x, minus_one, _CMP_LE_OQ), _mm256_cmp_ps(src_x, width,  _CMP_GE_OQ)),
+                    _mm256_or_ps(_mm256_cmp_ps(src_y, minus_one, _CMP_LE_OQ), _mm256_cmp_ps(src_y, height, _CMP_GE_OQ))
+                );
+
+                __m256 c[3];
+                if(_mm256_movemask_ps(outside) == 0xFF){
+                    c[0] = c[1] = c[2] = const_color;
+                }else{
+                    __m256 x_low = _mm256_floor_ps(src_x);
+                    __m256 y_low = _mm256_floor_ps(src_y);
+                    __m256 inside = _mm256_and_ps(
+                        _mm256_and_ps(_mm256_cmp_ps(x_low, zero, _CMP_GE_OQ), _mm256_cmp_ps(x_low, x_last, _CMP_LE_OQ)),
+                        _mm256_and_ps(_mm256_cmp_ps(y_low, zero, _CMP_GE_OQ), _mm256_cmp_ps(y_low, y_last, _CMP_LE_OQ))
+                    );
+
+                    if(_mm256_movemask_ps(inside) != 0xFF){
+                        for(int i = 0; i < 8; ++i){
+                            warp_affine_bilinear_and_normalize_pixel(
+                                src, src_line_size, src_width, src_height,
+                                dst, dst_width, dst_height,
+                                m, const_value, norm, dx + i, dy
+                            );
+                        }
+                        continue;
+                    }
+
+                    __m256 ly = _mm256_sub_ps(src_y, y_low);
+                    __m256 lx = _mm256_sub_ps(src_x, x_low);
+                    __m256 hy = _mm256_sub_ps(one, ly);
+                    __m256 hx = _mm256_sub_ps(one, lx);
+                    __m256 w1 = _mm256_mul_ps(hy, hx);
+                    __m256 w2 = _mm256_mul_ps(hy, lx);
+                    __m256 w3 = _mm256_mul_ps(ly, hx);
+                    __m256 w4 = _mm256_mul_ps(ly, lx);
+
+                    __m256i offset1 = _mm256_add_epi32(
+                        _mm256_mullo_epi32(_mm256_cvttps_epi32(y_low), line),
+                        _mm256_mullo_epi32(_mm256_cvttps_epi32(x_low), three)
+                    );
+                    __m256i offset2 = _mm256_add_epi32(offset1, three);
+                    __m256i offset3 = _mm256_add_epi32(offset1, line);
+                    __m256i offset4 = _mm256_add_epi32(offset3, three);
+                    __m256i v1 = _mm256_i32gather_epi32(base, offset1, 1);
+                    __m256i v2 = _mm256_i32gather_epi32(base, offset2, 1);
+                    __m256i v3 = _mm256_i32gather_epi32(base, offset3, 1);
+                    __m256i v4 = _mm256_i32gather_epi32(base, offset4, 1);
+
+                    for(int ic = 0; ic < 3; ++ic){
+                        int shift = ic * 8;
+                        __m256 p1 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(v1, shift), byte_mask));
+                        __m256 p2 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(v2, shift), byte_mask));
+                        __m256 p3 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(v3, shift), byte_mask));
+                        __m256 p4 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(v4, shift), byte_mask));
+                        __m256 value = _mm256_add_ps(_mm256_mul_ps(w1, p1), _mm256_mul_ps(w2, p2));
+                        value = _mm256_add_ps(value, _mm256_mul_ps(w3, p3));
+                        value = _mm256_add_ps(value, _mm256_mul_ps(w4, p4));
+                        c[ic] = _mm256_floor_ps(_mm256_add_ps(value, half));
+                    }
+                }
+
+                if(invert){
+                    __m256 t = c[2];
+                    c[2] = c[0];  c[0] = t;
+                }
+
+                for(int ic = 0; ic < 3; ++ic){
+                    if(norm.type == NormType::MeanStd)
+                        c[ic] = _mm256_div_ps(_mm256_sub_ps(_mm256_mul_ps(c[ic], alpha), mean[ic]), stdev[ic]);
+                    else if(norm.type == NormType::AlphaBeta)
+                        c[ic] = _mm256_add_ps(_mm256_mul_ps(c[ic], alpha), beta);
+                    _mm256_storeu_ps(pdst + ic * area + dx, c[ic]);
+                }
+            }
+
+            for(; dx < dst_width; ++dx){
+                warp_affine_bilinear_and_normalize_pixel(
+                    src, src_line_size, src_width, src_height,
+                    dst, dst_width, dst_height,
+                    m, const_value, norm, dx, dy
+                );
+            }
+        }
+
+        // 编译器不会在 target("avx2") 函数的出口插入 vzeroupper，回到 SSE 代码之后每条指令都会有切换的代价
+        _mm256_zeroupper();
+    }
+
+#endif // CPU_KERNEL_X86
+
+    bool is_simd_available(){
+#ifdef CPU_KERNEL_X86
+        static bool available = __builtin_cpu_supports("avx2");
+        return available;
+#else
+        return false;
+#endif
+    }
+
+    void set_simd_enabled(bool enabled){
+        g_simd_enabled = enabled;
+    }
+
+    bool is_simd_enabled(){
+        return g_simd_enabled.load(std::memory_order_relaxed) && is_simd_available();
+    }
+
+    void warp_affine_bilinear_and_normalize_plane(
+        const uint8_t* src, int src_line_size, int src_width, int src_height,
+        float* dst, int dst_width, int dst_height,
+        const float* matrix_2_3, uint8_t const_value, const Norm& norm){
+
+        auto rows = warp_affine_rows_scalar;
+#ifdef CPU_KERNEL_X86
+        if(is_simd_enabled())
+            rows = warp_affine_rows_avx2;
+#endif
+
+        // 按行分块交给 OpenCV 的线程池，每块至少 16 行，避免小图的调度开销超过计算
+        const int rows_per_stripe = 16;
+        int num_stripes = (dst_height + rows_per_stripe - 1) / rows_per_stripe;
+        cv::parallel_for_(cv::Range(0, num_stripes), [&](const cv::Range& range){
+            int y_begin = range.start * rows_per_stripe;
+            int y_end   = std::min(dst_height, range.end * rows_per_stripe);
+            rows(
+                src, src_line_size, src_width, src_height,
+                dst, dst_width, dst_height,
+                matrix_2_3, const_value, norm, y_begin, y_end
+            );
+        });
+    }
+};
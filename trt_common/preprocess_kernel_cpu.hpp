@@ -0,0 +1,34 @@
+#ifndef PREPROCESS_KERNEL_CPU_HPP
+#define PREPROCESS_KERNEL_CPU_HPP
+
+/// CUDAKernel 预处理的 host 版本，供 CPU 后端使用
+/// Norm 与 2x3 矩阵（dst -> src）的语义、采样和取整的步骤与 CUDA 核函数相同，
+/// 但 CUDA 侧以 --use_fast_math 编译并允许 FMA 合并，两者的结果只在浮点误差范围内一致，不保证逐位相同
+/// 一次遍历完成 warp affine + 归一化 + HWC -> CHW，按行分块在 OpenCV 的线程池上并行（线程数由 cv::setNumThreads 控制）
+/// x86 上运行时检测到 AVX2 时一次处理 8 个像素，与本文件的标量版本逐位一致
+
+#include "preprocess_kernel.cuh"
+
+namespace CPUKernel{
+
+    using CUDAKernel::Norm;
+    using CUDAKernel::NormType;
+    using CUDAKernel::ChannelType;
+
+    void warp_affine_bilinear_and_normalize_plane(
+        const uint8_t* src, int src_line_size, int src_width, int src_height,
+        float* dst, int dst_width, int dst_height,
+        const float* matrix_2_3, uint8_t const_value, const Norm& norm);
+
+    /// CPU 是否支持 AVX2
+    bool is_simd_available();
+
+    /// 默认开启，关闭之后使用逐像素的标量实现，用于对比和验证；同时控制各个模型 CPU decode 的实现
+    void set_simd_enabled(bool enabled);
+
+    /// 开启并且 CPU 支持 AVX2
+    bool is_simd_enabled();
+
+};
+
+#endif // PREPROCESS_KERNEL_CPU_HPP
@@ -0,0 +1,493 @@
+
+/// Replay 后端：从 capture 文件（mmap）中按 job 序号取出录制好的输出 Tensor
+/// 不需要 GPU，也不需要模型，可以在任意机器上对 decode / nms / 跟踪 / 画图 / 写文件等 host 端流程
+/// 做基准测试和 profile，并且每次运行的输入完全一致（bit-identical）
+
+#include "infer_capture.hpp"
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ilogger.hpp"
+
+using namespace std;
+
+namespace TRT {
+
+    static bool g_capture_enabled = false;
+
+    void set_capture_enabled(bool enabled){
+        g_capture_enabled = enabled;
+    }
+
+    bool is_capture_enabled(){
+        return g_capture_enabled;
+    }
+
+    string capture_file_of(const string& engine_file){
+        const string suffix = ".capture";
+        if(engine_file.size() >= suffix.size() &&
+           engine_file.compare(engine_file.size() - suffix.size(), suffix.size(), suffix) == 0)
+            return engine_file;
+        return engine_file + suffix;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    template<typename T>
+    static void write_pod(ofstream& out, const T& value){
+        out.write((const char*)&value, sizeof(T));
+    }
+
+    static void write_dims(ofstream& out, const vector<int>& dims){
+        write_pod(out, (int)dims.size());
+        out.write((const char*)dims.data(), sizeof(int) * dims.size());
+    }
+
+    shared_ptr<InferCapture> InferCapture::open(const string& file, Infer* infer){
+        static mutex registry_lock;
+        static map<string, weak_ptr<InferCapture>> registry;
+
+        unique_lock<mutex> l(registry_lock);
+        auto iter = registry.find(file);
+        if(iter != registry.end()){
+            auto exist = iter->second.lock();
+            if(exist) return exist;
+        }
+
+        shared_ptr<InferCapture> instance{new InferCapture{}};
+        instance->file_ = file;
+        instance->out_.open(file, ios::out | ios::binary | ios::trunc);
+        if(!instance->out_.is_open()){
+            INFOE("Open capture file failed: %s", file.c_str());
+            return nullptr;
+        }
+
+        if(!instance->write_header(infer)){
+            INFOE("Write capture header failed: %s", file.c_str());
+            return nullptr;
+        }
+        registry[file] = instance;
+        INFO("Capture forward outputs to %s", file.c_str());
+        return instance;
+    }
+
+    InferCapture::~InferCapture(){
+        if(out_.is_open()){
+            out_.close();
+            INFO("Capture %s closed, %lld records", file_.c_str(), (long long)seq_);
+        }
+    }
+
+    bool InferCapture::write_header(Infer* infer){
+        out_.write(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+        write_pod(out_, CAPTURE_VERSION);
+        write_pod(out_, infer->get_max_batch_size());
+        write_pod(out_, infer->num_input());
+        write_pod(out_, infer->num_output());
+
+        auto write_binding = [&](const string& name, const vector<int>& dims){
+            write_pod(out_, (int)name.size());
+            out_.write(name.data(), name.size());
+            write_dims(out_, dims);
+        };
+
+        for(int i = 0; i < infer->num_input(); ++i)
+            write_binding(infer->get_input_name(i), infer->input(i)->dims());
+        for(int i = 0; i < infer->num_output(); ++i)
+            write_binding(infer->get_output_name(i), infer->output(i)->dims());
+        return out_.good();
+    }
+
+    void InferCapture::record(int batch, const vector<JobKey>& keys, const vector<const void*>& outputs, const vector<vector<int>>& dims){
+        unique_lock<mutex> l(lock_);
+        bool keyed = keys.size() == batch;
+        for(int ibatch = 0; ibatch < batch; ++ibatch){
+            JobKey key = keyed ? keys[ibatch] : JobKey{-1, seq_};
+            seq_++;
+            write_pod(out_, key.stream);
+            write_pod(out_, key.frame);
+            for(int i = 0; i < outputs.size(); ++i){
+                // dims 第 0 维为 batch，录制时按单张图切开
+                vector<int> item_dims(dims[i].begin() + 1, dims[i].end());
+                uint64_t bytes = sizeof(float);
+                for(int d : item_dims) bytes *= d;
+
+                write_dims(out_, item_dims);
+                write_pod(out_, bytes);
+                out_.write((const char*)outputs[i] + ibatch * bytes, bytes);
+            }
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    class ReplayInferImpl : public Infer {
+    public:
+        ~ReplayInferImpl();
+        bool load(const string& file);
+        void forward(bool sync) override;
+        std::shared_ptr<Tensor> input(int index) override;
+        std::shared_ptr<Tensor> output(int index) override;
+        std::shared_ptr<Tensor> tensor(const std::string& name) override;
+        void set_input(int index, std::shared_ptr<Tensor> tensor) override;
+        void set_output(int index, std::shared_ptr<Tensor> tensor) override;
+        bool has_dynamic_dim() override { return false; }
+        std::vector<int> run_dims(const std::string &name) override;
+        std::vector<int> run_dims(int ibinding) override;
+        std::vector<int> static_dims(const std::string &name) override;
+        std::vector<int> static_dims(int ibinding) override;
+        bool set_run_dims(const std::string &name, const std::vector<int> &dims) override;
+        bool set_run_dims(int ibinding, const std::vector<int> &dims) override;
+        int num_bindings() override { return static_dims_.size(); }
+        int num_input() override { return inputs_.size(); }
+        int num_output() override { return outputs_.size(); }
+        std::string get_input_name(int index) override;
+        std::string get_output_name(int index) override;
+        bool is_input_name(const std::string& name) override;
+        bool is_output_name(const std::string& name) override;
+        bool is_input(int ibinding) override { return ibinding < inputs_.size(); }
+        void print() override;
+        void set_stream(CUStream stream) override {}
+        CUStream get_stream() override { return nullptr; }
+        int get_max_batch_size() override { return max_batch_size_; }
+        void synchronize() override {}
+        int device() override { return CPU_DEVICE_ID; }
+        size_t get_device_memory_size() override { return 0; }
+        std::shared_ptr<MixMemory> get_workspace() override { return workspace_; }
+        void set_job_keys(const std::vector<JobKey>& keys) override { job_keys_ = keys; }
+        bool uses_job_keys() override { return true; }
+
+    private:
+        struct Slice{
+            vector<int> dims;        // 不含 batch 维度
+            const uint8_t* data = nullptr;
+            uint64_t bytes = 0;
+        };
+
+        // 一个 item 是一张图的全部输出
+        struct Item{
+            JobKey key;
+            vector<Slice> outputs;
+        };
+
+        bool parse();
+        /// 第 ibatch 项回放的 item，job 没有被录制时返回 nullptr
+        const Item* find_item(int ibatch, uint64_t first);
+
+    private:
+        string file_;
+        int fd_ = -1;
+        uint8_t* mapped_ = nullptr;
+        size_t mapped_size_ = 0;
+
+        int max_batch_size_ = 1;
+        vector<shared_ptr<Tensor>> inputs_;
+        vector<shared_ptr<Tensor>> outputs_;
+        vector<string> inputs_names_;
+        vector<string> outputs_names_;
+        vector<vector<int>> static_dims_;   // binding 顺序：先全部输入，再全部输出
+        map<string, int> Blobs_name_mapper_;
+        shared_ptr<MixMemory> workspace_;
+
+        vector<Item> items_;                // 按 (stream, frame) 排序
+        map<pair<int, uint64_t>, int> index_;   // (stream, frame) -> items_ 的下标
+        vector<JobKey> job_keys_;           // 下一次 forward 的 batch 对应的 job，为空时按 cursor_ 依次回放
+        atomic<uint64_t> cursor_{0};        // 没有 job_keys_ 时下一个要回放的 item
+    };
+
+    ReplayInferImpl::~ReplayInferImpl() {
+        if(mapped_) munmap(mapped_, mapped_size_);
+        if(fd_ != -1) close(fd_);
+    }
+
+    bool ReplayInferImpl::load(const string& file) {
+        file_ = file;
+        fd_ = ::open(file.c_str(), O_RDONLY);
+        if(fd_ == -1){
+            INFOE("Open capture file failed: %s", file.c_str());
+            return false;
+        }
+
+        struct stat st{};
+        if(fstat(fd_, &st) != 0 || st.st_size == 0){
+            INFOE("Capture file is empty: %s", file.c_str());
+            return false;
+        }
+
+        mapped_size_ = st.st_size;
+        void* ptr = mmap(nullptr, mapped_size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if(ptr == MAP_FAILED){
+            INFOE("mmap capture file failed: %s", file.c_str());
+            return false;
+        }
+        mapped_ = (uint8_t*)ptr;
+        madvise(mapped_, mapped_size_, MADV_SEQUENTIAL);
+
+        workspace_.reset(new MixMemory{CPU_DEVICE_ID});
+        return parse();
+    }
+
+    bool ReplayInferImpl::parse() {
+        const uint8_t* p   = mapped_;
+        const uint8_t* end = mapped_ + mapped_size_;
+
+        auto read_bytes = [&](void* dst, size_t size){
+            if((size_t)(end - p) < size) return false;
+            memcpy(dst, p, size);
+            p += size;
+            return true;
+        };
+        auto read_dims = [&](vector<int>& dims){
+            int ndims = 0;
+            if(!read_bytes(&ndims, sizeof(ndims)) || ndims < 0 || ndims > 8) return false;
+            dims.resize(ndims);
+            return read_bytes(dims.data(), sizeof(int) * ndims);
+        };
+
+        char magic[sizeof(CAPTURE_MAGIC)];
+        int version = 0, num_input = 0, num_output = 0;
+        if(!read_bytes(magic, sizeof(magic)) || memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0){
+            INFOE("%s is not a capture file", file_.c_str());
+            return false;
+        }
+
+        if(!read_bytes(&version, sizeof(version)) || version != CAPTURE_VERSION){
+            INFOE("Unsupported capture version %d, expect %d, please record %s again", version, CAPTURE_VERSION, file_.c_str());
+            return false;
+        }
+
+        if(!read_bytes(&max_batch_size_, sizeof(int)) || !read_bytes(&num_input, sizeof(int)) || !read_bytes(&num_output, sizeof(int))){
+            INFOE("Capture header is truncated: %s", file_.c_str());
+            return false;
+        }
+
+        for(int i = 0; i < num_input + num_output; ++i){
+            int name_len = 0;
+            vector<int> dims;
+            if(!read_bytes(&name_len, sizeof(name_len)) || name_len < 0 || (size_t)(end - p) < (size_t)name_len){
+                INFOE("Capture header is truncated: %s", file_.c_str());
+                return false;
+            }
+
+            string name((const char*)p, name_len);
+            p += name_len;
+            if(!read_dims(dims)){
+                INFOE("Capture header is truncated: %s", file_.c_str());
+                return false;
+            }
+
+            auto newTensor = make_shared<Tensor>(dims, nullptr, CPU_DEVICE_ID);
+            newTensor->set_workspace(workspace_);
+            if(i < num_input){
+                inputs_.push_back(newTensor);
+                inputs_names_.push_back(name);
+            }else{
+                outputs_.push_back(newTensor);
+                outputs_names_.push_back(name);
+            }
+            Blobs_name_mapper_[name] = static_dims_.size();
+            static_dims_.push_back(dims);
+        }
+
+        // 逐条建立索引，数据本身留在 mmap 里，forward 时才拷贝
+        while(p < end){
+            Item item;
+            item.outputs.resize(num_output);
+            bool ok = read_bytes(&item.key.stream, sizeof(item.key.stream)) && read_bytes(&item.key.frame, sizeof(item.key.frame));
+            for(int i = 0; ok && i < num_output; ++i){
+                auto& slice = item.outputs[i];
+                ok = read_dims(slice.dims) && read_bytes(&slice.bytes, sizeof(slice.bytes)) && (uint64_t)(end - p) >= slice.bytes;
+                if(ok){
+                    slice.data = p;
+                    p += slice.bytes;
+                }
+            }
+
+            if(!ok){
+                // 录制进程被中途杀掉时最后一条可能不完整
+                INFOW("Capture %s has a truncated record at the end, ignored", file_.c_str());
+                break;
+            }
+            items_.emplace_back(move(item));
+        }
+
+        if(items_.empty()){
+            INFOE("Capture %s has no records", file_.c_str());
+            return false;
+        }
+
+        // 多副本同时录制时写入顺序和提交顺序不一致，按 job 排序；没有 JobKey 的录制（stream 为 -1）即为录制的顺序
+        sort(items_.begin(), items_.end(), [](const Item& a, const Item& b){
+            return make_pair(a.key.stream, a.key.frame) < make_pair(b.key.stream, b.key.frame);
+        });
+        for(int i = 0; i < items_.size(); ++i){
+            if(!index_.emplace(make_pair(items_[i].key.stream, items_[i].key.frame), i).second)
+                INFOW("Capture %s has duplicate records of stream %d frame %llu, the first is used",
+                      file_.c_str(), items_[i].key.stream, (unsigned long long)items_[i].key.frame);
+        }
+        return true;
+    }
+
+    const ReplayInferImpl::Item* ReplayInferImpl::find_item(int ibatch, uint64_t first) {
+        if(job_keys_.empty())
+            return &items_[(first + ibatch) % items_.size()];
+
+        auto& key = job_keys_[ibatch];
+        auto iter = index_.find(make_pair(key.stream, key.frame));
+        if(iter == index_.end()){
+            INFOW("Replay %s has no record of stream %d frame %llu, output zeros",
+                  file_.c_str(), key.stream, (unsigned long long)key.frame);
+            return nullptr;
+        }
+        return &items_[iter->second];
+    }
+
+    void ReplayInferImpl::forward(bool sync) {
+        int inputBatchSize = inputs_[0]->shape(0);
+        if(!job_keys_.empty() && job_keys_.size() != inputBatchSize){
+            INFOW("Replay got %d job keys for a batch of %d, replay in record order", (int)job_keys_.size(), inputBatchSize);
+            job_keys_.clear();
+        }
+
+        uint64_t first = 0;
+        if(job_keys_.empty()){
+            first = cursor_.fetch_add(inputBatchSize);
+            if(first < items_.size() && first + inputBatchSize > items_.size())
+                INFOW("Replay reached the end of %s (%d records), restart from the beginning", file_.c_str(), (int)items_.size());
+        }
+
+        vector<const Item*> batch_items(inputBatchSize);
+        for(int ibatch = 0; ibatch < inputBatchSize; ++ibatch)
+            batch_items[ibatch] = find_item(ibatch, first);
+
+        for(int i = 0; i < outputs_.size(); ++i){
+            auto& output = outputs_[i];
+            // 输出的形状取自录制的第一条，与 batch 中是哪些 job 无关
+            vector<int> dims = items_[0].outputs[i].dims;
+            dims.insert(dims.begin(), inputBatchSize);
+            output->resize(dims);
+
+            uint8_t* pdst = output->cpu<uint8_t>();
+            size_t item_bytes = output->bytes(1);
+            for(int ibatch = 0; ibatch < inputBatchSize; ++ibatch){
+                uint8_t* pitem = pdst + ibatch * item_bytes;
+                if(batch_items[ibatch] == nullptr){
+                    memset(pitem, 0, item_bytes);
+                    continue;
+                }
+
+                auto& slice = batch_items[ibatch]->outputs[i];
+                if(slice.bytes != item_bytes)
+                    INFOW("Replay record of stream %d frame %llu output %d has %lld bytes, expect %lld",
+                          batch_items[ibatch]->key.stream, (unsigned long long)batch_items[ibatch]->key.frame,
+                          i, (long long)slice.bytes, (long long)item_bytes);
+                memcpy(pitem, slice.data, min<size_t>(slice.bytes, item_bytes));
+            }
+        }
+        job_keys_.clear();
+    }
+
+    std::shared_ptr<Tensor> ReplayInferImpl::input(int index) {
+        if(index < 0 || index >= inputs_.size())
+            INFOF("Input index[%d] out of range [size=%d]", index, inputs_.size());
+        return inputs_[index];
+    }
+
+    std::shared_ptr<Tensor> ReplayInferImpl::output(int index) {
+        if(index < 0 || index >= outputs_.size())
+            INFOF("Output index[%d] out of range [size=%d]", index, outputs_.size());
+        return outputs_[index];
+    }
+
+    std::shared_ptr<Tensor> ReplayInferImpl::tensor(const string &name) {
+        auto node = Blobs_name_mapper_.find(name);
+        if(node == Blobs_name_mapper_.end())
+            INFOF("Could not find the input/output node '%s', please check your model.", name.c_str());
+        int index = node->second;
+        return index < inputs_.size() ? inputs_[index] : outputs_[index - inputs_.size()];
+    }
+
+    void ReplayInferImpl::set_input(int index, std::shared_ptr<Tensor> tensor) {
+        if(index < 0 || index >= inputs_.size())
+            INFOF("Input index[%d] out of range [size=%d]", index, inputs_.size());
+        inputs_[index] = tensor;
+    }
+
+    void ReplayInferImpl::set_output(int index, std::shared_ptr<Tensor> tensor) {
+        if(index < 0 || index >= outputs_.size())
+            INFOF("Output index[%d] out of range [size=%d]", index, outputs_.size());
+        outputs_[index] = tensor;
+    }
+
+    std::vector<int> ReplayInferImpl::run_dims(const std::string &name) {
+        return run_dims(Blobs_name_mapper_[name]);
+    }
+
+    std::vector<int> ReplayInferImpl::run_dims(int ibinding) {
+        return ibinding < inputs_.size() ? inputs_[ibinding]->dims() : outputs_[ibinding - inputs_.size()]->dims();
+    }
+
+    std::vector<int> ReplayInferImpl::static_dims(const std::string &name) {
+        return static_dims(Blobs_name_mapper_[name]);
+    }
+
+    std::vector<int> ReplayInferImpl::static_dims(int ibinding) {
+        return static_dims_[ibinding];
+    }
+
+    bool ReplayInferImpl::set_run_dims(const std::string &name, const std::vector<int> &dims) {
+        return set_run_dims(Blobs_name_mapper_[name], dims);
+    }
+
+    bool ReplayInferImpl::set_run_dims(int ibinding, const std::vector<int> &dims) {
+        if(!is_input(ibinding)) return false;
+        inputs_[ibinding]->resize(dims);
+        return true;
+    }
+
+    std::string ReplayInferImpl::get_input_name(int index) {
+        if(index < 0 || index >= inputs_names_.size())
+            INFOF("Input index[%d] out of range [size=%d]", index, inputs_names_.size());
+        return inputs_names_[index];
+    }
+
+    std::string ReplayInferImpl::get_output_name(int index) {
+        if(index < 0 || index >= outputs_names_.size())
+            INFOF("Output index[%d] out of range [size=%d]", index, outputs_names_.size());
+        return outputs_names_[index];
+    }
+
+    bool ReplayInferImpl::is_input_name(const string &name) {
+        return find(inputs_names_.begin(), inputs_names_.end(), name) != inputs_names_.end();
+    }
+
+    bool ReplayInferImpl::is_output_name(const string &name) {
+        return find(outputs_names_.begin(), outputs_names_.end(), name) != outputs_names_.end();
+    }
+
+    void ReplayInferImpl::print() {
+        INFO(" Infer %p detail", this);
+        INFO("\tBase device: Replay %s, %d records", file_.c_str(), (int)items_.size());
+        INFO("\tMax Batch Size: %d", max_batch_size_);
+        INFO("\tInputs: %d", inputs_.size());
+        for(int i = 0; i < inputs_.size(); ++i)
+            INFO("\t\t%d.%s : shape {%s}", i, inputs_names_[i].c_str(), inputs_[i]->shape_string());
+        INFO("\tOutputs: %d", outputs_.size());
+        for(int i = 0; i < outputs_.size(); ++i)
+            INFO("\t\t%d.%s : shape {%s}", i, outputs_names_[i].c_str(), outputs_[i]->shape_string());
+    }
+
+    shared_ptr<Infer> load_replay_infer(const string& file){
+        shared_ptr<ReplayInferImpl> instance{new ReplayInferImpl{}};
+        if(!instance->load(capture_file_of(file))) instance.reset();
+        return instance;
+    }
+
+}
@@ -0,0 +1,213 @@
+#ifndef REPLICA_POOL_HPP
+#define REPLICA_POOL_HPP
+
+/// Replica Pool
+/// 一个 Infer 句柄后面挂多个 InferController 副本（各自的 worker 线程、模型、stream，可以在不同的 GPU 上）
+/// 新任务派发给在途任务最少的副本；同一个 stream 的结果经过重排缓冲，按提交顺序交付
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <vector>
+#include <functional>
+#include "ilogger.hpp"
+#include "object_pool.hpp"
+
+struct ReplicaConfig{
+    int num_replicas = 1;       // 1 表示不使用 pool，和原来一样只有一个 controller
+    std::vector<int> gpuids;    // 第 i 个副本使用 gpuids[i % size]，为空时都使用 create_infer 传入的 gpuid
+};
+
+/// 进程级默认配置，app 的 create_infer 读取它，因此不需要改调用代码
+inline ReplicaConfig& default_replica_config(){
+    static ReplicaConfig config;
+    return config;
+}
+
+/// Replica 需要提供 commit(input, stream_id, callback)，即 InferController 的回调接口
+template<class Input, class Output, class Replica>
+class ReplicaPool{
+public:
+    using Callback = std::function<void(Output&& output)>;
+
+    virtual ~ReplicaPool(){
+        stop();
+    }
+
+    bool startup(std::vector<std::shared_ptr<Replica>> replicas){
+        if(replicas.empty()) return false;
+
+        replicas_ = std::move(replicas);
+        outstanding_.reset(new std::atomic<int>[replicas_.size()]);
+        dispatched_.reset(new std::atomic<uint64_t>[replicas_.size()]);
+        for(int i = 0; i < replicas_.size(); ++i){
+            outstanding_[i] = 0;
+            dispatched_[i]  = 0;
+            // 同一个 stream 的帧无论分到哪个副本都连续编号，录制 / Replay 才能按 job 对应
+            replicas_[i]->share_frames(*replicas_[0]);
+        }
+        return true;
+    }
+
+    /// 先停掉所有副本（未完成的任务以空结果交付），再释放
+    void stop(){
+        if(replicas_.empty()) return;
+
+        std::string report;
+        for(int i = 0; i < replicas_.size(); ++i)
+            report += iLogger::format("%s%llu", i == 0 ? "" : ", ", (unsigned long long)dispatched_[i].load());
+        INFO("Replica pool: %d replicas, dispatched [%s]", (int)replicas_.size(), report.c_str());
+        replicas_.clear();
+    }
+
+    std::shared_future<Output> commit(const Input& input, int stream_id = -1){
+        auto pro = make_pooled_promise<Output>();
+        std::shared_future<Output> future = pro->get_future();
+        commit(input, stream_id, [pro](Output&& output){
+            pro->set_value(std::move(output));
+        });
+        return future;
+    }
+
+    /// stream_id >= 0 时，同一个 stream 的 callback 严格按提交顺序调用（不会并发）
+    void commit(const Input& input, int stream_id, Callback callback){
+        int ireplica = pick();
+        outstanding_[ireplica]++;
+        dispatched_[ireplica]++;
+
+        if(stream_id < 0){
+            replicas_[ireplica]->commit(input, stream_id, [this, ireplica, callback](Output&& output){
+                outstanding_[ireplica]--;
+                callback(std::move(output));
+            });
+            return;
+        }
+
+        uint64_t seq = 0;
+        {
+            std::unique_lock<std::mutex> l(streams_lock_);
+            seq = streams_[stream_id].next_submit++;
+        }
+
+        replicas_[ireplica]->commit(input, stream_id, [this, ireplica, stream_id, seq, callback](Output&& output){
+            outstanding_[ireplica]--;
+            reorder(stream_id, seq, std::move(output), callback);
+        });
+    }
+
+    std::vector<std::shared_future<Output>> commits(const std::vector<Input>& inputs){
+        std::vector<std::shared_future<Output>> results(inputs.size());
+        for(int i = 0; i < inputs.size(); ++i)
+            results[i] = commit(inputs[i]);
+        return results;
+    }
+
+    int num_replicas() const{ return replicas_.size(); }
+
+    /// 每个副本累计派发的任务数
+    std::vector<uint64_t> dispatched() const{
+        std::vector<uint64_t> output(replicas_.size());
+        for(int i = 0; i < replicas_.size(); ++i)
+            output[i] = dispatched_[i].load();
+        return output;
+    }
+
+private:
+    /// least-outstanding，平局时从轮转的位置开始找，避免总是压在第一个副本上
+    int pick(){
+        int n = replicas_.size();
+        int start = (int)(round_robin_++ % n);
+        int best = start;
+        int best_load = outstanding_[start].load(std::memory_order_relaxed);
+        for(int k = 1; k < n && best_load > 0; ++k){
+            int i = (start + k) % n;
+            int load = outstanding_[i].load(std::memory_order_relaxed);
+            if(load < best_load){
+                best = i;
+                best_load = load;
+            }
+        }
+        return best;
+    }
+
+    struct Ready{
+        Output output;
+        Callback callback;
+    };
+
+    struct StreamOrder{
+        uint64_t next_submit  = 0;
+        uint64_t next_deliver = 0;
+        bool delivering = false;            // 同一时间只有一个线程在交付这个 stream 的结果
+        std::map<uint64_t, Ready> ready;    // 已完成但前面还有未完成的
+    };
+
+    void reorder(int stream_id, uint64_t seq, Output&& output, const Callback& callback){
+        std::unique_lock<std::mutex> l(streams_lock_);
+        auto& stream = streams_[stream_id];
+        stream.ready.emplace(seq, Ready{std::move(output), callback});
+        if(stream.delivering) return;
+
+        stream.delivering = true;
+        std::vector<Ready> batch;
+        for(;;){
+            while(!stream.ready.empty() && stream.ready.begin()->first == stream.next_deliver){
+                batch.emplace_back(std::move(stream.ready.begin()->second));
+                stream.ready.erase(stream.ready.begin());
+                stream.next_deliver++;
+            }
+
+            if(batch.empty()){
+                stream.delivering = false;
+                return;
+            }
+
+            l.unlock();
+            for(auto& item : batch)
+                item.callback(std::move(item.output));
+            batch.clear();
+            l.lock();
+        }
+    }
+
+private:
+    std::vector<std::shared_ptr<Replica>> replicas_;
+    std::unique_ptr<std::atomic<int>[]> outstanding_;
+    std::unique_ptr<std::atomic<uint64_t>[]> dispatched_;
+    std::atomic<uint64_t> round_robin_{0};
+    std::mutex streams_lock_;
+    std::map<int, StreamOrder> streams_;
+};
+
+/// 多副本的 app 句柄：把 app 接口（AppInfer）的 commits / commit 各个重载转给 ReplicaPool
+/// app 的 create_infer 在 num_replicas > 1 时使用，例如 ReplicaInfer<Yolo::Infer, cv::Mat, BoxArray, InferImpl>
+template<class AppInfer, class Input, class Output, class Replica>
+class ReplicaInfer : public AppInfer, public ReplicaPool<Input, Output, Replica>{
+public:
+    using Pool     = ReplicaPool<Input, Output, Replica>;
+    using Callback = typename Pool::Callback;
+
+    std::vector<std::shared_future<Output>> commits(const std::vector<Input>& inputs) override{
+        return Pool::commits(inputs);
+    }
+
+    std::shared_future<Output> commit(const Input& input) override{
+        return Pool::commit(input);
+    }
+
+    std::shared_future<Output> commit(const Input& input, int stream_id) override{
+        return Pool::commit(input, stream_id);
+    }
+
+    void commit(const Input& input, Callback callback) override{
+        Pool::commit(input, -1, std::move(callback));
+    }
+
+    void commit(const Input& input, int stream_id, Callback callback) override{
+        Pool::commit(input, stream_id, std::move(callback));
+    }
+};
+
+#endif // REPLICA_POOL_HPP
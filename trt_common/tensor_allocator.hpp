@@ -1,6 +1,8 @@
 /**
  * 分配器
  * 用以实现 tensor内存 复用的问题
+ * 空闲的 MonoData 用一个带版本号的无锁栈（free-list）管理，query/release 都是 O(1)，
+ * 不拥塞时不加锁；只有没有空闲对象、需要阻塞等待时才会用到 EventCount 里的 mutex
  **/
 
 #ifndef MONOPOLY_ALLOCATOR_HPP
@@ -9,8 +11,12 @@
 #include <condition_variable>
 #include <vector>
 #include <mutex>
+#include <atomic>
 #include <memory>
+#include <chrono>
+#include <thread>
 #include "trt_tensor.hpp"
+#include "event_count.hpp"
 
 class TensorAllocator{
 public:
@@ -24,30 +30,47 @@ public:
         void release(){ manager_->release_one(this); }
 
     private:
-        explicit MonoData(TensorAllocator* pmanager){ manager_ = pmanager; }
+        MonoData(TensorAllocator* pmanager, int index){ manager_ = pmanager; index_ = index; }
 
     private:
         friend class TensorAllocator;
         TensorAllocator* manager_ = nullptr;
         std::shared_ptr<TRT::Tensor> data_;
-        bool available_ = true;
+        std::atomic<bool> available_{true};
+        int index_ = 0;
     };
-    
+
     using MonoDataPtr = std::shared_ptr<MonoData>;
 
+    /// 占用情况统计
+    struct Stats{
+        int capacity    = 0;
+        int in_use      = 0;
+        int peak_in_use = 0;
+        uint64_t num_query   = 0;   // 成功获取的次数
+        uint64_t num_wait    = 0;   // 需要阻塞等待的次数
+        uint64_t num_timeout = 0;   // 等待超时（或者 try_query 失败）的次数
+
+        float occupancy() const{ return capacity == 0 ? 0 : in_use / (float)capacity; }
+    };
+
     explicit TensorAllocator(int size){
         capacity_ = size;
         num_available_ = size;
         datas_.resize(size);
+        next_.reset(new std::atomic<int>[size]);
 
-        for(int i = 0; i < size; ++i)
-            datas_[i] = std::shared_ptr<MonoData>(new MonoData(this));
+        for(int i = 0; i < size; ++i){
+            datas_[i] = std::shared_ptr<MonoData>(new MonoData(this, i));
+            next_[i].store(i + 1 < size ? i + 1 : -1, std::memory_order_relaxed);
+        }
+        head_.store(pack(0, size > 0 ? 0 : -1), std::memory_order_release);
     }
 
     virtual ~TensorAllocator(){
         run_ = false;
-        cv_.notify_all();
-        
+        free_event_.notify_all();
+
         std::unique_lock<std::mutex> l(lock_);
         cv_exit_.wait(l, [&](){
             return num_wait_thread_ == 0;
@@ -59,60 +82,143 @@ public:
     ///   请求得到一个对象后，该对象被占用，除非他执行了release释放该对象所有权
     MonoDataPtr query(int timeout = 10000){
 
-        std::unique_lock<std::mutex> l(lock_);
         if(!run_) return nullptr;
-        
-        if(num_available_ == 0){
-            num_wait_thread_++;
 
-            auto state = cv_.wait_for(l, std::chrono::milliseconds(timeout), [&](){
-                return num_available_ > 0 || !run_;
-            });
+        int index = pop_free();
+        if(index == -1){
+            num_wait_++;
+            num_wait_thread_++;
 
-            num_wait_thread_--;
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+            while(run_){
+                auto key = free_event_.prepare_wait();
+                index = pop_free();
+                if(index != -1 || !run_){
+                    free_event_.cancel_wait();
+                    break;
+                }
+
+                if(!free_event_.wait_until(key, deadline)){
+                    // timeout
+                    index = pop_free();
+                    break;
+                }
+            }
+
+            {
+                std::unique_lock<std::mutex> l(lock_);
+                num_wait_thread_--;
+            }
             cv_exit_.notify_one();
 
             // timeout, no available, exit program
-            if(!state || num_available_ == 0 || !run_)
+            if(index != -1 && !run_){
+                push_free(index);
+                index = -1;
+            }
+
+            if(index == -1){
+                num_timeout_++;
                 return nullptr;
+            }
         }
+        return take(index);
+    }
 
-        auto item = std::find_if(datas_.begin(), datas_.end(), [](MonoDataPtr& item){return item->available_;});
-        if(item == datas_.end())
+    ///   不阻塞，没有可用对象时立即返回空指针
+    MonoDataPtr try_query(){
+        if(!run_) return nullptr;
+
+        int index = pop_free();
+        if(index == -1){
+            num_timeout_++;
             return nullptr;
-        
-        (*item)->available_ = false;
-        num_available_--;
-        return *item;
+        }
+        return take(index);
     }
 
     int num_available() const{
-        return num_available_;
+        return num_available_.load(std::memory_order_relaxed);
     }
 
     int capacity() const{
         return capacity_;
     }
 
+    Stats stats() const{
+        Stats s;
+        s.capacity    = capacity_;
+        s.in_use      = capacity_ - num_available();
+        s.peak_in_use = peak_in_use_.load(std::memory_order_relaxed);
+        s.num_query   = num_query_.load(std::memory_order_relaxed);
+        s.num_wait    = num_wait_.load(std::memory_order_relaxed);
+        s.num_timeout = num_timeout_.load(std::memory_order_relaxed);
+        return s;
+    }
+
 private:
     void release_one(MonoData* prq){
-        std::unique_lock<std::mutex> l(lock_);
-        if(!prq->available_){
-            prq->available_ = true;
-            num_available_++;
-            cv_.notify_one();
+        // 重复 release 只生效一次
+        if(prq->available_.exchange(true, std::memory_order_acq_rel))
+            return;
+
+        num_available_.fetch_add(1, std::memory_order_relaxed);
+        push_free(prq->index_);
+        free_event_.notify_one();
+    }
+
+    MonoDataPtr take(int index){
+        auto& item = datas_[index];
+        item->available_.store(false, std::memory_order_release);
+        num_query_.fetch_add(1, std::memory_order_relaxed);
+
+        int in_use = capacity_ - (num_available_.fetch_sub(1, std::memory_order_relaxed) - 1);
+        int peak   = peak_in_use_.load(std::memory_order_relaxed);
+        while(in_use > peak && !peak_in_use_.compare_exchange_weak(peak, in_use, std::memory_order_relaxed));
+        return item;
+    }
+
+    /// head_ 高 32 位是版本号，低 32 位是栈顶 index + 1（0 表示空），版本号用来避免 ABA
+    static uint64_t pack(uint64_t tag, int index){ return (tag << 32) | (uint32_t)(index + 1); }
+    static int index_of(uint64_t head){ return (int)(head & 0xFFFFFFFFu) - 1; }
+
+    int pop_free(){
+        uint64_t head = head_.load(std::memory_order_acquire);
+        for(;;){
+            int index = index_of(head);
+            if(index == -1) return -1;
+
+            int next = next_[index].load(std::memory_order_relaxed);
+            if(head_.compare_exchange_weak(head, pack((head >> 32) + 1, next), std::memory_order_acq_rel, std::memory_order_acquire))
+                return index;
+        }
+    }
+
+    void push_free(int index){
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        for(;;){
+            next_[index].store(index_of(head), std::memory_order_relaxed);
+            if(head_.compare_exchange_weak(head, pack((head >> 32) + 1, index), std::memory_order_release, std::memory_order_relaxed))
+                return;
         }
     }
 
 private:
-    std::mutex lock_;
-    std::condition_variable cv_;
+    std::mutex lock_;               // 只在析构等待阻塞线程退出时使用
     std::condition_variable cv_exit_;
+    EventCount free_event_;
     std::vector<MonoDataPtr> datas_;
+    std::unique_ptr<std::atomic<int>[]> next_;
+    std::atomic<uint64_t> head_{0};
     int capacity_ = 0;
-    volatile int num_available_ = 0;
-    volatile int num_wait_thread_ = 0;
-    volatile bool run_ = true;
+    std::atomic<int> num_available_{0};
+    std::atomic<int> num_wait_thread_{0};
+    std::atomic<bool> run_{true};
+
+    std::atomic<int> peak_in_use_{0};
+    std::atomic<uint64_t> num_query_{0};
+    std::atomic<uint64_t> num_wait_{0};
+    std::atomic<uint64_t> num_timeout_{0};
 };
 
-#endif // MONOPOLY_ALLOCATOR_HPP
\ No newline at end of file
+#endif // MONOPOLY_ALLOCATOR_HPP
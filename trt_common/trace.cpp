@@ -0,0 +1,148 @@
+#include "trace.hpp"
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+#include <unistd.h>
+#include "ilogger.hpp"
+
+using namespace std;
+
+namespace Trace{
+
+    struct Event{
+        const char* name;
+        int64_t begin_ns;
+        int64_t end_ns;
+    };
+
+    /// 每个线程一个，只有所属线程写入；count 之前的 event 写完之后不再修改，save 可以并发读取
+    struct ThreadBuffer{
+        int tid = 0;
+        string name;                         // 受 g_lock 保护
+        unique_ptr<Event[]> events;
+        int capacity = 0;
+        atomic<int> count{0};
+        atomic<uint64_t> dropped{0};
+    };
+
+    static mutex g_lock;
+    static atomic<int> g_capacity{1 << 16};
+    static atomic<int64_t> g_origin_ns{0};
+
+    /// 线程退出之后缓冲区仍然保留到进程结束，故意不析构
+    static vector<shared_ptr<ThreadBuffer>>& buffers(){
+        static auto items = new vector<shared_ptr<ThreadBuffer>>();
+        return *items;
+    }
+
+    static ThreadBuffer* this_thread_buffer(){
+        thread_local ThreadBuffer* buffer = nullptr;
+        if(buffer == nullptr){
+            auto item = make_shared<ThreadBuffer>();
+            unique_lock<mutex> l(g_lock);
+            item->tid  = buffers().size() + 1;
+            item->name = iLogger::format("thread-%d", item->tid);
+            buffers().emplace_back(item);
+            buffer = item.get();
+        }
+        return buffer;
+    }
+
+    int64_t now_ns(){
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void start(int max_events_per_thread){
+        g_capacity = max(1, max_events_per_thread);
+        int64_t expected = 0;
+        g_origin_ns.compare_exchange_strong(expected, now_ns());
+        enabled_flag() = true;
+    }
+
+    void stop(){
+        enabled_flag() = false;
+    }
+
+    void set_thread_name(const string& name){
+        auto buffer = this_thread_buffer();
+        unique_lock<mutex> l(g_lock);
+        buffer->name = name;
+    }
+
+    void record(const char* name, int64_t begin_ns, int64_t end_ns){
+        auto buffer = this_thread_buffer();
+        if(buffer->events == nullptr){
+            buffer->capacity = g_capacity.load();
+            buffer->events.reset(new Event[buffer->capacity]);
+        }
+
+        int count = buffer->count.load(memory_order_relaxed);
+        if(count >= buffer->capacity){
+            buffer->dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+
+        buffer->events[count] = Event{name, begin_ns, end_ns};
+        buffer->count.store(count + 1, memory_order_release);
+    }
+
+    static string escape(const string& s){
+        string output;
+        for(char c : s){
+            if(c == '"' || c == '\\') output.push_back('\\');
+            output.push_back(c);
+        }
+        return output;
+    }
+
+    bool save(const string& file){
+
+        vector<shared_ptr<ThreadBuffer>> items;
+        vector<string> names;
+        {
+            unique_lock<mutex> l(g_lock);
+            items = buffers();
+            for(auto& item : items)
+                names.emplace_back(item->name);
+        }
+
+        FILE* f = iLogger::fopen_mkdirs(file, "wb");
+        if(f == nullptr){
+            INFOE("Open %s failed", file.c_str());
+            return false;
+        }
+
+        int pid = getpid();
+        int64_t origin = g_origin_ns.load();
+        uint64_t num_events = 0, num_dropped = 0;
+        bool first = true;
+
+        fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+        for(int i = 0; i < items.size(); ++i){
+            auto& item = items[i];
+            fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",", pid, item->tid, escape(names[i]).c_str());
+            first = false;
+
+            int count = item->count.load(memory_order_acquire);
+            for(int j = 0; j < count; ++j){
+                auto& e = item->events[j];
+                fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                        e.name, pid, item->tid, (e.begin_ns - origin) / 1000.0, (e.end_ns - e.begin_ns) / 1000.0);
+            }
+            num_events  += count;
+            num_dropped += item->dropped.load(memory_order_relaxed);
+        }
+        fprintf(f, "\n]}\n");
+        fclose(f);
+
+        if(num_dropped > 0)
+            INFOW("Trace buffer is full, %llu spans dropped", (unsigned long long)num_dropped);
+        INFO("Save %llu spans of %d threads to %s", (unsigned long long)num_events, (int)items.size(), file.c_str());
+        return true;
+    }
+
+}; // namespace Trace
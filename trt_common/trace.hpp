@@ -0,0 +1,73 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+/// Scoped Profiler
+/// TRACE_SCOPE("name") 记录当前作用域的起止时间，保存为 Chrome / Perfetto 的 trace event JSON
+/// （chrome://tracing 或 ui.perfetto.dev 打开），可以在一条时间线上看到预处理、推理、跟踪线程的重叠
+///
+/// 只有定义了 LINFER_WITH_TRACE（cmake -DUSE_TRACE=ON）时宏才展开，否则不产生任何代码；
+/// 编译进来之后还需要 Trace::start 打开，没有打开时一个 span 的开销是一次 relaxed 原子读
+/// 每个线程写自己的缓冲区（单写者，不加锁），写满之后丢弃新的 span
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+namespace Trace{
+
+    inline std::atomic<bool>& enabled_flag(){
+        static std::atomic<bool> flag{false};
+        return flag;
+    }
+
+    inline bool enabled(){
+        return enabled_flag().load(std::memory_order_relaxed);
+    }
+
+    /// max_events_per_thread：每个线程最多记录的 span 数，缓冲区在线程第一次记录时分配
+    void start(int max_events_per_thread = 1 << 16);
+    void stop();
+
+    /// 保存已经记录的所有 span，可以在记录过程中调用
+    bool save(const std::string& file);
+
+    /// 时间线上显示的线程名
+    void set_thread_name(const std::string& name);
+
+    int64_t now_ns();
+
+    /// name 必须是字符串常量（只保存指针）
+    void record(const char* name, int64_t begin_ns, int64_t end_ns);
+
+    class Scope{
+    public:
+        explicit Scope(const char* name) : name_(name){
+            begin_ns_ = enabled() ? now_ns() : -1;
+        }
+
+        ~Scope(){
+            if(begin_ns_ >= 0) record(name_, begin_ns_, now_ns());
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator = (const Scope&) = delete;
+
+    private:
+        const char* name_;
+        int64_t begin_ns_;
+    };
+
+}; // namespace Trace
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b)      TRACE_CONCAT_IMPL(a, b)
+
+#ifdef LINFER_WITH_TRACE
+#   define TRACE_SCOPE(name)       Trace::Scope TRACE_CONCAT(__trace_scope_, __LINE__)(name)
+#   define TRACE_THREAD_NAME(name) Trace::set_thread_name(name)
+#else
+#   define TRACE_SCOPE(name)       ((void)0)
+#   define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+#endif // TRACE_HPP
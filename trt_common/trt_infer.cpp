@@ -7,6 +7,8 @@
 #include <map>
 #include "cuda_tools.hpp"
 #include "ilogger.hpp"
+#include "infer_capture.hpp"
+#include "trace.hpp"
 
 
 using namespace std;
@@ -146,9 +148,12 @@ namespace TRT {
         int device() override;
         size_t get_device_memory_size() override;
         std::shared_ptr<MixMemory> get_workspace() override;
+        void set_job_keys(const std::vector<JobKey>& keys) override;
+        bool uses_job_keys() override { return capture_ != nullptr; }
 
     private:
         void build_engine_input_and_output_mapper();
+        void capture_outputs(int batch);
 
     private:
         vector<shared_ptr<Tensor>> inputs_;
@@ -165,6 +170,9 @@ namespace TRT {
         vector<void*> bindings_ptr_; // 存放输入输出的GPU内存地址的指针，用来传给enqueueV2函数
         shared_ptr<MixMemory> workspace_; // 所有输入输出Tensor共有的workspace，主要用来存仿射变换的矩阵
         int device_id_ = 0;
+        shared_ptr<InferCapture> capture_; // 为空表示不录制
+        vector<vector<uint8_t>> capture_buffers_; // 录制时输出拷贝到这里，不改变输出 Tensor 的 head
+        vector<JobKey> job_keys_; // 下一次 forward 的 batch 对应的 job，只在录制时使用
     };
 
 
@@ -200,9 +208,12 @@ namespace TRT {
         }
 
         workspace_.reset(new MixMemory{});
+        workspace_->set_owner("engine");
         cudaGetDevice(&device_id_);
 
         build_engine_input_and_output_mapper();
+        if(is_capture_enabled())
+            capture_ = InferCapture::open(capture_file_of(file), this);
         return true;
     }
 
@@ -226,6 +237,7 @@ namespace TRT {
             auto newTensor = make_shared<Tensor>(dims.nbDims, dims.d);
             newTensor->set_stream(context_->stream_);
             newTensor->set_workspace(workspace_);
+            newTensor->set_owner("engine");
             if(context_->engine_->bindingIsInput(i)){
                 // input
                 inputs_.push_back(newTensor);
@@ -246,6 +258,7 @@ namespace TRT {
     }
 
     void InferImpl::forward(bool sync) {
+        TRACE_SCOPE("forward");
         int inputBatchSize = inputs_[0]->shape(0);
 
         for(int i = 0; i < context_->engine_->getNbBindings(); ++i){
@@ -270,9 +283,34 @@ namespace TRT {
             INFOF("Enqueue failed, code %d[%s], message %s", code, cudaGetErrorName(code), cudaGetErrorString(code));
         }
 
+        if(capture_) capture_outputs(inputBatchSize);
         if(sync) synchronize();
     }
 
+    void InferImpl::capture_outputs(int batch) {
+        capture_buffers_.resize(outputs_.size());
+        vector<const void*> host_ptrs(outputs_.size());
+        vector<vector<int>> dims(outputs_.size());
+        for(int i = 0; i < outputs_.size(); ++i){
+            auto& output = outputs_[i];
+            auto& buffer = capture_buffers_[i];
+            dims[i] = output->dims();
+            dims[i][0] = batch;
+
+            size_t bytes = (size_t)batch * output->bytes(1);
+            buffer.resize(bytes);
+            checkCudaRuntime(cudaMemcpyAsync(buffer.data(), output->gpu(), bytes, cudaMemcpyDeviceToHost, context_->stream_));
+            host_ptrs[i] = buffer.data();
+        }
+        checkCudaRuntime(cudaStreamSynchronize(context_->stream_));
+        capture_->record(batch, job_keys_, host_ptrs, dims);
+        job_keys_.clear();
+    }
+
+    void InferImpl::set_job_keys(const std::vector<JobKey>& keys) {
+        if(capture_) job_keys_ = keys;
+    }
+
     std::shared_ptr<Tensor> InferImpl::input(int index) {
         if(index < 0 || index >= inputs_.size())
             INFOF("Input index[%d] out of range [size=%d]", index, inputs_.size());
@@ -442,7 +480,63 @@ namespace TRT {
         return workspace_;
     }
 
+    static Backend g_default_backend = Backend::TensorRT;
+
+    const char* backend_name(Backend backend){
+        switch(backend){
+            case Backend::TensorRT: return "TensorRT";
+            case Backend::CPU: return "CPU";
+            case Backend::Replay: return "Replay";
+            default: return "Unknow";
+        }
+    }
+
+    bool parse_backend(const string& name, Backend& backend){
+        string lower = name;
+        transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if(lower == "tensorrt" || lower == "trt" || lower == "gpu"){
+            backend = Backend::TensorRT;
+            return true;
+        }
+        if(lower == "cpu" || lower == "onnx"){
+            backend = Backend::CPU;
+            return true;
+        }
+        if(lower == "replay"){
+            backend = Backend::Replay;
+            return true;
+        }
+        return false;
+    }
+
+    void set_default_backend(Backend backend){
+        g_default_backend = backend;
+    }
+
+    Backend get_default_backend(){
+        return g_default_backend;
+    }
+
+    static bool is_onnx_file(const string& file){
+        const string suffix = ".onnx";
+        return file.size() >= suffix.size() &&
+               file.compare(file.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
     shared_ptr<Infer> load_infer(const string& file){
+        if(capture_file_of(file) == file)
+            return load_infer(file, Backend::Replay);
+        if(is_onnx_file(file))
+            return load_infer(file, Backend::CPU);
+        return load_infer(file, g_default_backend);
+    }
+
+    shared_ptr<Infer> load_infer(const string& file, Backend backend){
+        if(backend == Backend::CPU)
+            return load_cpu_infer(file);
+        if(backend == Backend::Replay)
+            return load_replay_infer(file);
+
         shared_ptr<InferImpl> instance{new InferImpl{}};
         if(!instance->load(file)) instance.reset();
         return instance;
@@ -15,6 +15,12 @@ namespace TRT {
     /// -------------- 封装接口类，对外只提供接口，具体实现逻辑在子类中 ---------------
     /// ------------------------------------------------------------------------
 
+    /// batch 中一项对应的 job：提交时的 stream id 和该 stream 内的帧序号（没有 stream 时为 -1 和提交顺序）
+    struct JobKey{
+        int stream = -1;
+        uint64_t frame = 0;
+    };
+
 	class Infer {
 	public:
         virtual void forward(bool sync = true) = 0;
@@ -46,14 +52,61 @@ namespace TRT {
         virtual int device() = 0;
         virtual size_t get_device_memory_size() = 0;
         virtual std::shared_ptr<MixMemory> get_workspace() = 0;
+
+        /// 下一次 forward 的 batch 中每一项对应的 job，录制按它保存，Replay 按它查找，forward 之后失效；其他后端忽略
+        virtual void set_job_keys(const std::vector<JobKey>& keys) {}
+        /// 正在录制或者是 Replay 后端时返回 true，否则 controller 不为 job 编号，也不调用 set_job_keys
+        virtual bool uses_job_keys() { return false; }
 	};
 
 	int get_device_count();
 	int get_device();
 	void set_device(int device_id);
 
+    /// ------------------------------------------------------------------------
+    /// --------------- 执行后端：TensorRT 引擎，或者在 CPU 上运行 ONNX 模型 --------------
+    /// ------------------------------------------------------------------------
+
+    enum class Backend : int{
+        TensorRT = 0,
+        CPU      = 1,
+        Replay   = 2    // 回放录制好的输出，见 set_capture_enabled
+    };
+
+    const char* backend_name(Backend backend);
+    /// "tensorrt" / "trt" / "cpu" / "onnx" / "replay"，无法识别时返回 false
+    bool parse_backend(const std::string& name, Backend& backend);
+
+    /// 进程级默认后端，load_infer(file) 使用它，默认 TensorRT
+    void set_default_backend(Backend backend);
+    Backend get_default_backend();
+
+    /// CPU 后端的线程数（0 表示使用全部硬件线程），以及模型 batch 维度为动态时的最大 batch
+    void set_cpu_num_threads(int num_threads);
+    void set_cpu_max_batch_size(int max_batch_size);
+
     /// 加载infer，资源获取即初始化
+    /// 文件后缀为 .onnx 时总是使用 CPU 后端，.capture 时总是使用 Replay 后端，否则使用默认后端
 	std::shared_ptr<Infer> load_infer(const std::string& file);
+	std::shared_ptr<Infer> load_infer(const std::string& file, Backend backend);
+
+    /// CPU 后端：加载 ONNX 模型，forward 在 CPU 线程上执行，device() 返回 CPU_DEVICE_ID
+    std::shared_ptr<Infer> load_cpu_infer(const std::string& file);
+
+    /// 录制：开启后 TensorRT 后端每次 forward 都把输出按 job（set_job_keys 的 stream id 和帧序号）写入 capture_file_of(engine_file)
+    /// 没有调用 set_job_keys 时按 forward 的顺序编号（stream 为 -1）
+    /// 关闭时 forward 只多一次指针判断；开启时每次 forward 都会同步 stream
+    void set_capture_enabled(bool enabled);
+    bool is_capture_enabled();
+    /// engine_file + ".capture"，本身已是 .capture 时原样返回
+    std::string capture_file_of(const std::string& engine_file);
+
+    /// Replay 后端：mmap 读取 capture 文件，forward 按 set_job_keys 给出的 (stream, frame) 取出录制时同一个 job 的输出，
+    /// 与副本数、动态 batch 怎样组 batch、各副本的执行顺序无关；前提是每个 stream 由一个线程按相同的顺序提交同样的帧
+    /// 录制中没有的 job（比如录制时被 overload 策略丢弃）输出全 0 并给出警告
+    /// 没有调用 set_job_keys 时按录制的顺序依次取出（到末尾后从头循环），这时只保证单副本、单线程提交的回放一致
+    /// 输入被忽略，device() 返回 CPU_DEVICE_ID，因此 app 走 host 端的 decode 流程
+    std::shared_ptr<Infer> load_replay_infer(const std::string& file);
 
 }
 
@@ -2,6 +2,8 @@
 #include "trt_tensor.hpp"
 #include <cuda_runtime.h>
 #include "cuda_tools.hpp"
+#include "trace.hpp"
+#include "preprocess_kernel_cpu.hpp"
 #include <cuda_fp16.h>
 
 using namespace std;
@@ -9,6 +11,9 @@ using namespace std;
 namespace TRT{
 
 	inline static int get_device(int device_id){
+		if(device_id == CPU_DEVICE_ID)
+			return CPU_DEVICE_ID;
+
 		if(device_id != CURRENT_DEVICE_ID){
 			CUDATools::check_device_id(device_id);
 			return device_id;
@@ -23,11 +28,58 @@ namespace TRT{
 	///  ----------------------- MixMemory类的定义 ---------------------------
 	///  --------------------------------------------------------------------
 	
+	/// 直接调用 malloc / cudaMallocHost / cudaMalloc，CachingAllocator 的 upstream
+	class SystemAllocator : public MemoryAllocator{
+	public:
+		MemoryBlock allocate(MemoryKind kind, int device_id, size_t size) override{
+			MemoryBlock block;
+			if(kind == MemoryKind::Host){
+				// 没有 GPU 时使用普通的 host 内存，无需 pinned memory
+				block.ptr = malloc(size);
+			}else{
+				CUDATools::AutoDevice auto_device_exchange(device_id);
+				cudaError_t code = kind == MemoryKind::Pinned ? cudaMallocHost(&block.ptr, size) : cudaMalloc(&block.ptr, size);
+				if(code != cudaSuccess){
+					// 清掉这次错误，调用者（CachingAllocator）会释放缓存后重试
+					cudaGetLastError();
+					block.ptr = nullptr;
+				}
+			}
+			block.capacity = block.ptr ? size : 0;
+			return block;
+		}
+
+		void deallocate(MemoryKind kind, int device_id, const MemoryBlock& block) override{
+			if(block.ptr == nullptr) return;
+			if(kind == MemoryKind::Host){
+				free(block.ptr);
+				return;
+			}
+
+			CUDATools::AutoDevice auto_device_exchange(device_id);
+			if(kind == MemoryKind::Pinned)
+				checkCudaRuntime(cudaFreeHost(block.ptr));
+			else
+				checkCudaRuntime(cudaFree(block.ptr));
+		}
+
+		void synchronize(MemoryKind kind, int device_id) override{
+			CUDATools::AutoDevice auto_device_exchange(device_id);
+			checkCudaRuntime(cudaDeviceSynchronize());
+		}
+	};
+
+	shared_ptr<MemoryAllocator> create_system_allocator(){
+		return make_shared<SystemAllocator>();
+	}
+
 	MixMemory::MixMemory(int device_id){
 		device_id_ = get_device(device_id);
+		allocator_ = get_memory_allocator();
 	}
 
 	MixMemory::MixMemory(void* cpu, size_t cpu_size, void* gpu, size_t gpu_size){
+		allocator_ = get_memory_allocator();
 		reference_data(cpu, cpu_size, gpu, gpu_size);		
 	}
 
@@ -51,22 +103,47 @@ namespace TRT{
 
 		this->owner_cpu_ = !(cpu && cpu_size > 0);
 		this->owner_gpu_ = !(gpu && gpu_size > 0);
-		checkCudaRuntime(cudaGetDevice(&device_id_));
+		if(device_id_ != CPU_DEVICE_ID)
+			checkCudaRuntime(cudaGetDevice(&device_id_));
 	}
 
 	MixMemory::~MixMemory() {
 		release_all();
 	}
 
+	void MixMemory::set_owner(const string& owner){
+		// 已经持有的内存转到新的 owner 名下
+		if(cpu_ && owner_cpu_){
+			update_memory_stats(owner_, cpu_kind(), -(int64_t)cpu_size_);
+			update_memory_stats(owner,  cpu_kind(), cpu_size_);
+		}
+		if(gpu_ && owner_gpu_){
+			update_memory_stats(owner_, MemoryKind::Device, -(int64_t)gpu_size_);
+			update_memory_stats(owner,  MemoryKind::Device, gpu_size_);
+		}
+		owner_ = owner;
+	}
+
     // 分配 GPU 内存，返回内存地址指针
 	void* MixMemory::gpu(size_t size) {
 
+		if(device_id_ == CPU_DEVICE_ID){
+			INFOE("MixMemory on CPU device can not allocate gpu memory");
+			return nullptr;
+		}
+
 		if (gpu_size_ < size) {
 			release_gpu();
 
-			gpu_size_ = size;
+			// 按 size class 取整之后的 capacity 记为 gpu_size_，图像尺寸小幅变化时不需要重新分配
+			auto block = allocator_->allocate(MemoryKind::Device, device_id_, size);
+			Assert(block.ptr != nullptr);
+			gpu_      = block.ptr;
+			gpu_size_ = block.capacity;
+			owner_gpu_ = true;
+			update_memory_stats(owner_, MemoryKind::Device, gpu_size_);
+
 			CUDATools::AutoDevice auto_device_exchange(device_id_);
-			checkCudaRuntime(cudaMalloc(&gpu_, size));
 			checkCudaRuntime(cudaMemset(gpu_, 0, size));
 		}
 		return gpu_;
@@ -78,10 +155,12 @@ namespace TRT{
 		if (cpu_size_ < size) {
 			release_cpu();
 
-			cpu_size_ = size;
-			CUDATools::AutoDevice auto_device_exchange(device_id_);
-			checkCudaRuntime(cudaMallocHost(&cpu_, size));
-			Assert(cpu_ != nullptr);
+			auto block = allocator_->allocate(cpu_kind(), device_id_, size);
+			Assert(block.ptr != nullptr);
+			cpu_      = block.ptr;
+			cpu_size_ = block.capacity;
+			owner_cpu_ = true;
+			update_memory_stats(owner_, cpu_kind(), cpu_size_);
 			memset(cpu_, 0, size);
 		}
 		return cpu_;
@@ -90,8 +169,11 @@ namespace TRT{
 	void MixMemory::release_cpu() {
 		if (cpu_) {
 			if(owner_cpu_){
-				CUDATools::AutoDevice auto_device_exchange(device_id_);
-				checkCudaRuntime(cudaFreeHost(cpu_));
+				MemoryBlock block;
+				block.ptr      = cpu_;
+				block.capacity = cpu_size_;
+				allocator_->deallocate(cpu_kind(), device_id_, block);
+				update_memory_stats(owner_, cpu_kind(), -(int64_t)cpu_size_);
 			}
 			cpu_ = nullptr;
 		}
@@ -101,8 +183,11 @@ namespace TRT{
 	void MixMemory::release_gpu() {
 		if (gpu_) {
 			if(owner_gpu_){
-				CUDATools::AutoDevice auto_device_exchange(device_id_);
-				checkCudaRuntime(cudaFree(gpu_));
+				MemoryBlock block;
+				block.ptr      = gpu_;
+				block.capacity = gpu_size_;
+				allocator_->deallocate(MemoryKind::Device, device_id_, block);
+				update_memory_stats(owner_, MemoryKind::Device, -(int64_t)gpu_size_);
 			}
 			gpu_ = nullptr;
 		}
@@ -219,7 +304,7 @@ namespace TRT{
 	}
 
 	shared_ptr<Tensor> Tensor::clone() const{
-		auto new_tensor = make_shared<Tensor>(shape_);
+		auto new_tensor = make_shared<Tensor>(shape_, nullptr, device_id_ == CPU_DEVICE_ID ? CPU_DEVICE_ID : CURRENT_DEVICE_ID);
 		if(head_ == DataHead::Init)
 			return new_tensor;
 		
@@ -392,6 +477,9 @@ namespace TRT{
 	}
 
 	Tensor& Tensor::synchronize(){ 
+		if(device_id_ == CPU_DEVICE_ID)
+			return *this;
+
 		CUDATools::AutoDevice auto_device_exchange(this->device());
 		checkCudaRuntime(cudaStreamSynchronize(stream_));
 		return *this;
@@ -402,6 +490,7 @@ namespace TRT{
 		if (head_ == DataHead::Device)
 			return *this;
 
+		TRACE_SCOPE("Tensor::to_gpu");
 		head_ = DataHead::Device;
 		data_->gpu(bytes_);  // 分配 GPU 内存
 
@@ -417,6 +506,7 @@ namespace TRT{
 		if (head_ == DataHead::Host)
 			return *this;
 
+		TRACE_SCOPE("Tensor::to_cpu");
 		head_ = DataHead::Host;
 		data_->cpu(bytes_);
 
@@ -454,6 +544,16 @@ namespace TRT{
 		return offset_array(index_array.size(), index_array.data());
 	}
 
+	/// 与输出同样大小的 8 位 BGR 图像，用单位矩阵走 CPU 的 warp affine 核函数，一次遍历写入 CHW 的三个平面
+	static void set_norm_mat_u8(float* dst, const cv::Mat& image, const CUDAKernel::Norm& norm){
+		float identity[] = {1, 0, 0, 0, 1, 0};
+		CPUKernel::warp_affine_bilinear_and_normalize_plane(
+			image.data, image.step, image.cols, image.rows,
+			dst, image.cols, image.rows,
+			identity, 0, norm
+		);
+	}
+
 	Tensor& Tensor::set_norm_mat(int n, const cv::Mat& image, float mean[3], float std[3]) {
 		Assert(image.channels() == 3 && !image.empty());
 		Assert(ndims() == 4 && n < shape_[0]);
@@ -466,6 +566,12 @@ namespace TRT{
 		if(inputframe.size() != cv::Size(width, height))
 			cv::resize(inputframe, inputframe, cv::Size(width, height));
 
+		// 8 位图像：转换、拆分通道、归一化一次完成
+		if(CV_MAT_DEPTH(inputframe.type()) == CV_8U){
+			set_norm_mat_u8(cpu<float>(n), inputframe, CUDAKernel::Norm::mean_std(mean, std, scale));
+			return *this;
+		}
+
 		if(CV_MAT_DEPTH(inputframe.type()) != CV_32F){
 			inputframe.convertTo(inputframe, CV_32F, scale);
 		}
@@ -493,6 +599,14 @@ namespace TRT{
         if(inputframe.size() != cv::Size(width, height))
             cv::resize(inputframe, inputframe, cv::Size(width, height));
 
+        // 核函数先交换通道再归一化，mean / std 是按输入图像的通道给的，所以也要反过来
+        if(CV_MAT_DEPTH(inputframe.type()) == CV_8U){
+            float invert_mean[] = {mean[2], mean[1], mean[0]};
+            float invert_std[]  = {std[2],  std[1],  std[0]};
+            set_norm_mat_u8(cpu<float>(n), inputframe, CUDAKernel::Norm::mean_std(invert_mean, invert_std, 1.f / 255.f, CUDAKernel::ChannelType::Invert));
+            return *this;
+        }
+
         if(CV_MAT_DEPTH(inputframe.type()) != CV_32F){
             inputframe.convertTo(inputframe, CV_32F);
         }
@@ -7,11 +7,13 @@
 #include <vector>
 #include <map>
 #include <opencv2/opencv.hpp>
+#include "memory_allocator.hpp"
 
 struct CUstream_st;
 typedef CUstream_st CUStreamRaw;
 
 #define CURRENT_DEVICE_ID 0
+#define CPU_DEVICE_ID    -1   // 纯 host 内存，不调用任何 CUDA 接口（CPU 后端使用）
 
 namespace TRT {
 
@@ -48,6 +50,7 @@ namespace TRT {
         /// 是否属于我自己分配的gpu/cpu
         bool owner_gpu()  const { return owner_gpu_; }
         bool owner_cpu()  const { return owner_cpu_; }
+        bool is_host_only() const { return device_id_ == CPU_DEVICE_ID; }
 
         /// 以下三个函数为释放内存空间
         void release_gpu();
@@ -57,7 +60,16 @@ namespace TRT {
         /// 刷新内存（重新初始化）
         void reference_data(void* cpu, size_t cpu_size, void* gpu, size_t gpu_size);
 
+        /// 内存统计按 owner 归类，见 memory_stats()
+        void set_owner(const std::string& owner);
+        const std::string& owner() const { return owner_; }
+
+    private:
+        MemoryKind cpu_kind() const { return is_host_only() ? MemoryKind::Host : MemoryKind::Pinned; }
+
     private:
+        std::shared_ptr<MemoryAllocator> allocator_;   // 创建时的分配器，释放时还给它
+        std::string owner_ = "default";
         void* cpu_ = nullptr;
         size_t cpu_size_ = 0;
         bool owner_cpu_ = true;
@@ -151,6 +163,7 @@ namespace TRT {
         bool is_stream_owner() const {return stream_owner_;}
         CUStream get_stream() const{return stream_;}
         Tensor& set_stream(CUStream stream, bool owner=false){stream_ = stream; stream_owner_ = owner; return *this;}
+        Tensor& set_owner(const std::string& owner){data_->set_owner(owner); return *this;}
 
         Tensor& set_mat     (int n, const cv::Mat& image);
         Tensor& set_norm_mat(int n, const cv::Mat& image, float mean[3], float std[3]);
@@ -0,0 +1,99 @@
+#include "work_stealing_pool.hpp"
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+WorkStealingPool::WorkStealingPool(int num_threads){
+    if(num_threads < 0)
+        num_threads = max(0, (int)thread::hardware_concurrency() - 1);
+
+    for(int i = 0; i <= num_threads; ++i)
+        queues_.emplace_back(new Queue());
+    for(int i = 0; i < num_threads; ++i)
+        threads_.emplace_back(&WorkStealingPool::worker, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool(){
+    stop_ = true;
+    work_ready_.notify_all();
+    for(auto& t : threads_)
+        t.join();
+}
+
+void WorkStealingPool::run(int count, const function<void(int)>& func){
+    if(count <= 0) return;
+
+    unique_lock<mutex> run_lock(run_lock_);
+    int num_queues = queues_.size();
+    func_ = &func;
+    num_stolen_ = 0;
+    remaining_ = count;
+    // 必须在填充队列之前发布：上一轮的线程可能还在 run_one 中，一旦队列解锁就会取走任务并减少 queued_，
+    // 之后再写入会覆盖这次减少，queued_ 停在 > 0，空闲的线程在 worker 中不停地 cancel_wait 空转
+    queued_.store(count);
+
+    // 第 q 个队列分到 [count * q / num_queues, count * (q + 1) / num_queues)
+    for(int q = 0; q < num_queues; ++q){
+        auto& queue = *queues_[q];
+        unique_lock<mutex> l(queue.lock);
+        queue.items.clear();
+        for(int i = (long long)count * q / num_queues; i < (long long)count * (q + 1) / num_queues; ++i)
+            queue.items.push_back(i);
+        queue.head = 0;
+        queue.tail = queue.items.size();
+    }
+    work_ready_.notify_all();
+
+    int self = num_queues - 1;
+    while(run_one(self));
+
+    // 剩下的任务都已经被其他线程取走，等它们执行完
+    while(remaining_.load() > 0){
+        auto key = done_.prepare_wait();
+        if(remaining_.load() == 0){
+            done_.cancel_wait();
+            break;
+        }
+        done_.wait(key);
+    }
+    // 每个任务先减少 queued_ 再减少 remaining_，全部执行完时队列一定为空
+    assert(queued_.load() == 0);
+    func_ = nullptr;
+}
+
+bool WorkStealingPool::run_one(int self){
+    int num_queues = queues_.size();
+    int task = -1;
+    const function<void(int)>* func = nullptr;
+    for(int k = 0; k < num_queues && task == -1; ++k){
+        auto& queue = *queues_[(self + k) % num_queues];
+        unique_lock<mutex> l(queue.lock);
+        if(queue.head == queue.tail) continue;
+
+        // 自己的队列从头部取，保持区间内的顺序；窃取从尾部取，离队列的主人最远
+        task = k == 0 ? queue.items[queue.head++] : queue.items[--queue.tail];
+        func = func_;
+        if(k != 0) num_stolen_.fetch_add(1, memory_order_relaxed);
+    }
+    if(task == -1) return false;
+
+    queued_.fetch_sub(1);
+    (*func)(task);
+    if(remaining_.fetch_sub(1) == 1)
+        done_.notify_all();
+    return true;
+}
+
+void WorkStealingPool::worker(int self){
+    while(!stop_.load()){
+        if(run_one(self)) continue;
+
+        auto key = work_ready_.prepare_wait();
+        if(stop_.load() || queued_.load() > 0){
+            work_ready_.cancel_wait();
+            continue;
+        }
+        work_ready_.wait(key);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef WORK_STEALING_POOL_HPP
+#define WORK_STEALING_POOL_HPP
+
+/// 工作窃取线程池
+/// run(count, func) 把 [0, count) 按连续的区间分到每个线程（含调用线程）自己的队列里，
+/// 线程先从自己队列的头部取任务，取完之后从其他队列的尾部窃取，耗时不均匀的任务也能分摊到所有线程
+/// 适合一批粒度较粗的任务（比如每路视频流的一次 tracker update），队列用 mutex 保护
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <functional>
+#include "event_count.hpp"
+
+class WorkStealingPool{
+public:
+    /// num_threads 为工作线程数，不含调用 run 的线程；< 0 时为 CPU 核数 - 1，0 表示全部在调用线程上执行
+    explicit WorkStealingPool(int num_threads = -1);
+    virtual ~WorkStealingPool();
+
+    int num_threads() const{ return (int)threads_.size(); }
+
+    /// 执行 func(0) ... func(count - 1)，调用线程也参与，全部完成之后返回
+    /// 多个线程同时调用时依次执行；func 中不能再调用同一个 pool 的 run
+    void run(int count, const std::function<void(int)>& func);
+
+    /// 最近一次 run 中被窃取的任务数，用于观察负载是否均衡
+    int num_stolen() const{ return num_stolen_.load(std::memory_order_relaxed); }
+
+    /// 还在队列里没有被取走的任务数，run 返回之后应当为 0
+    int num_queued() const{ return queued_.load(); }
+
+private:
+    struct Queue{
+        std::mutex lock;
+        std::vector<int> items;
+        size_t head = 0;
+        size_t tail = 0;
+    };
+
+    void worker(int self);
+    bool run_one(int self);
+
+    std::vector<std::thread> threads_;
+    std::vector<std::unique_ptr<Queue>> queues_;    // 最后一个属于调用线程
+    const std::function<void(int)>* func_ = nullptr; // 在队列的锁内读取，和填充队列之间有 happens-before
+    std::mutex run_lock_;
+    std::atomic<int> queued_{0};                     // 还在队列里的任务
+    std::atomic<int> remaining_{0};                  // 还没有执行完的任务
+    std::atomic<int> num_stolen_{0};
+    std::atomic<bool> stop_{false};
+    EventCount work_ready_;
+    EventCount done_;
+};
+
+#endif // WORK_STEALING_POOL_HPP